@@ -1,18 +1,33 @@
-#version 330 core
+#version 440 core
 
 
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
+#ifdef MULTI_DRAW
+// material properties of the instance, from the draw data
+flat in vec4 DrawAlbedoColor;
+flat in vec4 DrawEmissiveColor;
+flat in vec4 DrawSpecular;
+vec4 albedoColor;
+vec4 emissiveColor;
+vec4 specular;
+#else
 layout (std140) uniform MaterialProperties
 {
     vec4 albedoColor;
     vec4 emissiveColor;
     vec4 specular;
 };
+#endif
 
 void main()
 {    
+    #ifdef MULTI_DRAW
+        albedoColor = DrawAlbedoColor;
+        emissiveColor = DrawEmissiveColor;
+        specular = DrawSpecular;
+    #endif
     FragColor = albedoColor;
 }
\ No newline at end of file
@@ -1,5 +1,9 @@
 #version 440 core
 
+#ifdef MULTI_DRAW
+#include "drawData.glsl"
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec3 aTangent;
@@ -17,17 +21,34 @@ layout (std140) uniform GlobalMatrices
     mat4 inverseViewMatrix;
 };
 
+#ifdef MULTI_DRAW
+flat out uint DrawMaterial;
+flat out vec4 DrawAlbedoColor;
+flat out vec4 DrawEmissiveColor;
+flat out vec4 DrawSpecular;
+#else
 layout (std140) uniform LocalMatrices
 {
     mat4 modelMatrix;
     mat4 normalMatrix;
 };
+#endif
 
  
 
 
 void main()
 {
+    #ifdef MULTI_DRAW
+        DrawData draw = GetDrawData();
+        mat4 modelMatrix = draw.modelMatrix;
+        mat4 normalMatrix = draw.normalMatrix;
+        DrawMaterial = draw.material;
+        DrawAlbedoColor = draw.albedoColor;
+        DrawEmissiveColor = draw.emissiveColor;
+        DrawSpecular = draw.specular;
+    #endif
+
     TexCoords = aTexCoords;    
     gl_Position = projectionMatrix * viewMatrix * modelMatrix * vec4(aPos, 1.0);
     ViewNormal = vec3(normalMatrix * vec4(aNormal,0.0));  
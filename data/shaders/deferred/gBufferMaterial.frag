@@ -0,0 +1,83 @@
+#version 440 core
+
+#include "normalMaps.glsl"
+#include "materials.glsl"
+
+#ifndef MATERIAL_ARRAYS_LOCATION
+#define MATERIAL_ARRAYS_LOCATION 1
+#endif
+
+layout (location = 0) out vec4 gAlbedoSpec;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gPosition;
+
+in vec2 TexCoords;
+in vec3 ViewFragPos;
+in vec3 ViewTangent;
+in vec3 ViewNormal;
+
+//Same output as gBufferTextured.frag, but the material is read from the material table, so textured and untextured
+//objects are drawn by the same program without binding anything per draw other than the material index
+#ifdef MULTI_DRAW
+flat in uint DrawMaterial;
+//The material changes between the draws of a multi draw, but the draws are batched by the texture arrays of their
+//material: taking the arrays from a uniform keeps the sampler index dynamically uniform (diffuse, normal)
+layout (location = MATERIAL_ARRAYS_LOCATION) uniform ivec2 materialArrays;
+#else
+uniform uint materialIndex;
+#endif
+
+
+//http://www.thetenthplanet.de/archives/1180
+mat3 cotangent_frame( vec3 N, vec3 p, vec2 uv ) 
+{ 
+    // get edge vectors of the pixel triangle 
+    vec3 dp1 = dFdx(p); 
+    vec3 dp2 = dFdy(p); 
+    vec2 duv1 = dFdx(uv); 
+    vec2 duv2 = dFdy(uv);   
+
+    // solve the linear system
+    vec3 dp2perp = cross(dp2, N); 
+    vec3 dp1perp = cross(N, dp1); 
+    vec3 T = dp2perp * duv1.x + dp1perp * duv2.x; 
+    vec3 B = dp2perp * duv1.y + dp1perp * duv2.y;   
+
+    // construct a scale-invariant frame but preserve the relative difference between T and B
+    float invmax = inversesqrt(max(dot(T,T), dot(B,B)));
+    return mat3(T * invmax, B * invmax, N); 
+}
+
+vec3 perturb_normal(vec3 N, vec3 V, vec2 texcoord, int normalArray, int normalTexture) 
+{
+    vec3 map = SampleNormalMap(materialTextures[normalArray], MaterialTexcoord(normalTexture, texcoord)); 
+    mat3 TBN = cotangent_frame( N, -V, texcoord ); 
+
+    return normalize( TBN * map ); 
+}
+
+void main()
+{    
+    #ifdef MULTI_DRAW
+        Material material = materials[DrawMaterial];
+        int diffuseArray = materialArrays.x;
+        int normalArray = materialArrays.y;
+    #else
+        Material material = materials[materialIndex];
+        int diffuseArray = material.diffuseTexture >> 16;
+        int normalArray = material.normalTexture >> 16;
+    #endif
+    gPosition = vec4(ViewFragPos,1.0);
+
+    gNormal = vec4(normalize(ViewNormal),0.0);
+    #ifdef NORMAL_MAPPED
+        if (material.normalTexture != NO_MATERIAL_TEXTURE)
+            gNormal = vec4(perturb_normal(normalize(ViewNormal), -ViewFragPos, TexCoords, normalArray, material.normalTexture),0.0);
+    #endif
+
+    if (material.diffuseTexture != NO_MATERIAL_TEXTURE)
+        gAlbedoSpec.rgb = SampleMaterialTexture(diffuseArray, material.diffuseTexture, TexCoords).rgb;
+    else
+        gAlbedoSpec.rgb = material.albedoColor.rgb;
+    gAlbedoSpec.a = material.specular.a;
+}  
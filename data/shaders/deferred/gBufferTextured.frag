@@ -1,5 +1,7 @@
 #version 440 core
 
+#include "normalMaps.glsl"
+
 layout (location = 0) out vec4 gAlbedoSpec;
 layout (location = 1) out vec4 gNormal;
 layout (location = 2) out vec4 gPosition;
@@ -14,12 +16,22 @@ in vec3 ViewTangent;
 in vec3 ViewNormal;
 
 
+#ifdef MULTI_DRAW
+// material properties of the instance, from the draw data
+flat in vec4 DrawAlbedoColor;
+flat in vec4 DrawEmissiveColor;
+flat in vec4 DrawSpecular;
+vec4 albedoColor;
+vec4 emissiveColor;
+vec4 specular;
+#else
 layout (std140) uniform MaterialProperties
 {
     vec4 albedoColor;
     vec4 emissiveColor;
     vec4 specular;
 };
+#endif
 
 //We define 2 sampling methods: one for when the model is textured and the other for untextured models. This allows the same shader program to be used
 //for both cases, instead of having to build and manage 2 different programs
@@ -41,8 +53,7 @@ vec3 CalcBumpedNormal()
     vec3 Tangent = normalize(ViewTangent);
     Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);
     vec3 Bitangent = cross(Tangent, Normal);
-    vec3 BumpMapNormal = texture(texture_normal1, TexCoords).xyz;
-    BumpMapNormal = 2.0 * BumpMapNormal - vec3(1.0, 1.0, 1.0);
+    vec3 BumpMapNormal = SampleNormalMap(texture_normal1, TexCoords);
     vec3 NewNormal;
     mat3 TBN = mat3(Tangent, Bitangent, Normal);
     NewNormal = TBN * BumpMapNormal;
@@ -77,8 +88,7 @@ vec3 perturb_normal(vec3 N, vec3 V, vec2 texcoord)
 {
     // assume N, the interpolated vertex normal and 
     // V, the view vector (vertex to eye) 
-    vec3 map = texture2D( texture_normal1, texcoord ).xyz; 
-    map = 2.0 * map - 1.0; 
+    vec3 map = SampleNormalMap(texture_normal1, texcoord); 
     //map.y = -map.y;
 
     mat3 TBN = cotangent_frame( N, -V, texcoord ); 
@@ -88,6 +98,11 @@ vec3 perturb_normal(vec3 N, vec3 V, vec2 texcoord)
 
 void main()
 {    
+    #ifdef MULTI_DRAW
+        albedoColor = DrawAlbedoColor;
+        emissiveColor = DrawEmissiveColor;
+        specular = DrawSpecular;
+    #endif
     gPosition = vec4(ViewFragPos,1.0);
     
     #ifdef NORMAL_MAPPED
@@ -1,6 +1,7 @@
 #version 440 core
 
 #include "lights.glsl"
+#include "normalMaps.glsl"
 
 
 out vec4 FragColor;
@@ -23,12 +24,22 @@ layout (std140) uniform GlobalMatrices
     mat4 inverseViewMatrix;
 };
 
+#ifdef MULTI_DRAW
+// material properties of the instance, from the draw data
+flat in vec4 DrawAlbedoColor;
+flat in vec4 DrawEmissiveColor;
+flat in vec4 DrawSpecular;
+vec4 albedoColor;
+vec4 emissiveColor;
+vec4 specular;
+#else
 layout (std140) uniform MaterialProperties
 {
     vec4 albedoColor;
     vec4 emissiveColor;
     vec4 specular;
 };
+#endif
 
 
 //We define 2 sampling methods: one for when the model is textured and the other for untextured models. This allows the same shader program to be used
@@ -82,8 +93,7 @@ mat3 cotangent_frame( vec3 N, vec3 p, vec2 uv ) {
 vec3 perturb_normal( vec3 N, vec3 V, vec2 texcoord ) {
     // assume N, the interpolated vertex normal and 
     // V, the view vector (vertex to eye) 
-    vec3 map = texture2D( texture_normal1, texcoord ).xyz; 
-    map = 2.0 * map - 1.0; 
+    vec3 map = SampleNormalMap(texture_normal1, texcoord); 
     map.y = -map.y;
 
     mat3 TBN = cotangent_frame( N, -V, texcoord ); 
@@ -100,8 +110,7 @@ vec3 CalcBumpedNormal()
     vec3 Tangent = normalize(ViewTangent);
     Tangent = normalize(Tangent - dot(Tangent, Normal) * Normal);
     vec3 Bitangent = normalize(cross(Tangent, Normal));
-    vec3 BumpMapNormal = texture(texture_normal1, TexCoords).xyz;
-    BumpMapNormal = 2.0 * BumpMapNormal - 1.0;
+    vec3 BumpMapNormal = SampleNormalMap(texture_normal1, TexCoords);
     vec3 NewNormal;
     mat3 TBN = mat3(Tangent, Bitangent, Normal);
     NewNormal = TBN * BumpMapNormal;
@@ -112,6 +121,11 @@ vec3 CalcBumpedNormal()
 
 void main()
 {    
+    #ifdef MULTI_DRAW
+        albedoColor = DrawAlbedoColor;
+        emissiveColor = DrawEmissiveColor;
+        specular = DrawSpecular;
+    #endif
     vec4 albedo = SampleColor();
     vec4 specMap = SampleSpecular();
 
@@ -0,0 +1,32 @@
+#pragma once
+#extension GL_ARB_shader_draw_parameters : require
+
+#ifndef DRAW_DATA_BINDING
+#define DRAW_DATA_BINDING 4
+#endif
+
+// Per draw data of the multi draws and instanced draws (MultiDrawList.h, RenderQueue.h). Each instance reads the entry
+// at the base instance of its draw plus its instance index
+struct DrawData
+{
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+    // material properties, for the programs that dont read the material table
+    vec4 albedoColor;
+    vec4 emissiveColor;
+    vec4 specular;
+    uint material;
+    uint cascadeMask;
+    uint pad0;
+    uint pad1;
+};
+
+layout (std430, binding = DRAW_DATA_BINDING) readonly buffer DrawDataBuffer
+{
+    DrawData draws[];
+};
+
+DrawData GetDrawData()
+{
+    return draws[gl_BaseInstanceARB + gl_InstanceID];
+}
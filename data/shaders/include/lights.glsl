@@ -1,3 +1,4 @@
+#pragma once
 
 #ifndef MAX_DIR_LIGHTS
 #define MAX_DIR_LIGHTS 5
@@ -0,0 +1,48 @@
+#pragma once
+
+#ifndef MATERIAL_TABLE_BINDING
+#define MATERIAL_TABLE_BINDING 3
+#endif
+
+#ifndef MATERIAL_TEXTURE_ARRAYS
+#define MATERIAL_TEXTURE_ARRAYS 16
+#endif
+
+#define NO_MATERIAL_TEXTURE -1
+
+// Scene materials, filled by MaterialTable.h. Textures are referenced as (array << 16) | layer
+struct Material
+{
+    vec4 albedoColor;
+    vec4 emissiveColor;
+    vec4 specular;
+    int diffuseTexture;
+    int normalTexture;
+    int pad0;
+    int pad1;
+};
+
+layout (std430, binding = MATERIAL_TABLE_BINDING) readonly buffer MaterialTable
+{
+    Material materials[];
+};
+
+uniform sampler2DArray materialTextures[MATERIAL_TEXTURE_ARRAYS];
+
+// The array of a texture can only be selected with a dynamically uniform index, i.e. the material has to be the same
+// for the whole draw
+vec3 MaterialTexcoord(int textureRef, vec2 texcoord)
+{
+    return vec3(texcoord, float(textureRef & 0xFFFF));
+}
+
+vec4 SampleMaterialTexture(int textureRef, vec2 texcoord)
+{
+    return texture(materialTextures[textureRef >> 16], MaterialTexcoord(textureRef, texcoord));
+}
+
+// Same, with the array given apart (e.g. by a uniform, when the material isnt the same for the whole draw)
+vec4 SampleMaterialTexture(int array, int textureRef, vec2 texcoord)
+{
+    return texture(materialTextures[array], MaterialTexcoord(textureRef, texcoord));
+}
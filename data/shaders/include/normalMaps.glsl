@@ -0,0 +1,16 @@
+#pragma once
+
+// Normal maps may be stored with only two channels (BC5 / RG textures), so z is always reconstructed from xy.
+// For three channel maps this gives the same result as long as the stored normals are unit length
+vec3 SampleNormalMap(sampler2D normalMap, vec2 texcoord)
+{
+    vec2 xy = 2.0 * texture(normalMap, texcoord).rg - 1.0;
+    return vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy))));
+}
+
+// Same, for a layer of a texture array (texcoord.z is the layer)
+vec3 SampleNormalMap(sampler2DArray normalMaps, vec3 texcoord)
+{
+    vec2 xy = 2.0 * texture(normalMaps, texcoord).rg - 1.0;
+    return vec3(xy, sqrt(max(0.0, 1.0 - dot(xy, xy))));
+}
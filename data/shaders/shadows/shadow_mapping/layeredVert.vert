@@ -1,9 +1,23 @@
 #version 440 core
+
+#ifdef MULTI_DRAW
+#include "drawData.glsl"
+#endif
+
 layout (location = 0) in vec3 aPos;
-    
+
+#ifdef MULTI_DRAW
+out uint vCascadeMask;
+#else
 uniform mat4 modelMatrix;
+#endif
     
 void main()
 {
+    #ifdef MULTI_DRAW
+        DrawData draw = GetDrawData();
+        mat4 modelMatrix = draw.modelMatrix;
+        vCascadeMask = draw.cascadeMask;
+    #endif
     gl_Position = modelMatrix * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -1,7 +1,14 @@
 #version 440
 
+#ifdef MULTI_DRAW
+#include "materials.glsl"
 
+#ifndef MATERIAL_ARRAYS_LOCATION
+#define MATERIAL_ARRAYS_LOCATION 1
+#endif
+#else
 uniform sampler2D texture_diffuse1;
+#endif
 layout(r32ui) uniform uimage2DArray voxelTextures;
 layout(r32ui) uniform uimage3D voxel3DData;
 
@@ -15,6 +22,9 @@ in vec3 viewNormal;
 in vec3 voxelTexCoord;
 
 flat in uint domInd;
+#ifdef MULTI_DRAW
+flat in uint DrawMaterial;
+#endif
 
 
 #include "lights.glsl"
@@ -30,12 +40,17 @@ layout (std140) uniform GlobalMatrices
 	mat4 inverseVoxelMatrix;
 };
 
+#ifdef MULTI_DRAW
+//texture arrays of the batch being drawn (diffuse, normal), see gBufferMaterial.frag
+layout (location = MATERIAL_ARRAYS_LOCATION) uniform ivec2 materialArrays;
+#else
 layout (std140) uniform MaterialProperties
 {
     vec4 albedoColor;
     vec4 emissiveColor;
     vec4 specular;
 };
+#endif
 
 
 
@@ -113,6 +128,16 @@ uint packRG11B10(uvec3 dataIn)
 
 
 
+#ifdef MULTI_DRAW
+//the material of the draw comes from the material table, textured or not
+vec4 SampleColor()
+{
+	Material material = materials[DrawMaterial];
+	if (material.diffuseTexture != NO_MATERIAL_TEXTURE)
+		return vec4(SampleMaterialTexture(materialArrays.x, material.diffuseTexture, TexCoords).rgb, 1.0f);
+	return material.albedoColor;
+}
+#else
 //We define 2 sampling methods: one for when the model is textured and the other for untextured models. This allows the same shader program to be used
 //for both cases, instead of having to build and manage 2 different programs
 subroutine vec4 GetColor();
@@ -124,6 +149,7 @@ layout(index = 1) subroutine(GetColor)
 vec4 TextureColor() {return vec4(texture(texture_diffuse1, TexCoords).rgb, 1.0f);}
 
 layout(location = 0) subroutine uniform GetColor SampleColor;
+#endif
 
 
 
@@ -1,5 +1,9 @@
 #version 440 core
 
+#ifdef MULTI_DRAW
+#include "drawData.glsl"
+#endif
+
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 3) in vec2 aTexCoords;
@@ -17,17 +21,27 @@ layout (std140) uniform GlobalMatrices
     mat4 inverseVoxelMatrix;
 };
 
+#ifdef MULTI_DRAW
+out uint vMaterial;
+#else
 layout (std140) uniform LocalMatrices
 {
     mat4 modelMatrix;
     mat4 normalMatrix;
 };
+#endif
 
  
 
 
 void main()
 {
+    #ifdef MULTI_DRAW
+        DrawData draw = GetDrawData();
+        mat4 modelMatrix = draw.modelMatrix;
+        mat4 normalMatrix = draw.normalMatrix;
+        vMaterial = draw.material;
+    #endif
     vTexCoords = aTexCoords;    
     vNormal = normalMatrix * vec4(aNormal, 0.0f);
     vWorldPos =  modelMatrix * vec4(aPos, 1.0f);
@@ -0,0 +1,285 @@
+#ifndef CULLING_KERNEL_H
+#define CULLING_KERNEL_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+#include "MathUtils.h"
+#include "JobSystem.h"
+
+/*
+ * Flat frustum culling of large object lists. The world bounds (sphere and box) of the objects are stored as SoA float
+ * arrays and tested against several frustums in one sweep (e.g. the camera and every shadow cascade), so each block of
+ * objects is loaded once for all of them. An object is visible from a frustum when both its sphere and its box are
+ * inside or intersect all 6 planes.
+ *
+ * The tests run on blocks of 8 objects with AVX2 (or two 4 wide halves with SSE), with a scalar fallback for the last
+ * block. The visible indices are written compacted, in increasing order. Large lists are split in chunks across the job
+ * system, each chunk writing its own lists that are concatenated at the end.
+ *
+ * The SIMD paths compute every plane distance in the same order as IsVisibleReference, so the results match it exactly
+ * (as long as the compiler doesnt fuse the scalar multiply-adds on its own)
+ */
+
+namespace CullingKernel
+{
+    static constexpr unsigned int MAX_VIEWS = 8;
+    static constexpr size_t BLOCK_SIZE = 8;
+    // objects per job when the sweep is split across the job system
+    static constexpr size_t CHUNK_SIZE = 8192;
+
+    struct BoundsSoA
+    {
+        std::vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+        std::vector<float> centerX, centerY, centerZ;
+        std::vector<float> extentX, extentY, extentZ;
+
+        size_t GetCount() const
+        {
+            return sphereX.size();
+        }
+
+        void Push(const MathUtils::AABB &box, const MathUtils::Sphere &sphere)
+        {
+            sphereX.push_back(0); sphereY.push_back(0); sphereZ.push_back(0); sphereRadius.push_back(0);
+            centerX.push_back(0); centerY.push_back(0); centerZ.push_back(0);
+            extentX.push_back(0); extentY.push_back(0); extentZ.push_back(0);
+            Set(GetCount() - 1, box, sphere);
+        }
+
+        void Set(size_t index, const MathUtils::AABB &box, const MathUtils::Sphere &sphere)
+        {
+            glm::vec3 center = box.GetCenter();
+            glm::vec3 extents = box.GetExtents();
+            sphereX[index] = sphere.center.x; sphereY[index] = sphere.center.y; sphereZ[index] = sphere.center.z;
+            sphereRadius[index] = sphere.radius;
+            centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+            extentX[index] = extents.x; extentY[index] = extents.y; extentZ[index] = extents.z;
+        }
+
+        void Copy(size_t from, size_t to)
+        {
+            sphereX[to] = sphereX[from]; sphereY[to] = sphereY[from]; sphereZ[to] = sphereZ[from];
+            sphereRadius[to] = sphereRadius[from];
+            centerX[to] = centerX[from]; centerY[to] = centerY[from]; centerZ[to] = centerZ[from];
+            extentX[to] = extentX[from]; extentY[to] = extentY[from]; extentZ[to] = extentZ[from];
+        }
+
+        void PopBack()
+        {
+            sphereX.pop_back(); sphereY.pop_back(); sphereZ.pop_back(); sphereRadius.pop_back();
+            centerX.pop_back(); centerY.pop_back(); centerZ.pop_back();
+            extentX.pop_back(); extentY.pop_back(); extentZ.pop_back();
+        }
+    };
+
+    // Scalar glm version of the test, on the AoS bounds
+    inline bool IsVisibleReference(const MathUtils::Frustum &frustum, const MathUtils::AABB &box, const MathUtils::Sphere &sphere)
+    {
+        glm::vec3 center = box.GetCenter();
+        glm::vec3 extents = box.GetExtents();
+        for (int i = 0; i < 6; i++)
+        {
+            glm::vec3 normal = glm::vec3(frustum.planes[i]);
+            if (glm::dot(normal, sphere.center) + frustum.planes[i].w < -sphere.radius)
+                return false;
+            if (glm::dot(normal, center) + frustum.planes[i].w < -glm::dot(extents, glm::abs(normal)))
+                return false;
+        }
+        return true;
+    }
+
+    // planes of a view, one array per coefficient
+    struct ViewPlanes
+    {
+        float x[6], y[6], z[6], w[6];
+        float absX[6], absY[6], absZ[6];
+
+        ViewPlanes(const MathUtils::Frustum &frustum)
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                x[i] = frustum.planes[i].x; y[i] = frustum.planes[i].y; z[i] = frustum.planes[i].z; w[i] = frustum.planes[i].w;
+                absX[i] = std::abs(x[i]); absY[i] = std::abs(y[i]); absZ[i] = std::abs(z[i]);
+            }
+        }
+        ViewPlanes(){}
+    };
+
+    inline bool IsVisibleScalar(const ViewPlanes &view, const BoundsSoA &bounds, size_t i)
+    {
+        for (int p = 0; p < 6; p++)
+        {
+            float sphereDistance = view.x[p] * bounds.sphereX[i] + view.y[p] * bounds.sphereY[i] + view.z[p] * bounds.sphereZ[i] + view.w[p];
+            if (sphereDistance < -bounds.sphereRadius[i])
+                return false;
+
+            float boxDistance = view.x[p] * bounds.centerX[i] + view.y[p] * bounds.centerY[i] + view.z[p] * bounds.centerZ[i] + view.w[p];
+            float boxRadius = bounds.extentX[i] * view.absX[p] + bounds.extentY[i] * view.absY[p] + bounds.extentZ[i] * view.absZ[p];
+            if (boxDistance < -boxRadius)
+                return false;
+        }
+        return true;
+    }
+
+    // Visibility bits of the 8 objects starting at first (bit i set when first + i is visible)
+    inline uint32_t TestBlock(const ViewPlanes &view, const BoundsSoA &bounds, size_t first)
+    {
+        #if defined(__AVX2__)
+            const __m256 signBit = _mm256_set1_ps(-0.0f);
+            __m256 sx = _mm256_loadu_ps(&bounds.sphereX[first]);
+            __m256 sy = _mm256_loadu_ps(&bounds.sphereY[first]);
+            __m256 sz = _mm256_loadu_ps(&bounds.sphereZ[first]);
+            __m256 negRadius = _mm256_xor_ps(_mm256_loadu_ps(&bounds.sphereRadius[first]), signBit);
+            __m256 cx = _mm256_loadu_ps(&bounds.centerX[first]);
+            __m256 cy = _mm256_loadu_ps(&bounds.centerY[first]);
+            __m256 cz = _mm256_loadu_ps(&bounds.centerZ[first]);
+            __m256 ex = _mm256_loadu_ps(&bounds.extentX[first]);
+            __m256 ey = _mm256_loadu_ps(&bounds.extentY[first]);
+            __m256 ez = _mm256_loadu_ps(&bounds.extentZ[first]);
+
+            __m256 visible = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+            for (int p = 0; p < 6; p++)
+            {
+                __m256 px = _mm256_set1_ps(view.x[p]), py = _mm256_set1_ps(view.y[p]), pz = _mm256_set1_ps(view.z[p]), pw = _mm256_set1_ps(view.w[p]);
+
+                __m256 sphereDistance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, sx), _mm256_mul_ps(py, sy)), _mm256_mul_ps(pz, sz)), pw);
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(sphereDistance, negRadius, _CMP_NLT_UQ));
+
+                __m256 boxDistance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, cx), _mm256_mul_ps(py, cy)), _mm256_mul_ps(pz, cz)), pw);
+                __m256 boxRadius = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ex, _mm256_set1_ps(view.absX[p])), _mm256_mul_ps(ey, _mm256_set1_ps(view.absY[p]))),
+                                                 _mm256_mul_ps(ez, _mm256_set1_ps(view.absZ[p])));
+                visible = _mm256_and_ps(visible, _mm256_cmp_ps(boxDistance, _mm256_xor_ps(boxRadius, signBit), _CMP_NLT_UQ));
+            }
+            return (uint32_t)_mm256_movemask_ps(visible);
+        #elif defined(__SSE2__) || defined(_M_X64)
+            const __m128 signBit = _mm_set1_ps(-0.0f);
+            uint32_t mask = 0;
+            for (size_t half = 0; half < 2; half++)
+            {
+                size_t i = first + half * 4;
+                __m128 sx = _mm_loadu_ps(&bounds.sphereX[i]);
+                __m128 sy = _mm_loadu_ps(&bounds.sphereY[i]);
+                __m128 sz = _mm_loadu_ps(&bounds.sphereZ[i]);
+                __m128 negRadius = _mm_xor_ps(_mm_loadu_ps(&bounds.sphereRadius[i]), signBit);
+                __m128 cx = _mm_loadu_ps(&bounds.centerX[i]);
+                __m128 cy = _mm_loadu_ps(&bounds.centerY[i]);
+                __m128 cz = _mm_loadu_ps(&bounds.centerZ[i]);
+                __m128 ex = _mm_loadu_ps(&bounds.extentX[i]);
+                __m128 ey = _mm_loadu_ps(&bounds.extentY[i]);
+                __m128 ez = _mm_loadu_ps(&bounds.extentZ[i]);
+
+                __m128 visible = _mm_castsi128_ps(_mm_set1_epi32(-1));
+                for (int p = 0; p < 6; p++)
+                {
+                    __m128 px = _mm_set1_ps(view.x[p]), py = _mm_set1_ps(view.y[p]), pz = _mm_set1_ps(view.z[p]), pw = _mm_set1_ps(view.w[p]);
+
+                    __m128 sphereDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, sx), _mm_mul_ps(py, sy)), _mm_mul_ps(pz, sz)), pw);
+                    visible = _mm_and_ps(visible, _mm_cmpnlt_ps(sphereDistance, negRadius));
+
+                    __m128 boxDistance = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(px, cx), _mm_mul_ps(py, cy)), _mm_mul_ps(pz, cz)), pw);
+                    __m128 boxRadius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(ex, _mm_set1_ps(view.absX[p])), _mm_mul_ps(ey, _mm_set1_ps(view.absY[p]))),
+                                                  _mm_mul_ps(ez, _mm_set1_ps(view.absZ[p])));
+                    visible = _mm_and_ps(visible, _mm_cmpnlt_ps(boxDistance, _mm_xor_ps(boxRadius, signBit)));
+                }
+                mask |= (uint32_t)_mm_movemask_ps(visible) << (half * 4);
+            }
+            return mask;
+        #else
+            uint32_t mask = 0;
+            for (size_t i = 0; i < BLOCK_SIZE; i++)
+            {
+                if (IsVisibleScalar(view, bounds, first + i))
+                    mask |= 1 << i;
+            }
+            return mask;
+        #endif
+    }
+
+    // Culls the objects [begin, end) against every view, appending the visible indices to visibleLists[view]
+    inline void CullRange(const ViewPlanes *views, unsigned int viewCount, const BoundsSoA &bounds, size_t begin, size_t end, std::vector<uint32_t> *visibleLists)
+    {
+        size_t i = begin;
+        for (; i + BLOCK_SIZE <= end; i += BLOCK_SIZE)
+        {
+            for (unsigned int v = 0; v < viewCount; v++)
+            {
+                uint32_t mask = TestBlock(views[v], bounds, i);
+                for (uint32_t bit = 0; mask != 0; bit++, mask >>= 1)
+                {
+                    if (mask & 1)
+                        visibleLists[v].push_back((uint32_t)(i + bit));
+                }
+            }
+        }
+
+        for (; i < end; i++)
+        {
+            for (unsigned int v = 0; v < viewCount; v++)
+            {
+                if (IsVisibleScalar(views[v], bounds, i))
+                    visibleLists[v].push_back((uint32_t)i);
+            }
+        }
+    }
+
+    // Keeps the per chunk lists between calls, so culling every frame doesnt allocate
+    class MultiViewCuller
+    {
+        public:
+            // visibleLists[i] receives the indices of the objects visible from frustums[i]. When parallel, lists larger than
+            // CHUNK_SIZE are split in jobs
+            void Cull(const BoundsSoA &bounds, const MathUtils::Frustum *frustums, unsigned int frustumCount, std::vector<uint32_t> *visibleLists, bool parallel = true)
+            {
+                frustumCount = std::min(frustumCount, MAX_VIEWS);
+                ViewPlanes views[MAX_VIEWS];
+                for (unsigned int v = 0; v < frustumCount; v++)
+                {
+                    views[v] = ViewPlanes(frustums[v]);
+                    visibleLists[v].clear();
+                }
+
+                size_t count = bounds.GetCount();
+                size_t chunkCount = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+                if (!parallel || chunkCount <= 1 || JobSystem::Get().GetWorkerCount() == 0)
+                {
+                    CullRange(views, frustumCount, bounds, 0, count, visibleLists);
+                    return;
+                }
+
+                if (chunkLists.size() < chunkCount * MAX_VIEWS)
+                    chunkLists.resize(chunkCount * MAX_VIEWS);
+
+                JobSystem::Get().ParallelFor(count, CHUNK_SIZE, [&](size_t begin, size_t end){
+                    std::vector<uint32_t> *lists = &chunkLists[(begin / CHUNK_SIZE) * MAX_VIEWS];
+                    for (unsigned int v = 0; v < frustumCount; v++)
+                        lists[v].clear();
+                    CullRange(views, frustumCount, bounds, begin, end, lists);
+                });
+
+                for (size_t chunk = 0; chunk < chunkCount; chunk++)
+                {
+                    for (unsigned int v = 0; v < frustumCount; v++)
+                    {
+                        auto &list = chunkLists[chunk * MAX_VIEWS + v];
+                        visibleLists[v].insert(visibleLists[v].end(), list.begin(), list.end());
+                    }
+                }
+            }
+
+        private:
+            // [chunk * MAX_VIEWS + view]
+            std::vector<std::vector<uint32_t>> chunkLists;
+    };
+}
+
+#endif
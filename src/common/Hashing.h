@@ -0,0 +1,61 @@
+#ifndef HASHING_H
+#define HASHING_H
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <fstream>
+
+// FNV-1a 64 bits, used to key cached (cooked) assets by the contents of their source files, and the uniform names of the shaders
+namespace Hashing
+{
+    static constexpr uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+    static constexpr uint64_t FNV_PRIME = 1099511628211ull;
+
+    inline uint64_t HashBytes(const void *data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        const unsigned char *bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    // same hash over a null terminated string, usable at compile time (e.g. on string literals)
+    constexpr uint64_t HashString(const char *text, uint64_t hash = FNV_OFFSET_BASIS)
+    {
+        while (*text != 0)
+        {
+            hash ^= (unsigned char)*text++;
+            hash *= FNV_PRIME;
+        }
+        return hash;
+    }
+
+    inline bool ReadWholeFile(const std::string &path, std::string &contents)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        file.seekg(0, std::ios::end);
+        contents.resize((size_t)file.tellg());
+        file.seekg(0, std::ios::beg);
+        file.read(&contents[0], contents.size());
+        return true;
+    }
+
+    // returns 0 if the file cant be read
+    inline uint64_t HashFile(const std::string &path)
+    {
+        std::string contents;
+        if (!ReadWholeFile(path, contents))
+            return 0;
+
+        return HashBytes(contents.data(), contents.size());
+    }
+}
+
+#endif
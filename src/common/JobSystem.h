@@ -0,0 +1,359 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <algorithm>
+#include <chrono>
+
+/*
+ * Work stealing job system shared by the whole engine (scene loading, transform updates, culling, ...).
+ *
+ * Every worker owns a deque of jobs: it pushes and pops its own jobs at the back (most recent first, while its data is
+ * still in cache) and, when its deque is empty, steals the oldest job from the front of another deque. Threads that
+ * arent workers (the main thread) push to a shared deque that the workers steal from.
+ *
+ * Jobs can signal a JobCounter when they finish. Waiting on a counter doesnt block the waiting thread: it keeps
+ * executing jobs until the counter reaches zero, so waiting from inside a job is fine and with 0 workers every job
+ * simply runs on the thread that waits for it. A job can also be queued to run after a counter reaches zero (RunAfter).
+ *
+ * GL calls must stay on the main thread (the one owning the context): RunOnMainThread queues a job that only runs
+ * there, either when the main thread waits on a counter or on ExecuteMainThreadJobs (called once per frame).
+ */
+
+using Job = std::function<void()>;
+
+// Number of unfinished jobs of a group. A counter can be reused (or destroyed) after a Wait on it returns
+class JobCounter
+{
+    public:
+        bool IsDone() const
+        {
+            return pending.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+
+        struct Continuation
+        {
+            Job job;
+            JobCounter *counter;
+        };
+
+        std::atomic<unsigned int> pending{0};
+        std::mutex mutex;
+        std::vector<Continuation> continuations;
+};
+
+class JobSystem
+{
+    public:
+        // The engine wide instance, started by main (with no workers until then)
+        static JobSystem &Get()
+        {
+            static JobSystem instance;
+            return instance;
+        }
+
+        JobSystem()
+        {
+            mainThreadId = std::this_thread::get_id();
+            queues.emplace_back(new JobQueue());
+        }
+
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        ~JobSystem()
+        {
+            Stop();
+        }
+
+        // Starts workerCount worker threads. Should be called from the main thread
+        void Start(unsigned int workerCount)
+        {
+            Stop();
+            mainThreadId = std::this_thread::get_id();
+            stopping = false;
+
+            for (unsigned int i = 0; i < workerCount; i++)
+                queues.emplace_back(new JobQueue());
+            for (unsigned int i = 0; i < workerCount; i++)
+                workers.emplace_back(&JobSystem::WorkerLoop, this, i + 1);
+        }
+
+        // Joins the workers. Jobs still queued are left for the threads that wait on them
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                stopping = true;
+            }
+            jobAvailable.notify_all();
+
+            for (auto &worker : workers)
+                worker.join();
+            workers.clear();
+
+            // jobs left on the worker deques move to the shared one
+            for (size_t i = 1; i < queues.size(); i++)
+            {
+                for (auto &task : queues[i]->tasks)
+                    queues[0]->tasks.push_back(std::move(task));
+            }
+            queues.resize(1);
+        }
+
+        unsigned int GetWorkerCount() const
+        {
+            return (unsigned int)workers.size();
+        }
+
+        bool IsMainThread() const
+        {
+            return std::this_thread::get_id() == mainThreadId;
+        }
+
+        void Run(Job job, JobCounter *counter = nullptr)
+        {
+            if (counter != nullptr)
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+            Push({std::move(job), counter});
+        }
+
+        // Queues the job once dependency reaches zero (right away if it already did)
+        void RunAfter(JobCounter &dependency, Job job, JobCounter *counter = nullptr)
+        {
+            if (counter != nullptr)
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(dependency.mutex);
+                if (!dependency.IsDone())
+                {
+                    dependency.continuations.push_back({std::move(job), counter});
+                    return;
+                }
+            }
+            Push({std::move(job), counter});
+        }
+
+        // Queues a job that only runs on the main thread (e.g. GL uploads of data prepared by a worker)
+        void RunOnMainThread(Job job, JobCounter *counter = nullptr)
+        {
+            if (counter != nullptr)
+                counter->pending.fetch_add(1, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(mainThreadMutex);
+                mainThreadTasks.push_back({std::move(job), counter});
+            }
+            // wake the main thread if it sleeps inside Wait
+            jobAvailable.notify_all();
+        }
+
+        // Runs the main thread jobs queued so far. Only valid on the main thread
+        void ExecuteMainThreadJobs()
+        {
+            Task task;
+            while (PopMainThreadTask(task))
+                Execute(task);
+        }
+
+        // Executes jobs until the counter reaches zero
+        void Wait(JobCounter &counter)
+        {
+            bool mainThread = IsMainThread();
+            unsigned int queueIndex = CurrentQueueIndex();
+
+            while (!counter.IsDone())
+            {
+                Task task;
+                if ((mainThread && PopMainThreadTask(task)) || PopOrSteal(queueIndex, task))
+                {
+                    Execute(task);
+                    continue;
+                }
+
+                // nothing to help with: the remaining jobs are running on other threads
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                jobAvailable.wait_for(lock, std::chrono::microseconds(100));
+            }
+
+            // the last job decrements the counter while holding its lock: once we get the lock it no longer touches the
+            // counter, which can then be destroyed
+            std::lock_guard<std::mutex> lock(counter.mutex);
+        }
+
+        // Calls body(begin, end) over [0, count) in chunks of chunkSize elements, spread across the workers and the
+        // calling thread. Returns when every chunk is done
+        void ParallelFor(size_t count, size_t chunkSize, const std::function<void(size_t begin, size_t end)> &body)
+        {
+            chunkSize = std::max<size_t>(chunkSize, 1);
+            size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+            if (workers.empty() || chunkCount <= 1)
+            {
+                if (count > 0)
+                    body(0, count);
+                return;
+            }
+
+            JobCounter counter;
+            // the calling thread takes the first chunk itself
+            for (size_t chunk = 1; chunk < chunkCount; chunk++)
+            {
+                size_t begin = chunk * chunkSize;
+                size_t end = std::min(count, begin + chunkSize);
+                Run([&body, begin, end]{ body(begin, end); }, &counter);
+            }
+            body(0, std::min(count, chunkSize));
+            Wait(counter);
+        }
+
+    private:
+        struct Task
+        {
+            Job job;
+            JobCounter *counter = nullptr;
+        };
+
+        struct JobQueue
+        {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+        };
+
+        // queue 0 is shared by the threads that arent workers, queue i + 1 belongs to worker i
+        std::vector<std::unique_ptr<JobQueue>> queues;
+        std::vector<std::thread> workers;
+        std::thread::id mainThreadId;
+
+        std::mutex mainThreadMutex;
+        std::deque<Task> mainThreadTasks;
+
+        std::mutex sleepMutex;
+        std::condition_variable jobAvailable;
+        std::atomic<size_t> queuedCount{0};
+        bool stopping = false;
+
+        static unsigned int &ThreadQueueIndex()
+        {
+            static thread_local unsigned int index = 0;
+            return index;
+        }
+
+        unsigned int CurrentQueueIndex() const
+        {
+            unsigned int index = ThreadQueueIndex();
+            return index < queues.size() ? index : 0;
+        }
+
+        void Push(Task &&task)
+        {
+            JobQueue &queue = *queues[CurrentQueueIndex()];
+            {
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                queue.tasks.push_back(std::move(task));
+            }
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                queuedCount++;
+            }
+            jobAvailable.notify_one();
+        }
+
+        // own jobs come from the back, stolen ones from the front of the other queues
+        bool PopOrSteal(unsigned int queueIndex, Task &task)
+        {
+            if (queuedCount.load(std::memory_order_acquire) == 0)
+                return false;
+
+            {
+                JobQueue &own = *queues[queueIndex];
+                std::lock_guard<std::mutex> lock(own.mutex);
+                if (!own.tasks.empty())
+                {
+                    task = std::move(own.tasks.back());
+                    own.tasks.pop_back();
+                    queuedCount--;
+                    return true;
+                }
+            }
+
+            for (size_t i = 1; i < queues.size(); i++)
+            {
+                JobQueue &victim = *queues[(queueIndex + i) % queues.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (!victim.tasks.empty())
+                {
+                    task = std::move(victim.tasks.front());
+                    victim.tasks.pop_front();
+                    queuedCount--;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool PopMainThreadTask(Task &task)
+        {
+            std::lock_guard<std::mutex> lock(mainThreadMutex);
+            if (mainThreadTasks.empty())
+                return false;
+
+            task = std::move(mainThreadTasks.front());
+            mainThreadTasks.pop_front();
+            return true;
+        }
+
+        void Execute(Task &task)
+        {
+            task.job();
+            if (task.counter != nullptr)
+                Finish(*task.counter);
+        }
+
+        void Finish(JobCounter &counter)
+        {
+            std::vector<JobCounter::Continuation> continuations;
+            {
+                // the lock makes RunAfter either see the counter done or have its continuation released here
+                std::lock_guard<std::mutex> lock(counter.mutex);
+                if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                    return;
+                continuations.swap(counter.continuations);
+            }
+
+            for (auto &continuation : continuations)
+                Push({std::move(continuation.job), continuation.counter});
+            jobAvailable.notify_all();
+        }
+
+        void WorkerLoop(unsigned int queueIndex)
+        {
+            ThreadQueueIndex() = queueIndex;
+            while (true)
+            {
+                Task task;
+                if (PopOrSteal(queueIndex, task))
+                {
+                    Execute(task);
+                    continue;
+                }
+
+                std::unique_lock<std::mutex> lock(sleepMutex);
+                jobAvailable.wait(lock, [this]{ return stopping || queuedCount > 0; });
+                if (stopping)
+                    return;
+            }
+        }
+};
+
+#endif
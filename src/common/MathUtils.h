@@ -1,6 +1,7 @@
 #ifndef MATH_UTILS_H
 #define MATH_UTILS_H
 
+#include <cstdint>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -10,5 +11,143 @@ namespace MathUtils
     {
         return glm::transpose(glm::inverse(view * model));
     }
+
+    // Axis aligned bounding box
+    struct AABB
+    {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+
+        // Box containing this box after the transform (Arvo's method: each axis of the matrix is added to the min or 
+        // max depending on its sign)
+        AABB Transform(const glm::mat4 &transform) const
+        {
+            AABB result;
+            result.min = glm::vec3(transform[3]);
+            result.max = glm::vec3(transform[3]);
+            for (int axis = 0; axis < 3; axis++)
+            {
+                glm::vec3 a = glm::vec3(transform[axis]) * min[axis];
+                glm::vec3 b = glm::vec3(transform[axis]) * max[axis];
+                result.min += glm::min(a, b);
+                result.max += glm::max(a, b);
+            }
+            return result;
+        }
+
+        glm::vec3 GetCenter() const { return 0.5f * (min + max); }
+        glm::vec3 GetExtents() const { return 0.5f * (max - min); }
+
+        void Expand(const AABB &other)
+        {
+            min = glm::min(min, other.min);
+            max = glm::max(max, other.max);
+        }
+    };
+
+    struct Sphere
+    {
+        glm::vec3 center = glm::vec3(0.0f);
+        float radius = 0.0f;
+
+        // Sphere containing this sphere after the transform (the radius is scaled by the largest axis scale)
+        Sphere Transform(const glm::mat4 &transform) const
+        {
+            Sphere result;
+            result.center = glm::vec3(transform * glm::vec4(center, 1.0f));
+            float scale2 = glm::max(glm::dot(glm::vec3(transform[0]), glm::vec3(transform[0])), 
+                           glm::max(glm::dot(glm::vec3(transform[1]), glm::vec3(transform[1])), glm::dot(glm::vec3(transform[2]), glm::vec3(transform[2]))));
+            result.radius = radius * glm::sqrt(scale2);
+            return result;
+        }
+    };
+
+    enum FrustumTest
+    {
+        OP_FRUSTUM_OUTSIDE = 0,
+        OP_FRUSTUM_INTERSECTS = 1,
+        OP_FRUSTUM_INSIDE = 2
+    };
+
+    // View frustum as 6 planes (left, right, bottom, top, near, far), with the normals (xyz) pointing inwards:
+    // a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum
+    {
+        static constexpr uint32_t ALL_PLANES = (1 << 6) - 1;
+        static constexpr int NEAR_PLANE = 4;
+        glm::vec4 planes[6];
+
+        // Extracts the planes from a projection * view matrix (Gribb/Hartmann). With a projection matrix only, the planes
+        // are in view space. Assumes the GL clip space (-w <= z <= w)
+        static Frustum FromMatrix(const glm::mat4 &viewProjection)
+        {
+            glm::mat4 m = glm::transpose(viewProjection);
+            Frustum frustum;
+            frustum.planes[0] = m[3] + m[0];
+            frustum.planes[1] = m[3] - m[0];
+            frustum.planes[2] = m[3] + m[1];
+            frustum.planes[3] = m[3] - m[1];
+            frustum.planes[4] = m[3] + m[2];
+            frustum.planes[5] = m[3] - m[2];
+
+            for (int i = 0; i < 6; i++)
+                frustum.planes[i] /= glm::length(glm::vec3(frustum.planes[i]));
+            return frustum;
+        }
+
+        // Volume covered by a shadow map: the light frustum without its near plane, since casters between the light and
+        // the near plane still project into the map
+        static Frustum FromShadowMatrix(const glm::mat4 &lightMatrix)
+        {
+            Frustum frustum = FromMatrix(lightMatrix);
+            frustum.RemovePlane(NEAR_PLANE);
+            return frustum;
+        }
+
+        // Replaces the plane by one that contains everything (e.g. the near plane, to extrude the volume towards the eye)
+        void RemovePlane(int plane)
+        {
+            planes[plane] = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+
+        // Tests the box against the planes set on planeMask. The planes the box is fully inside of are removed from the
+        // mask, so the children of a bounding volume hierarchy only test the planes that cross their parent
+        FrustumTest Test(const AABB &box, uint32_t &planeMask) const
+        {
+            glm::vec3 center = box.GetCenter();
+            glm::vec3 extents = box.GetExtents();
+            for (int i = 0; i < 6; i++)
+            {
+                if (!(planeMask & (1 << i)))
+                    continue;
+
+                glm::vec3 normal = glm::vec3(planes[i]);
+                float distance = glm::dot(normal, center) + planes[i].w;
+                float radius = glm::dot(extents, glm::abs(normal));
+
+                if (distance < -radius)
+                    return OP_FRUSTUM_OUTSIDE;
+                if (distance >= radius)
+                    planeMask &= ~(1 << i);
+            }
+            return planeMask == 0 ? OP_FRUSTUM_INSIDE : OP_FRUSTUM_INTERSECTS;
+        }
+
+        bool Intersects(const AABB &box) const
+        {
+            uint32_t planeMask = ALL_PLANES;
+            return Test(box, planeMask) != OP_FRUSTUM_OUTSIDE;
+        }
+
+        bool Intersects(const Sphere &sphere, uint32_t planeMask = ALL_PLANES) const
+        {
+            for (int i = 0; i < 6; i++)
+            {
+                if ((planeMask & (1 << i)) && glm::dot(glm::vec3(planes[i]), sphere.center) + planes[i].w < -sphere.radius)
+                    return false;
+            }
+            return true;
+        }
+    };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,453 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+/*
+ * CPU mip chain generation for RGBA8 images, used when cooking textures so the chain is computed once and stored
+ * with the cooked texture instead of depending on the driver's glGenerateMipmap.
+ *
+ * Every level is filtered from the previous one in floating point (the intermediate levels are never requantized).
+ * Filters:
+ *  - Box: 2x2 average
+ *  - Kaiser: separable 6 tap Kaiser windowed sinc. Sharper than the box filter, with less aliasing
+ *
+ * Color data can be filtered in linear space (sRGB decode -> filter -> encode), and normal maps can be renormalized
+ * after filtering. The inner filter loops use AVX2 (2 texels per iteration) or SSE (1 texel per iteration) depending
+ * on the target, with a scalar fallback. Each call is single threaded: textures are processed in parallel by the
+ * loading workers.
+ */
+
+namespace MipGenerator
+{
+    enum MipFilter
+    {
+        OP_MIP_FILTER_BOX,
+        OP_MIP_FILTER_KAISER
+    };
+
+    struct MipSettings
+    {
+        MipFilter filter = OP_MIP_FILTER_KAISER;
+        // rgb are sRGB encoded and should be filtered in linear space. Alpha is always linear
+        bool gammaCorrect = true;
+        // rgb store a tangent space normal (n * 0.5 + 0.5) that is renormalized after filtering
+        bool renormalize = false;
+    };
+
+    // a single RGBA level stored as 4 floats per texel
+    struct FloatImage
+    {
+        unsigned int width = 0;
+        unsigned int height = 0;
+        std::vector<float> texels;
+
+        float *Row(unsigned int y) { return texels.data() + (size_t)y * width * 4; }
+        const float *Row(unsigned int y) const { return texels.data() + (size_t)y * width * 4; }
+    };
+
+    static constexpr unsigned int LINEAR_TO_SRGB_TABLE_SIZE = 4096;
+
+    inline const float *SRGBToLinearTable()
+    {
+        static const std::vector<float> table = []{
+            std::vector<float> values(256);
+            for (int i = 0; i < 256; i++)
+            {
+                float c = i / 255.0f;
+                values[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    inline const uint8_t *LinearToSRGBTable()
+    {
+        static const std::vector<uint8_t> table = []{
+            std::vector<uint8_t> values(LINEAR_TO_SRGB_TABLE_SIZE);
+            for (unsigned int i = 0; i < LINEAR_TO_SRGB_TABLE_SIZE; i++)
+            {
+                float l = i / float(LINEAR_TO_SRGB_TABLE_SIZE - 1);
+                float c = l <= 0.0031308f ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+                values[i] = (uint8_t)std::min(255.0f, std::max(0.0f, c * 255.0f + 0.5f));
+            }
+            return values;
+        }();
+        return table.data();
+    }
+
+    inline void DecodeRow(const uint8_t *source, unsigned int width, const MipSettings &settings, float *output)
+    {
+        const float *toLinear = SRGBToLinearTable();
+        for (unsigned int i = 0; i < width * 4; i++)
+        {
+            output[i] = (settings.gammaCorrect && (i & 3) != 3) ? toLinear[source[i]] : source[i] * (1.0f / 255.0f);
+        }
+    }
+
+    inline void EncodeLevel(const FloatImage &level, const MipSettings &settings, std::vector<uint8_t> &output)
+    {
+        const uint8_t *toSRGB = LinearToSRGBTable();
+        size_t texelCount = (size_t)level.width * level.height;
+        output.resize(texelCount * 4);
+
+        for (size_t t = 0; t < texelCount; t++)
+        {
+            float texel[4];
+            for (int c = 0; c < 4; c++)
+                texel[c] = std::min(1.0f, std::max(0.0f, level.texels[t * 4 + c]));
+
+            if (settings.renormalize)
+            {
+                float n[3] = {texel[0] * 2.0f - 1.0f, texel[1] * 2.0f - 1.0f, texel[2] * 2.0f - 1.0f};
+                float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+                if (length > 1e-6f)
+                {
+                    for (int c = 0; c < 3; c++)
+                        texel[c] = (n[c] / length) * 0.5f + 0.5f;
+                }
+            }
+
+            for (int c = 0; c < 4; c++)
+            {
+                if (settings.gammaCorrect && c != 3)
+                    output[t * 4 + c] = toSRGB[(unsigned int)(texel[c] * (LINEAR_TO_SRGB_TABLE_SIZE - 1) + 0.5f)];
+                else
+                    output[t * 4 + c] = (uint8_t)(texel[c] * 255.0f + 0.5f);
+            }
+        }
+    }
+
+
+
+    // Gives access to the rows of the level being downsampled. The base level is kept as RGBA8 and decoded one row at a time
+    class SourceLevel
+    {
+        public:
+            SourceLevel(const uint8_t *rgba, unsigned int width, unsigned int height, const MipSettings &settings)
+                : width(width), height(height), rgba(rgba), image(nullptr), settings(settings)
+            {
+                scratch.resize((size_t)width * 4);
+            }
+
+            SourceLevel(const FloatImage &image, const MipSettings &settings)
+                : width(image.width), height(image.height), rgba(nullptr), image(&image), settings(settings) {}
+
+            // the returned row is only valid until the next call
+            const float *GetRow(unsigned int y)
+            {
+                if (image != nullptr)
+                    return image->Row(y);
+
+                DecodeRow(rgba + (size_t)y * width * 4, width, settings, scratch.data());
+                return scratch.data();
+            }
+
+            unsigned int width;
+            unsigned int height;
+
+        private:
+            const uint8_t *rgba;
+            const FloatImage *image;
+            const MipSettings &settings;
+            std::vector<float> scratch;
+    };
+
+
+    // out = (a + b + c + d) / 4 for every texel of the output row. a/b are 2 consecutive texels on the first source row
+    // and c/d on the second
+    inline void BoxRow(const float *row0, const float *row1, unsigned int sourceWidth, unsigned int width, float *output)
+    {
+        unsigned int x = 0;
+
+        if (sourceWidth >= 2)
+        {
+            #if defined(__AVX2__)
+                const __m256 quarter = _mm256_set1_ps(0.25f);
+                for (; x + 2 <= width; x += 2)
+                {
+                    // (p0, p1), (p2, p3) of each row -> (p0, p2) + (p1, p3)
+                    __m256 a0 = _mm256_loadu_ps(row0 + x * 8);
+                    __m256 b0 = _mm256_loadu_ps(row0 + x * 8 + 8);
+                    __m256 a1 = _mm256_loadu_ps(row1 + x * 8);
+                    __m256 b1 = _mm256_loadu_ps(row1 + x * 8 + 8);
+                    __m256 sum0 = _mm256_add_ps(_mm256_permute2f128_ps(a0, b0, 0x20), _mm256_permute2f128_ps(a0, b0, 0x31));
+                    __m256 sum1 = _mm256_add_ps(_mm256_permute2f128_ps(a1, b1, 0x20), _mm256_permute2f128_ps(a1, b1, 0x31));
+                    _mm256_storeu_ps(output + x * 4, _mm256_mul_ps(_mm256_add_ps(sum0, sum1), quarter));
+                }
+            #endif
+            #if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+                const __m128 quarter4 = _mm_set1_ps(0.25f);
+                for (; x < width; x++)
+                {
+                    __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x * 8), _mm_loadu_ps(row0 + x * 8 + 4)),
+                                            _mm_add_ps(_mm_loadu_ps(row1 + x * 8), _mm_loadu_ps(row1 + x * 8 + 4)));
+                    _mm_storeu_ps(output + x * 4, _mm_mul_ps(sum, quarter4));
+                }
+            #endif
+        }
+
+        for (; x < width; x++)
+        {
+            unsigned int x0 = std::min(2 * x, sourceWidth - 1);
+            unsigned int x1 = std::min(2 * x + 1, sourceWidth - 1);
+            for (int c = 0; c < 4; c++)
+                output[x * 4 + c] = 0.25f * ((row0[x0 * 4 + c] + row0[x1 * 4 + c]) + (row1[x0 * 4 + c] + row1[x1 * 4 + c]));
+        }
+    }
+
+    inline void DownsampleBox(SourceLevel &source, FloatImage &output)
+    {
+        std::vector<float> row0((size_t)source.width * 4);
+
+        for (unsigned int y = 0; y < output.height; y++)
+        {
+            unsigned int y0 = std::min(2 * y, source.height - 1);
+            unsigned int y1 = std::min(2 * y + 1, source.height - 1);
+
+            const float *sourceRow = source.GetRow(y0);
+            std::copy(sourceRow, sourceRow + (size_t)source.width * 4, row0.begin());
+            const float *row1 = source.GetRow(y1);
+
+            BoxRow(row0.data(), row1, source.width, output.width, output.Row(y));
+        }
+    }
+
+
+
+    static constexpr int KAISER_TAPS = 6;
+
+    // Weights of a Kaiser windowed sinc for a 2x downsample. The taps are the 6 source texels around the output texel
+    // center, at distances of +-0.25, +-0.75 and +-1.25 output texels
+    inline const float *KaiserWeights()
+    {
+        static const std::vector<float> weights = []{
+            const double PI = 3.14159265358979323846;
+            const double alpha = 4.0;
+            const double windowWidth = 1.5;
+            auto besselI0 = [](double x) {
+                double sum = 1.0, term = 1.0;
+                for (int k = 1; k < 20; k++)
+                {
+                    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                    sum += term;
+                }
+                return sum;
+            };
+
+            std::vector<float> values(KAISER_TAPS);
+            double total = 0.0;
+            for (int k = 0; k < KAISER_TAPS; k++)
+            {
+                double t = std::fabs((k - 2.5) * 0.5);
+                double sinc = std::sin(PI * t) / (PI * t);
+                double ratio = t / windowWidth;
+                double window = besselI0(alpha * std::sqrt(std::max(0.0, 1.0 - ratio * ratio))) / besselI0(alpha);
+                values[k] = (float)(sinc * window);
+                total += values[k];
+            }
+            for (auto &value : values)
+                value = (float)(value / total);
+            return values;
+        }();
+        return weights.data();
+    }
+
+    // Horizontal pass. taps holds the (clamped) source texel index of every tap of every output texel, so the borders
+    // dont need a separate path
+    inline void KaiserRow(const float *source, const std::vector<unsigned int> &taps, unsigned int width, float *output)
+    {
+        const float *weights = KaiserWeights();
+        unsigned int x = 0;
+
+        #if defined(__AVX2__)
+            for (; x + 2 <= width; x += 2)
+            {
+                __m256 sum = _mm256_setzero_ps();
+                for (int k = 0; k < KAISER_TAPS; k++)
+                {
+                    __m256 texels = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(source + taps[x * KAISER_TAPS + k] * 4)),
+                                                         _mm_loadu_ps(source + taps[(x + 1) * KAISER_TAPS + k] * 4), 1);
+                    #if defined(__FMA__)
+                        sum = _mm256_fmadd_ps(texels, _mm256_set1_ps(weights[k]), sum);
+                    #else
+                        sum = _mm256_add_ps(sum, _mm256_mul_ps(texels, _mm256_set1_ps(weights[k])));
+                    #endif
+                }
+                _mm256_storeu_ps(output + x * 4, sum);
+            }
+        #endif
+        #if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+            for (; x < width; x++)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(source + taps[x * KAISER_TAPS + k] * 4), _mm_set1_ps(weights[k])));
+                _mm_storeu_ps(output + x * 4, sum);
+            }
+        #endif
+
+        for (; x < width; x++)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                float sum = 0.0f;
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum += source[taps[x * KAISER_TAPS + k] * 4 + c] * weights[k];
+                output[x * 4 + c] = sum;
+            }
+        }
+    }
+
+    // Vertical pass: weighted sum of 6 horizontally filtered rows
+    inline void KaiserColumn(const float *rows[KAISER_TAPS], unsigned int floatCount, float *output)
+    {
+        const float *weights = KaiserWeights();
+        unsigned int i = 0;
+
+        #if defined(__AVX2__)
+            for (; i + 8 <= floatCount; i += 8)
+            {
+                __m256 sum = _mm256_setzero_ps();
+                for (int k = 0; k < KAISER_TAPS; k++)
+                {
+                    #if defined(__FMA__)
+                        sum = _mm256_fmadd_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k]), sum);
+                    #else
+                        sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i), _mm256_set1_ps(weights[k])));
+                    #endif
+                }
+                _mm256_storeu_ps(output + i, sum);
+            }
+        #endif
+        #if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+            for (; i + 4 <= floatCount; i += 4)
+            {
+                __m128 sum = _mm_setzero_ps();
+                for (int k = 0; k < KAISER_TAPS; k++)
+                    sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(rows[k] + i), _mm_set1_ps(weights[k])));
+                _mm_storeu_ps(output + i, sum);
+            }
+        #endif
+
+        for (; i < floatCount; i++)
+        {
+            float sum = 0.0f;
+            for (int k = 0; k < KAISER_TAPS; k++)
+                sum += rows[k][i] * weights[k];
+            output[i] = sum;
+        }
+    }
+
+    inline void DownsampleKaiser(SourceLevel &source, FloatImage &output)
+    {
+        std::vector<unsigned int> taps((size_t)output.width * KAISER_TAPS);
+        for (unsigned int x = 0; x < output.width; x++)
+        {
+            for (int k = 0; k < KAISER_TAPS; k++)
+                taps[x * KAISER_TAPS + k] = (unsigned int)std::min(std::max(2 * (int)x - 2 + k, 0), (int)source.width - 1);
+        }
+
+        // horizontally filtered source rows. Consecutive output rows share 4 of their 6 source rows, so they are cached
+        static constexpr unsigned int CACHE_SIZE = 8;
+        std::vector<std::vector<float>> filteredRows(CACHE_SIZE, std::vector<float>((size_t)output.width * 4));
+        std::vector<int> cachedRow(CACHE_SIZE, -1);
+
+        const float *rows[KAISER_TAPS];
+        for (unsigned int y = 0; y < output.height; y++)
+        {
+            for (int k = 0; k < KAISER_TAPS; k++)
+            {
+                int sourceRow = std::min(std::max(2 * (int)y - 2 + k, 0), (int)source.height - 1);
+                unsigned int slot = sourceRow % CACHE_SIZE;
+                if (cachedRow[slot] != sourceRow)
+                {
+                    KaiserRow(source.GetRow(sourceRow), taps, output.width, filteredRows[slot].data());
+                    cachedRow[slot] = sourceRow;
+                }
+                rows[k] = filteredRows[slot].data();
+            }
+            KaiserColumn(rows, output.width * 4, output.Row(y));
+        }
+    }
+
+
+
+    // Returns levels 1 to N (down to 1x1) of the RGBA8 image, each one as RGBA8
+    inline std::vector<std::vector<uint8_t>> GenerateMipChain(const uint8_t *rgba, unsigned int width, unsigned int height, const MipSettings &settings)
+    {
+        std::vector<std::vector<uint8_t>> levels;
+        FloatImage previous;
+        FloatImage current;
+
+        while (width > 1 || height > 1)
+        {
+            current.width = std::max(1u, width / 2);
+            current.height = std::max(1u, height / 2);
+            current.texels.resize((size_t)current.width * current.height * 4);
+
+            SourceLevel source = levels.empty() ? SourceLevel(rgba, width, height, settings) : SourceLevel(previous, settings);
+            if (settings.filter == OP_MIP_FILTER_KAISER)
+                DownsampleKaiser(source, current);
+            else
+                DownsampleBox(source, current);
+
+            levels.emplace_back();
+            EncodeLevel(current, settings, levels.back());
+
+            std::swap(previous, current);
+            width = previous.width;
+            height = previous.height;
+        }
+
+        return levels;
+    }
+
+    // Same as above for images with 1 to 4 components (as decoded by stb_image). The image is expanded to RGBA for
+    // filtering: grey is replicated on rgb and missing alpha is opaque. The levels keep the component count of the source
+    inline std::vector<std::vector<uint8_t>> GenerateMipChain(const uint8_t *pixels, unsigned int width, unsigned int height, int components, const MipSettings &settings)
+    {
+        if (components == 4)
+            return GenerateMipChain(pixels, width, height, settings);
+
+        // source component of r, g, b and a (-1 = opaque)
+        const int channelMap[3][4] = {{0, 0, 0, -1}, {0, 0, 0, 1}, {0, 1, 2, -1}};
+        const int *map = channelMap[components - 1];
+        // rgba component written back for every source component
+        const int packMap[3][3] = {{0}, {0, 3}, {0, 1, 2}};
+        const int *pack = packMap[components - 1];
+
+        size_t texelCount = (size_t)width * height;
+        std::vector<uint8_t> rgba(texelCount * 4);
+        for (size_t t = 0; t < texelCount; t++)
+        {
+            for (int c = 0; c < 4; c++)
+                rgba[t * 4 + c] = map[c] < 0 ? 255 : pixels[t * components + map[c]];
+        }
+
+        std::vector<std::vector<uint8_t>> levels = GenerateMipChain(rgba.data(), width, height, settings);
+        for (auto &level : levels)
+        {
+            size_t levelTexels = level.size() / 4;
+            for (size_t t = 0; t < levelTexels; t++)
+            {
+                for (int c = 0; c < components; c++)
+                    level[t * components + c] = level[t * 4 + pack[c]];
+            }
+            level.resize(levelTexels * components);
+        }
+        return levels;
+    }
+}
+
+#endif
@@ -2,106 +2,267 @@
 #define POOL_H
 
 #include <vector>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include <utility>
 
-//This class is responsible for managing the creation of unique ids for objects
+/*
+ * Storage of objects referenced through generational ids (a slot map).
+ *
+ * Each id holds the slot of the object and the generation of that slot. Releasing an object bumps the generation, so
+ * the ids of released objects are never resolved again, even after their slot is reused (IsPresent returns false and
+ * Get asserts). Adding and releasing are O(1): the free slots are chained on a list and the objects are kept densely
+ * packed (a released object is replaced by the last one), so iterating only touches live objects.
+ *
+ * With StablePointers the objects are allocated in fixed chunks and never move, so pointers and references to them
+ * stay valid until they are released. Iteration still only visits live objects, through a packed list of their slots.
+ */
 
-template<typename T>
+template<typename T, bool StablePointers = false>
 class Pool
 {
     public:
         struct Id
         {
-            Id(size_t val) : asInt(val) {}
-            Id() : asInt(size_t(-1)) {}
-            bool operator == (const Id &other) const { return this->asInt == other.asInt; }
-            size_t asInt;
+            Id() : index(UINT32_MAX), generation(0) {}
+            Id(uint32_t index, uint32_t generation = 0) : index(index), generation(generation) {}
+            bool operator == (const Id &other) const { return index == other.index && generation == other.generation; }
+            bool operator != (const Id &other) const { return !(*this == other); }
+            bool IsValid() const { return index != UINT32_MAX; }
+            uint32_t index;
+            uint32_t generation;
         };
 
-        struct Iterator
+        template<typename PoolType, typename Element>
+        struct BasicIterator
         {
-            Iterator(Id id, Pool<T> &pool) : id(id), pool(pool)
+            BasicIterator(PoolType *pool, size_t position) : pool(pool), position(position) {}
+            Element &operator *() const
             {
-                Skip();
+                return pool->GetDense(position);
             }
-            T &operator *()
+            Element *operator ->() const
             {
-                return pool.Get(id);
+                return &pool->GetDense(position);
             }
-            void operator++()
+            BasicIterator &operator++()
             {
-                id.asInt++;
-                Skip();
+                position++;
+                return *this;
             }
-            bool operator != (const Iterator &other)
+            bool operator != (const BasicIterator &other) const
             {
-                return this->id.asInt != other.id.asInt;
+                return position != other.position;
             }
-        private:
-            void Skip()
+            bool operator == (const BasicIterator &other) const
+            {
+                return position == other.position;
+            }
+            // id of the current object
+            Id GetId() const
             {
-                for (; id.asInt < pool.GetSize() && !pool.IsPresent(id); id.asInt++);
+                return pool->GetDenseId(position);
             }
-            Id id;
-            Pool<T> &pool;
+        private:
+            PoolType *pool;
+            size_t position;
         };
+        using Iterator = BasicIterator<Pool, T>;
+        using ConstIterator = BasicIterator<const Pool, const T>;
+
+        Pool(){}
+
+        ~Pool()
+        {
+            Clear();
+        }
 
-        Iterator begin()
+        Pool(Pool &&other)
         {
-            return Iterator({ 0 }, *this);
+            *this = std::move(other);
         }
-        Iterator end()
+
+        Pool &operator = (Pool &&other)
         {
-            return Iterator({ GetSize() }, *this);
+            Clear();
+            slots = std::move(other.slots);
+            denseSlots = std::move(other.denseSlots);
+            dense = std::move(other.dense);
+            chunks = std::move(other.chunks);
+            freeSlot = other.freeSlot;
+            other.freeSlot = UINT32_MAX;
+            return *this;
         }
 
+        Iterator begin() { return Iterator(this, 0); }
+        Iterator end() { return Iterator(this, denseSlots.size()); }
+        ConstIterator begin() const { return ConstIterator(this, 0); }
+        ConstIterator end() const { return ConstIterator(this, denseSlots.size()); }
+
         Id Add(T &&elem)
         {
-            if (freeIds.size() > 0)
+            return Emplace(std::move(elem));
+        }
+
+        Id Add(const T &elem)
+        {
+            return Emplace(elem);
+        }
+
+        template<typename... Args>
+        Id Emplace(Args&&... args)
+        {
+            uint32_t index;
+            if (freeSlot != UINT32_MAX)
             {
-                Id id = { freeIds.back() };
-                freeIds.pop_back();
-                data[id.asInt] = std::move(elem);
-                isPresent[id.asInt] = true;
-                return id;
+                index = freeSlot;
+                freeSlot = slots[index].position;
             }
             else
             {
-                Id id = { data.size() };
-                data.push_back(std::move(elem));
-                isPresent.push_back(true);
-                return id;
+                index = (uint32_t)slots.size();
+                slots.push_back({0, 0});
             }
+
+            if constexpr (StablePointers)
+            {
+                if (index / CHUNK_SIZE >= chunks.size())
+                    chunks.emplace_back(new Chunk());
+                new (ChunkElement(index)) T(std::forward<Args>(args)...);
+            }
+            else
+                dense.emplace_back(std::forward<Args>(args)...);
+
+            slots[index].position = (uint32_t)denseSlots.size();
+            denseSlots.push_back(index);
+            return Id(index, slots[index].generation);
         }
 
         void Release(const Id &id)
         {
-            assert(isPresent[id.asInt]);
-            isPresent[id.asInt] = false;
-            freeIds.push_back(id);
+            assert(IsPresent(id));
+            Slot &slot = slots[id.index];
+            uint32_t position = slot.position;
+            uint32_t last = (uint32_t)denseSlots.size() - 1;
+
+            if constexpr (StablePointers)
+                ChunkElement(id.index)->~T();
+            else
+            {
+                if (position != last)
+                    dense[position] = std::move(dense[last]);
+                dense.pop_back();
+            }
+
+            denseSlots[position] = denseSlots[last];
+            slots[denseSlots[position]].position = position;
+            denseSlots.pop_back();
+
+            slot.generation++;
+            slot.position = freeSlot;
+            freeSlot = id.index;
         }
-        
+
         T &Get(const Id &id)
         {
-            assert(id.asInt != size_t(-1));
-            assert(id.asInt < data.size());
-            assert(isPresent[id.asInt]);
-            return data[id.asInt];
+            assert(IsPresent(id));
+            return GetDense(slots[id.index].position);
+        }
+
+        const T &Get(const Id &id) const
+        {
+            assert(IsPresent(id));
+            return GetDense(slots[id.index].position);
+        }
+
+        // Returns nullptr if the object was released
+        T *TryGet(const Id &id)
+        {
+            return IsPresent(id) ? &GetDense(slots[id.index].position) : nullptr;
+        }
+
+        bool IsPresent(const Id &id) const
+        {
+            if (id.index >= slots.size() || slots[id.index].generation != id.generation)
+                return false;
+            // the position of a free slot links to the next free slot, check that it really points back to it
+            uint32_t position = slots[id.index].position;
+            return position < denseSlots.size() && denseSlots[position] == id.index;
+        }
+
+        // number of live objects
+        size_t GetCount() const
+        {
+            return denseSlots.size();
+        }
+
+        // The objects are indexed [0, GetCount()) in iteration order. Releasing an object changes the order
+        T &GetDense(size_t position)
+        {
+            if constexpr (StablePointers)
+                return *ChunkElement(denseSlots[position]);
+            else
+                return dense[position];
+        }
+
+        const T &GetDense(size_t position) const
+        {
+            if constexpr (StablePointers)
+                return *ChunkElement(denseSlots[position]);
+            else
+                return dense[position];
+        }
+
+        Id GetDenseId(size_t position) const
+        {
+            uint32_t index = denseSlots[position];
+            return Id(index, slots[index].generation);
         }
-        size_t GetSize()
+
+        void Reserve(size_t count)
         {
-            return data.size();
+            slots.reserve(count);
+            denseSlots.reserve(count);
+            if constexpr (!StablePointers)
+                dense.reserve(count);
         }
-        bool IsPresent(Id id)
+
+        // Releases every object. Ids handed out before stay invalid
+        void Clear()
         {
-            return isPresent[id.asInt];
+            while (!denseSlots.empty())
+                Release(GetDenseId(denseSlots.size() - 1));
         }
+
     private:
-        std::vector<T> data;
-        std::vector<bool> isPresent;
-        std::vector<Id> freeIds;
-};
+        static constexpr uint32_t CHUNK_SIZE = 256;
+
+        struct Slot
+        {
+            // index on denseSlots while the slot is used, next free slot otherwise
+            uint32_t position;
+            uint32_t generation;
+        };
+
+        struct Chunk
+        {
+            alignas(T) unsigned char bytes[sizeof(T) * CHUNK_SIZE];
+        };
 
+        std::vector<Slot> slots;
+        std::vector<uint32_t> denseSlots;
+        std::vector<T> dense;
+        std::vector<std::unique_ptr<Chunk>> chunks;
+        uint32_t freeSlot = UINT32_MAX;
 
+        T *ChunkElement(uint32_t index) const
+        {
+            return reinterpret_cast<T*>(chunks[index / CHUNK_SIZE]->bytes) + index % CHUNK_SIZE;
+        }
 
+        Pool(const Pool&) = delete;
+        Pool &operator = (const Pool &other) = delete;
+};
 
-#endif
\ No newline at end of file
+#endif
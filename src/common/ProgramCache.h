@@ -0,0 +1,172 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include "env.h"
+
+#include "Hashing.h"
+
+// Linked programs stored with glGetProgramBinary under the build directory (SHADER_CACHE_DIR), so that warm starts and
+// shader reloads of unchanged programs skip the GLSL compilation and linking.
+//
+// A program is keyed by its stage set, the preprocessed source of each stage, its preprocessor defines and the GL
+// vendor, renderer and version strings (binaries are only valid for the driver that made them). The driver can still
+// reject a binary (e.g. after an update that kept the version string), glProgramBinary then fails to link and the
+// program is compiled from source and stored again.
+//
+// Layout: [FileHeader][binary]
+
+#define PROGRAM_CACHE_EXTENSION ".opprog"
+
+namespace ProgramCache
+{
+    static constexpr uint32_t PROGRAM_CACHE_MAGIC = 0x52504F43; // "COPR"
+    static constexpr uint32_t PROGRAM_CACHE_VERSION = 1;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t key;
+        uint32_t binaryFormat;
+        uint32_t binarySize;
+    };
+
+    // Programs built since the last reset, how many came from the cache and the time spent building them
+    struct Stats
+    {
+        size_t programs = 0;
+        size_t hits = 0;
+        double milliseconds = 0.0;
+    };
+
+    inline Stats &GetStats()
+    {
+        static Stats stats;
+        return stats;
+    }
+
+    // can be turned off to time the builds from source (e.g. --no-program-cache)
+    inline bool &Enabled()
+    {
+        static bool enabled = true;
+        return enabled;
+    }
+
+    // false when the driver doesnt support any binary format. Only valid on the GL thread
+    inline bool IsSupported()
+    {
+        static GLint formatCount = -1;
+        if (formatCount < 0)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+        return Enabled() && formatCount > 0;
+    }
+
+    inline uint64_t HashDriver()
+    {
+        static uint64_t hash = 0;
+        if (hash == 0)
+        {
+            hash = Hashing::FNV_OFFSET_BASIS;
+            const GLenum strings[3] = {GL_VENDOR, GL_RENDERER, GL_VERSION};
+            for (GLenum name : strings)
+            {
+                const char *value = (const char*)glGetString(name);
+                if (value != nullptr)
+                    hash = Hashing::HashString(value, hash);
+                hash = Hashing::HashBytes(&name, sizeof(name), hash);
+            }
+        }
+        return hash;
+    }
+
+    // Key of a program from its stages (type and preprocessed source each) and defines
+    inline uint64_t HashProgram(const std::vector<std::pair<GLenum, std::string>> &stages, const std::vector<std::string> &defines)
+    {
+        uint64_t hash = HashDriver();
+        for (const auto &stage : stages)
+        {
+            hash = Hashing::HashBytes(&stage.first, sizeof(stage.first), hash);
+            uint64_t size = stage.second.size();
+            hash = Hashing::HashBytes(&size, sizeof(size), hash);
+            hash = Hashing::HashBytes(stage.second.data(), stage.second.size(), hash);
+        }
+        for (const std::string &define : defines)
+            hash = Hashing::HashBytes(define.c_str(), define.size() + 1, hash);
+        return hash;
+    }
+
+    inline std::string GetPath(uint64_t key)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string name(16, '0');
+        for (int i = 15; i >= 0; i--, key >>= 4)
+            name[i] = digits[key & 0xF];
+        return SHADER_CACHE_DIR + name + PROGRAM_CACHE_EXTENSION;
+    }
+
+    // Loads the cached binary of the key into program, returns false when there is none or the driver rejects it
+    inline bool Load(GLuint program, uint64_t key)
+    {
+        if (!IsSupported())
+            return false;
+
+        std::string contents;
+        if (!Hashing::ReadWholeFile(GetPath(key), contents) || contents.size() < sizeof(FileHeader))
+            return false;
+
+        FileHeader header;
+        std::memcpy(&header, contents.data(), sizeof(FileHeader));
+        if (header.magic != PROGRAM_CACHE_MAGIC || header.version != PROGRAM_CACHE_VERSION || header.key != key ||
+            contents.size() != sizeof(FileHeader) + header.binarySize)
+            return false;
+
+        glProgramBinary(program, header.binaryFormat, contents.data() + sizeof(FileHeader), (GLsizei)header.binarySize);
+
+        GLint success = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        return success == GL_TRUE;
+    }
+
+    // Writes the binary of the linked program. The program has to be linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+    inline bool Store(GLuint program, uint64_t key)
+    {
+        if (!IsSupported())
+            return false;
+
+        GLint binarySize = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binarySize);
+        if (binarySize <= 0)
+            return false;
+
+        std::vector<char> binary(binarySize);
+        GLenum binaryFormat = 0;
+        glGetProgramBinary(program, binarySize, &binarySize, &binaryFormat, binary.data());
+
+        FileHeader header = FileHeader();
+        header.magic = PROGRAM_CACHE_MAGIC;
+        header.version = PROGRAM_CACHE_VERSION;
+        header.key = key;
+        header.binaryFormat = binaryFormat;
+        header.binarySize = (uint32_t)binarySize;
+
+        std::string path = GetPath(key);
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cout << "Failed to write program binary: " << path << "\n";
+            return false;
+        }
+        output.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+        output.write(binary.data(), binarySize);
+        return output.good();
+    }
+}
+
+#endif
@@ -5,23 +5,28 @@
 #include <glad/glad.h> 
 #include <string>
 #include <vector>
+#include <unordered_map>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
-#include <boost/regex.hpp>
 #include <exception>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
 #include "env.h"
 
 #include "../common/ShaderMemoryPool.h"
+#include "../common/Hashing.h"
+#include "../common/ProgramCache.h"
+#include "../common/ShaderPreprocessor.h"
 //Todo:
 /*
 - add support for spir-v compilation and separate shader objects
  */
 
-#define SHADER_INCLUDE_SUBDIR "/data/shaders/include/"
-
 
 
 class Shader
@@ -67,19 +72,28 @@ class Shader
         {
             for (auto& b: namedUniformBindings)
             {
-                BindUniformBlock(b.first, b.second.asInt);
+                BindUniformBlock(b.first, b.second.index);
             }
             
         }
 
-        // bind the property block to a binding point using its name
+        // bind the property block to a binding point using its name. Blocks the program doesnt use are skipped
         void BindUniformBlock(const std::string &block, unsigned int binding)
         {
-            unsigned int blockId = glGetUniformBlockIndex(ID, block.c_str());
-            glUniformBlockBinding(ID, blockId, binding);
+            GLuint blockIndex = GetUniformBlockIndex(UniformName(block));
+            if (blockIndex != GL_INVALID_INDEX)
+                glUniformBlockBinding(ID, blockIndex, binding);
         } 
 
 
+        // Shader and include files the program was built from, with the include edges between them (e.g. to rebuild
+        // only the programs depending on a changed file)
+        const ShaderPreprocessor::Dependencies &GetDependencies() const
+        {
+            return dependencies;
+        }
+
+
         // use (activate) the shader program
         void UseProgram()
         { 
@@ -90,64 +104,168 @@ class Shader
             glUseProgram(ID);
         }  
 
-        
-        // utility functions for setting uniforms
-        void SetBool(const std::string &name, bool value) const
-        {         
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
-        }
-        void SetUInt(const std::string &name, unsigned int value) const
-        { 
-            glUniform1ui(glGetUniformLocation(ID, name.c_str()), value); 
-        }
 
-        inline void SetSamplerBinding (const std::string &name, int value)
+        // Name of a uniform, block or subroutine, hashed at compile time when built from a string literal in a constant
+        // expression (e.g. static constexpr Shader::UniformName MODEL_MATRIX = "modelMatrix")
+        struct UniformName
         {
-            SetInt(name, value);
-        }
-        void SetInt(const std::string &name, int value) const
-        { 
-            glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
-        }
+            uint64_t hash;
+            const char *name;
 
-        void SetFloat(const std::string &name, float value) const
-        { 
-            glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
-        } 
+            constexpr UniformName(const char *name) : hash(Hashing::HashString(name)), name(name) {}
+            UniformName(const std::string &name) : hash(Hashing::HashString(name.c_str())), name(name.c_str()) {}
+        };
 
-        void SetVec2(const std::string &name, float v1, float v2) const
-        { 
-            glUniform2f(glGetUniformLocation(ID, name.c_str()), v1, v2); 
-        } 
+        // Position of a uniform on the reflection table of the program, valid until it is built again
+        struct UniformHandle
+        {
+            int32_t index = -1;
 
-        void SetVec2(const std::string &name, glm::vec2 v) const
-        { 
-            glUniform2f(glGetUniformLocation(ID, name.c_str()), v.x, v.y); 
-        } 
+            bool IsValid() const { return index >= 0; }
+        };
 
-        void SetVec3(const std::string &name, glm::vec3 v) const
-        { 
-            glUniform3f(glGetUniformLocation(ID, name.c_str()), v.x, v.y, v.z); 
-        } 
-        void SetVec3(const std::string &name, float v1, float v2, float v3) const
-        { 
-            glUniform3f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3); 
-        } 
+        // Uniform sets issued to GL and skipped because the uniform already had the value, and locations that had to be
+        // queried by name (uniforms not found on the reflection, e.g. array elements other than the first), since the
+        // last reset. Shared by every shader
+        struct UniformStats
+        {
+            size_t sets = 0;
+            size_t skippedSets = 0;
+            size_t locationQueries = 0;
+        };
 
-        void SetVec4(const std::string &name, glm::vec4 v) const
-        { 
-            glUniform4f(glGetUniformLocation(ID, name.c_str()), v.x, v.y, v.z, v.w); 
-        } 
-        void SetVec4(const std::string &name, float v1, float v2, float v3, float v4) const
-        { 
-            glUniform4f(glGetUniformLocation(ID, name.c_str()), v1, v2, v3, v4); 
-        } 
+        static UniformStats &GetUniformStats()
+        {
+            static UniformStats stats;
+            return stats;
+        }
 
-        void SetMat4(const std::string &name, glm::mat4 mat4, GLboolean transpose = GL_FALSE)
+        UniformHandle GetUniformHandle(UniformName name)
         {
-            glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, transpose, glm::value_ptr(mat4)); 
+            auto reflectedEnd = uniforms.begin() + reflectedUniformCount;
+            auto it = std::lower_bound(uniforms.begin(), reflectedEnd, name.hash, [](const UniformEntry &entry, uint64_t hash){
+                return entry.hash < hash;
+            });
+            if (it != reflectedEnd && it->hash == name.hash)
+                return {(int32_t)(it - uniforms.begin())};
+
+            // not an active uniform by that name, queried once and appended after the reflected ones, so the
+            // handles given before stay valid
+            for (size_t i = reflectedUniformCount; i < uniforms.size(); i++)
+            {
+                if (uniforms[i].hash == name.hash)
+                    return {(int32_t)i};
+            }
+            GetUniformStats().locationQueries++;
+            UniformEntry entry;
+            entry.hash = name.hash;
+            entry.location = glGetUniformLocation(ID, name.name);
+            uniforms.push_back(entry);
+            return {(int32_t)(uniforms.size() - 1)};
         }
 
+        GLuint GetUniformBlockIndex(UniformName name) const
+        {
+            for (const NamedIndex &block : uniformBlocks)
+            {
+                if (block.hash == name.hash)
+                    return block.index;
+            }
+            return GL_INVALID_INDEX;
+        }
+
+        // index of a fragment subroutine function and location of a fragment subroutine uniform, as reflected at link time
+        GLuint GetSubroutineIndex(UniformName name) const
+        {
+            for (const NamedIndex &subroutine : subroutines)
+            {
+                if (subroutine.hash == name.hash)
+                    return subroutine.index;
+            }
+            return GL_INVALID_INDEX;
+        }
+
+        GLint GetSubroutineUniformLocation(UniformName name) const
+        {
+            for (const NamedIndex &subroutineUniform : subroutineUniforms)
+            {
+                if (subroutineUniform.hash == name.hash)
+                    return (GLint)subroutineUniform.index;
+            }
+            return -1;
+        }
+
+        
+        // utility functions for setting uniforms. The values are set on the program (it doesnt need to be in use) and
+        // skipped when the uniform already has them
+        void SetBool(UniformHandle handle, bool value)
+        {
+            SetInt(handle, (int)value);
+        }
+        void SetUInt(UniformHandle handle, unsigned int value)
+        {
+            if (CacheValue(handle, &value, sizeof(value)))
+                glProgramUniform1ui(ID, uniforms[handle.index].location, value);
+        }
+        void SetInt(UniformHandle handle, int value)
+        {
+            if (CacheValue(handle, &value, sizeof(value)))
+                glProgramUniform1i(ID, uniforms[handle.index].location, value);
+        }
+        void SetFloat(UniformHandle handle, float value)
+        {
+            if (CacheValue(handle, &value, sizeof(value)))
+                glProgramUniform1f(ID, uniforms[handle.index].location, value);
+        }
+        void SetVec2(UniformHandle handle, glm::vec2 v)
+        {
+            if (CacheValue(handle, &v, sizeof(v)))
+                glProgramUniform2f(ID, uniforms[handle.index].location, v.x, v.y);
+        }
+        void SetIVec2(UniformHandle handle, glm::ivec2 v)
+        {
+            if (CacheValue(handle, &v, sizeof(v)))
+                glProgramUniform2i(ID, uniforms[handle.index].location, v.x, v.y);
+        }
+        // count consecutive elements of a vec4 array, from the first. Arrays larger than a mat4 are always set
+        void SetVec4Array(UniformHandle handle, const glm::vec4 *values, unsigned int count)
+        {
+            if (CacheValue(handle, values, count * sizeof(glm::vec4)))
+                glProgramUniform4fv(ID, uniforms[handle.index].location, (GLsizei)count, glm::value_ptr(values[0]));
+        }
+        void SetVec3(UniformHandle handle, glm::vec3 v)
+        {
+            if (CacheValue(handle, &v, sizeof(v)))
+                glProgramUniform3f(ID, uniforms[handle.index].location, v.x, v.y, v.z);
+        }
+        void SetVec4(UniformHandle handle, glm::vec4 v)
+        {
+            if (CacheValue(handle, &v, sizeof(v)))
+                glProgramUniform4f(ID, uniforms[handle.index].location, v.x, v.y, v.z, v.w);
+        }
+        void SetMat4(UniformHandle handle, glm::mat4 mat4, GLboolean transpose = GL_FALSE)
+        {
+            if (transpose)
+                mat4 = glm::transpose(mat4);
+            if (CacheValue(handle, &mat4, sizeof(mat4)))
+                glProgramUniformMatrix4fv(ID, uniforms[handle.index].location, 1, GL_FALSE, glm::value_ptr(mat4));
+        }
+
+        // same by name, looked up on the reflection table
+        void SetBool(UniformName name, bool value) { SetBool(GetUniformHandle(name), value); }
+        void SetUInt(UniformName name, unsigned int value) { SetUInt(GetUniformHandle(name), value); }
+        inline void SetSamplerBinding(UniformName name, int value) { SetInt(GetUniformHandle(name), value); }
+        void SetInt(UniformName name, int value) { SetInt(GetUniformHandle(name), value); }
+        void SetFloat(UniformName name, float value) { SetFloat(GetUniformHandle(name), value); }
+        void SetVec2(UniformName name, float v1, float v2) { SetVec2(GetUniformHandle(name), glm::vec2(v1, v2)); }
+        void SetVec2(UniformName name, glm::vec2 v) { SetVec2(GetUniformHandle(name), v); }
+        void SetIVec2(UniformName name, glm::ivec2 v) { SetIVec2(GetUniformHandle(name), v); }
+        void SetVec3(UniformName name, glm::vec3 v) { SetVec3(GetUniformHandle(name), v); }
+        void SetVec3(UniformName name, float v1, float v2, float v3) { SetVec3(GetUniformHandle(name), glm::vec3(v1, v2, v3)); }
+        void SetVec4(UniformName name, glm::vec4 v) { SetVec4(GetUniformHandle(name), v); }
+        void SetVec4(UniformName name, float v1, float v2, float v3, float v4) { SetVec4(GetUniformHandle(name), glm::vec4(v1, v2, v3, v4)); }
+        void SetMat4(UniformName name, glm::mat4 mat4, GLboolean transpose = GL_FALSE) { SetMat4(GetUniformHandle(name), mat4, transpose); }
+
 
         class ShaderException: public std::exception
         {
@@ -168,80 +286,197 @@ class Shader
         bool isReady = false;
         std::vector<std::string> preDefines;
 
+        // uniform outside blocks with the last value set (up to a mat4). The active ones come first, sorted by name hash,
+        // followed by the names queried later in lookup order
+        struct UniformEntry
+        {
+            uint64_t hash = 0;
+            GLint location = -1;
+            bool hasValue = false;
+            alignas(16) unsigned char value[64];
+        };
 
+        struct NamedIndex
+        {
+            uint64_t hash;
+            GLuint index;
+        };
 
-        std::string PreProcessShader(std::string &source, const std::string &filePath, unsigned int level, bool versionMatch = false)
+        std::vector<UniformEntry> uniforms;
+        size_t reflectedUniformCount = 0;
+        std::vector<NamedIndex> uniformBlocks;
+        std::vector<NamedIndex> subroutines;
+        std::vector<NamedIndex> subroutineUniforms;
+
+        // Reflects the active uniforms (samplers included), uniform blocks and, with a fragment stage, the fragment
+        // subroutines of the linked program, so nothing is looked up by name afterwards
+        void ReflectProgram(bool hasFragmentStage)
         {
-            if(level > 32)
-                throw ShaderException("the" + filePath + "header inclusion reached depth limit (32), might be caused by cyclic header inclusion");
+            uniforms.clear();
+            uniformBlocks.clear();
+            subroutines.clear();
+            subroutineUniforms.clear();
+
+            ForEachResource(GL_UNIFORM, [&](GLuint resource, const std::string &name){
+                const GLenum properties[2] = {GL_LOCATION, GL_BLOCK_INDEX};
+                GLint values[2];
+                glGetProgramResourceiv(ID, GL_UNIFORM, resource, 2, properties, 2, NULL, values);
+                if (values[1] != -1)
+                    return;
+
+                UniformEntry entry;
+                entry.hash = Hashing::HashString(name.c_str());
+                entry.location = values[0];
+                uniforms.push_back(entry);
+
+                // arrays are reflected as name[0], and can be set by name alone too
+                size_t bracket = name.find("[0]");
+                if (bracket != std::string::npos && bracket + 3 == name.size())
+                {
+                    entry.hash = Hashing::HashString(name.substr(0, bracket).c_str());
+                    uniforms.push_back(entry);
+                }
+            });
+            std::sort(uniforms.begin(), uniforms.end(), [](const UniformEntry &a, const UniformEntry &b){
+                return a.hash < b.hash;
+            });
+            reflectedUniformCount = uniforms.size();
 
-            static const boost::regex re("^[ ]*#[ ]*include[ ]+[\"<](.*)[\">].*");
-            static const std::string includeDir = BASE_DIR  SHADER_INCLUDE_SUBDIR;
+            ForEachResource(GL_UNIFORM_BLOCK, [&](GLuint resource, const std::string &name){
+                uniformBlocks.push_back({Hashing::HashString(name.c_str()), resource});
+            });
 
-            static const boost::regex ver("^[ ]*#[ ]*version[ ]+(.*).*");
-            static bool hasPreDefines;
+            if (hasFragmentStage)
+            {
+                ForEachResource(GL_FRAGMENT_SUBROUTINE, [&](GLuint resource, const std::string &name){
+                    subroutines.push_back({Hashing::HashString(name.c_str()), resource});
+                });
+                ForEachResource(GL_FRAGMENT_SUBROUTINE_UNIFORM, [&](GLuint resource, const std::string &name){
+                    GLuint location = (GLuint)glGetProgramResourceLocation(ID, GL_FRAGMENT_SUBROUTINE_UNIFORM, name.c_str());
+                    subroutineUniforms.push_back({Hashing::HashString(name.c_str()), location});
+                });
+            }
+        }
 
-            std::stringstream input;
-            std::stringstream output;
-            input << source;
+        template<typename Visitor>
+        void ForEachResource(GLenum programInterface, Visitor &&visitor)
+        {
+            GLint count = 0, maxLength = 0;
+            glGetProgramInterfaceiv(ID, programInterface, GL_ACTIVE_RESOURCES, &count);
+            glGetProgramInterfaceiv(ID, programInterface, GL_MAX_NAME_LENGTH, &maxLength);
 
-            size_t line_number = 1;
-            boost::smatch reMatches;
-            boost::smatch verMatches;
-            
-            std::string line;
+            std::vector<char> name(std::max(maxLength, 1));
+            for (GLint i = 0; i < count; i++)
+            {
+                GLsizei length = 0;
+                glGetProgramResourceName(ID, programInterface, (GLuint)i, (GLsizei)name.size(), &length, name.data());
+                visitor((GLuint)i, std::string(name.data(), length));
+            }
+        }
 
+        // Keeps the value of a uniform, returns false when it already had it (or the program doesnt use the uniform).
+        // Values larger than the cached one arent kept and are always set
+        bool CacheValue(UniformHandle handle, const void *value, size_t size)
+        {
+            if (!handle.IsValid() || uniforms[handle.index].location < 0)
+                return false;
 
-            while(std::getline(input,line))
+            UniformEntry &entry = uniforms[handle.index];
+            if (size > sizeof(entry.value))
             {
-                if(!versionMatch)
-                {
-                    hasPreDefines = false;
-                    versionMatch = boost::regex_search(line, verMatches, ver);
+                entry.hasValue = false;
+                GetUniformStats().sets++;
+                return true;
+            }
+            if (entry.hasValue && std::memcmp(entry.value, value, size) == 0)
+            {
+                GetUniformStats().skippedSets++;
+                return false;
+            }
+
+            std::memcpy(entry.value, value, size);
+            entry.hasValue = true;
+            GetUniformStats().sets++;
+            return true;
+        }
 
-                    if(versionMatch)
-                        output <<  line << std::endl;
 
-                    ++line_number;
-                    continue;
-                }
 
-                if (!hasPreDefines)
+        // preprocessed source of every stage, paired with its type
+        typedef std::vector<std::pair<GLenum, std::string>> ShaderStages;
+
+        // files of the program, gathered while its stages are preprocessed
+        ShaderPreprocessor::Dependencies dependencies;
+
+        std::string PreProcessFile(const std::string& srcPath)
+        {
+            try
+            {
+                return ShaderPreprocessor::Get().Process(srcPath, preDefines, &dependencies);
+            }
+            catch(const std::runtime_error &e)
+            {
+                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+                throw ShaderException("Shader construction failed. " + std::string(e.what()));
+            }
+        }
+
+        // Creates the program from its preprocessed stages, from the program cache when it has the binary, otherwise
+        // compiled, linked and stored in the cache
+        void CreateProgram(const ShaderStages &stages, const char *errorPrefix)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            ProgramCache::Stats &stats = ProgramCache::GetStats();
+            stats.programs++;
+
+            uint64_t key = ProgramCache::HashProgram(stages, preDefines);
+            ID = glCreateProgram();
+            bool cached = ProgramCache::Load(ID, key);
+
+            if (cached)
+            {
+                stats.hits++;
+            }
+            else
+            {
+                std::vector<GLuint> shaderPipeline;
+                for (const auto &stage : stages)
+                    shaderPipeline.push_back(CompileShader(stage.second, stage.first));
+
+                for (size_t i = 0; i < shaderPipeline.size(); i++)
                 {
-                    for (size_t i = 0; i < preDefines.size(); i++)
-                    {
-                        output << "#define " <<  preDefines[i] << std::endl;
-                    }
-                    
-                    hasPreDefines = true;
+                    glAttachShader(ID, shaderPipeline[i]);
                 }
-                
-                
-                if (boost::regex_search(line, reMatches, re))
+                glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+                glLinkProgram(ID);
+
+                int success;
+                char infoLog[512];
+
+                // print linking errors if any
+                glGetProgramiv(ID, GL_LINK_STATUS, &success);
+                if(!success)
                 {
-                    std::string include_file = reMatches[1];
-                    std::string include_string = ReadShaderFile(includeDir + include_file);
-                    
-                    output << PreProcessShader(include_string, include_file, level + 1, versionMatch) << std::endl;
+                    glGetProgramInfoLog(ID, 512, NULL, infoLog);
+                    std::cout << errorPrefix << "::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+                    throw ShaderException("Shader linking failed\n");
                 }
-                else
+
+                // delete the shaders as they're linked into the program now and therefore are longer necessary
+                for (size_t i = 0; i < shaderPipeline.size(); i++)
                 {
-                    
-                    output <<  line << std::endl;
-                    output << "#line "<< line_number << " \"" << filePath << "\""  << std::endl;
+                    glDetachShader(ID, shaderPipeline[i]);
+                    glDeleteShader(shaderPipeline[i]);
                 }
-                ++line_number;
+
+                ProgramCache::Store(ID, key);
             }
 
-            return output.str();
+            stats.milliseconds += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
         }
 
-        
-        GLuint CompileShader(const std::string& srcPath, GLenum ShaderType)
+        GLuint CompileShader(const std::string& ppSrcCode, GLenum ShaderType)
         {
-            std::string srcCode = ReadShaderFile(srcPath);
-            std::string ppSrcCode = PreProcessShader(srcCode, srcPath, 0);
-
             const char* shaderCode = ppSrcCode.c_str();
 
             GLuint shaderObject;
@@ -285,34 +520,6 @@ class Shader
             };
             return shaderObject;
         }
-
-        std::string ReadShaderFile(std::string path)
-        {
-            std::string sourceCode = "";
-            std::ifstream file;
-            // ensure ifstream objects can throw exceptions:
-            file.exceptions (std::ifstream::failbit | std::ifstream::badbit);
-            try 
-            {
-                // open files
-                file.open(path);
-                std::stringstream shaderStream;
-                // read file's buffer contents into streams
-                shaderStream << file.rdbuf();
-
-                // close file handlers
-                file.close();
-                // convert stream into string
-                sourceCode = shaderStream.str();	
-            }
-            catch(std::ifstream::failure e)
-            {
-                std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
-                throw ShaderException("Shader construction failed. Cannot read file: " + path);
-            }
-
-            return sourceCode;
-        }
 };
 
 
@@ -349,58 +556,30 @@ class StandardShader : public Shader
         // virtual function
         void BuildProgram()
         {
-            // compile shaders:
-            unsigned int vertex, fragment;
-            int success;
-            char infoLog[512];
-            
-            std::vector<GLuint> shaderPipeline;
+            ShaderStages stages;
+            dependencies.Clear();
 
             // 1) Vertex shader
             // ----------------
-            vertex = CompileShader(vertexShaderPath, GL_VERTEX_SHADER);
-            shaderPipeline.push_back(vertex);
+            stages.push_back({GL_VERTEX_SHADER, PreProcessFile(vertexShaderPath)});
             
             // 2) Fragment shader
             // ------------------
-            fragment = CompileShader(fragmentShaderPath, GL_FRAGMENT_SHADER);
-            shaderPipeline.push_back(fragment);
+            stages.push_back({GL_FRAGMENT_SHADER, PreProcessFile(fragmentShaderPath)});
 
             // 3) Additional Shaders
             // ---------------------
             if (additionalShaderStages.find(GL_GEOMETRY_SHADER) != additionalShaderStages.end())
             {
-                GLuint geometry = CompileShader(additionalShaderStages[GL_GEOMETRY_SHADER], GL_GEOMETRY_SHADER);
-                shaderPipeline.push_back(geometry);
+                stages.push_back({GL_GEOMETRY_SHADER, PreProcessFile(additionalShaderStages[GL_GEOMETRY_SHADER])});
             }
 
 
             // Linking the final program
             // -------------------------
-            ID = glCreateProgram();
-
-            for (size_t i = 0; i < shaderPipeline.size(); i++)
-            {
-                glAttachShader(ID, shaderPipeline[i]);
-            }
-            glLinkProgram(ID);
-
-            // print linking errors if any
-            glGetProgramiv(ID, GL_LINK_STATUS, &success);
-            if(!success)
-            {
-                glGetProgramInfoLog(ID, 512, NULL, infoLog);
-                std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-                throw ShaderException("Shader linking failed\n");
-                
-            }
-            
-            // delete the shaders as they're linked into the program now and therefore are longer necessary
-            for (size_t i = 0; i < shaderPipeline.size(); i++)
-            {
-                glDeleteShader(shaderPipeline[i]);
-            }
+            CreateProgram(stages, "ERROR::SHADER");
 
+            ReflectProgram(true);
             isReady = true;
         }
 
@@ -433,28 +612,10 @@ class ComputeShader : public Shader
 
         void BuildProgram()
         {
-	        GLuint computeShader = CompileShader(computeShaderPath, GL_COMPUTE_SHADER);
-            
-            ID = glCreateProgram();
-            glAttachShader(ID, computeShader);
-            glLinkProgram(ID);
-
-            int success;
-            char infoLog[512];
-
-            // print linking errors if any
-            glGetProgramiv(ID, GL_LINK_STATUS, &success);
-            if(!success)
-            {
-                glGetProgramInfoLog(ID, 512, NULL, infoLog);
-                std::cout << "ERROR::COMPUTE_SHADER::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
-                throw ShaderException("Shader linking failed\n");
-                
-            }
-            
-            glDetachShader(ID, computeShader);
-            glDeleteShader(computeShader);
+            dependencies.Clear();
+            CreateProgram({{GL_COMPUTE_SHADER, PreProcessFile(computeShaderPath)}}, "ERROR::COMPUTE_SHADER");
 
+            ReflectProgram(false);
             isReady = true;
             
         }
@@ -3,6 +3,7 @@
 
 #include "../common/Pool.h"
 #include "../gl/GLBuffer.h"
+#include <unordered_map>
 
 
 
@@ -21,7 +22,7 @@ class ShaderMemoryPool
         {
             GLUniformBuffer buffer(size, name);
             namedUniformBindings[name] = uniformBuffers.Add(std::move(buffer));
-            GetUniformBuffer(name)->BindBufferFull(namedUniformBindings[name].asInt);
+            GetUniformBuffer(name)->BindBufferFull(namedUniformBindings[name].index);
         }
 
         GLUniformBuffer *GetUniformBuffer(const std::string &name)
@@ -31,7 +32,7 @@ class ShaderMemoryPool
 
         GLuint GetUniformBufferBinding(const std::string &name)
         {
-            return namedUniformBindings[name].asInt;
+            return namedUniformBindings[name].index;
         }
 
         std::unordered_map<std::string, UniformBufferBinding> GetNamedBindings()
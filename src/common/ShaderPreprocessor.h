@@ -0,0 +1,371 @@
+#ifndef SHADER_PREPROCESSOR_H
+#define SHADER_PREPROCESSOR_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cctype>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <stdexcept>
+#include <filesystem>
+#include "env.h"
+
+#include "Hashing.h"
+
+#define SHADER_INCLUDE_SUBDIR "/data/shaders/include/"
+
+/*
+ * Expands the #include directives of the GLSL sources and adds the preprocessor defines of a program after #version.
+ *
+ * Every file (shader or include) is read and scanned once into segments: runs of plain lines copied as they are, and
+ * the directives the expansion needs (#version, #include, #pragma once). The parsed files are kept in memory and only
+ * read again when their size or modification time changes, so building the programs of a renderer (and reloading them)
+ * mostly concatenates cached text. Includes are resolved in SHADER_INCLUDE_SUBDIR, a file with #pragma once is expanded
+ * once per stage, and a #line directive follows the start and end of every include so errors keep their file and line.
+ *
+ * Process has no state besides the file cache (guarded by a mutex), so the stages of many programs can be preprocessed
+ * in parallel from the job system.
+ */
+
+class ShaderPreprocessor
+{
+    public:
+        // includes nested deeper than this are assumed to be cyclic
+        static constexpr unsigned int MAX_INCLUDE_DEPTH = 32;
+
+        // Files a stage (or program) was built from: files[0] is the shader itself, each edge goes from the including
+        // file to the included one (indices into files)
+        struct Dependencies
+        {
+            std::vector<std::string> files;
+            std::vector<std::pair<uint32_t, uint32_t>> edges;
+
+            uint32_t AddFile(const std::string &file)
+            {
+                for (size_t i = 0; i < files.size(); i++)
+                {
+                    if (files[i] == file)
+                        return (uint32_t)i;
+                }
+                files.push_back(file);
+                return (uint32_t)(files.size() - 1);
+            }
+
+            void AddEdge(uint32_t from, uint32_t to)
+            {
+                for (const auto &edge : edges)
+                {
+                    if (edge.first == from && edge.second == to)
+                        return;
+                }
+                edges.push_back({from, to});
+            }
+
+            void Merge(const Dependencies &other)
+            {
+                for (const auto &edge : other.edges)
+                    AddEdge(AddFile(other.files[edge.first]), AddFile(other.files[edge.second]));
+                for (const std::string &file : other.files)
+                    AddFile(file);
+            }
+
+            bool Contains(const std::string &file) const
+            {
+                for (const std::string &dependency : files)
+                {
+                    if (dependency == file)
+                        return true;
+                }
+                return false;
+            }
+
+            void Clear()
+            {
+                files.clear();
+                edges.clear();
+            }
+        };
+
+        // The instance shared by every shader
+        static ShaderPreprocessor &Get()
+        {
+            static ShaderPreprocessor instance;
+            return instance;
+        }
+
+        // Preprocessed source of the shader file at path. Throws std::runtime_error when a file cant be read or the
+        // includes are nested too deep
+        std::string Process(const std::string &path, const std::vector<std::string> &defines, Dependencies *dependencies = nullptr)
+        {
+            std::shared_ptr<const ParsedFile> file = GetFile(path);
+            if (!file)
+                throw std::runtime_error("Cannot read shader file: " + path);
+
+            Expansion expansion;
+            expansion.output.reserve(file->text.size() * 2);
+            expansion.dependencies = dependencies;
+            if (dependencies != nullptr)
+                dependencies->AddFile(path);
+
+            // everything before #version is dropped, the defines go right after it
+            size_t first = 0;
+            for (size_t i = 0; i < file->segments.size(); i++)
+            {
+                const Segment &segment = file->segments[i];
+                if (segment.type == OP_SEGMENT_VERSION)
+                {
+                    expansion.output.append(file->text, segment.begin, segment.end - segment.begin);
+                    if (expansion.output.back() != '\n')
+                        expansion.output += '\n';
+                    first = i + 1;
+                    break;
+                }
+            }
+            for (const std::string &define : defines)
+            {
+                expansion.output += "#define ";
+                expansion.output += define;
+                expansion.output += '\n';
+            }
+            if (first > 0)
+                AppendLine(expansion.output, file->segments[first - 1].line + 1, path);
+
+            Expand(*file, path, first, 0, expansion);
+            return std::move(expansion.output);
+        }
+
+        // Drops the cached files, they are read again on their next use
+        void ClearCache()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            files.clear();
+        }
+
+        std::string GetIncludePath(const std::string &include) const
+        {
+            return BASE_DIR SHADER_INCLUDE_SUBDIR + include;
+        }
+
+    private:
+        enum SegmentType
+        {
+            OP_SEGMENT_TEXT,
+            OP_SEGMENT_VERSION,
+            OP_SEGMENT_INCLUDE,
+            OP_SEGMENT_PRAGMA_ONCE
+        };
+
+        // a range of lines of the file text. Includes keep the included name instead
+        struct Segment
+        {
+            SegmentType type;
+            size_t begin;
+            size_t end;
+            // line of the directive (1 based)
+            uint32_t line;
+            std::string include;
+        };
+
+        struct ParsedFile
+        {
+            std::string text;
+            std::vector<Segment> segments;
+            bool pragmaOnce = false;
+            std::uintmax_t size = 0;
+            std::filesystem::file_time_type writeTime;
+        };
+
+        struct Expansion
+        {
+            std::string output;
+            Dependencies *dependencies = nullptr;
+            // files with #pragma once already expanded
+            std::vector<std::shared_ptr<const ParsedFile>> expandedOnce;
+        };
+
+        std::mutex mutex;
+        std::unordered_map<std::string, std::shared_ptr<const ParsedFile>> files;
+
+        static void AppendLine(std::string &output, uint32_t line, const std::string &file)
+        {
+            output += "#line ";
+            output += std::to_string(line);
+            output += " \"";
+            output += file;
+            output += "\"\n";
+        }
+
+        void Expand(const ParsedFile &file, const std::string &name, size_t firstSegment, unsigned int depth, Expansion &expansion)
+        {
+            if (depth > MAX_INCLUDE_DEPTH)
+                throw std::runtime_error("the " + name + " header inclusion reached depth limit (32), might be caused by cyclic header inclusion");
+
+            uint32_t fileIndex = expansion.dependencies != nullptr ? expansion.dependencies->AddFile(depth == 0 ? name : GetIncludePath(name)) : 0;
+
+            for (size_t i = firstSegment; i < file.segments.size(); i++)
+            {
+                const Segment &segment = file.segments[i];
+                switch (segment.type)
+                {
+                    case OP_SEGMENT_TEXT:
+                    case OP_SEGMENT_VERSION:
+                        expansion.output.append(file.text, segment.begin, segment.end - segment.begin);
+                        break;
+
+                    case OP_SEGMENT_PRAGMA_ONCE:
+                        // kept as an empty line so the numbering doesnt change
+                        expansion.output += '\n';
+                        break;
+
+                    case OP_SEGMENT_INCLUDE:
+                    {
+                        std::string includePath = GetIncludePath(segment.include);
+                        std::shared_ptr<const ParsedFile> include = GetFile(includePath);
+                        if (!include)
+                            throw std::runtime_error("Cannot read shader include: " + includePath + " (included by " + name + ")");
+
+                        if (expansion.dependencies != nullptr)
+                            expansion.dependencies->AddEdge(fileIndex, expansion.dependencies->AddFile(includePath));
+
+                        bool skip = false;
+                        if (include->pragmaOnce)
+                        {
+                            for (const auto &expanded : expansion.expandedOnce)
+                                skip = skip || expanded == include;
+                            if (!skip)
+                                expansion.expandedOnce.push_back(include);
+                        }
+
+                        if (!skip)
+                        {
+                            AppendLine(expansion.output, 1, segment.include);
+                            Expand(*include, segment.include, 0, depth + 1, expansion);
+                            if (!expansion.output.empty() && expansion.output.back() != '\n')
+                                expansion.output += '\n';
+                        }
+                        AppendLine(expansion.output, segment.line + 1, name);
+                        break;
+                    }
+                }
+            }
+        }
+
+        // The parsed file from the cache, read again if it changed on disk. Null when it cant be read
+        std::shared_ptr<const ParsedFile> GetFile(const std::string &path)
+        {
+            std::error_code error;
+            std::uintmax_t size = std::filesystem::file_size(path, error);
+            std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(path, error);
+            if (error)
+                return nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = files.find(path);
+                if (it != files.end() && it->second->size == size && it->second->writeTime == writeTime)
+                    return it->second;
+            }
+
+            auto file = std::make_shared<ParsedFile>();
+            if (!Hashing::ReadWholeFile(path, file->text))
+                return nullptr;
+            file->size = size;
+            file->writeTime = writeTime;
+            Parse(*file);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            files[path] = file;
+            return file;
+        }
+
+        // compares the word at position of line (up to end) and moves position past it
+        static bool MatchWord(const std::string &text, size_t &position, size_t end, const char *word)
+        {
+            size_t length = std::char_traits<char>::length(word);
+            if (position + length > end || text.compare(position, length, word) != 0)
+                return false;
+            if (position + length < end && (std::isalnum((unsigned char)text[position + length]) || text[position + length] == '_'))
+                return false;
+
+            position += length;
+            return true;
+        }
+
+        static void SkipSpaces(const std::string &text, size_t &position, size_t end)
+        {
+            while (position < end && (text[position] == ' ' || text[position] == '\t'))
+                position++;
+        }
+
+        // single pass over the lines of the file, splitting it in segments
+        static void Parse(ParsedFile &file)
+        {
+            const std::string &text = file.text;
+            uint32_t line = 1;
+            size_t lineStart = 0;
+            size_t textStart = 0;
+
+            auto flushText = [&](size_t end){
+                if (end > textStart)
+                    file.segments.push_back({OP_SEGMENT_TEXT, textStart, end, 0, std::string()});
+            };
+
+            while (lineStart < text.size())
+            {
+                size_t lineEnd = text.find('\n', lineStart);
+                size_t next = lineEnd == std::string::npos ? text.size() : lineEnd + 1;
+                if (lineEnd == std::string::npos)
+                    lineEnd = text.size();
+
+                size_t position = lineStart;
+                SkipSpaces(text, position, lineEnd);
+                if (position < lineEnd && text[position] == '#')
+                {
+                    position++;
+                    SkipSpaces(text, position, lineEnd);
+
+                    if (MatchWord(text, position, lineEnd, "version"))
+                    {
+                        flushText(lineStart);
+                        file.segments.push_back({OP_SEGMENT_VERSION, lineStart, next, line, std::string()});
+                        textStart = next;
+                    }
+                    else if (MatchWord(text, position, lineEnd, "include"))
+                    {
+                        SkipSpaces(text, position, lineEnd);
+                        char close = position < lineEnd && text[position] == '<' ? '>' : '"';
+                        if (position < lineEnd && (text[position] == '"' || text[position] == '<'))
+                        {
+                            size_t nameEnd = text.find(close, position + 1);
+                            if (nameEnd != std::string::npos && nameEnd < lineEnd)
+                            {
+                                flushText(lineStart);
+                                std::string include = text.substr(position + 1, nameEnd - position - 1);
+                                file.segments.push_back({OP_SEGMENT_INCLUDE, lineStart, next, line, include});
+                                textStart = next;
+                            }
+                        }
+                    }
+                    else if (MatchWord(text, position, lineEnd, "pragma"))
+                    {
+                        SkipSpaces(text, position, lineEnd);
+                        if (MatchWord(text, position, lineEnd, "once"))
+                        {
+                            flushText(lineStart);
+                            file.segments.push_back({OP_SEGMENT_PRAGMA_ONCE, lineStart, next, line, std::string()});
+                            file.pragmaOnce = true;
+                            textStart = next;
+                        }
+                    }
+                }
+
+                lineStart = next;
+                line++;
+            }
+            flushText(text.size());
+        }
+};
+
+#endif
@@ -0,0 +1,89 @@
+#ifndef TRANSFORM_KERNEL_H
+#define TRANSFORM_KERNEL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <xmmintrin.h>
+#endif
+
+#include "JobSystem.h"
+
+/*
+ * Normal matrices of many objects for one view in a single sweep, instead of an inverse per object and pass.
+ *
+ * The normal matrix transpose(inverse(view * model)) is also transpose(inverse(model) * inverse(view)). The inverse of
+ * the model matrix is kept by the ObjectStore (recomputed only when the transform changes, so never for static objects)
+ * and the inverse of the view is shared by every object, which leaves one 4x4 multiply and a transpose per object, done
+ * 4 wide with SSE (scalar glm otherwise). Large lists are split in chunks across the job system.
+ */
+
+namespace TransformKernel
+{
+    // objects per job when the sweep is split across the job system
+    static constexpr size_t CHUNK_SIZE = 4096;
+
+    // Scalar glm version, same result as MathUtils::ComputeNormalMatrix up to rounding
+    inline glm::mat4 NormalMatrixReference(const glm::mat4 &inverseModel, const glm::mat4 &inverseView)
+    {
+        return glm::transpose(inverseModel * inverseView);
+    }
+
+    // Writes normalMatrices[object] for the listed objects. inverseTransforms is indexed by object
+    inline void ComputeRange(const glm::mat4 *inverseTransforms, const uint32_t *objects, size_t begin, size_t end, const glm::mat4 &inverseView, glm::mat4 *normalMatrices)
+    {
+        #if defined(__SSE2__) || defined(_M_X64)
+            // the inverse view is the right operand of every product, its elements are broadcast once
+            __m128 view[4][4];
+            for (int column = 0; column < 4; column++)
+            {
+                for (int row = 0; row < 4; row++)
+                    view[column][row] = _mm_set1_ps(inverseView[column][row]);
+            }
+
+            for (size_t i = begin; i < end; i++)
+            {
+                const float *model = &inverseTransforms[objects[i]][0][0];
+                __m128 m0 = _mm_loadu_ps(model);
+                __m128 m1 = _mm_loadu_ps(model + 4);
+                __m128 m2 = _mm_loadu_ps(model + 8);
+                __m128 m3 = _mm_loadu_ps(model + 12);
+
+                // column c of the product is the model columns weighted by column c of the view
+                __m128 c0 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, view[0][0]), _mm_mul_ps(m1, view[0][1])), _mm_add_ps(_mm_mul_ps(m2, view[0][2]), _mm_mul_ps(m3, view[0][3])));
+                __m128 c1 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, view[1][0]), _mm_mul_ps(m1, view[1][1])), _mm_add_ps(_mm_mul_ps(m2, view[1][2]), _mm_mul_ps(m3, view[1][3])));
+                __m128 c2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, view[2][0]), _mm_mul_ps(m1, view[2][1])), _mm_add_ps(_mm_mul_ps(m2, view[2][2]), _mm_mul_ps(m3, view[2][3])));
+                __m128 c3 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(m0, view[3][0]), _mm_mul_ps(m1, view[3][1])), _mm_add_ps(_mm_mul_ps(m2, view[3][2]), _mm_mul_ps(m3, view[3][3])));
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+
+                float *normal = &normalMatrices[objects[i]][0][0];
+                _mm_storeu_ps(normal, c0);
+                _mm_storeu_ps(normal + 4, c1);
+                _mm_storeu_ps(normal + 8, c2);
+                _mm_storeu_ps(normal + 12, c3);
+            }
+        #else
+            for (size_t i = begin; i < end; i++)
+                normalMatrices[objects[i]] = NormalMatrixReference(inverseTransforms[objects[i]], inverseView);
+        #endif
+    }
+
+    // Writes normalMatrices[object] for the count objects listed, on the job system when parallel
+    inline void ComputeNormalMatrices(const glm::mat4 *inverseTransforms, const uint32_t *objects, size_t count, const glm::mat4 &inverseView, glm::mat4 *normalMatrices,
+                                      bool parallel = true)
+    {
+        if (!parallel || count <= CHUNK_SIZE)
+        {
+            ComputeRange(inverseTransforms, objects, 0, count, inverseView, normalMatrices);
+            return;
+        }
+
+        JobSystem::Get().ParallelFor(count, CHUNK_SIZE, [&](size_t begin, size_t end){
+            ComputeRange(inverseTransforms, objects, begin, end, inverseView, normalMatrices);
+        });
+    }
+}
+
+#endif
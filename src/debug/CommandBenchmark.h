@@ -0,0 +1,169 @@
+#ifndef COMMAND_BENCHMARK_H
+#define COMMAND_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "env.h"
+#include "../common/JobSystem.h"
+#include "../common/TransformKernel.h"
+#include "../common/ShaderMemoryPool.h"
+#include "../scene/Scene.h"
+#include "../render/RenderQueue.h"
+
+/*
+ * Splits the cost of drawing objectCount objects (64 meshes, 16 materials) between the CPU side and the driver:
+ *  - immediate: the previous per object loop, binding and uploading through GL as each object is visited
+ *  - queue build: classifying and radix sorting the draws (RenderQueue::Build)
+ *  - recording: the normal matrix sweep (TransformKernel.h) and RenderQueue::Record from 1 to maxThreads threads (the
+ *    job system is restarted for each count)
+ *  - replay: issuing the recorded commands on this thread
+ * The GL timings include a glFinish. Requires a current GL context
+ */
+
+namespace CommandBenchmark
+{
+    struct LocalMatrices
+    {
+        glm::mat4 modelMatrix;
+        glm::mat4 normalMatrix;
+    };
+
+    inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int maxThreads, unsigned int passCount = 20)
+    {
+        JobSystem &jobs = JobSystem::Get();
+        unsigned int previousWorkers = jobs.GetWorkerCount();
+
+        std::vector<MeshData::Vertex> vertices(3);
+        vertices[1].Position = glm::vec3(1.0f, 0.0f, 0.0f);
+        vertices[2].Position = glm::vec3(0.0f, 1.0f, 0.0f);
+        std::vector<unsigned int> indices = {0, 1, 2};
+
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        for (unsigned int m = 0; m < 64; m++)
+            meshes.push_back(std::make_shared<Mesh>(vertices, indices));
+
+        std::mt19937 random(42);
+        Scene scene = Scene();
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            MaterialTemplate materialTemplate = MaterialTemplate(OP_MATERIAL_DEFAULT);
+            materialTemplate.id = random() % 16;
+            MaterialInstance::MaterialProperties properties = MaterialInstance::MaterialProperties();
+            properties.albedoColor = glm::vec4((float)materialTemplate.id / 16.0f, 0.5f, 0.5f, 1.0f);
+
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(i % 100, (i / 100) % 100, i / 10000));
+            scene.AddObject(meshes[random() % meshes.size()], transform, properties, materialTemplate, OP_MATERIAL_DEFAULT);
+        }
+        scene.Update();
+
+        std::vector<uint32_t> objectIndices(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++)
+            objectIndices[i] = i;
+
+        ShaderMemoryPool shaderMemoryPool;
+        shaderMemoryPool.AddUniformBuffer(3 * sizeof(glm::mat4), "GlobalMatrices");
+        shaderMemoryPool.AddUniformBuffer(sizeof(LocalMatrices), "LocalMatrices");
+        shaderMemoryPool.AddUniformBuffer(sizeof(MaterialInstance::MaterialProperties), "MaterialProperties");
+
+        StandardShader shader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
+        shader.BuildProgram();
+        shader.BindUniformBlocks(shaderMemoryPool.GetNamedBindings());
+
+        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(50.0f, 50.0f, -50.0f), glm::vec3(50.0f, 50.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        GLUniformBuffer *materialBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
+        GLUniformBuffer *matricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices");
+        RenderQueue::TextureUnits textureUnits = {0, 1, 2};
+
+        // previous per object loop
+        glFinish();
+        auto immediateStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            shader.UseProgram();
+            scene.ForEachObject(objectIndices, [&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                materialBuffer->SetData(0, sizeof(MaterialInstance::MaterialProperties), &(materialInstance.properties));
+                LocalMatrices localMatrices = {objectToWorld, MathUtils::ComputeNormalMatrix(viewMatrix, objectToWorld)};
+                matricesBuffer->SetData(0, sizeof(LocalMatrices), &localMatrices);
+                mesh.BindBuffers();
+                glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
+            });
+        }
+        glFinish();
+        double immediateTime = MillisecondsSince(immediateStart) / passCount;
+
+        RenderQueue renderQueue;
+        auto buildStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            renderQueue.Build(scene, objectIndices, viewMatrix, 200.0f, [&](MaterialInstance &materialInstance, RenderQueue::DrawState &state)
+            {
+                state.program = &shader;
+                return true;
+            });
+        }
+        double buildTime = MillisecondsSince(buildStart) / passCount;
+
+        GLuint materialBufferId = materialBuffer->GetGLId();
+        GLuint matricesBufferId = matricesBuffer->GetGLId();
+        std::vector<glm::mat4> normalMatrices(objectCount);
+        glm::mat4 inverseViewMatrix = glm::inverse(viewMatrix);
+        auto record = [&]
+        {
+            TransformKernel::ComputeNormalMatrices(scene.GetObjects().GetInverseTransforms(), objectIndices.data(), objectIndices.size(), inverseViewMatrix, normalMatrices.data());
+            renderQueue.Record(scene, textureUnits, normalMatrices.data(), [&](CommandList &commands, const glm::mat4 &objectToWorld, const glm::mat4 &normalMatrix, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                commands.SetUniformData(materialBufferId, 0, sizeof(MaterialInstance::MaterialProperties), &(materialInstance.properties));
+                LocalMatrices localMatrices = {objectToWorld, normalMatrix};
+                commands.SetUniformData(matricesBufferId, 0, sizeof(LocalMatrices), &localMatrices);
+            });
+        };
+
+        std::cout << "Command recording benchmark (" << objectCount << " objects, average of " << passCount << " passes):\n";
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "   immediate per object loop (CPU + driver): " << immediateTime << " ms\n";
+        std::cout << "   queue build and sort: " << buildTime << " ms\n";
+
+        double singleThreadTime = 0;
+        for (unsigned int threads = 1; threads <= maxThreads; threads++)
+        {
+            jobs.Start(threads - 1);
+            record();
+
+            auto recordStart = std::chrono::high_resolution_clock::now();
+            for (unsigned int pass = 0; pass < passCount; pass++)
+                record();
+            double recordTime = MillisecondsSince(recordStart) / passCount;
+            if (threads == 1)
+                singleThreadTime = recordTime;
+
+            std::cout << "   recording on " << threads << " threads: " << recordTime << " ms (" << std::setprecision(1)
+                      << singleThreadTime / recordTime << "x)" << std::setprecision(3) << "\n";
+        }
+        jobs.Start(previousWorkers);
+
+        glFinish();
+        auto replayStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            renderQueue.Replay(0);
+        glFinish();
+        double replayTime = MillisecondsSince(replayStart) / passCount;
+
+        std::cout << "   replay (driver): " << replayTime << " ms (" << renderQueue.GetCommandCount() << " commands, "
+                  << renderQueue.GetSortedChanges().GetTotal() << " state changes)\n";
+    }
+}
+
+#endif
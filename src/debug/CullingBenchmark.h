@@ -0,0 +1,128 @@
+#ifndef CULLING_BENCHMARK_H
+#define CULLING_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../common/CullingKernel.h"
+
+/*
+ * Compares the flat culling kernel (CullingKernel.h) with a scalar glm loop over the AoS bounds, on random objects
+ * culled against a camera and 4 shadow cascade volumes (5 views, as in a frame of the classical renderers):
+ *  - reference: IsVisibleReference for every object and view
+ *  - kernel: one SIMD sweep, on the calling thread and split in jobs across the job system workers
+ * The visible lists of every view are compared against the reference, and any mismatch is reported (the kernel is
+ * expected to match it exactly). Doesnt need a GL context
+ */
+
+namespace CullingBenchmark
+{
+    inline double NanosecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline size_t CountMismatches(const std::vector<uint32_t> *lists, const std::vector<uint32_t> *referenceLists, unsigned int viewCount)
+    {
+        size_t mismatches = 0;
+        for (unsigned int v = 0; v < viewCount; v++)
+        {
+            if (lists[v] != referenceLists[v])
+                mismatches++;
+        }
+        return mismatches;
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int passCount = 50)
+    {
+        const unsigned int viewCount = 5;
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.2f, 4.0f);
+
+        std::vector<MathUtils::AABB> boxes(objectCount);
+        std::vector<MathUtils::Sphere> spheres(objectCount);
+        CullingKernel::BoundsSoA bounds;
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            glm::vec3 center = glm::vec3(position(random), position(random) * 0.1f, position(random));
+            glm::vec3 extents = glm::vec3(size(random), size(random), size(random));
+            boxes[i] = {center - extents, center + extents};
+            spheres[i] = {center, glm::length(extents)};
+            bounds.Push(boxes[i], spheres[i]);
+        }
+
+        // camera looking over the scene, and ortho cascades of growing size along its view direction
+        MathUtils::Frustum frustums[viewCount];
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(1.0f, 18.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frustums[0] = MathUtils::Frustum::FromMatrix(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f) * view);
+        glm::vec3 lightDir = glm::normalize(glm::vec3(0.3f, 1.0f, 0.2f));
+        for (unsigned int c = 0; c < viewCount - 1; c++)
+        {
+            float radius = 25.0f * (float)(1 << (2 * c));
+            glm::vec3 center = glm::vec3(1.0f, 0.0f, 1.0f) * radius * 0.5f;
+            glm::mat4 lightView = glm::lookAt(center + lightDir, center, glm::vec3(0.0f, 1.0f, 0.0f));
+            glm::mat4 lightProjection = glm::ortho(-radius, radius, -radius, radius, -radius * 4.0f, radius * 4.0f);
+            frustums[1 + c] = MathUtils::Frustum::FromShadowMatrix(lightProjection * lightView);
+        }
+
+        std::vector<uint32_t> referenceLists[viewCount];
+        auto referenceStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (unsigned int v = 0; v < viewCount; v++)
+            {
+                referenceLists[v].clear();
+                for (unsigned int i = 0; i < objectCount; i++)
+                {
+                    if (CullingKernel::IsVisibleReference(frustums[v], boxes[i], spheres[i]))
+                        referenceLists[v].push_back(i);
+                }
+            }
+        }
+        double referenceTime = NanosecondsSince(referenceStart) / passCount;
+
+        CullingKernel::MultiViewCuller culler;
+        std::vector<uint32_t> lists[viewCount];
+
+        auto kernelStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            culler.Cull(bounds, frustums, viewCount, lists, false);
+        double kernelTime = NanosecondsSince(kernelStart) / passCount;
+        size_t kernelMismatches = CountMismatches(lists, referenceLists, viewCount);
+
+        auto threadedStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            culler.Cull(bounds, frustums, viewCount, lists, true);
+        double threadedTime = NanosecondsSince(threadedStart) / passCount;
+        size_t threadedMismatches = CountMismatches(lists, referenceLists, viewCount);
+
+        #if defined(__AVX2__)
+            const char *path = "AVX2";
+        #elif defined(__SSE2__) || defined(_M_X64)
+            const char *path = "SSE";
+        #else
+            const char *path = "scalar";
+        #endif
+
+        double tests = (double)objectCount * viewCount;
+        std::cout << "Culling benchmark (" << objectCount << " objects, " << viewCount << " views, average of " << passCount << " passes):\n";
+        std::cout << "   visible objects per view:";
+        for (unsigned int v = 0; v < viewCount; v++)
+            std::cout << " " << referenceLists[v].size();
+        std::cout << "\n";
+        std::cout << "   scalar glm reference: " << referenceTime / 1e6 << " ms (" << tests / referenceTime << " object tests/ns)\n";
+        std::cout << "   " << path << " kernel: " << kernelTime / 1e6 << " ms (" << tests / kernelTime << " object tests/ns)\n";
+        std::cout << "   " << path << " kernel on " << JobSystem::Get().GetWorkerCount() + 1 << " threads: " << threadedTime / 1e6 << " ms (" << tests / threadedTime << " object tests/ns)\n";
+        if (kernelMismatches + threadedMismatches == 0)
+            std::cout << "   kernel output matches the reference on every view\n";
+        else
+            std::cout << "   ERROR: kernel output differs from the reference on " << kernelMismatches << " (single thread) and " << threadedMismatches << " (threaded) views\n";
+    }
+}
+
+#endif
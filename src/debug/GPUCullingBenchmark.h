@@ -0,0 +1,108 @@
+#ifndef GPU_CULLING_BENCHMARK_H
+#define GPU_CULLING_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../scene/Scene.h"
+#include "../render/MultiDrawList.h"
+#include "../render/GPUCuller.h"
+
+/*
+ * Checks the GPU culling pass (GPUCuller.h) against the CPU on objectCount random objects (16 meshes, drawn in 4 batches)
+ * seen by a camera looking over them:
+ *  - the visible draws read back from the culled commands are compared with CullingKernel::IsVisibleReference on the
+ *    same bounds, any mismatch is reported
+ *  - the culling dispatch is timed with a GL timer query, the CPU scene culling (BVH or SIMD kernel) on the same frustum
+ *    is timed for comparison
+ * Compacts with a count buffer when the driver supports it, otherwise zeroes the culled commands, so it also runs on
+ * software drivers (e.g. LIBGL_ALWAYS_SOFTWARE=1 with Mesa llvmpipe under a virtual X server). Requires a current GL context
+ */
+
+namespace GPUCullingBenchmark
+{
+    inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int passCount = 20)
+    {
+        std::vector<MeshData::Vertex> vertices(3);
+        vertices[0].Position = glm::vec3(-1.0f, -1.0f, -1.0f);
+        vertices[1].Position = glm::vec3(1.0f, -1.0f, -1.0f);
+        vertices[2].Position = glm::vec3(0.0f, 1.0f, 1.0f);
+        std::vector<unsigned int> indices = {0, 1, 2};
+
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        for (unsigned int m = 0; m < 16; m++)
+            meshes.push_back(std::make_shared<Mesh>(vertices, indices));
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.2f, 4.0f);
+        Scene scene = Scene();
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            MaterialTemplate materialTemplate = MaterialTemplate(OP_MATERIAL_DEFAULT);
+            materialTemplate.id = random() % 4;
+            MaterialInstance::MaterialProperties properties = MaterialInstance::MaterialProperties();
+
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random) * 0.1f, position(random)));
+            transform = glm::scale(transform, glm::vec3(size(random), size(random), size(random)));
+            scene.AddObject(meshes[random() % meshes.size()], transform, properties, materialTemplate, OP_MATERIAL_DEFAULT);
+        }
+        scene.Update();
+
+        std::vector<uint32_t> objectIndices(objectCount);
+        for (uint32_t i = 0; i < objectCount; i++)
+            objectIndices[i] = i;
+
+        const MaterialHandle *materials = scene.GetObjects().GetMaterials();
+        MultiDrawList draws;
+        draws.Build(scene, objectIndices, [&](size_t position, uint32_t object, MaterialInstance &materialInstance, MultiDrawList::DrawData &draw)
+        {
+            draw.material = materials[object];
+            return (uint32_t)(materials[object] % 4);
+        }, false);
+
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(1.0f, 18.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        MathUtils::Frustum frustum = MathUtils::Frustum::FromMatrix(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f) * view);
+
+        GPUCuller culler;
+        culler.ReloadShader();
+        culler.Cull(scene, draws, frustum);
+        size_t visibleCount;
+        size_t mismatches = culler.CountMismatches(frustum, visibleCount);
+
+        GLuint query;
+        glGenQueries(1, &query);
+        glFinish();
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            culler.Cull(scene, draws, frustum);
+        glEndQuery(GL_TIME_ELAPSED);
+        GLuint64 gpuTime = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuTime);
+        glDeleteQueries(1, &query);
+
+        std::vector<uint32_t> cpuVisible;
+        auto cpuStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            scene.CullObjects(frustum, cpuVisible);
+        double cpuTime = MillisecondsSince(cpuStart) / passCount;
+
+        std::cout << "GPU culling benchmark (" << objectCount << " objects, " << draws.GetDrawCount() << " draws in "
+                  << draws.GetBatches().size() << " batches, " << (culler.IsCompacting() ? "compacted with a count buffer" : "culled in place") << "):\n";
+        std::cout << "   GPU: " << visibleCount << " visible draws, " << gpuTime / 1.0e6 / passCount << " ms per pass (bounds upload and dispatch)\n";
+        std::cout << "   CPU scene culling: " << cpuVisible.size() << " visible objects, " << cpuTime << " ms per pass\n";
+        std::cout << "   " << mismatches << " draws differ from the CPU reference" << (mismatches == 0 ? "" : " (MISMATCH)") << "\n";
+    }
+}
+
+#endif
@@ -0,0 +1,165 @@
+#ifndef JOB_BENCHMARK_H
+#define JOB_BENCHMARK_H
+
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <atomic>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../common/JobSystem.h"
+#include "../common/CullingKernel.h"
+#include "../scene/TransformGraph.h"
+
+/*
+ * Measures how the engine work on the job system (JobSystem.h) scales from 1 to maxThreads threads (the calling thread
+ * plus maxThreads - 1 workers):
+ *  - transforms: TransformGraph::Update with every root dirty (objectCount nodes, in 2 levels)
+ *  - culling: the multi view culling sweep over objectCount objects and 5 views
+ *  - tiny jobs: cost of running and waiting on empty jobs, per job
+ *  - dependency chain: jobs that each start after the previous one (RunAfter), per job
+ * The job system is restarted for every thread count and left with its previous worker count. Doesnt need a GL context
+ */
+
+namespace JobBenchmark
+{
+    inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline double TimeTransforms(TransformGraph &graph, const std::vector<TransformId> &roots, unsigned int passCount)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            glm::mat4 offset = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.01f * pass, 0.0f));
+            for (TransformId root : roots)
+                graph.SetLocalTransform(root, offset);
+            graph.Update();
+        }
+        return MillisecondsSince(start) / passCount;
+    }
+
+    inline double TimeCulling(const CullingKernel::BoundsSoA &bounds, const MathUtils::Frustum *frustums, unsigned int viewCount, unsigned int passCount)
+    {
+        CullingKernel::MultiViewCuller culler;
+        std::vector<uint32_t> lists[CullingKernel::MAX_VIEWS];
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            culler.Cull(bounds, frustums, viewCount, lists);
+        return MillisecondsSince(start) / passCount;
+    }
+
+    // nanoseconds per job
+    inline double TimeTinyJobs(unsigned int jobCount)
+    {
+        JobSystem &jobs = JobSystem::Get();
+        std::atomic<unsigned int> executed{0};
+        JobCounter counter;
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (unsigned int i = 0; i < jobCount; i++)
+            jobs.Run([&executed]{ executed.fetch_add(1, std::memory_order_relaxed); }, &counter);
+        jobs.Wait(counter);
+        return MillisecondsSince(start) * 1e6 / jobCount;
+    }
+
+    // nanoseconds per job
+    inline double TimeDependencyChain(unsigned int jobCount)
+    {
+        JobSystem &jobs = JobSystem::Get();
+        std::unique_ptr<JobCounter[]> counters(new JobCounter[jobCount]);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        jobs.Run([]{}, &counters[0]);
+        for (unsigned int i = 1; i < jobCount; i++)
+            jobs.RunAfter(counters[i - 1], []{}, &counters[i]);
+        jobs.Wait(counters[jobCount - 1]);
+        double time = MillisecondsSince(start) * 1e6 / jobCount;
+
+        // every counter has to be released before they are destroyed
+        for (unsigned int i = 0; i < jobCount; i++)
+            jobs.Wait(counters[i]);
+        return time;
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int maxThreads, unsigned int passCount = 20)
+    {
+        JobSystem &jobs = JobSystem::Get();
+        unsigned int previousWorkers = jobs.GetWorkerCount();
+
+        // 1 / 4 of the nodes are roots, each with 3 children
+        TransformGraph graph;
+        std::vector<TransformId> roots;
+        for (unsigned int i = 0; i < objectCount / 4; i++)
+        {
+            roots.push_back(graph.Add(glm::mat4(1.0f)));
+            for (unsigned int c = 0; c < 3; c++)
+                graph.Add(glm::translate(glm::mat4(1.0f), glm::vec3((float)c, 0.0f, 0.0f)), roots.back());
+        }
+
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.2f, 4.0f);
+        CullingKernel::BoundsSoA bounds;
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            glm::vec3 center = glm::vec3(position(random), position(random) * 0.1f, position(random));
+            glm::vec3 extents = glm::vec3(size(random), size(random), size(random));
+            bounds.Push({center - extents, center + extents}, {center, glm::length(extents)});
+        }
+
+        const unsigned int viewCount = 5;
+        MathUtils::Frustum frustums[viewCount];
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, 0.0f), glm::vec3(1.0f, 18.0f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        frustums[0] = MathUtils::Frustum::FromMatrix(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f) * view);
+        for (unsigned int c = 1; c < viewCount; c++)
+        {
+            float radius = 25.0f * (float)(1 << (2 * c));
+            glm::mat4 lightView = glm::lookAt(glm::vec3(0.3f, 1.0f, 0.2f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+            frustums[c] = MathUtils::Frustum::FromShadowMatrix(glm::ortho(-radius, radius, -radius, radius, -radius * 4.0f, radius * 4.0f) * lightView);
+        }
+
+        const unsigned int tinyJobCount = 100000;
+        const unsigned int chainLength = 10000;
+
+        std::cout << "Job system benchmark (" << objectCount << " objects, average of " << passCount << " passes):\n";
+        std::cout << std::setw(10) << "threads" << std::setw(18) << "transforms (ms)" << std::setw(16) << "culling (ms)"
+                  << std::setw(18) << "tiny job (ns)" << std::setw(22) << "chained job (ns)" << "\n";
+
+        double baseTransforms = 0, baseCulling = 0;
+        for (unsigned int threads = 1; threads <= maxThreads; threads++)
+        {
+            jobs.Start(threads - 1);
+
+            // warm up (allocations of the level and chunk lists)
+            TimeTransforms(graph, roots, 1);
+            TimeCulling(bounds, frustums, viewCount, 1);
+
+            double transformTime = TimeTransforms(graph, roots, passCount);
+            double cullingTime = TimeCulling(bounds, frustums, viewCount, passCount);
+            double tinyJobTime = TimeTinyJobs(tinyJobCount);
+            double chainTime = TimeDependencyChain(chainLength);
+            if (threads == 1)
+            {
+                baseTransforms = transformTime;
+                baseCulling = cullingTime;
+            }
+
+            std::cout << std::fixed << std::setprecision(3) << std::setw(10) << threads
+                      << std::setw(10) << transformTime << " (" << std::setprecision(1) << baseTransforms / transformTime << "x)"
+                      << std::setprecision(3) << std::setw(8) << cullingTime << " (" << std::setprecision(1) << baseCulling / cullingTime << "x)"
+                      << std::setw(18) << tinyJobTime << std::setw(22) << chainTime << "\n";
+        }
+
+        jobs.Start(previousWorkers);
+    }
+}
+
+#endif
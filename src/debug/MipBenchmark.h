@@ -0,0 +1,119 @@
+#ifndef MIP_BENCHMARK_H
+#define MIP_BENCHMARK_H
+
+#include <glad/glad.h>
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <stb_image.h>
+
+#include "../common/MipGenerator.h"
+#include "../common/JobSystem.h"
+#include "../gl/TextureCooker.h"
+
+/*
+ * Compares the CPU mip generation (MipGenerator.h) against the driver path (glGenerateTextureMipmap) on a set of
+ * textures. Images are decoded as RGBA8 before timing, so only mip generation is measured:
+ *  - cpu box / cpu kaiser: full chain on a single thread
+ *  - driver: glGenerateTextureMipmap on an already uploaded base level, until glFinish returns
+ * The total for the Kaiser filter spread over the job system is also reported. Requires a current GL context
+ */
+
+namespace MipBenchmark
+{
+    inline float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline float TimeCPUChain(const std::vector<uint8_t> &rgba, unsigned int width, unsigned int height, MipGenerator::MipSettings settings)
+    {
+        auto start = std::chrono::high_resolution_clock::now();
+        auto levels = MipGenerator::GenerateMipChain(rgba.data(), width, height, settings);
+        return MillisecondsSince(start);
+    }
+
+    inline float TimeDriverChain(const std::vector<uint8_t> &rgba, unsigned int width, unsigned int height, bool sRGB)
+    {
+        GLuint texture;
+        glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+        unsigned int levels = 1;
+        while ((width >> levels) > 0 || (height >> levels) > 0)
+            levels++;
+        glTextureStorage2D(texture, levels, sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8, width, height);
+        glTextureSubImage2D(texture, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+        glFinish();
+
+        auto start = std::chrono::high_resolution_clock::now();
+        glGenerateTextureMipmap(texture);
+        glFinish();
+        float time = MillisecondsSince(start);
+
+        glDeleteTextures(1, &texture);
+        return time;
+    }
+
+    inline void Run(const std::vector<std::string> &texturePaths, const std::vector<TextureUsage> &textureUsages)
+    {
+        struct DecodedImage
+        {
+            std::vector<uint8_t> rgba;
+            unsigned int width = 0;
+            unsigned int height = 0;
+            MipGenerator::MipSettings settings;
+        };
+
+        std::vector<DecodedImage> images;
+        for (size_t i = 0; i < texturePaths.size(); i++)
+        {
+            int width, height, nrComponents;
+            unsigned char *data = stbi_load(texturePaths[i].c_str(), &width, &height, &nrComponents, 4);
+            if (!data)
+                continue;
+
+            DecodedImage image;
+            image.rgba.assign(data, data + (size_t)width * height * 4);
+            image.width = width;
+            image.height = height;
+            image.settings = TextureCooker::GetMipSettings(nrComponents == 1 ? GL_COMPRESSED_RED_RGTC1 : GL_COMPRESSED_RGB_S3TC_DXT1_EXT, textureUsages[i]);
+            images.push_back(std::move(image));
+            stbi_image_free(data);
+        }
+
+        std::cout << "Mip generation benchmark (" << images.size() << " textures, times in ms):\n";
+        std::cout << std::setw(12) << "size" << std::setw(12) << "cpu box" << std::setw(12) << "cpu kaiser" << std::setw(12) << "driver" << "\n";
+
+        float totalBox = 0, totalKaiser = 0, totalDriver = 0;
+        for (auto &image : images)
+        {
+            MipGenerator::MipSettings box = image.settings;
+            box.filter = MipGenerator::OP_MIP_FILTER_BOX;
+            MipGenerator::MipSettings kaiser = image.settings;
+            kaiser.filter = MipGenerator::OP_MIP_FILTER_KAISER;
+
+            float boxTime = TimeCPUChain(image.rgba, image.width, image.height, box);
+            float kaiserTime = TimeCPUChain(image.rgba, image.width, image.height, kaiser);
+            float driverTime = TimeDriverChain(image.rgba, image.width, image.height, image.settings.gammaCorrect);
+            totalBox += boxTime;
+            totalKaiser += kaiserTime;
+            totalDriver += driverTime;
+
+            std::cout << std::setw(12) << std::to_string(image.width) + "x" + std::to_string(image.height) << std::fixed << std::setprecision(2)
+                      << std::setw(12) << boxTime << std::setw(12) << kaiserTime << std::setw(12) << driverTime << "\n";
+        }
+
+        auto parallelStart = std::chrono::high_resolution_clock::now();
+        JobSystem::Get().ParallelFor(images.size(), 1, [&](size_t begin, size_t end){
+            for (size_t i = begin; i < end; i++)
+                TimeCPUChain(images[i].rgba, images[i].width, images[i].height, images[i].settings);
+        });
+        float parallelTime = MillisecondsSince(parallelStart);
+
+        std::cout << std::setw(12) << "total" << std::setw(12) << totalBox << std::setw(12) << totalKaiser << std::setw(12) << totalDriver << "\n";
+        std::cout << "cpu kaiser on " << JobSystem::Get().GetWorkerCount() + 1 << " threads: " << parallelTime << " ms\n";
+    }
+}
+
+#endif
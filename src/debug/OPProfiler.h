@@ -174,6 +174,30 @@ namespace OPProfiler
             }
 
 
+            //CPU side counters (e.g. upload throughput, culled objects). A counter keeps its last value until it is set again
+            void SetCounter(const std::string &name, double value, const std::string &unit = "")
+            {
+                auto it = counterNameToIndex.find(name);
+                if (it == counterNameToIndex.end())
+                {
+                    counterNameToIndex[name] = counters.size();
+                    counters.push_back({name, unit, value});
+                }
+                else
+                {
+                    counters[it->second].value = value;
+                    counters[it->second].unit = unit;
+                }
+            }
+
+            void RenderCounters()
+            {
+                for (const auto &counter : counters)
+                {
+                    ImGui::Text("%s: %.2f %s", counter.name.c_str(), counter.value, counter.unit.c_str());
+                }
+            }
+
             void RenderWindow(int graphWidth, int legendWidth, int height, int frameIndexOffset)
             {
                 ImDrawList* drawList = ImGui::GetWindowDrawList();
@@ -198,6 +222,16 @@ namespace OPProfiler
             std::vector<TaskStats> taskStats;
             std::map<std::string, size_t> taskNameToStatsIndex;
 
+            struct Counter
+            {
+                std::string name;
+                std::string unit;
+                double value;
+            };
+
+            std::vector<Counter> counters;
+            std::map<std::string, size_t> counterNameToIndex;
+
             size_t currFrameIndex = 1;
             size_t prevFrameIndex = 0;
 
@@ -0,0 +1,182 @@
+#ifndef POOL_BENCHMARK_H
+#define POOL_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cassert>
+#include <glm/glm.hpp>
+
+#include "../common/Pool.h"
+
+/*
+ * Compares Pool (generational slot map, packed storage) with the previous layout: the objects stored on their slots,
+ * liveness on a vector<bool> and an iterator skipping the released slots one at a time.
+ * Churn releases and adds a random tenth of the objects per round, iteration sums every live object after half of them
+ * were released. The stale ids of the released objects are checked to never resolve again. Doesnt need a GL context
+ */
+
+namespace PoolBenchmark
+{
+    struct Element
+    {
+        glm::mat4 transform;
+        uint32_t value;
+    };
+
+    // the previous Pool, without generations
+    struct LegacyPool
+    {
+        std::vector<Element> data;
+        std::vector<bool> isPresent;
+        std::vector<size_t> freeIds;
+
+        size_t Add(Element &&element)
+        {
+            if (!freeIds.empty())
+            {
+                size_t id = freeIds.back();
+                freeIds.pop_back();
+                data[id] = std::move(element);
+                isPresent[id] = true;
+                return id;
+            }
+            data.push_back(std::move(element));
+            isPresent.push_back(true);
+            return data.size() - 1;
+        }
+
+        void Release(size_t id)
+        {
+            isPresent[id] = false;
+            freeIds.push_back(id);
+        }
+
+        template<typename Visitor>
+        void ForEach(Visitor &&visitor)
+        {
+            for (size_t id = 0; id < data.size(); id++)
+            {
+                if (isPresent[id])
+                    visitor(data[id]);
+            }
+        }
+    };
+
+    inline float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline Element MakeElement(uint32_t value)
+    {
+        Element element;
+        element.transform = glm::mat4(1.0f);
+        element.value = value;
+        return element;
+    }
+
+    template<typename PoolType>
+    bool CheckIds(PoolType &pool, const std::vector<typename PoolType::Id> &ids, const std::vector<typename PoolType::Id> &released)
+    {
+        for (auto &id : ids)
+        {
+            if (!pool.IsPresent(id))
+                return false;
+        }
+        for (auto &id : released)
+        {
+            if (pool.IsPresent(id))
+                return false;
+        }
+        return true;
+    }
+
+    // churn and iteration of a Pool, returns the checksum
+    template<typename PoolType>
+    uint64_t RunPool(unsigned int elementCount, unsigned int rounds, unsigned int passCount, float &churnTime, float &iterationTime, bool &idsValid)
+    {
+        std::mt19937 random(42);
+        PoolType pool;
+        std::vector<typename PoolType::Id> ids;
+        std::vector<typename PoolType::Id> released;
+        for (uint32_t i = 0; i < elementCount; i++)
+            ids.push_back(pool.Add(MakeElement(i)));
+
+        auto churnStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int round = 0; round < rounds; round++)
+        {
+            for (unsigned int i = 0; i < elementCount / 10; i++)
+            {
+                size_t index = random() % ids.size();
+                pool.Release(ids[index]);
+                if (released.size() < 1024)
+                    released.push_back(ids[index]);
+                ids[index] = pool.Add(MakeElement(round));
+            }
+        }
+        churnTime = MillisecondsSince(churnStart) / rounds;
+        idsValid = CheckIds(pool, ids, released);
+
+        for (size_t i = 0; i < ids.size(); i += 2)
+            pool.Release(ids[i]);
+
+        uint64_t sum = 0;
+        auto iterationStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (Element &element : pool)
+                sum += element.value + (uint64_t)element.transform[3][3];
+        }
+        iterationTime = MillisecondsSince(iterationStart) / passCount;
+        return sum;
+    }
+
+    inline void Run(unsigned int elementCount, unsigned int rounds = 20, unsigned int passCount = 20)
+    {
+        std::mt19937 random(42);
+
+        // previous pool
+        LegacyPool legacy;
+        std::vector<size_t> legacyIds;
+        for (uint32_t i = 0; i < elementCount; i++)
+            legacyIds.push_back(legacy.Add(MakeElement(i)));
+
+        auto churnStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int round = 0; round < rounds; round++)
+        {
+            for (unsigned int i = 0; i < elementCount / 10; i++)
+            {
+                size_t index = random() % legacyIds.size();
+                legacy.Release(legacyIds[index]);
+                legacyIds[index] = legacy.Add(MakeElement(round));
+            }
+        }
+        float legacyChurnTime = MillisecondsSince(churnStart) / rounds;
+
+        for (size_t i = 0; i < legacyIds.size(); i += 2)
+            legacy.Release(legacyIds[i]);
+
+        uint64_t legacySum = 0;
+        auto iterationStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            legacy.ForEach([&](Element &element) { legacySum += element.value + (uint64_t)element.transform[3][3]; });
+        float legacyIterationTime = MillisecondsSince(iterationStart) / passCount;
+
+        float packedChurnTime, packedIterationTime, stableChurnTime, stableIterationTime;
+        bool packedIdsValid, stableIdsValid;
+        uint64_t packedSum = RunPool<Pool<Element>>(elementCount, rounds, passCount, packedChurnTime, packedIterationTime, packedIdsValid);
+        uint64_t stableSum = RunPool<Pool<Element, true>>(elementCount, rounds, passCount, stableChurnTime, stableIterationTime, stableIdsValid);
+
+        std::cout << "Pool benchmark (" << elementCount << " objects, " << elementCount / 10 << " releases and adds per churn round, "
+                  << "iteration over half of them):\n";
+        std::cout << "   previous pool: churn " << legacyChurnTime << " ms per round, iteration " << legacyIterationTime << " ms per pass\n";
+        std::cout << "   Pool: churn " << packedChurnTime << " ms per round, iteration " << packedIterationTime << " ms per pass\n";
+        std::cout << "   Pool (stable pointers): churn " << stableChurnTime << " ms per round, iteration " << stableIterationTime << " ms per pass\n";
+        std::cout << "   ids " << (packedIdsValid && stableIdsValid ? "valid" : "INVALID") << ", checksums "
+                  << (legacySum == packedSum && packedSum == stableSum ? "match" : "DONT MATCH") << "\n";
+    }
+}
+
+#endif
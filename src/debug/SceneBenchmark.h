@@ -0,0 +1,176 @@
+#ifndef SCENE_BENCHMARK_H
+#define SCENE_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <functional>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../scene/Scene.h"
+
+/*
+ * Compares the per pass object iteration of the scene storage (ObjectStore.h) with the previous layout, where every
+ * object was a separate heap allocation holding a shared_ptr<Mesh>, a unique_ptr<MaterialInstance> and its matrix.
+ * Both passes do the same work as the draw loops: skip unlit objects, read the transform and the mesh index count.
+ * The objects are created in a shuffled order, as they would be after a scene is edited, and share a few meshes.
+ * Requires a current GL context (the meshes are real GL meshes)
+ *
+ * The iteration API is compared as well: the previous Scene::IterateObjects (std::function callback receiving the
+ * shared_ptr<Mesh> by value) against Scene::ForEachObject. A frame is counted as the 4 object passes of the deferred
+ * renderers (shadows, gBuffer, voxelization and unlit)
+ */
+
+namespace SceneBenchmark
+{
+    struct LegacyObject
+    {
+        std::shared_ptr<Mesh> mesh;
+        std::unique_ptr<MaterialInstance> materialInstance;
+        glm::mat4 objToWorld;
+    };
+
+    inline float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int passCount = 100)
+    {
+        std::vector<MeshData::Vertex> vertices(3);
+        vertices[1].Position = glm::vec3(1.0f, 0.0f, 0.0f);
+        vertices[2].Position = glm::vec3(0.0f, 1.0f, 0.0f);
+        std::vector<unsigned int> indices = {0, 1, 2};
+
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        for (unsigned int m = 0; m < 64; m++)
+        {
+            std::vector<MeshData::Vertex> meshVertices = vertices;
+            std::vector<unsigned int> meshIndices = indices;
+            meshes.push_back(std::make_shared<Mesh>(meshVertices, meshIndices));
+        }
+
+        MaterialTemplate materialTemplate = MaterialTemplate(OP_MATERIAL_DEFAULT);
+        materialTemplate.id = 0;
+        MaterialInstance::MaterialProperties properties = MaterialInstance::MaterialProperties();
+
+        std::mt19937 random(42);
+        std::vector<LegacyObject*> legacyAllocations;
+        std::vector<std::shared_ptr<LegacyObject>> legacyObjects;
+        Scene scene = Scene();
+
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(i % 100, (i / 100) % 100, i / 10000));
+            unsigned int flags = (i % 50 == 0) ? OP_MATERIAL_UNLIT : OP_MATERIAL_DEFAULT;
+            auto &mesh = meshes[random() % meshes.size()];
+
+            LegacyObject *object = new LegacyObject();
+            object->mesh = mesh;
+            object->materialInstance = std::make_unique<MaterialInstance>(materialTemplate);
+            object->materialInstance->AddFlags(flags);
+            object->objToWorld = transform;
+            legacyAllocations.push_back(object);
+
+            scene.AddObject(mesh, transform, properties, materialTemplate, flags);
+        }
+
+        // the legacy objects are referenced in a different order than they were allocated in
+        std::shuffle(legacyAllocations.begin(), legacyAllocations.end(), random);
+        for (auto *object : legacyAllocations)
+            legacyObjects.emplace_back(object);
+
+
+        glm::vec4 positionSum = glm::vec4(0.0f);
+        size_t indexSum = 0;
+
+        auto legacyStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (auto &object : legacyObjects)
+            {
+                std::shared_ptr<Mesh> mesh = object->mesh;
+                if (object->materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                    continue;
+
+                positionSum += object->objToWorld[3];
+                indexSum += mesh->indicesCount;
+            }
+        }
+        float legacyTime = MillisecondsSince(legacyStart) / passCount;
+
+        auto storeStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            ObjectStore &objects = scene.GetObjects();
+            const glm::mat4 *transforms = objects.GetTransforms();
+            const MeshHandle *meshHandles = objects.GetMeshes();
+            const uint32_t *flags = objects.GetFlags();
+
+            for (size_t i = 0; i < objects.GetCount(); i++)
+            {
+                if (flags[i] & OP_OBJECT_UNLIT)
+                    continue;
+
+                positionSum += transforms[i][3];
+                indexSum += scene.GetMesh(meshHandles[i]).indicesCount;
+            }
+        }
+        float storeTime = MillisecondsSince(storeStart) / passCount;
+
+        // previous iteration API, emulated over the same store
+        using ObjectCallback = std::function<void(const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)>;
+        std::vector<std::shared_ptr<Mesh>> meshTable;
+        for (size_t i = 0; i < objectCount; i++)
+            meshTable.push_back(meshes[0]);
+        auto iterateObjects = [&](ObjectCallback callback)
+        {
+            ObjectStore &objects = scene.GetObjects();
+            for (size_t i = 0; i < objects.GetCount(); i++)
+            {
+                auto &mesh = meshTable[i];
+                callback(objects.GetTransforms()[i], scene.GetMaterial(objects.GetMaterials()[i]), mesh, mesh->verticesCount, mesh->indicesCount);
+            }
+        };
+
+        const unsigned int passesPerFrame = 4;
+        auto callbackStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount * passesPerFrame; pass++)
+        {
+            iterateObjects([&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            {
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                    return;
+                positionSum += objectToWorld[3];
+                indexSum += indicesCount;
+            });
+        }
+        float callbackTime = MillisecondsSince(callbackStart) / passCount;
+
+        auto visitorStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount * passesPerFrame; pass++)
+        {
+            scene.ForEachObject([&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                    return;
+                positionSum += objectToWorld[3];
+                indexSum += mesh.indicesCount;
+            });
+        }
+        float visitorTime = MillisecondsSince(visitorStart) / passCount;
+
+        std::cout << "Object iteration benchmark (" << objectCount << " objects, average of " << passCount << " passes):\n";
+        std::cout << "   vector<shared_ptr<Object>>: " << legacyTime << " ms per pass\n";
+        std::cout << "   ObjectStore (SoA): " << storeTime << " ms per pass\n";
+        std::cout << "   IterateObjects (std::function + shared_ptr): " << callbackTime << " ms per frame (" << passesPerFrame << " passes)\n";
+        std::cout << "   ForEachObject (template visitor): " << visitorTime << " ms per frame (" << passesPerFrame << " passes)\n";
+        std::cout << "   (checksum " << indexSum + (size_t)positionSum.x << ")\n";
+    }
+}
+
+#endif
@@ -0,0 +1,207 @@
+#ifndef SHADER_PREPROCESSOR_BENCHMARK_H
+#define SHADER_PREPROCESSOR_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+#include <filesystem>
+#include <boost/regex.hpp>
+
+#include "../common/ShaderPreprocessor.h"
+#include "../common/JobSystem.h"
+
+/*
+ * Compares the shader preprocessor (ShaderPreprocessor.h) with the previous one on every shader of data/shaders:
+ *  - legacy: two regex searches per line through stringstreams, every include read from disk again
+ *  - scanner, cold: the file cache is dropped before each pass, so every file is read and scanned once per pass
+ *  - scanner, warm: the parsed files are cached (a size and time check per file)
+ *  - scanner, warm on the job system: one job per shader
+ * The outputs of both are compared with the #line directives, #pragma once and empty lines left out (those are expected
+ * to differ). Doesnt need a GL context
+ */
+
+namespace ShaderPreprocessorBenchmark
+{
+    // the previous Shader::PreProcessShader
+    inline std::string LegacyReadFile(const std::string &path)
+    {
+        std::ifstream file(path);
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    inline std::string LegacyPreProcess(std::string &source, const std::string &filePath, const std::vector<std::string> &preDefines, unsigned int level, bool versionMatch = false)
+    {
+        static const boost::regex re("^[ ]*#[ ]*include[ ]+[\"<](.*)[\">].*");
+        static const std::string includeDir = BASE_DIR  SHADER_INCLUDE_SUBDIR;
+        static const boost::regex ver("^[ ]*#[ ]*version[ ]+(.*).*");
+        static bool hasPreDefines;
+
+        std::stringstream input;
+        std::stringstream output;
+        input << source;
+
+        size_t line_number = 1;
+        boost::smatch reMatches;
+        boost::smatch verMatches;
+        std::string line;
+
+        while(std::getline(input,line))
+        {
+            if(!versionMatch)
+            {
+                hasPreDefines = false;
+                versionMatch = boost::regex_search(line, verMatches, ver);
+                if(versionMatch)
+                    output <<  line << std::endl;
+                ++line_number;
+                continue;
+            }
+
+            if (!hasPreDefines)
+            {
+                for (size_t i = 0; i < preDefines.size(); i++)
+                    output << "#define " <<  preDefines[i] << std::endl;
+                hasPreDefines = true;
+            }
+
+            if (boost::regex_search(line, reMatches, re))
+            {
+                std::string include_file = reMatches[1];
+                std::string include_string = LegacyReadFile(includeDir + include_file);
+                output << LegacyPreProcess(include_string, include_file, preDefines, level + 1, versionMatch) << std::endl;
+            }
+            else
+            {
+                output <<  line << std::endl;
+                output << "#line "<< line_number << " \"" << filePath << "\""  << std::endl;
+            }
+            ++line_number;
+        }
+
+        return output.str();
+    }
+
+    // lines of the source without #line, #pragma once and empty lines
+    inline std::vector<std::string> CodeLines(const std::string &source)
+    {
+        std::vector<std::string> lines;
+        size_t lineStart = 0;
+        while (lineStart < source.size())
+        {
+            size_t lineEnd = source.find('\n', lineStart);
+            if (lineEnd == std::string::npos)
+                lineEnd = source.size();
+
+            std::string line = source.substr(lineStart, lineEnd - lineStart);
+            line.erase(0, line.find_first_not_of(" \t"));
+            while (!line.empty() && (line.back() == '\r' || line.back() == ' ' || line.back() == '\t'))
+                line.pop_back();
+
+            if (!line.empty() && line.compare(0, 5, "#line") != 0 && line != "#pragma once")
+                lines.push_back(line);
+            lineStart = lineEnd + 1;
+        }
+        return lines;
+    }
+
+    inline double MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline void Run(unsigned int passCount)
+    {
+        std::vector<std::string> shaders;
+        for (const auto &entry : std::filesystem::recursive_directory_iterator(BASE_DIR "/data/shaders"))
+        {
+            std::string extension = entry.path().extension().string();
+            if (entry.is_regular_file() && (extension == ".vert" || extension == ".frag" || extension == ".geom" || extension == ".comp"))
+                shaders.push_back(entry.path().generic_string());
+        }
+        std::sort(shaders.begin(), shaders.end());
+
+        // the defines of the renderers
+        std::vector<std::string> defines = {"MAX_DIR_LIGHTS 5", "MAX_POINT_LIGHTS 5", "SHADOW_CASCADE_COUNT 4", "MULTI_DRAW"};
+
+        ShaderPreprocessor &preprocessor = ShaderPreprocessor::Get();
+        size_t mismatches = 0, failures = 0, outputSize = 0;
+        size_t includeCount = 0;
+        for (const std::string &shader : shaders)
+        {
+            try
+            {
+                ShaderPreprocessor::Dependencies dependencies;
+                std::string output = preprocessor.Process(shader, defines, &dependencies);
+                std::string source = LegacyReadFile(shader);
+                std::string legacyOutput = LegacyPreProcess(source, shader, defines, 0);
+                outputSize += output.size();
+                includeCount += dependencies.edges.size();
+
+                if (CodeLines(output) != CodeLines(legacyOutput))
+                {
+                    mismatches++;
+                    std::cout << "   output differs from the legacy preprocessor: " << shader << "\n";
+                }
+            }
+            catch(const std::exception &e)
+            {
+                failures++;
+                std::cout << "   " << e.what() << "\n";
+            }
+        }
+
+        auto legacyStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (const std::string &shader : shaders)
+            {
+                std::string source = LegacyReadFile(shader);
+                LegacyPreProcess(source, shader, defines, 0);
+            }
+        }
+        double legacyTime = MillisecondsSince(legacyStart) / passCount;
+
+        auto runPass = [&](size_t begin, size_t end){
+            for (size_t i = begin; i < end; i++)
+            {
+                try { preprocessor.Process(shaders[i], defines); } catch(const std::exception &e) {}
+            }
+        };
+
+        auto coldStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            preprocessor.ClearCache();
+            runPass(0, shaders.size());
+        }
+        double coldTime = MillisecondsSince(coldStart) / passCount;
+
+        auto warmStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            runPass(0, shaders.size());
+        double warmTime = MillisecondsSince(warmStart) / passCount;
+
+        auto parallelStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            JobSystem::Get().ParallelFor(shaders.size(), 1, runPass);
+        double parallelTime = MillisecondsSince(parallelStart) / passCount;
+
+        std::cout << "Shader preprocessor benchmark (" << shaders.size() << " shaders, " << includeCount << " includes, "
+                  << outputSize / 1024 << " KB of output, average of " << passCount << " passes):\n";
+        std::cout << "   legacy (regex, includes read every time): " << legacyTime << " ms\n";
+        std::cout << "   scanner, cold file cache: " << coldTime << " ms (" << legacyTime / coldTime << "x)\n";
+        std::cout << "   scanner, warm file cache: " << warmTime << " ms (" << legacyTime / warmTime << "x)\n";
+        std::cout << "   scanner, warm on " << JobSystem::Get().GetWorkerCount() + 1 << " threads: " << parallelTime << " ms ("
+                  << legacyTime / parallelTime << "x)\n";
+        std::cout << "   " << mismatches << " shaders differ from the legacy output, " << failures << " failed\n";
+    }
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef TRANSFORM_BENCHMARK_H
+#define TRANSFORM_BENCHMARK_H
+
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../common/MathUtils.h"
+#include "../common/TransformKernel.h"
+
+/*
+ * Compares the normal matrix sweep (TransformKernel.h) with the per draw path of the renderers, on random static objects
+ * seen by a moving camera (the view changes every pass, the transforms dont):
+ *  - per draw: MathUtils::ComputeNormalMatrix (a full inverse of view * model) for every object
+ *  - kernel: the product of the cached inverse transforms with the inverse view, on the calling thread and split in
+ *    jobs across the job system workers
+ * The largest difference of the kernel matrices with the per draw ones is reported (rounding only). Doesnt need a GL
+ * context
+ */
+
+namespace TransformBenchmark
+{
+    inline double NanosecondsSince(std::chrono::high_resolution_clock::time_point start)
+    {
+        return std::chrono::duration<double, std::nano>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    inline float MaxDifference(const std::vector<glm::mat4> &matrices, const std::vector<glm::mat4> &referenceMatrices)
+    {
+        float difference = 0.0f;
+        for (size_t i = 0; i < matrices.size(); i++)
+        {
+            for (int column = 0; column < 4; column++)
+            {
+                glm::vec4 delta = glm::abs(matrices[i][column] - referenceMatrices[i][column]);
+                difference = std::max(difference, std::max(std::max(delta.x, delta.y), std::max(delta.z, delta.w)));
+            }
+        }
+        return difference;
+    }
+
+    inline void Run(unsigned int objectCount, unsigned int passCount = 50)
+    {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.2f, 4.0f);
+        std::uniform_real_distribution<float> angle(0.0f, 6.28f);
+
+        std::vector<glm::mat4> transforms(objectCount);
+        std::vector<glm::mat4> inverseTransforms(objectCount);
+        std::vector<uint32_t> objects(objectCount);
+        for (unsigned int i = 0; i < objectCount; i++)
+        {
+            glm::mat4 transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(random), position(random) * 0.1f, position(random)));
+            transform = glm::rotate(transform, angle(random), glm::normalize(glm::vec3(0.2f, 1.0f, 0.1f)));
+            transforms[i] = glm::scale(transform, glm::vec3(size(random), size(random), size(random)));
+            inverseTransforms[i] = glm::inverse(transforms[i]);
+            objects[i] = i;
+        }
+
+        std::vector<glm::mat4> views(passCount);
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            glm::vec3 eye = glm::vec3((float)pass, 20.0f, 0.0f);
+            views[pass] = glm::lookAt(eye, eye + glm::vec3(1.0f, -0.1f, 1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+
+        std::vector<glm::mat4> referenceMatrices(objectCount);
+        auto referenceStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+        {
+            for (unsigned int i = 0; i < objectCount; i++)
+                referenceMatrices[i] = MathUtils::ComputeNormalMatrix(views[pass], transforms[i]);
+        }
+        double referenceTime = NanosecondsSince(referenceStart) / passCount;
+
+        std::vector<glm::mat4> matrices(objectCount);
+        auto kernelStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            TransformKernel::ComputeNormalMatrices(inverseTransforms.data(), objects.data(), objectCount, glm::inverse(views[pass]), matrices.data(), false);
+        double kernelTime = NanosecondsSince(kernelStart) / passCount;
+        float kernelDifference = MaxDifference(matrices, referenceMatrices);
+
+        auto threadedStart = std::chrono::high_resolution_clock::now();
+        for (unsigned int pass = 0; pass < passCount; pass++)
+            TransformKernel::ComputeNormalMatrices(inverseTransforms.data(), objects.data(), objectCount, glm::inverse(views[pass]), matrices.data(), true);
+        double threadedTime = NanosecondsSince(threadedStart) / passCount;
+        float threadedDifference = MaxDifference(matrices, referenceMatrices);
+
+        #if defined(__SSE2__) || defined(_M_X64)
+            const char *path = "SSE";
+        #else
+            const char *path = "scalar";
+        #endif
+
+        std::cout << "Transform benchmark (" << objectCount << " static objects, average of " << passCount << " passes):\n";
+        std::cout << "   per draw inverse (MathUtils::ComputeNormalMatrix): " << referenceTime / 1e6 << " ms (" << referenceTime / objectCount << " ns/object)\n";
+        std::cout << "   " << path << " kernel on cached inverses: " << kernelTime / 1e6 << " ms (" << kernelTime / objectCount << " ns/object, "
+                  << referenceTime / kernelTime << "x)\n";
+        std::cout << "   " << path << " kernel on " << JobSystem::Get().GetWorkerCount() + 1 << " threads: " << threadedTime / 1e6 << " ms ("
+                  << referenceTime / threadedTime << "x)\n";
+        std::cout << "   largest difference with the per draw matrices: " << std::max(kernelDifference, threadedDifference) << "\n";
+    }
+}
+
+#endif
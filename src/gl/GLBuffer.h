@@ -16,6 +16,9 @@
  * 2) using SetData for each individual element of the buffer, which will call glBufferSubData with the given offset and size of the element
  * this seems to perform better when the same range of data in the buffer needs to be set multiple times per frame (like object-related
  * properties that need to be sent before each object's draw call)
+ *
+ * the per object data of the render queue doesnt go through either anymore: it is written once per draw into a persistently
+ * mapped ring (GLRingBuffer.h) and bound by range
  */
 
 // change to GLBuffer and make it more generic 
@@ -82,6 +85,11 @@ class GLUniformBuffer
             }
         }
 
+        GLuint GetGLId() const
+        {
+            return GLId;
+        }
+
         void BindBufferFull(GLuint binding)
         {
             glBindBufferRange(GL_UNIFORM_BUFFER, binding, GLId, 0, size);
@@ -0,0 +1,194 @@
+#ifndef GL_RING_BUFFER_H
+#define GL_RING_BUFFER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+/*
+ * Persistently mapped buffer for the data written once per draw (uniform or storage blocks), split in FRAME_COUNT
+ * regions used one frame each in turn.
+ *
+ * Every piece of data gets a fresh slice of the region of the current frame, aligned for glBindBufferRange, and is
+ * written straight into the mapping (coherent, so nothing has to be flushed) instead of going through glBufferSubData
+ * on a shared buffer before each draw. Slices can be allocated from any thread. A fence is placed after the frames
+ * that used a region, and BeginFrame waits for it before the region is reused FRAME_COUNT frames later, so the GPU is
+ * never reading what is being written.
+ * When a frame needs more than a region the allocations fail (the caller falls back to its own buffer) and the buffer
+ * is grown on the next BeginFrame.
+ */
+
+class GLRingBuffer
+{
+    public:
+        static constexpr unsigned int FRAME_COUNT = 3;
+        static constexpr size_t MIN_REGION_SIZE = 64 * 1024;
+
+        struct Allocation
+        {
+            // null when the region of the frame is full
+            void *data;
+            GLintptr offset;
+        };
+
+        GLRingBuffer(){}
+
+        ~GLRingBuffer()
+        {
+            Release();
+        }
+
+        GLRingBuffer(GLRingBuffer &&other)
+        {
+            *this = std::move(other);
+        }
+
+        GLRingBuffer &operator = (GLRingBuffer &&other)
+        {
+            std::swap(GLId, other.GLId);
+            std::swap(mapping, other.mapping);
+            std::swap(regionSize, other.regionSize);
+            std::swap(alignment, other.alignment);
+            std::swap(frame, other.frame);
+            std::swap(waitCount, other.waitCount);
+            for (unsigned int i = 0; i < FRAME_COUNT; i++)
+                std::swap(fences[i], other.fences[i]);
+
+            size_t head = this->head.load();
+            this->head.store(other.head.load());
+            other.head.store(head);
+            bool overflow = this->overflow.load();
+            this->overflow.store(other.overflow.load());
+            other.overflow.store(overflow);
+            return *this;
+        }
+
+        // Fences the region of the previous frame and moves to the next one, waiting until the GPU is done with it.
+        // The regions grow to fit expectedSize, and double after a frame that didnt fit. Only valid on the GL thread
+        void BeginFrame(size_t expectedSize)
+        {
+            if (GLId == 0)
+            {
+                GLint uniformAlignment = 1, storageAlignment = 1;
+                glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+                glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &storageAlignment);
+                alignment = (size_t)std::max(std::max(uniformAlignment, storageAlignment), 1);
+            }
+
+            if (GLId != 0)
+            {
+                fences[frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                frame = (frame + 1) % FRAME_COUNT;
+            }
+            size_t size = std::max(regionSize, MIN_REGION_SIZE);
+            if (overflow.load())
+                size *= 2;
+            while (size < expectedSize)
+                size *= 2;
+            if (size != regionSize)
+                CreateStorage(size);
+
+            WaitFence(frame);
+            head.store(0);
+            overflow.store(false);
+        }
+
+        // Slice of size bytes of the current frame. May run on any thread
+        Allocation Allocate(GLsizeiptr size)
+        {
+            size_t offset = head.fetch_add(Align((size_t)size));
+            if (mapping == nullptr || offset + (size_t)size > regionSize)
+            {
+                overflow.store(true);
+                return {nullptr, 0};
+            }
+
+            size_t bufferOffset = frame * regionSize + offset;
+            return {mapping + bufferOffset, (GLintptr)bufferOffset};
+        }
+
+        size_t Align(size_t size) const
+        {
+            return (size + alignment - 1) / alignment * alignment;
+        }
+
+        GLuint GetGLId() const
+        {
+            return GLId;
+        }
+
+        // bytes allocated on the current frame
+        size_t GetFrameBytes() const
+        {
+            return std::min(head.load(), regionSize);
+        }
+
+        // times BeginFrame had to wait for the GPU to release a region
+        size_t GetWaitCount() const
+        {
+            return waitCount;
+        }
+
+    private:
+        GLuint GLId = 0;
+        uint8_t *mapping = nullptr;
+        size_t regionSize = 0;
+        // the largest alignment GL allows until the actual one is queried
+        size_t alignment = 256;
+        unsigned int frame = 0;
+        GLsync fences[FRAME_COUNT] = {};
+        std::atomic<size_t> head{0};
+        std::atomic<bool> overflow{false};
+        size_t waitCount = 0;
+
+        GLRingBuffer(const GLRingBuffer&) = delete;
+        GLRingBuffer &operator = (const GLRingBuffer &other) = delete;
+
+        void WaitFence(unsigned int region)
+        {
+            if (fences[region] == 0)
+                return;
+
+            GLenum result = glClientWaitSync(fences[region], 0, 0);
+            if (result == GL_TIMEOUT_EXPIRED)
+            {
+                waitCount++;
+                while (result == GL_TIMEOUT_EXPIRED)
+                    result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+
+        // reallocates the buffer once the GPU is done with every region
+        void CreateStorage(size_t size)
+        {
+            Release();
+            regionSize = size;
+            frame = 0;
+
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &GLId);
+            glNamedBufferStorage(GLId, regionSize * FRAME_COUNT, NULL, flags);
+            mapping = (uint8_t*)glMapNamedBufferRange(GLId, 0, regionSize * FRAME_COUNT, flags);
+        }
+
+        void Release()
+        {
+            for (unsigned int i = 0; i < FRAME_COUNT; i++)
+                WaitFence(i);
+
+            if (GLId != 0)
+            {
+                glUnmapNamedBuffer(GLId);
+                glDeleteBuffers(1, &GLId);
+            }
+            GLId = 0;
+            mapping = nullptr;
+            regionSize = 0;
+        }
+};
+
+#endif
@@ -4,8 +4,16 @@
 #include <iostream>
 #include <glad/glad.h>
 #include <string>
+#include <utility>
+#include <algorithm>
+#include <memory>
+#include <vector>
 #include <stb_image.h>
 
+#include "TextureUploadService.h"
+#include "TextureCooker.h"
+#include "../common/MipGenerator.h"
+
 
 
 
@@ -26,6 +34,71 @@ struct TextureDescriptor
     GLint wrapR = GL_CLAMP_TO_EDGE;
 };
 
+// Pixel data decoded by stb_image, freed when it goes out of scope
+struct TextureImageData
+{
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+    unsigned char *data = nullptr;
+    // levels 1 to N, with the same layout as data. Empty when the mips are left to the driver
+    std::vector<std::vector<uint8_t>> mips;
+
+    TextureImageData(){}
+    TextureImageData(const TextureImageData&) = delete;
+    TextureImageData& operator=(const TextureImageData&) = delete;
+
+    TextureImageData(TextureImageData &&other)
+    {
+        *this = std::move(other);
+    }
+
+    TextureImageData &operator = (TextureImageData &&other)
+    {
+        if (data != nullptr && data != other.data)
+            stbi_image_free(data);
+
+        width = other.width;
+        height = other.height;
+        nrComponents = other.nrComponents;
+        data = other.data;
+        mips = std::move(other.mips);
+        other.data = nullptr;
+        return *this;
+    }
+
+    ~TextureImageData()
+    {
+        if (data != nullptr)
+            stbi_image_free(data);
+    }
+
+    size_t GetByteSize() const
+    {
+        return (size_t)width * height * nrComponents;
+    }
+
+    // Computes the mip chain on the CPU (see MipGenerator.h). Doesnt touch GL, so it can run on the loading workers
+    void GenerateMips(TextureUsage usage)
+    {
+        if (data == nullptr)
+            return;
+
+        MipGenerator::MipSettings settings = MipGenerator::MipSettings();
+        settings.gammaCorrect = usage == OP_TEXTURE_USAGE_COLOR && nrComponents >= 3;
+        settings.renormalize = usage == OP_TEXTURE_USAGE_NORMAL && nrComponents >= 3;
+        mips = MipGenerator::GenerateMipChain(data, width, height, nrComponents, settings);
+    }
+
+    // transfers the ownership of the pixels (e.g. to an upload request)
+    std::shared_ptr<const unsigned char> Release()
+    {
+        std::shared_ptr<const unsigned char> pixels(data, stbi_image_free);
+        data = nullptr;
+        return pixels;
+    }
+};
+
 //CHECK IF THE DESCRIPTORS ARE VALID FOR EACH TYPE OF TEXTURE:
 class TextureObject
 {   
@@ -42,6 +115,21 @@ class TextureObject
             glBindTexture(descriptor.GLType, GLId);
         }
 
+        GLuint GetGLId() const
+        {
+            return GLId;
+        }
+
+        GLenum GetTarget() const
+        {
+            return descriptor.GLType;
+        }
+
+        const TextureDescriptor &GetDescriptor() const
+        {
+            return descriptor;
+        }
+
         //Binds the texture image specified by level and layer with read permission
         void BindImageR(GLuint binding, GLint level, GLint layer)
         {
@@ -97,10 +185,54 @@ class TextureObject
         {
             glGenerateTextureMipmap(GLId);
         }
+
+        //Estimated GPU memory used by the texture (only tracked for textures loaded from files)
+        size_t GetMemorySize() const
+        {
+            return memorySize;
+        }
+
+        //Returns false while any level queued on the uploader hasnt reached the GPU yet
+        bool IsResident(const TextureUploadService &uploader) const
+        {
+            return uploader.IsResident(GLId);
+        }
         
     protected:
         GLuint GLId;
         TextureDescriptor descriptor;
+        size_t memorySize = 0;
+
+        //Queues the upload of a full 2D level. The storage of the level must already be allocated and the pixels 
+        //are expected in the descriptor's internalFormat/pixelFormat, tightly packed
+        void QueueLevelUpload2D(TextureUploadService &uploader, GLuint level, std::shared_ptr<const unsigned char> pixels, size_t byteSize, bool generateMips)
+        {
+            TextureUploadService::UploadRequest request;
+            request.texture = GLId;
+            request.level = level;
+            request.width = std::max(1u, descriptor.width >> level);
+            request.height = std::max(1u, descriptor.height >> level);
+            request.format = descriptor.internalFormat;
+            request.type = descriptor.pixelFormat;
+            request.generateMips = generateMips;
+            request.pixels = std::move(pixels);
+            request.byteSize = byteSize;
+            uploader.QueueUpload(std::move(request));
+        }
+
+        void QueueCompressedLevelUpload2D(TextureUploadService &uploader, GLuint level, unsigned int width, unsigned int height, std::shared_ptr<const unsigned char> data, size_t byteSize)
+        {
+            TextureUploadService::UploadRequest request;
+            request.texture = GLId;
+            request.level = level;
+            request.width = width;
+            request.height = height;
+            request.format = descriptor.sizedInternalFormat;
+            request.compressed = true;
+            request.pixels = std::move(data);
+            request.byteSize = byteSize;
+            uploader.QueueUpload(std::move(request));
+        }
 };
 
 
@@ -240,6 +372,7 @@ class Texture2D : public TextureObject
         {
             this->GLId = other.GLId;
             this->descriptor = other.descriptor;
+            this->memorySize = other.memorySize;
             other.GLId = 0;
         }   
 
@@ -247,11 +380,12 @@ class Texture2D : public TextureObject
         {
             if (GLId != 0)
             {
-                glDeleteBuffers(1, &GLId);
+                glDeleteTextures(1, &GLId);
             }
 
             this->GLId = other.GLId;
             this->descriptor = other.descriptor;
+            this->memorySize = other.memorySize;
             other.GLId = 0;
             return *this;
         }
@@ -287,11 +421,22 @@ class Texture2D : public TextureObject
             glNamedFramebufferTexture(frameBuffer, attachmentBinding, GLId, level);
         }
 
-        static Texture2D TextureFromFile(const std::string &filename, unsigned int numMips = 1)
+        // Decodes the image and builds its mip chain on the CPU. Doesnt touch GL, so it can be called from any thread
+        static TextureImageData LoadImageData(const std::string &filename, TextureUsage usage = OP_TEXTURE_USAGE_COLOR)
         {
-            int width, height, nrComponents;
-            unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
+            TextureImageData image = TextureImageData();
+            image.data = stbi_load(filename.c_str(), &image.width, &image.height, &image.nrComponents, 0);
 
+            if (!image.data)
+            {
+                std::cout << "Texture failed to load at path: " << filename << "\n";
+            }
+            image.GenerateMips(TextureCooker::DetectUsage(filename, usage));
+            return image;
+        }
+
+        static TextureDescriptor ImageDescriptor(const TextureImageData &image, unsigned int numMips)
+        {
             TextureDescriptor desc = TextureDescriptor();
             desc.GLType = GL_TEXTURE_2D;
             desc.numMips = numMips;
@@ -301,32 +446,175 @@ class Texture2D : public TextureObject
             desc.wrapS = GL_REPEAT;
             desc.wrapT = GL_REPEAT;
 
-            if (data)
+            if (image.data)
             {
                 GLenum format;
-                if (nrComponents == 1)
+                if (image.nrComponents == 1)
                     format = GL_RED;
-                else if (nrComponents == 3)
+                else if (image.nrComponents == 2)
+                    format = GL_RG;
+                else if (image.nrComponents == 3)
                     format = GL_RGB;
-                else if (nrComponents == 4)
+                else if (image.nrComponents == 4)
                     format = GL_RGBA;
                 
-                desc.width = width;
-                desc.height = height;
+                desc.width = image.width;
+                desc.height = image.height;
                 desc.internalFormat = format;
                 desc.sizedInternalFormat = format;
-                
             }
-            else
+            return desc;
+        }
+
+        // Uploads an image decoded by LoadImageData level by level. Images without a CPU mip chain get their mips from
+        // the driver. Must be called on the GL thread
+        static Texture2D TextureFromImage(const TextureImageData &image, unsigned int numMips = 1)
+        {
+            Texture2D tex = Texture2D(ImageDescriptor(image, numMips), image.data);
+            tex.memorySize = EstimateImageMemory(image);
+
+            if (image.mips.empty())
             {
-                std::cout << "Texture failed to load at path: " << filename << "\n";
+                tex.GenerateMipMaps();
+                return tex;
             }
 
-            Texture2D tex = Texture2D(desc, data);
-            tex.GenerateMipMaps();
-            stbi_image_free(data);
+            tex.AllocateMipLevels(image.mips.size());
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (unsigned int level = 1; level <= image.mips.size(); level++)
+            {
+                glTextureSubImage2D(tex.GLId, level, 0, 0, std::max(1, image.width >> level), std::max(1, image.height >> level), 
+                                    tex.descriptor.internalFormat, tex.descriptor.pixelFormat, image.mips[level - 1].data());
+            }
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            return tex;
+        }
+
+        // Allocates the texture and queues the upload of every level (or of the base level and the driver mip generation 
+        // when the image has no CPU mip chain) on the uploader. The texture can be bound right away, but its contents 
+        // are undefined until IsResident returns true
+        static Texture2D TextureFromImageAsync(TextureImageData &&image, TextureUploadService &uploader, unsigned int numMips = 1)
+        {
+            Texture2D tex = Texture2D(ImageDescriptor(image, numMips));
+            tex.memorySize = EstimateImageMemory(image);
+
+            if (image.data)
+            {
+                bool driverMips = image.mips.empty();
+                if (!driverMips)
+                    tex.AllocateMipLevels(image.mips.size());
+
+                auto mips = std::make_shared<std::vector<std::vector<uint8_t>>>(std::move(image.mips));
+                size_t byteSize = image.GetByteSize();
+                tex.UploadLevelAsync(uploader, 0, image.Release(), byteSize, driverMips);
+
+                for (unsigned int level = 1; level <= mips->size(); level++)
+                {
+                    auto &pixels = (*mips)[level - 1];
+                    tex.UploadLevelAsync(uploader, level, std::shared_ptr<const unsigned char>(mips, pixels.data()), pixels.size());
+                }
+            }
+            return tex;
+        }
+
+        void UploadLevelAsync(TextureUploadService &uploader, GLuint level, std::shared_ptr<const unsigned char> pixels, size_t byteSize, bool generateMips = false)
+        {
+            QueueLevelUpload2D(uploader, level, std::move(pixels), byteSize, generateMips);
+        }
+
+        static TextureDescriptor CookedDescriptor(const CookedTextureData &cooked)
+        {
+            TextureDescriptor desc = TextureDescriptor();
+            desc.GLType = GL_TEXTURE_2D;
+            desc.width = cooked.width;
+            desc.height = cooked.height;
+            desc.numMips = cooked.levels.size();
+            desc.internalFormat = cooked.internalFormat;
+            desc.sizedInternalFormat = cooked.internalFormat;
+            desc.pixelFormat = GL_UNSIGNED_BYTE;
+            desc.minFilter = GL_LINEAR_MIPMAP_LINEAR;
+            desc.magFilter = GL_LINEAR;
+            desc.wrapS = GL_REPEAT;
+            desc.wrapT = GL_REPEAT;
+            return desc;
+        }
+
+        // Uploads a cooked (block compressed) mip chain. Must be called on the GL thread
+        static Texture2D TextureFromCooked(const CookedTextureData &cooked)
+        {
+            Texture2D tex = Texture2D();
+            tex.descriptor = CookedDescriptor(cooked);
+            glGenTextures(1, &tex.GLId);
+            tex.AllocateCompressedLevels(cooked, true);
+            tex.memorySize = cooked.GetByteSize();
+            return tex;
+        }
+
+        // Allocates the compressed levels and queues their upload on the uploader. The contents are undefined until 
+        // IsResident returns true
+        static Texture2D TextureFromCookedAsync(CookedTextureData &&cooked, TextureUploadService &uploader)
+        {
+            Texture2D tex = Texture2D();
+            tex.descriptor = CookedDescriptor(cooked);
+            glGenTextures(1, &tex.GLId);
+            tex.AllocateCompressedLevels(cooked, false);
+            tex.memorySize = cooked.GetByteSize();
+
+            for (unsigned int level = 0; level < cooked.levels.size(); level++)
+            {
+                auto &levelData = cooked.levels[level];
+                tex.QueueCompressedLevelUpload2D(uploader, level, levelData.width, levelData.height, cooked.GetSharedLevelData(level), levelData.size);
+            }
             return tex;
+        }
+
+        // Loads the cooked version of the image (cooking it on the first use), so the image is never decoded at runtime
+        static Texture2D TextureFromFile(const std::string &filename, TextureUsage usage = OP_TEXTURE_USAGE_COLOR)
+        {
+            CookedTextureData cooked = TextureCooker::LoadOrCook(filename, usage);
+            if (!cooked.IsValid())
+                return TextureFromImage(LoadImageData(filename));
+
+            return TextureFromCooked(cooked);
         }  
+
+    private:
+        // uncompressed RGB is usually padded to 4 bytes per texel by the driver. The full mip chain adds ~1/3
+        static size_t EstimateImageMemory(const TextureImageData &image)
+        {
+            size_t bytesPerTexel = image.nrComponents == 3 ? 4 : image.nrComponents;
+            return (size_t)image.width * image.height * bytesPerTexel * 4 / 3;
+        }
+
+        // allocates the storage of levels 1 to mipCount of an uncompressed texture that already has its base level
+        void AllocateMipLevels(size_t mipCount)
+        {
+            glBindTexture(descriptor.GLType, GLId);
+            for (unsigned int level = 1; level <= mipCount; level++)
+            {
+                glTexImage2D(descriptor.GLType, level, descriptor.sizedInternalFormat, std::max(1u, descriptor.width >> level), 
+                             std::max(1u, descriptor.height >> level), 0, descriptor.internalFormat, descriptor.pixelFormat, NULL);
+            }
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_MAX_LEVEL, (GLint)mipCount);
+            glBindTexture(descriptor.GLType, 0);
+        }
+
+        void AllocateCompressedLevels(const CookedTextureData &cooked, bool uploadData)
+        {
+            glBindTexture(descriptor.GLType, GLId);
+            for (unsigned int level = 0; level < cooked.levels.size(); level++)
+            {
+                auto &levelData = cooked.levels[level];
+                glCompressedTexImage2D(descriptor.GLType, level, cooked.internalFormat, levelData.width, levelData.height, 0, 
+                                       (GLsizei)levelData.size, uploadData ? cooked.GetLevelData(level) : NULL);
+            }
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_MAX_LEVEL, (GLint)cooked.levels.size() - 1);
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_WRAP_S, descriptor.wrapS);
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_WRAP_T, descriptor.wrapT);
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_MIN_FILTER, descriptor.minFilter);
+            glTexParameteri(descriptor.GLType, GL_TEXTURE_MAG_FILTER, descriptor.magFilter);
+            glBindTexture(descriptor.GLType, 0);
+        }
 };
 
 class ITexture2D : public TextureObject
@@ -374,6 +662,12 @@ class ITexture2D : public TextureObject
             other.GLId = 0;
             return *this;
         }
+
+        // Queues the upload of a level of the immutable storage. The contents of the level are undefined until IsResident returns true
+        void UploadLevelAsync(TextureUploadService &uploader, GLuint level, std::shared_ptr<const unsigned char> pixels, size_t byteSize, bool generateMips = false)
+        {
+            QueueLevelUpload2D(uploader, level, std::move(pixels), byteSize, generateMips);
+        }
 };
 
 
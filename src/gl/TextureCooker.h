@@ -0,0 +1,548 @@
+#ifndef TEXTURE_COOKER_H
+#define TEXTURE_COOKER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <filesystem>
+#include <stb_image.h>
+
+#include "../common/Hashing.h"
+#include "../common/MipGenerator.h"
+
+// S3TC formats come from EXT_texture_compression_s3tc, which is not part of the core profile loaded by glad
+// but is exposed by every desktop driver
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+/*
+ * Offline texture cooking: source images are decoded once, their full mip chain is generated (see MipGenerator.h) and
+ * block compressed on the CPU, and the result is stored in a container next to the source (<source>.optex). At runtime the container is
+ * read as is and uploaded with glCompressedTexImage2D, so no image is decoded after the first run.
+ *
+ * Formats:
+ *  - BC1 (DXT1): opaque color maps
+ *  - BC3 (DXT5): color maps with alpha
+ *  - BC4 (RGTC1): single channel maps
+ *  - BC5 (RGTC2): normal maps. Only xy are stored, z has to be reconstructed in the shader (include/normalMaps.glsl)
+ *
+ * Container layout:
+ *  [TextureFileHeader][TextureLevelRecord * levelCount][level data...]
+ *
+ * The container is invalidated when the format version, the usage or the hash of the source file changes. The source is
+ * only hashed again when its size or write time differ from the ones stored with the container
+ */
+
+#define COOKED_TEXTURE_EXTENSION ".optex"
+
+enum TextureUsage
+{
+    OP_TEXTURE_USAGE_COLOR = 0,
+    OP_TEXTURE_USAGE_NORMAL = 1
+};
+
+
+// Compressed mip chain of a texture, as stored in the container. The blob is shared so that levels can be handed to
+// the upload service without copies
+struct CookedTextureData
+{
+    struct Level
+    {
+        unsigned int width;
+        unsigned int height;
+        size_t offset;
+        size_t size;
+    };
+
+    GLenum internalFormat = 0;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    std::vector<Level> levels;
+    std::shared_ptr<std::vector<unsigned char>> blob;
+
+    bool IsValid() const
+    {
+        return blob != nullptr && !levels.empty();
+    }
+
+    size_t GetByteSize() const
+    {
+        size_t size = 0;
+        for (auto &level : levels)
+            size += level.size;
+        return size;
+    }
+
+    const unsigned char *GetLevelData(unsigned int level) const
+    {
+        return blob->data() + levels[level].offset;
+    }
+
+    std::shared_ptr<const unsigned char> GetSharedLevelData(unsigned int level) const
+    {
+        return std::shared_ptr<const unsigned char>(blob, blob->data() + levels[level].offset);
+    }
+};
+
+
+namespace TextureCooker
+{
+    static constexpr uint32_t COOKED_TEXTURE_MAGIC = 0x5854504F; // "OPTX"
+    static constexpr uint32_t COOKED_TEXTURE_VERSION = 3;
+
+    // size and write time of the source file when it was cooked
+    struct SourceStamp
+    {
+        uint64_t size = 0;
+        int64_t writeTime = 0;
+
+        bool operator == (const SourceStamp &other) const
+        {
+            return size == other.size && writeTime == other.writeTime;
+        }
+    };
+
+    struct TextureFileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        SourceStamp sourceStamp;
+        uint32_t internalFormat;
+        uint32_t usage;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t padding;
+    };
+
+    struct TextureLevelRecord
+    {
+        uint32_t width;
+        uint32_t height;
+        uint64_t offset;
+        uint64_t size;
+    };
+
+
+    // Block encoders. Every block is a 4x4 tile of RGBA8 texels
+
+    inline uint16_t PackRGB565(const float color[3])
+    {
+        int r = std::min(31, std::max(0, (int)std::round(color[0] * 31.0f / 255.0f)));
+        int g = std::min(63, std::max(0, (int)std::round(color[1] * 63.0f / 255.0f)));
+        int b = std::min(31, std::max(0, (int)std::round(color[2] * 31.0f / 255.0f)));
+        return (uint16_t)((r << 11) | (g << 5) | b);
+    }
+
+    inline void UnpackRGB565(uint16_t packed, float color[3])
+    {
+        int r = (packed >> 11) & 31;
+        int g = (packed >> 5) & 63;
+        int b = packed & 31;
+        color[0] = (float)((r << 3) | (r >> 2));
+        color[1] = (float)((g << 2) | (g >> 4));
+        color[2] = (float)((b << 3) | (b >> 2));
+    }
+
+    // The endpoints are the extremes of the block colors projected on their principal axis (found by power iteration on
+    // the covariance matrix), inset slightly to reduce the quantization error. Always uses the 4 color mode
+    inline void EncodeBC1Block(const uint8_t texels[64], uint8_t output[8])
+    {
+        float mean[3] = {0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            for (int c = 0; c < 3; c++)
+                mean[c] += texels[i * 4 + c];
+        }
+        for (int c = 0; c < 3; c++)
+            mean[c] /= 16.0f;
+
+        float cov[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+        for (int i = 0; i < 16; i++)
+        {
+            float r = texels[i * 4 + 0] - mean[0];
+            float g = texels[i * 4 + 1] - mean[1];
+            float b = texels[i * 4 + 2] - mean[2];
+            cov[0] += r * r; cov[1] += r * g; cov[2] += r * b;
+            cov[3] += g * g; cov[4] += g * b; cov[5] += b * b;
+        }
+
+        float axis[3] = {1.0f, 1.0f, 1.0f};
+        for (int iteration = 0; iteration < 4; iteration++)
+        {
+            float x = axis[0] * cov[0] + axis[1] * cov[1] + axis[2] * cov[2];
+            float y = axis[0] * cov[1] + axis[1] * cov[3] + axis[2] * cov[4];
+            float z = axis[0] * cov[2] + axis[1] * cov[4] + axis[2] * cov[5];
+            float length = std::max(std::max(std::fabs(x), std::fabs(y)), std::fabs(z));
+            if (length < 1e-6f)
+                break;
+            axis[0] = x / length; axis[1] = y / length; axis[2] = z / length;
+        }
+
+        float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+        float minT = 0.0f, maxT = 0.0f;
+        for (int i = 0; i < 16; i++)
+        {
+            float t = (texels[i * 4 + 0] - mean[0]) * axis[0] + (texels[i * 4 + 1] - mean[1]) * axis[1] + (texels[i * 4 + 2] - mean[2]) * axis[2];
+            t /= axisLength2;
+            minT = std::min(minT, t);
+            maxT = std::max(maxT, t);
+        }
+
+        float inset = (maxT - minT) / 32.0f;
+        minT += inset;
+        maxT -= inset;
+
+        float maxColor[3], minColor[3];
+        for (int c = 0; c < 3; c++)
+        {
+            maxColor[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * maxT));
+            minColor[c] = std::min(255.0f, std::max(0.0f, mean[c] + axis[c] * minT));
+        }
+
+        uint16_t color0 = PackRGB565(maxColor);
+        uint16_t color1 = PackRGB565(minColor);
+        if (color0 < color1)
+            std::swap(color0, color1);
+
+        uint32_t indices = 0;
+        if (color0 != color1)
+        {
+            float palette[4][3];
+            UnpackRGB565(color0, palette[0]);
+            UnpackRGB565(color1, palette[1]);
+            for (int c = 0; c < 3; c++)
+            {
+                palette[2][c] = (2.0f * palette[0][c] + palette[1][c]) / 3.0f;
+                palette[3][c] = (palette[0][c] + 2.0f * palette[1][c]) / 3.0f;
+            }
+
+            for (int i = 0; i < 16; i++)
+            {
+                uint32_t bestIndex = 0;
+                float bestDistance = 1e30f;
+                for (uint32_t p = 0; p < 4; p++)
+                {
+                    float dr = texels[i * 4 + 0] - palette[p][0];
+                    float dg = texels[i * 4 + 1] - palette[p][1];
+                    float db = texels[i * 4 + 2] - palette[p][2];
+                    float distance = dr * dr + dg * dg + db * db;
+                    if (distance < bestDistance)
+                    {
+                        bestDistance = distance;
+                        bestIndex = p;
+                    }
+                }
+                indices |= bestIndex << (2 * i);
+            }
+        }
+
+        output[0] = color0 & 0xFF; output[1] = color0 >> 8;
+        output[2] = color1 & 0xFF; output[3] = color1 >> 8;
+        output[4] = indices & 0xFF; output[5] = (indices >> 8) & 0xFF;
+        output[6] = (indices >> 16) & 0xFF; output[7] = (indices >> 24) & 0xFF;
+    }
+
+    // Single channel block (BC4, also the alpha block of BC3 and each channel of BC5). Uses the 8 value mode
+    inline void EncodeBC4Block(const uint8_t texels[64], int channel, uint8_t output[8])
+    {
+        uint8_t minValue = 255, maxValue = 0;
+        for (int i = 0; i < 16; i++)
+        {
+            minValue = std::min(minValue, texels[i * 4 + channel]);
+            maxValue = std::max(maxValue, texels[i * 4 + channel]);
+        }
+
+        uint64_t indices = 0;
+        if (maxValue != minValue)
+        {
+            float range = (float)(maxValue - minValue);
+            for (int i = 0; i < 16; i++)
+            {
+                // position between min (0) and max (7), remapped to the BC4 index order: 0 = max, 1 = min, 2..7 = interpolated
+                int position = (int)std::round((texels[i * 4 + channel] - minValue) * 7.0f / range);
+                uint64_t index = position == 7 ? 0 : (position == 0 ? 1 : 8 - position);
+                indices |= index << (3 * i);
+            }
+        }
+
+        output[0] = maxValue;
+        output[1] = minValue;
+        for (int b = 0; b < 6; b++)
+            output[2 + b] = (uint8_t)((indices >> (8 * b)) & 0xFF);
+    }
+
+    inline bool IsCompressedFormat(GLenum internalFormat)
+    {
+        return internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT ||
+               internalFormat == GL_COMPRESSED_RED_RGTC1 || internalFormat == GL_COMPRESSED_RG_RGTC2;
+    }
+
+    inline size_t GetBlockSize(GLenum internalFormat)
+    {
+        return (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RED_RGTC1) ? 8 : 16;
+    }
+
+    inline size_t GetCompressedSize(GLenum internalFormat, unsigned int width, unsigned int height)
+    {
+        return (size_t)((width + 3) / 4) * ((height + 3) / 4) * GetBlockSize(internalFormat);
+    }
+
+    // Compresses a RGBA8 image. Blocks on the edges of images that arent multiple of 4 clamp to the last texel
+    inline void CompressImage(const uint8_t *rgba, unsigned int width, unsigned int height, GLenum internalFormat, unsigned char *output)
+    {
+        uint8_t block[64];
+        size_t blockSize = GetBlockSize(internalFormat);
+
+        for (unsigned int by = 0; by < height; by += 4)
+        {
+            for (unsigned int bx = 0; bx < width; bx += 4)
+            {
+                for (unsigned int y = 0; y < 4; y++)
+                {
+                    unsigned int sy = std::min(by + y, height - 1);
+                    for (unsigned int x = 0; x < 4; x++)
+                    {
+                        unsigned int sx = std::min(bx + x, width - 1);
+                        std::memcpy(&block[(y * 4 + x) * 4], &rgba[((size_t)sy * width + sx) * 4], 4);
+                    }
+                }
+
+                switch (internalFormat)
+                {
+                    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+                        EncodeBC1Block(block, output);
+                        break;
+                    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+                        EncodeBC4Block(block, 3, output);
+                        EncodeBC1Block(block, output + 8);
+                        break;
+                    case GL_COMPRESSED_RED_RGTC1:
+                        EncodeBC4Block(block, 0, output);
+                        break;
+                    case GL_COMPRESSED_RG_RGTC2:
+                        EncodeBC4Block(block, 0, output);
+                        EncodeBC4Block(block, 1, output + 8);
+                        break;
+                }
+                output += blockSize;
+            }
+        }
+    }
+
+    // Color maps are filtered in linear space and normal maps are renormalized. Single channel maps are left as is
+    inline MipGenerator::MipSettings GetMipSettings(GLenum internalFormat, TextureUsage usage)
+    {
+        MipGenerator::MipSettings settings = MipGenerator::MipSettings();
+        settings.gammaCorrect = usage == OP_TEXTURE_USAGE_COLOR && internalFormat != GL_COMPRESSED_RED_RGTC1;
+        settings.renormalize = usage == OP_TEXTURE_USAGE_NORMAL;
+        return settings;
+    }
+
+    inline GLenum ChooseFormat(const uint8_t *rgba, unsigned int width, unsigned int height, int nrComponents, TextureUsage usage)
+    {
+        if (usage == OP_TEXTURE_USAGE_NORMAL)
+            return GL_COMPRESSED_RG_RGTC2;
+        if (nrComponents == 1)
+            return GL_COMPRESSED_RED_RGTC1;
+
+        if (nrComponents == 2 || nrComponents == 4)
+        {
+            for (size_t i = 0; i < (size_t)width * height; i++)
+            {
+                if (rgba[i * 4 + 3] != 255)
+                    return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+            }
+        }
+        return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    }
+
+    // Normal maps are detected by the usage given by the material or by the "_ddn" suffix used on the sponza textures
+    inline TextureUsage DetectUsage(const std::string &filename, TextureUsage hint)
+    {
+        if (hint == OP_TEXTURE_USAGE_NORMAL || filename.find("_ddn") != std::string::npos)
+            return OP_TEXTURE_USAGE_NORMAL;
+        return hint;
+    }
+
+
+
+    // Returns false when the file cant be found
+    inline bool GetSourceStamp(const std::string &filename, SourceStamp &stamp)
+    {
+        std::error_code error;
+        std::uintmax_t size = std::filesystem::file_size(filename, error);
+        std::filesystem::file_time_type writeTime = std::filesystem::last_write_time(filename, error);
+        if (error)
+            return false;
+
+        stamp.size = size;
+        stamp.writeTime = (int64_t)writeTime.time_since_epoch().count();
+        return true;
+    }
+
+    inline bool WriteContainer(const std::string &path, const CookedTextureData &texture, uint64_t sourceHash,
+                               const SourceStamp &sourceStamp, TextureUsage usage)
+    {
+        TextureFileHeader header = TextureFileHeader();
+        header.magic = COOKED_TEXTURE_MAGIC;
+        header.version = COOKED_TEXTURE_VERSION;
+        header.sourceHash = sourceHash;
+        header.sourceStamp = sourceStamp;
+        header.internalFormat = texture.internalFormat;
+        header.usage = usage;
+        header.width = texture.width;
+        header.height = texture.height;
+        header.levelCount = (uint32_t)texture.levels.size();
+
+        uint64_t dataOffset = sizeof(TextureFileHeader) + texture.levels.size() * sizeof(TextureLevelRecord);
+        std::vector<TextureLevelRecord> records;
+        for (auto &level : texture.levels)
+            records.push_back({level.width, level.height, dataOffset + level.offset, level.size});
+
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output.is_open())
+        {
+            std::cout << "Failed to write cooked texture: " << path << "\n";
+            return false;
+        }
+        output.write(reinterpret_cast<const char*>(&header), sizeof(TextureFileHeader));
+        output.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(TextureLevelRecord));
+        output.write(reinterpret_cast<const char*>(texture.blob->data()), texture.blob->size());
+        return output.good();
+    }
+
+    // Returns an invalid texture if the container doesnt exist, was cooked for another usage or format version, or its
+    // levels dont match their format and dimensions. The header is returned to check the source against it
+    inline CookedTextureData ReadContainer(const std::string &path, TextureUsage usage, TextureFileHeader &header)
+    {
+        CookedTextureData texture;
+        std::string contents;
+        if (!Hashing::ReadWholeFile(path, contents) || contents.size() < sizeof(TextureFileHeader))
+            return texture;
+
+        std::memcpy(&header, contents.data(), sizeof(TextureFileHeader));
+        if (header.magic != COOKED_TEXTURE_MAGIC || header.version != COOKED_TEXTURE_VERSION ||
+            header.usage != (uint32_t)usage || header.levelCount == 0 || !IsCompressedFormat(header.internalFormat))
+            return texture;
+
+        uint64_t dataOffset = sizeof(TextureFileHeader) + (uint64_t)header.levelCount * sizeof(TextureLevelRecord);
+        if (dataOffset > contents.size())
+            return texture;
+
+        std::vector<TextureLevelRecord> records(header.levelCount);
+        std::memcpy(records.data(), contents.data() + sizeof(TextureFileHeader), header.levelCount * sizeof(TextureLevelRecord));
+
+        // every level halves the previous one, down to 1 texel
+        uint32_t levelWidth = header.width, levelHeight = header.height;
+        for (auto &record : records)
+        {
+            if (record.width != levelWidth || record.height != levelHeight || record.width == 0 || record.height == 0 ||
+                record.size != GetCompressedSize(header.internalFormat, record.width, record.height) ||
+                record.offset < dataOffset || record.offset + record.size > contents.size())
+            {
+                texture.levels.clear();
+                return texture;
+            }
+            texture.levels.push_back({record.width, record.height, (size_t)(record.offset - dataOffset), (size_t)record.size});
+
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+
+        texture.internalFormat = header.internalFormat;
+        texture.width = header.width;
+        texture.height = header.height;
+        texture.blob = std::make_shared<std::vector<unsigned char>>(contents.begin() + dataOffset, contents.end());
+        return texture;
+    }
+
+    // Decodes the source image, builds its mip chain and compresses every level
+    inline CookedTextureData CookTexture(const std::string &filename, TextureUsage usage)
+    {
+        CookedTextureData texture;
+
+        int width, height, nrComponents;
+        unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 4);
+        if (!data)
+        {
+            std::cout << "Texture failed to load at path: " << filename << "\n";
+            return texture;
+        }
+
+        std::vector<uint8_t> level(data, data + (size_t)width * height * 4);
+        stbi_image_free(data);
+
+        texture.internalFormat = ChooseFormat(level.data(), width, height, nrComponents, usage);
+        texture.width = width;
+        texture.height = height;
+        texture.blob = std::make_shared<std::vector<unsigned char>>();
+
+        std::vector<std::vector<uint8_t>> mips = MipGenerator::GenerateMipChain(level.data(), width, height, GetMipSettings(texture.internalFormat, usage));
+
+        unsigned int levelWidth = width, levelHeight = height;
+        for (size_t i = 0; i <= mips.size(); i++)
+        {
+            size_t offset = texture.blob->size();
+            size_t size = GetCompressedSize(texture.internalFormat, levelWidth, levelHeight);
+            texture.blob->resize(offset + size);
+            CompressImage(i == 0 ? level.data() : mips[i - 1].data(), levelWidth, levelHeight, texture.internalFormat, texture.blob->data() + offset);
+            texture.levels.push_back({levelWidth, levelHeight, offset, size});
+
+            levelWidth = std::max(1u, levelWidth / 2);
+            levelHeight = std::max(1u, levelHeight / 2);
+        }
+
+        return texture;
+    }
+
+    // Reads the cooked version of the texture or, if it is missing or stale, cooks the source and writes the container
+    // next to it. Doesnt touch GL, so it can run on any thread
+    inline CookedTextureData LoadOrCook(const std::string &filename, TextureUsage usageHint = OP_TEXTURE_USAGE_COLOR, bool *cacheHit = nullptr)
+    {
+        TextureUsage usage = DetectUsage(filename, usageHint);
+        std::string cookedFile = filename + COOKED_TEXTURE_EXTENSION;
+        SourceStamp sourceStamp;
+        bool hasSource = GetSourceStamp(filename, sourceStamp);
+
+        TextureFileHeader header;
+        CookedTextureData texture = ReadContainer(cookedFile, usage, header);
+        uint64_t sourceHash = 0;
+        bool hashed = false;
+        if (texture.IsValid() && !(hasSource && header.sourceStamp == sourceStamp))
+        {
+            // the source was touched, its contents decide if the container is still current (the new stamp is kept)
+            sourceHash = Hashing::HashFile(filename);
+            hashed = true;
+            if (hasSource && sourceHash == header.sourceHash)
+                WriteContainer(cookedFile, texture, sourceHash, sourceStamp, usage);
+            else
+                texture = CookedTextureData();
+        }
+
+        if (cacheHit != nullptr)
+            *cacheHit = texture.IsValid();
+
+        if (!texture.IsValid())
+        {
+            texture = CookTexture(filename, usage);
+            if (texture.IsValid())
+                WriteContainer(cookedFile, texture, hashed ? sourceHash : Hashing::HashFile(filename), sourceStamp, usage);
+        }
+        return texture;
+    }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef TEXTURE_REGISTRY_H
+#define TEXTURE_REGISTRY_H
+
+#include <cstdint>
+#include <cassert>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "Texture.h"
+#include "../common/Pool.h"
+
+/*
+ * Owner of the textures loaded from files, referenced through TextureHandles.
+ *
+ * Textures are registered once under their name (the path used by the materials) and materials resolve their names to
+ * handles when they are created, so drawing never looks up strings. Handles are the generational ids of the Pool the
+ * textures are stored in: once a texture is removed its handle is never resolved again, even if the slot is reused.
+ *
+ * Every material referencing a texture holds a reference to it. Releasing the last reference removes the texture.
+ * Textures can also be unloaded (the GL texture is deleted but the handle stays valid and binds nothing) and reloaded
+ * from their file, e.g. after it changed on disk. The revision of a texture changes on every reload, so copies of
+ * its contents (texture arrays, ...) can be refreshed.
+ */
+
+struct TextureHandle
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return slot != UINT32_MAX; }
+    bool operator == (const TextureHandle &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator != (const TextureHandle &other) const { return !(*this == other); }
+};
+
+class TextureRegistry
+{
+    public:
+        // Registers a texture (loaded from path) under name, without references. Returns the existing handle if the
+        // name is already registered
+        TextureHandle Add(const std::string &name, const std::string &path, TextureUsage usage, Texture2D &&texture)
+        {
+            TextureHandle existing = Find(name);
+            if (existing.IsValid())
+                return existing;
+
+            Entry entry;
+            entry.texture = std::move(texture);
+            entry.name = name;
+            entry.path = path;
+            entry.usage = usage;
+            entry.loaded = true;
+
+            EntryPool::Id id = entries.Add(std::move(entry));
+            TextureHandle handle = {id.index, id.generation};
+
+            handles.emplace(name, handle);
+            return handle;
+        }
+
+        // Returns the handle of the texture registered under name, or an invalid handle
+        TextureHandle Find(const std::string &name) const
+        {
+            auto found = handles.find(name);
+            return found != handles.end() ? found->second : TextureHandle();
+        }
+
+        bool IsAlive(TextureHandle handle) const
+        {
+            return entries.IsPresent({handle.slot, handle.generation});
+        }
+
+        void AddReference(TextureHandle handle)
+        {
+            GetEntry(handle).refCount++;
+        }
+
+        // Removes the texture when its last reference is released
+        void Release(TextureHandle handle)
+        {
+            Entry &entry = GetEntry(handle);
+            assert(entry.refCount > 0);
+            if (--entry.refCount > 0)
+                return;
+
+            handles.erase(entry.name);
+            entries.Release({handle.slot, handle.generation});
+        }
+
+        // Deletes the GL texture, keeping the handle valid. The texture binds nothing until it is reloaded
+        void Unload(TextureHandle handle)
+        {
+            Entry &entry = GetEntry(handle);
+            entry.texture = Texture2D();
+            entry.loaded = false;
+        }
+
+        // Loads the texture from its file again (the cooked version, see Texture2D::TextureFromFile). Synchronous, only
+        // valid on the GL thread
+        void Reload(TextureHandle handle)
+        {
+            Entry &entry = GetEntry(handle);
+            entry.texture = Texture2D::TextureFromFile(entry.path, entry.usage);
+            entry.loaded = true;
+            entry.revision++;
+        }
+
+        Texture2D &Get(TextureHandle handle)
+        {
+            return GetEntry(handle).texture;
+        }
+
+        const Texture2D &Get(TextureHandle handle) const
+        {
+            return GetEntry(handle).texture;
+        }
+
+        bool IsLoaded(TextureHandle handle) const
+        {
+            return GetEntry(handle).loaded;
+        }
+
+        uint32_t GetRevision(TextureHandle handle) const
+        {
+            return GetEntry(handle).revision;
+        }
+
+        uint32_t GetReferenceCount(TextureHandle handle) const
+        {
+            return GetEntry(handle).refCount;
+        }
+
+        const std::string &GetName(TextureHandle handle) const
+        {
+            return GetEntry(handle).name;
+        }
+
+        // Estimated GPU memory of the texture (0 while it is unloaded)
+        size_t GetResidentMemory(TextureHandle handle) const
+        {
+            const Entry &entry = GetEntry(handle);
+            return entry.loaded ? entry.texture.GetMemorySize() : 0;
+        }
+
+        size_t GetResidentMemory() const
+        {
+            size_t size = 0;
+            for (auto &handle : handles)
+                size += GetResidentMemory(handle.second);
+            return size;
+        }
+
+        size_t GetCount() const
+        {
+            return handles.size();
+        }
+
+        // Calls visitor(TextureHandle) for every registered texture. The visitor may unload and reload textures, but
+        // not release them
+        template<typename Visitor>
+        void ForEach(Visitor &&visitor) const
+        {
+            for (size_t i = 0; i < entries.GetCount(); i++)
+            {
+                EntryPool::Id id = entries.GetDenseId(i);
+                visitor(TextureHandle{id.index, id.generation});
+            }
+        }
+
+    private:
+        struct Entry
+        {
+            Texture2D texture;
+            std::string name;
+            std::string path;
+            TextureUsage usage = OP_TEXTURE_USAGE_COLOR;
+            uint32_t refCount = 0;
+            uint32_t revision = 0;
+            bool loaded = false;
+        };
+
+        using EntryPool = Pool<Entry>;
+
+        EntryPool entries;
+        std::unordered_map<std::string, TextureHandle> handles;
+
+        Entry &GetEntry(TextureHandle handle)
+        {
+            return entries.Get({handle.slot, handle.generation});
+        }
+
+        const Entry &GetEntry(TextureHandle handle) const
+        {
+            return entries.Get({handle.slot, handle.generation});
+        }
+};
+
+#endif
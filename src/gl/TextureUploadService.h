@@ -0,0 +1,292 @@
+#ifndef TEXTURE_UPLOAD_SERVICE_H
+#define TEXTURE_UPLOAD_SERVICE_H
+
+#include <glad/glad.h>
+#include <iostream>
+#include <memory>
+#include <deque>
+#include <unordered_map>
+#include <chrono>
+#include <cstring>
+
+/*
+ * Streams texture data to the GPU through a persistently mapped pixel unpack buffer (PBO) used as a ring buffer
+ * (https://www.khronos.org/opengl/wiki/Buffer_Object_Streaming#Persistent_mapping)
+ *
+ * Each queued upload is copied into the next free region of the ring and transfered with glTextureSubImage2D (or its
+ * compressed variant) using the ring offset as the source, so the driver can perform the copy asynchronously instead of
+ * stalling on client memory.
+ * A fence is placed after each transfer: the region is only reused, and the texture level is only reported as resident,
+ * after its fence is signaled.
+ *
+ * Update should be called once per frame (and can be called more often during loading). It never blocks: uploads that
+ * dont fit on the ring or on the per frame budget are kept on the queue until the next call.
+ */
+
+class TextureUploadService
+{
+    public:
+        // CPU pixel data of a single upload. The shared pointer can own any kind of storage (stb images, vectors...)
+        // and is released as soon as the data is copied into the ring
+        struct UploadRequest
+        {
+            GLuint texture = 0;
+            GLuint level = 0;
+            GLsizei width = 0;
+            GLsizei height = 0;
+            GLenum format = GL_RGBA; // internal format for compressed uploads
+            GLenum type = GL_UNSIGNED_BYTE;
+            bool compressed = false;
+            bool generateMips = false;
+            std::shared_ptr<const unsigned char> pixels;
+            size_t byteSize = 0;
+        };
+
+        TextureUploadService(size_t ringSize = 64 * 1024 * 1024, size_t maxBytesPerUpdate = 16 * 1024 * 1024)
+        {
+            this->ringSize = ringSize;
+            this->maxBytesPerUpdate = maxBytesPerUpdate;
+
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glCreateBuffers(1, &GLId);
+            glNamedBufferStorage(GLId, ringSize, NULL, flags);
+            mappedRing = static_cast<unsigned char*>(glMapNamedBufferRange(GLId, 0, ringSize, flags));
+
+            throughputWindowStart = std::chrono::steady_clock::now();
+        }
+
+        ~TextureUploadService()
+        {
+            for (auto &region : inFlight)
+                glDeleteSync(region.fence);
+
+            if (GLId != 0)
+            {
+                glUnmapNamedBuffer(GLId);
+                glDeleteBuffers(1, &GLId);
+            }
+        }
+
+        // the texture storage of the level must already be allocated
+        void QueueUpload(UploadRequest &&request)
+        {
+            pendingLevels[request.texture]++;
+            queued.push_back(std::move(request));
+        }
+
+        bool IsResident(GLuint texture) const
+        {
+            return pendingLevels.find(texture) == pendingLevels.end();
+        }
+
+        bool IsIdle() const
+        {
+            return queued.empty() && inFlight.empty();
+        }
+
+        void Update()
+        {
+            RetireFinishedUploads();
+
+            size_t budget = maxBytesPerUpdate;
+            bool uploaded = false;
+
+            while (!queued.empty())
+            {
+                UploadRequest &request = queued.front();
+
+                // requests that could never fit on the ring are sent directly from client memory
+                if (request.byteSize > ringSize / 2)
+                {
+                    if (uploaded && request.byteSize > budget)
+                        break;
+
+                    BeginUnpack();
+                    SubmitLevel(request, request.pixels.get());
+                    if (request.generateMips)
+                        glGenerateTextureMipmap(request.texture);
+
+                    CompleteLevel(request.texture);
+                }
+                else
+                {
+                    size_t offset;
+                    if (request.byteSize > budget || !Allocate(request.byteSize, offset))
+                        break;
+
+                    std::memcpy(mappedRing + offset, request.pixels.get(), request.byteSize);
+
+                    BeginUnpack();
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, GLId);
+                    SubmitLevel(request, (void*)offset);
+                    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                    if (request.generateMips)
+                        glGenerateTextureMipmap(request.texture);
+
+                    InFlightRegion region;
+                    region.offset = offset;
+                    region.size = request.byteSize;
+                    region.texture = request.texture;
+                    region.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                    inFlight.push_back(region);
+                    head = offset + AlignSize(request.byteSize);
+                }
+
+                budget = request.byteSize > budget ? 0 : budget - request.byteSize;
+                windowBytes += request.byteSize;
+                uploaded = true;
+                queued.pop_front();
+            }
+
+            if (uploaded)
+                EndUnpack();
+
+            UpdateThroughput();
+        }
+
+        // bytes sent per second, averaged over the last half second
+        double GetThroughputMBs() const
+        {
+            return throughputMBs;
+        }
+
+        size_t GetQueuedCount() const
+        {
+            return queued.size();
+        }
+
+    private:
+        struct InFlightRegion
+        {
+            size_t offset;
+            size_t size;
+            GLuint texture;
+            GLsync fence;
+        };
+
+        static constexpr size_t REGION_ALIGNMENT = 64;
+
+        GLuint GLId = 0;
+        unsigned char *mappedRing = nullptr;
+        size_t ringSize;
+        size_t maxBytesPerUpdate;
+        size_t head = 0;
+
+        std::deque<UploadRequest> queued;
+        std::deque<InFlightRegion> inFlight;
+        // number of queued or in flight levels of each texture
+        std::unordered_map<GLuint, unsigned int> pendingLevels;
+
+        std::chrono::steady_clock::time_point throughputWindowStart;
+        size_t windowBytes = 0;
+        double throughputMBs = 0;
+
+        static size_t AlignSize(size_t size)
+        {
+            return (size + REGION_ALIGNMENT - 1) & ~(REGION_ALIGNMENT - 1);
+        }
+
+        // Finds a contiguous free region after the head, wrapping around to the start of the ring if needed.
+        // The region between the oldest in flight upload and the head is still in use by the GPU
+        bool Allocate(size_t size, size_t &offset)
+        {
+            size = AlignSize(size);
+
+            if (inFlight.empty())
+            {
+                head = 0;
+                offset = 0;
+                return size <= ringSize;
+            }
+
+            size_t tail = inFlight.front().offset;
+
+            if (head >= tail)
+            {
+                if (head + size <= ringSize)
+                {
+                    offset = head;
+                    return true;
+                }
+                if (size < tail)
+                {
+                    offset = 0;
+                    return true;
+                }
+                return false;
+            }
+
+            if (head + size < tail)
+            {
+                offset = head;
+                return true;
+            }
+            return false;
+        }
+
+        // source is either a client pointer or an offset on the bound unpack buffer
+        void SubmitLevel(const UploadRequest &request, const void *source)
+        {
+            if (request.compressed)
+            {
+                glCompressedTextureSubImage2D(request.texture, request.level, 0, 0, request.width, request.height,
+                                              request.format, (GLsizei)request.byteSize, source);
+            }
+            else
+            {
+                glTextureSubImage2D(request.texture, request.level, 0, 0, request.width, request.height,
+                                    request.format, request.type, source);
+            }
+        }
+
+        void RetireFinishedUploads()
+        {
+            while (!inFlight.empty())
+            {
+                InFlightRegion &region = inFlight.front();
+                GLenum result = glClientWaitSync(region.fence, 0, 0);
+                if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+                    break;
+
+                glDeleteSync(region.fence);
+                CompleteLevel(region.texture);
+                inFlight.pop_front();
+            }
+        }
+
+        void CompleteLevel(GLuint texture)
+        {
+            auto it = pendingLevels.find(texture);
+            if (it != pendingLevels.end() && --(it->second) == 0)
+                pendingLevels.erase(it);
+        }
+
+        // the queued data is tightly packed
+        void BeginUnpack()
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        }
+
+        void EndUnpack()
+        {
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        }
+
+        void UpdateThroughput()
+        {
+            auto now = std::chrono::steady_clock::now();
+            double elapsed = std::chrono::duration<double>(now - throughputWindowStart).count();
+
+            if (elapsed >= 0.5)
+            {
+                throughputMBs = (windowBytes / (1024.0 * 1024.0)) / elapsed;
+                windowBytes = 0;
+                throughputWindowStart = now;
+            }
+        }
+
+        TextureUploadService(const TextureUploadService&) = delete;
+        TextureUploadService &operator = (const TextureUploadService &other) = delete;
+};
+
+#endif
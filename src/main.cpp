@@ -4,6 +4,9 @@
 
 #include <iostream>
 #include <cmath>
+#include <cstdlib>
+#include <thread>
+#include <algorithm>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -21,6 +24,15 @@
 #include "scene/SceneParser.h"
 #include "render/renderers.h"
 #include "debug/OPProfiler.h"
+#include "debug/MipBenchmark.h"
+#include "debug/SceneBenchmark.h"
+#include "debug/CullingBenchmark.h"
+#include "debug/JobBenchmark.h"
+#include "debug/CommandBenchmark.h"
+#include "debug/PoolBenchmark.h"
+#include "debug/GPUCullingBenchmark.h"
+#include "debug/TransformBenchmark.h"
+#include "debug/ShaderPreprocessorBenchmark.h"
 
 //a custom library with simple objects for testing:
 #include "test/GLtest.h"
@@ -57,8 +69,128 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void toggle_camera_rotation_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void processInput(GLFWwindow *window);
 
-int main()
+int main(int argc, char **argv)
 {
+    bool useCookedMeshes = true;
+    bool compressTextures = true;
+    unsigned int workerThreads = std::max(1u, std::thread::hardware_concurrency()) - 1;
+    std::string mipBenchmarkScene;
+    unsigned int sceneBenchmarkObjects = 0;
+    unsigned int cullingBenchmarkObjects = 0;
+    unsigned int jobBenchmarkObjects = 0;
+    unsigned int commandBenchmarkObjects = 0;
+    unsigned int poolBenchmarkObjects = 0;
+    unsigned int gpuCullingBenchmarkObjects = 0;
+    unsigned int transformBenchmarkObjects = 0;
+    unsigned int shaderBenchmarkPasses = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+
+        // offline cooking: writes the cooked mesh files of a scene and exits (e.g. --cook /data/scenes/sponza_scene.json)
+        if (arg == "--cook" && i + 1 < argc)
+        {
+            JsonHelpers::SceneParser::CookScene(argv[++i]);
+            return 0;
+        }
+        // compares the CPU mip generation with glGenerateMipmap on the textures of a scene and exits (needs a GL context)
+        else if (arg == "--mip-benchmark" && i + 1 < argc)
+        {
+            mipBenchmarkScene = argv[++i];
+        }
+        // compares the object iteration of the scene storage with the previous layout and exits (e.g. --scene-benchmark 100000)
+        else if (arg == "--scene-benchmark" && i + 1 < argc)
+        {
+            sceneBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // compares the SIMD culling kernel with a scalar reference and exits (e.g. --culling-benchmark 100000)
+        else if (arg == "--culling-benchmark" && i + 1 < argc)
+        {
+            cullingBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // measures the scaling of the job system work from 1 to N threads and exits (e.g. --job-benchmark 100000)
+        else if (arg == "--job-benchmark" && i + 1 < argc)
+        {
+            jobBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // measures the recording of the render queue from 1 to N threads against its replay and exits (e.g. --command-benchmark 100000)
+        else if (arg == "--command-benchmark" && i + 1 < argc)
+        {
+            commandBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // compares the churn and iteration of Pool with its previous layout and exits (e.g. --pool-benchmark 1000000)
+        else if (arg == "--pool-benchmark" && i + 1 < argc)
+        {
+            poolBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // checks the GPU culling pass against the CPU reference and exits (e.g. --gpu-culling-benchmark 100000)
+        else if (arg == "--gpu-culling-benchmark" && i + 1 < argc)
+        {
+            gpuCullingBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // compares the batched normal matrices with the per draw inverse and exits (e.g. --transform-benchmark 100000)
+        else if (arg == "--transform-benchmark" && i + 1 < argc)
+        {
+            transformBenchmarkObjects = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        // compares the shader preprocessor with the previous one on every shader of data/shaders and exits (e.g. --shader-benchmark 20)
+        else if (arg == "--shader-benchmark" && i + 1 < argc)
+        {
+            shaderBenchmarkPasses = (unsigned int)std::max(1, std::atoi(argv[++i]));
+        }
+        else if (arg == "--no-mesh-cache")
+        {
+            useCookedMeshes = false;
+        }
+        else if (arg == "--uncompressed-textures")
+        {
+            compressTextures = false;
+        }
+        // builds every shader program from source, to compare with the startup time of the program binary cache
+        else if (arg == "--no-program-cache")
+        {
+            ProgramCache::Enabled() = false;
+        }
+        // worker threads of the job system (0 runs every job on the main thread)
+        else if (arg == "--worker-threads" && i + 1 < argc)
+        {
+            workerThreads = (unsigned int)std::max(0, std::atoi(argv[++i]));
+        }
+    }
+
+    JobSystem::Get().Start(workerThreads);
+
+    if (cullingBenchmarkObjects > 0)
+    {
+        CullingBenchmark::Run(cullingBenchmarkObjects);
+        return 0;
+    }
+
+    if (shaderBenchmarkPasses > 0)
+    {
+        ShaderPreprocessorBenchmark::Run(shaderBenchmarkPasses);
+        return 0;
+    }
+
+    if (transformBenchmarkObjects > 0)
+    {
+        TransformBenchmark::Run(transformBenchmarkObjects);
+        return 0;
+    }
+
+    if (poolBenchmarkObjects > 0)
+    {
+        PoolBenchmark::Run(poolBenchmarkObjects);
+        return 0;
+    }
+
+    if (jobBenchmarkObjects > 0)
+    {
+        JobBenchmark::Run(jobBenchmarkObjects, workerThreads + 1);
+        return 0;
+    }
+
     // GLFW: initialize and configure
     // ------------------------------
     GLFWwindow* window;
@@ -81,6 +213,19 @@ int main()
     // GLFW: rendering window creation
     // -------------------------------
     window = glfwCreateWindow(windowWidth, windowHeight, PROJECT_NAME " " VERSION, NULL, NULL);
+    if (window == NULL)
+    {
+        // drivers without 4.6 (e.g. Mesa llvmpipe), the passes needing it fall back on their own
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+        window = glfwCreateWindow(windowWidth, windowHeight, PROJECT_NAME " " VERSION, NULL, NULL);
+    }
+    if (window == NULL)
+    {
+        std::cout << "ERROR: couldn't create the window" << std::endl;
+
+        glfwTerminate();
+        return -1;
+    }
     glfwMakeContextCurrent(window);
 
     #ifdef VSYNC_OFF
@@ -96,6 +241,45 @@ int main()
         return -1;
     }
 
+    if (!mipBenchmarkScene.empty())
+    {
+        std::vector<std::string> texturePaths;
+        std::vector<TextureUsage> textureUsages;
+        for (auto &texture : JsonHelpers::SceneParser::CollectSceneTextures(mipBenchmarkScene))
+        {
+            texturePaths.push_back(texture.path);
+            textureUsages.push_back(texture.usage);
+        }
+        MipBenchmark::Run(texturePaths, textureUsages);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (sceneBenchmarkObjects > 0)
+    {
+        SceneBenchmark::Run(sceneBenchmarkObjects);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (commandBenchmarkObjects > 0)
+    {
+        CommandBenchmark::Run(commandBenchmarkObjects, workerThreads + 1);
+
+        glfwTerminate();
+        return 0;
+    }
+
+    if (gpuCullingBenchmarkObjects > 0)
+    {
+        GPUCullingBenchmark::Run(gpuCullingBenchmarkObjects);
+
+        glfwTerminate();
+        return 0;
+    }
+
     // GLFW: initial viewport configuration and callbacks
     // --------------------------------------------------
 
@@ -164,6 +348,11 @@ int main()
        
     Scene scene = Scene();
     auto sceneParser = JsonHelpers::SceneParser();
+    sceneParser.useCookedMeshes = useCookedMeshes;
+    sceneParser.compressTextures = compressTextures;
+
+    auto textureUploader = TextureUploadService();
+    sceneParser.textureUploader = &textureUploader;
     //sceneParser.Parse(scene, &mainCamera, "/data/scenes/2D/RadianceCascadeTest.json", OP_OBJ); 
 
     //sceneParser.Parse(scene, &mainCamera, "/data/scenes/sponza_scene.json", OP_OBJ);
@@ -195,6 +384,11 @@ int main()
         std::cerr << e.what() << '\n';
         return 1;
     }
+
+    // cold starts (empty cache) compile every program, warm starts load the binaries of the unchanged ones
+    ProgramCache::Stats &programStats = ProgramCache::GetStats();
+    std::cout << "Built " << programStats.programs << " shader programs in " << programStats.milliseconds << " ms ("
+              << programStats.hits << " from the program cache" << (ProgramCache::Enabled() ? "" : ", disabled") << ")\n";
     
     
     // hide the cursor when the window on focus:
@@ -220,6 +414,21 @@ int main()
 
         profiler.BeginFrame();
 
+        // Run the GL work queued by the jobs
+        // ----------------------------------
+        JobSystem::Get().ExecuteMainThreadJobs();
+
+        // Propagate the transform changes of the scene
+        // ---------------------------------------------
+        scene.Update();
+
+        // Stream pending texture uploads
+        // ------------------------------
+        textureUploader.Update();
+        profiler.SetCounter("Texture uploads", textureUploader.GetThroughputMBs(), "MB/s");
+        profiler.SetCounter("Queued texture uploads", (double)textureUploader.GetQueuedCount());
+        profiler.SetCounter("Texture memory", scene.GetTextureMemorySize() / (1024.0 * 1024.0), "MB");
+
 
 
         // GLFW: poll IO events (keys pressed/released, mouse moved etc.)
@@ -250,6 +459,16 @@ int main()
         // -------------------
         renderer->RenderFrame(mainCamera, &scene, window, &profiler);
 
+        // Uniform calls of the frame: the ones issued, the ones skipped as redundant and what looking every uniform up
+        // by name (a location query plus a set per call) would have cost
+        // -------------------------------------------------------------------------------------------------------
+        Shader::UniformStats &uniformStats = Shader::GetUniformStats();
+        profiler.SetCounter("Uniform sets", (double)uniformStats.sets);
+        profiler.SetCounter("Redundant uniform sets", (double)uniformStats.skippedSets);
+        profiler.SetCounter("Uniform GL calls", (double)(uniformStats.sets + uniformStats.locationQueries));
+        profiler.SetCounter("Uniform GL calls by name", (double)(2 * (uniformStats.sets + uniformStats.skippedSets)));
+        uniformStats = Shader::UniformStats();
+
         profiler.EndFrame();
 
 
@@ -268,7 +487,26 @@ int main()
         ImGui::End();
 
         ImGui::Begin("Scene");
-        ImGui::Text("Scene");
+        TextureRegistry &textures = scene.GetTextures();
+        if (ImGui::CollapsingHeader("Textures"))
+        {
+            ImGui::Text("%zu textures, %.2f MB resident", textures.GetCount(), textures.GetResidentMemory() / (1024.0 * 1024.0));
+            textures.ForEach([&](TextureHandle handle)
+            {
+                ImGui::PushID((int)handle.slot);
+                ImGui::Text("%s: %.2f MB, %u refs", textures.GetName(handle).c_str(),
+                            textures.GetResidentMemory(handle) / (1024.0 * 1024.0), textures.GetReferenceCount(handle));
+                ImGui::SameLine();
+                if (textures.IsLoaded(handle))
+                {
+                    if (ImGui::SmallButton("Unload"))
+                        textures.Unload(handle);
+                }
+                else if (ImGui::SmallButton("Reload"))
+                    textures.Reload(handle);
+                ImGui::PopID();
+            });
+        }
         ImGui::End();
         
         // Render custom UI (defined on the renderer derived classes)
@@ -283,6 +521,7 @@ int main()
         title << std::fixed << "profiler [" << deltaTime * 1000.0f << "ms  " << 1.0f/deltaTime << "fps]###ProfilerWindow";
 
         ImGui::Begin(title.str().c_str(), 0, ImGuiWindowFlags_NoScrollbar);
+        profiler.RenderCounters();
         ImGui::Text("GPU profiler:");
         ImVec2 canvasSize = ImGui::GetContentRegionAvail();
         int sizeMargin = int(ImGui::GetStyle().ItemSpacing.y);
@@ -325,6 +564,7 @@ int main()
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    JobSystem::Get().Stop();
 
     // GLFW: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
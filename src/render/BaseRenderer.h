@@ -2,13 +2,24 @@
 #define BASE_RENDERER_H
 
 #include <memory>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <numeric>
+#include <cstring>
 #include "../scene/Scene.h"
 #include "../scene/Camera.h"
 #include "../scene/lights.h"
 #include "../common/MathUtils.h"
+#include "../common/TransformKernel.h"
 #include "../common/ShaderMemoryPool.h"
 #include "../debug/OPProfiler.h"
 #include "../gl/Texture.h"
+#include "../gl/GLRingBuffer.h"
+#include "RenderQueue.h"
+#include "MaterialTable.h"
+#include "MultiDrawList.h"
+#include "GPUCuller.h"
 
 
 
@@ -57,11 +68,233 @@ class BaseRenderer
             glm::mat4 inverseViewMatrix;
 
             ShaderMemoryPool *shaderMemoryPool;
+
+            //objects inside each shadow cascade volume, if they were culled together with the camera
+            const std::vector<uint32_t> *cascadeObjects = nullptr;
+            unsigned int cascadeCount = 0;
         }; 
         
 
     protected:
         ShaderMemoryPool shaderMemoryPool;
+        static constexpr unsigned int MAX_SHADOW_CASCADES = 4;
+        //indices of the scene objects inside the camera frustum and inside each shadow cascade volume on the current frame
+        std::vector<uint32_t> visibleObjects;
+        std::vector<uint32_t> cascadeObjects[MAX_SHADOW_CASCADES];
+        //visible objects sorted by state, rebuilt every frame by the renderers that draw through it
+        RenderQueue renderQueue;
+        //scene materials in a storage buffer and their textures in texture arrays, for the passes that read them from there
+        MaterialTable materialTable;
+        //lit visible objects drawn from the geometry heap by the gBuffer pass, and the visible objects left to the render queue
+        MultiDrawList gBufferDraws;
+        std::vector<uint32_t> queuedObjects;
+        //with gpuCulling, the gBuffer multi draws are built from every object and culled against the camera on the GPU,
+        //checkGPUCulling compares the result with the CPU reference every frame (stalls)
+        GPUCuller gBufferCuller;
+        bool gpuCulling = false;
+        bool checkGPUCulling = false;
+        //per draw uniform data of the render queue, written once per draw into its own slice and bound by range
+        GLRingBuffer uniformRing;
+        //camera normal matrices of the objects drawn this frame, indexed by object (only the drawn ones are valid)
+        std::vector<glm::mat4> normalMatrices;
+
+        //Culls the scene against the camera frustum into visibleObjects and, when the cascade matrices are given, against
+        //the shadow cascade volumes into cascadeObjects, all in one pass. Computes the normal matrices of the visible
+        //objects. Reports the object counts and the culling time
+        void CullVisibleObjects(FrameResources &frameResources, OPProfiler::OPProfiler *profiler, const glm::mat4 *cascadeMatrices = nullptr, unsigned int cascadeCount = 0)
+        {
+            cascadeCount = std::min(cascadeCount, MAX_SHADOW_CASCADES);
+            MathUtils::Frustum frustums[1 + MAX_SHADOW_CASCADES];
+            frustums[0] = MathUtils::Frustum::FromMatrix(frameResources.projectionMatrix * frameResources.viewMatrix);
+            for (unsigned int i = 0; i < cascadeCount; i++)
+                frustums[1 + i] = MathUtils::Frustum::FromShadowMatrix(cascadeMatrices[i]);
+
+            auto cullStart = std::chrono::high_resolution_clock::now();
+            frameResources.scene->CullObjects(frustums, 1 + cascadeCount, cullLists);
+            double cullTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - cullStart).count();
+
+            visibleObjects.swap(cullLists[0]);
+            for (unsigned int i = 0; i < cascadeCount; i++)
+                cascadeObjects[i].swap(cullLists[1 + i]);
+            frameResources.cascadeObjects = cascadeCount > 0 ? cascadeObjects : nullptr;
+            frameResources.cascadeCount = cascadeCount;
+
+            profiler->SetCounter("Submitted objects", (double)frameResources.scene->GetObjects().GetCount());
+            profiler->SetCounter("Visible objects", (double)visibleObjects.size());
+            profiler->SetCounter("Frustum culling", cullTime, "ms");
+
+            auto transformStart = std::chrono::high_resolution_clock::now();
+            UpdateNormalMatrices(frameResources, visibleObjects);
+            double transformTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - transformStart).count();
+            profiler->SetCounter("Normal matrices", transformTime, "ms");
+        }
+
+        //Computes the camera normal matrices of the listed objects into normalMatrices, from the inverse transforms the
+        //scene keeps, in one sweep on the job system
+        void UpdateNormalMatrices(FrameResources &frameResources, const std::vector<uint32_t> &objects)
+        {
+            const ObjectStore &store = frameResources.scene->GetObjects();
+            if (normalMatrices.size() < store.GetCount())
+                normalMatrices.resize(store.GetCount());
+            TransformKernel::ComputeNormalMatrices(store.GetInverseTransforms(), objects.data(), objects.size(), frameResources.inverseViewMatrix, normalMatrices.data());
+        }
+
+        //Reports the state changes of the render queue against binding every object in scene order, and the time spent
+        //recording and replaying its commands
+        void ReportRenderQueue(OPProfiler::OPProfiler *profiler)
+        {
+            const RenderQueue::StateChanges &sorted = renderQueue.GetSortedChanges();
+            const RenderQueue::StateChanges &sceneOrder = renderQueue.GetSceneOrderChanges();
+
+            profiler->SetCounter("State changes (per object)", (double)sceneOrder.GetTotal());
+            profiler->SetCounter("State changes (sorted)", (double)sorted.GetTotal());
+            profiler->SetCounter("Program changes", (double)sorted.programs);
+            profiler->SetCounter("Texture binds", (double)sorted.textures);
+            profiler->SetCounter("Mesh binds", (double)sorted.meshes);
+            profiler->SetCounter("Instanced draw calls", (double)sorted.instancedDraws);
+            profiler->SetCounter("Instanced objects", (double)sorted.instances);
+            profiler->SetCounter("Recorded commands", (double)renderQueue.GetCommandCount());
+            profiler->SetCounter("Command recording", renderQueue.GetRecordTime(), "ms");
+            profiler->SetCounter("Command replay", renderQueue.GetReplayTime(), "ms");
+            profiler->SetCounter("Uniform ring upload", uniformRing.GetFrameBytes() / 1024.0, "KB");
+            profiler->SetCounter("Uniform ring waits", (double)uniformRing.GetWaitCount());
+        }
+
+        //Records the bind of a slice of the uniform ring holding the data of a uniform block for the next draw, or the
+        //copy into the shared buffer of the block when the ring of this frame is full. May run on any thread
+        void RecordUniformData(CommandList &commands, GLuint binding, GLuint sharedBuffer, const void *data, GLsizeiptr size)
+        {
+            GLRingBuffer::Allocation slice = uniformRing.Allocate(size);
+            if (slice.data != nullptr)
+            {
+                std::memcpy(slice.data, data, size);
+                commands.BindUniformRange(binding, uniformRing.GetGLId(), slice.offset, size);
+                return;
+            }
+            commands.BindUniformRange(binding, sharedBuffer, 0, size);
+            commands.SetUniformData(sharedBuffer, 0, (GLuint)size, data);
+        }
+
+        //Replays a pass of the render queue, then binds back the shared buffers of the per object blocks for the
+        //passes that still set them per draw
+        void ReplayRenderQueue(unsigned int pass)
+        {
+            renderQueue.Replay(pass);
+            for (const char *block : {"LocalMatrices", "MaterialProperties"})
+                shaderMemoryPool.GetUniformBuffer(block)->BindBufferFull(shaderMemoryPool.GetUniformBufferBinding(block));
+        }
+
+        //Defines of the instanced variants of the render queue programs, reading the matrices and material properties
+        //of each instance from the draw data instead of the per object uniforms
+        static std::vector<std::string> GetInstancingDefines()
+        {
+            return {"DRAW_DATA_BINDING " + std::to_string(MultiDrawList::DRAW_DATA_BINDING), "MULTI_DRAW"};
+        }
+
+        //Compiles the material table when the scene has new materials and copies the textures that finished streaming.
+        //Returns false while the table cant be used, in that case the materials are bound per draw
+        bool UpdateMaterialTable(Scene &scene, OPProfiler::OPProfiler *profiler)
+        {
+            if (materialTable.GetMaterialCount() != scene.GetMaterialCount())
+                materialTable.Build(scene);
+            materialTable.Update(scene);
+
+            profiler->SetCounter("Texture arrays", (double)materialTable.GetArrayCount());
+            profiler->SetCounter("Pending array layers", (double)materialTable.GetPendingLayerCount());
+            profiler->SetCounter("Material table memory", materialTable.GetMemorySize() / (1024.0 * 1024.0), "MB");
+            return materialTable.IsValid();
+        }
+
+        //Moves the lit visible objects whose mesh is in the geometry heap to the gBuffer multi draws, batched by the texture
+        //arrays of their material, and leaves the remaining visible objects in queuedObjects. With gpuCulling every lit
+        //object of the heap is drawn and culled by the GPU instead. Needs a valid material table
+        void BuildGBufferDraws(FrameResources &frameResources, OPProfiler::OPProfiler *profiler)
+        {
+            Scene &scene = *frameResources.scene;
+            const glm::mat4 &viewMatrix = frameResources.viewMatrix;
+            const glm::mat4 *transforms = scene.GetObjects().GetTransforms();
+            const MaterialHandle *materials = scene.GetObjects().GetMaterials();
+
+            //the visible objects already have their normal matrices
+            if (gpuCulling)
+                UpdateNormalMatrices(frameResources, GetSceneObjects(scene));
+
+            gBufferDraws.Build(scene, gpuCulling ? GetSceneObjects(scene) : visibleObjects, [&](size_t position, uint32_t object, MaterialInstance &materialInstance, MultiDrawList::DrawData &draw)
+            {
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                    return MultiDrawList::SKIP_DRAW;
+
+                draw.modelMatrix = transforms[object];
+                draw.normalMatrix = normalMatrices[object];
+                draw.material = materials[object];
+                draw.cascadeMask = 0;
+                return materialTable.GetTextureArrays(materials[object]);
+            }, !gpuCulling);
+
+            //unlit objects and the ones outside the heap (the fallbacks of the multi draws)
+            queuedObjects.clear();
+            const uint32_t *flags = scene.GetObjects().GetFlags();
+            const MeshHandle *meshes = scene.GetObjects().GetMeshes();
+            for (uint32_t object : visibleObjects)
+            {
+                if ((flags[object] & OP_OBJECT_UNLIT) || !scene.GetMeshRange(meshes[object]).IsValid())
+                    queuedObjects.push_back(object);
+            }
+
+            profiler->SetCounter("Multi draw calls", (double)gBufferDraws.GetBatches().size());
+            profiler->SetCounter("Multi draw commands", (double)gBufferDraws.GetDrawCount());
+            profiler->SetCounter("Multi drawn objects", (double)gBufferDraws.GetInstanceCount());
+
+            if (gpuCulling)
+            {
+                MathUtils::Frustum frustum = MathUtils::Frustum::FromMatrix(frameResources.projectionMatrix * viewMatrix);
+                gBufferCuller.Cull(scene, gBufferDraws, frustum);
+                profiler->SetCounter("GPU culled draws", (double)gBufferCuller.GetDrawCount());
+                if (checkGPUCulling)
+                {
+                    size_t visibleCount;
+                    size_t mismatches = gBufferCuller.CountMismatches(frustum, visibleCount);
+                    profiler->SetCounter("GPU visible draws", (double)visibleCount);
+                    profiler->SetCounter("GPU culling mismatches", (double)mismatches);
+                }
+            }
+            profiler->SetCounter("Geometry heap memory", scene.GetGeometry().GetMemorySize() / (1024.0 * 1024.0), "MB");
+        }
+
+        //Submits the gBuffer multi draws with a program built from gBufferMaterial.frag with MULTI_DRAW, setting the
+        //texture arrays of each batch on its materialArrays uniform. The material table has to be bound
+        void DrawGBufferBatches(Scene &scene, Shader &program)
+        {
+            if (gBufferDraws.GetBatches().empty())
+                return;
+
+            program.UseProgram();
+            Shader::UniformHandle materialArrays = program.GetUniformHandle("materialArrays");
+            auto batchSetup = [&](const MultiDrawList::Batch &batch)
+            {
+                program.SetIVec2(materialArrays, glm::ivec2(batch.key >> 8, batch.key & 0xFF));
+            };
+            if (gpuCulling)
+                gBufferCuller.DrawBatches(scene, gBufferDraws, batchSetup);
+            else
+                gBufferDraws.DrawBatches(scene, batchSetup);
+        }
+
+        //Indices of every object of the scene (for the passes that arent culled on the CPU), rebuilt when the count changes
+        const std::vector<uint32_t> &GetSceneObjects(const Scene &scene)
+        {
+            if (sceneObjects.size() != scene.GetObjects().GetCount())
+            {
+                sceneObjects.resize(scene.GetObjects().GetCount());
+                std::iota(sceneObjects.begin(), sceneObjects.end(), 0u);
+            }
+            return sceneObjects;
+        }
+
+    private:
+        //the culling output, swapped into visibleObjects and cascadeObjects
+        std::vector<uint32_t> cullLists[1 + MAX_SHADOW_CASCADES];
+        std::vector<uint32_t> sceneObjects;
         
 };
 
@@ -31,6 +31,19 @@ class DeferredRenderer : public BaseRenderer
             SPECULAR_TEXTURE0_BINDING = 4,
         };
 
+        enum RenderQueuePasses
+        {
+            GBUFFER_QUEUE_PASS = 0,
+            UNLIT_QUEUE_PASS = 1,
+        };
+
+        enum MaterialTableBindings
+        {
+            MATERIAL_TEXTURE_ARRAY0_BINDING = 0, // up to MaterialTable::MAX_TEXTURE_ARRAYS units
+            MATERIAL_TABLE_BUFFER_BINDING = 3,
+            MATERIAL_ARRAYS_LOCATION = 1, // multi draws
+        };
+
         enum LightingPassBufferBindings
         {
             COLOR_SPEC_BUFFER_BINDING = 0,
@@ -261,112 +274,101 @@ class DeferredRenderer : public BaseRenderer
             }
             lightDataBuffer->EndSetData();
 
-            // 1) Shadow Map Rendering Pass:
-            // -----------------------------
-            auto shadowTask = profiler->AddTask("Shadow Pass", Colors::amethyst);
-            shadowTask->Start();
+            // Frustum culling (camera and shadow cascades in one pass):
+            unsigned int cascadeCount = enableShadowMapping ? shadowRenderer.UpdateCascades(frameResources) : 0;
+            CullVisibleObjects(frameResources, profiler, shadowRenderer.GetCascadeMatrices(), cascadeCount);
 
-            ShadowsOutput shadowOut = {0, GL_TEXTURE_2D};
-            if (enableShadowMapping)
-            {
-                shadowOut = shadowRenderer.Render(frameResources);
-            }
-            shadowTask->End();
+            // Material table: when usable, the gBuffer pass reads every material from it with a single program
+            bool useMaterialTable = UpdateMaterialTable(*scene, profiler);
 
+            // Multi draws: with the material table, the lit objects in the geometry heap are drawn by a few indirect
+            // multi draws (one per texture array pair), the render queue gets the rest
+            bool useMultiDraw = useMaterialTable && !scene->GetGeometry().IsEmpty();
+            if (useMultiDraw)
+                BuildGBufferDraws(frameResources, profiler);
 
-            // 2) gBuffer Pass:
-            // ----------------
-            auto gbufferTask = profiler->AddTask("gBuffer Pass", Colors::emerald);
-            gbufferTask->Start();
-
-            glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            int shaderCache = -1;
-
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
-            {    
-                StandardShader activeShader;
-                GLuint activeRoutine;
-
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+            // Render queue: lit objects go to the gBuffer pass and unlit ones to the unlit pass, sorted by state
+            Shader::UniformHandle materialIndex = gBufferMaterialShader.GetUniformHandle("materialIndex");
+            renderQueue.Build(*scene, useMultiDraw ? queuedObjects : visibleObjects, viewMatrix, camera.Far, [&](MaterialInstance &materialInstance, RenderQueue::DrawState &state)
+            {
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
                 {
-                    return;
+                    state.pass = UNLIT_QUEUE_PASS;
+                    state.program = &defaultVertUnlitFrag;
+                    state.instancedProgram = &instancedVertUnlitFrag;
+                    return true;
                 }
-                else if (materialInstance->HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
+
+                state.pass = GBUFFER_QUEUE_PASS;
+                if (useMaterialTable)
                 {
-                    activeShader = defaultVertNormalTexFrag;
-                    activeRoutine = 1;
+                    state.program = &gBufferMaterialShader;
+                    state.materialIndex = materialIndex;
+                    return true;
                 }
-                else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
+
+                if (materialInstance.HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
                 {
-                    activeShader = defaultVertFrag;
-                    activeRoutine = 1;
+                    state.program = &defaultVertNormalTexFrag;
+                    state.instancedProgram = &instancedVertNormalTexFrag;
                 }
                 else
                 {
-                    activeShader = defaultVertFrag;
-                    activeRoutine = 0;
-                }
-
-                // shader has to be used before updating the uniforms
-                if (activeShader.ID != shaderCache)
-                {
-                    activeShader.UseProgram();
-                    shaderCache = activeShader.ID;
+                    state.program = &defaultVertFrag;
+                    state.instancedProgram = &instancedVertFrag;
                 }
 
                 // setting if the color is sampled from texture or from UBO
-                glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, 1, &activeRoutine);
-
-
-                auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
+                state.subroutines[0] = materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE) ? 1 : 0;
+                state.subroutineCount = 1;
+                return true;
+            });
+
+            // Command recording: the binds and per object data of every queued draw, recorded by jobs and replayed by the passes
+            // the per object blocks go to the uniform ring, each draw binding its own slices
+            GLuint materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties")->GetGLId();
+            GLuint localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices")->GetGLId();
+            GLuint materialPropertiesBinding = shaderMemoryPool.GetUniformBufferBinding("MaterialProperties");
+            GLuint localMatricesBinding = shaderMemoryPool.GetUniformBufferBinding("LocalMatrices");
+            uniformRing.BeginFrame(renderQueue.GetDrawCount() * (uniformRing.Align(sizeof(LocalMatrices)) + uniformRing.Align(sizeof(MaterialProperties))));
+            RenderQueue::TextureUnits textureUnits = {DIFFUSE_TEXTURE0_BINDING, NORMAL_TEXTURE0_BINDING, SPECULAR_TEXTURE0_BINDING};
+
+            renderQueue.Record(*scene, textureUnits, normalMatrices.data(), [&](CommandList &commands, const glm::mat4 &objectToWorld, const glm::mat4 &normalMatrix, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                if (!useMaterialTable || materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                    RecordUniformData(commands, materialPropertiesBinding, materialPropertiesBuffer, &(materialInstance.properties), sizeof(MaterialProperties));
 
-                auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices"); 
-                localMatricesBuffer->SetData( 0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                localMatricesBuffer->SetData( sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
+                // model and normal matrices:
+                LocalMatrices localMatrices = {objectToWorld, normalMatrix};
+                RecordUniformData(commands, localMatricesBinding, localMatricesBuffer, &localMatrices, sizeof(LocalMatrices));
+            });
 
+            // 1) Shadow Map Rendering Pass:
+            // -----------------------------
+            auto shadowTask = profiler->AddTask("Shadow Pass", Colors::amethyst);
+            shadowTask->Start();
 
-                //Bind all textures
-                unsigned int diffuseBinding = DIFFUSE_TEXTURE0_BINDING;
-                unsigned int normalBinding = NORMAL_TEXTURE0_BINDING;
-                unsigned int specularBinding = SPECULAR_TEXTURE0_BINDING;
+            ShadowsOutput shadowOut = {0, GL_TEXTURE_2D};
+            if (enableShadowMapping)
+            {
+                shadowOut = shadowRenderer.Render(frameResources);
+            }
+            shadowTask->End();
 
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_DIFFUSE); i++)
-                {
-                    diffuseBinding = std::min(diffuseBinding, (unsigned int)NORMAL_TEXTURE0_BINDING);
-                    
-                    auto texName = materialInstance->GetDiffuseMapName(i);
-                    scene->GetTexture(texName).BindForRead(diffuseBinding);
-                    
-                    diffuseBinding++;
-                }
 
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_NORMAL); i++)
-                {
-                    normalBinding = std::min(normalBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetNormalMapName(i);
-                    scene->GetTexture(texName).BindForRead(normalBinding);
-                    
-                    normalBinding++;
-                }
+            // 2) gBuffer Pass:
+            // ----------------
+            auto gbufferTask = profiler->AddTask("gBuffer Pass", Colors::emerald);
+            gbufferTask->Start();
 
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_SPECULAR); i++)
-                {
-                    //specularBinding = std::min(specularBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetSpecularMapName(i);
-                    scene->GetTexture(texName).BindForRead(specularBinding);
-                    
-                    specularBinding++;
-                }
-                
-                //bind VAO
-                mesh->BindBuffers();
+            glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-                //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            });  
+            if (useMaterialTable)
+                materialTable.Bind(MATERIAL_TABLE_BUFFER_BINDING, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            ReplayRenderQueue(GBUFFER_QUEUE_PASS);
+            if (useMultiDraw)
+                DrawGBufferBatches(*scene, gBufferMultiDrawShader);
 
             gbufferTask->End();
             
@@ -465,35 +467,8 @@ class DeferredRenderer : public BaseRenderer
             glEnable(GL_DEPTH_TEST);
             glDisable(GL_BLEND);
 
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
-            {    
-                StandardShader activeShader;
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
-                {
-                    activeShader = defaultVertUnlitFrag;   
-                }
-                else
-                {
-                    return;
-                }
-
-                if (activeShader.ID != shaderCache)
-                {
-                    activeShader.UseProgram();
-                    shaderCache = activeShader.ID; 
-                }
-
-                auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
-
-                auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices"); 
-                localMatricesBuffer->SetData(0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                localMatricesBuffer->SetData(sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
-
-
-                mesh->BindBuffers();
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            }); 
+            ReplayRenderQueue(UNLIT_QUEUE_PASS);
+            ReportRenderQueue(profiler);
 
             this->skyRenderer.Render(frameResources);
             
@@ -544,26 +519,63 @@ class DeferredRenderer : public BaseRenderer
         {   
             auto bufferBindings = shaderMemoryPool.GetNamedBindings();
 
-            defaultVertFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
-            defaultVertFrag.BuildProgram();
-            defaultVertFrag.UseProgram();
-            defaultVertFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertFrag.BindUniformBlocks(bufferBindings);
-
-            defaultVertNormalTexFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
+            // the instanced variants draw the runs of the same instance group of the render queue
+            auto buildTexturedShader = [&](StandardShader &shader, bool normalMapped, bool instanced)
+            {
+                shader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
+                if (normalMapped)
+                {
+                    std::string s = "NORMAL_MAPPED";
+                    shader.AddPreProcessorDefines(&s,1);
+                }
+                if (instanced)
+                    shader.AddPreProcessorDefines(GetInstancingDefines());
+                shader.BuildProgram();
+                shader.UseProgram();
+                shader.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
+                shader.BindUniformBlocks(bufferBindings);
+            };
+            buildTexturedShader(defaultVertFrag, false, false);
+            buildTexturedShader(defaultVertNormalTexFrag, enableNormalMaps, false);
+            buildTexturedShader(instancedVertFrag, false, true);
+            buildTexturedShader(instancedVertNormalTexFrag, enableNormalMaps, true);
+
+            gBufferMaterialShader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferMaterial.frag");
+            gBufferMaterialShader.AddPreProcessorDefines({
+                "MATERIAL_TABLE_BINDING " + std::to_string(MATERIAL_TABLE_BUFFER_BINDING),
+                "MATERIAL_TEXTURE_ARRAYS " + std::to_string(MaterialTable::MAX_TEXTURE_ARRAYS)
+            });
+            if (enableNormalMaps)
+            {
+                std::string s = "NORMAL_MAPPED";
+                gBufferMaterialShader.AddPreProcessorDefines(&s,1);
+            }
+            gBufferMaterialShader.BuildProgram();
+            gBufferMaterialShader.UseProgram();
+            MaterialTable::SetSamplerBindings(gBufferMaterialShader, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            gBufferMaterialShader.BindUniformBlocks(bufferBindings);
+
+            // same, reading the per draw data of the multi draws
+            gBufferMultiDrawShader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferMaterial.frag");
+            gBufferMultiDrawShader.AddPreProcessorDefines({
+                "MATERIAL_TABLE_BINDING " + std::to_string(MATERIAL_TABLE_BUFFER_BINDING),
+                "MATERIAL_TEXTURE_ARRAYS " + std::to_string(MaterialTable::MAX_TEXTURE_ARRAYS),
+                "MATERIAL_ARRAYS_LOCATION " + std::to_string(MATERIAL_ARRAYS_LOCATION),
+                "DRAW_DATA_BINDING " + std::to_string(MultiDrawList::DRAW_DATA_BINDING),
+                "MULTI_DRAW"
+            });
             if (enableNormalMaps)
             {
                 std::string s = "NORMAL_MAPPED";
-                defaultVertNormalTexFrag.AddPreProcessorDefines(&s,1);
+                gBufferMultiDrawShader.AddPreProcessorDefines(&s,1);
             }
-            defaultVertNormalTexFrag.BuildProgram();
-            defaultVertNormalTexFrag.UseProgram();
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.BindUniformBlocks(bufferBindings);
+            gBufferMultiDrawShader.BuildProgram();
+            gBufferMultiDrawShader.UseProgram();
+            MaterialTable::SetSamplerBindings(gBufferMultiDrawShader, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            gBufferMultiDrawShader.BindUniformBlocks(bufferBindings);
+            gBufferCuller.ReloadShader();
             
             defaultVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
             defaultVertUnlitFrag.BuildProgram();
@@ -573,6 +585,11 @@ class DeferredRenderer : public BaseRenderer
             defaultVertUnlitFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
             defaultVertUnlitFrag.BindUniformBlocks(bufferBindings);
 
+            instancedVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
+            instancedVertUnlitFrag.AddPreProcessorDefines(GetInstancingDefines());
+            instancedVertUnlitFrag.BuildProgram();
+            instancedVertUnlitFrag.BindUniformBlocks(bufferBindings);
+
             directionalLightingPass = StandardShader(BASE_DIR"/data/shaders/screenQuad/quad.vert", BASE_DIR"/data/shaders/deferred/fsDeferredLighting.frag");
             directionalLightingPass.AddPreProcessorDefines(preprocessorDefines);
             if (enableLightVolumes)
@@ -614,6 +631,10 @@ class DeferredRenderer : public BaseRenderer
             ImGui::SeparatorText("Postprocessing");
             ImGui::SliderFloat("Tonemap Exposure", &tonemapExposure, 0.0f, 10.0f, "exposure = %.3f");
 
+            ImGui::SeparatorText("Culling");
+            ImGui::Checkbox("GPU culling (multi draws)", &gpuCulling);
+            ImGui::Checkbox("Check against the CPU", &checkGPUCulling);
+
             
             ImGui::End();
         }
@@ -637,7 +658,12 @@ class DeferredRenderer : public BaseRenderer
 
         StandardShader defaultVertFrag;
         StandardShader defaultVertNormalTexFrag;
+        StandardShader gBufferMaterialShader;
+        StandardShader gBufferMultiDrawShader;
         StandardShader defaultVertUnlitFrag;
+        StandardShader instancedVertFrag;
+        StandardShader instancedVertNormalTexFrag;
+        StandardShader instancedVertUnlitFrag;
 
         StandardShader directionalLightingPass;
         
@@ -195,6 +195,64 @@ class ForwardRenderer : public BaseRenderer
             }
             lightDataBuffer->EndSetData();
 
+            // Frustum culling (camera and shadow cascades in one pass):
+            unsigned int cascadeCount = enableShadowMapping ? shadowRenderer.UpdateCascades(frameResources) : 0;
+            CullVisibleObjects(frameResources, profiler, shadowRenderer.GetCascadeMatrices(), cascadeCount);
+
+            // Render queue: every visible object is drawn on the main pass, sorted by state
+            renderQueue.Build(*scene, visibleObjects, viewMatrix, camera.Far, [&](MaterialInstance &materialInstance, RenderQueue::DrawState &state)
+            {
+                // setting if the color is sampled from texture or from UBO
+                if (materialInstance.HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
+                {
+                    state.program = &defaultVertNormalTexFrag;
+                    state.instancedProgram = &instancedVertNormalTexFrag;
+                    state.subroutines[0] = 1;
+                    state.subroutines[1] = 3;
+                    state.subroutineCount = 2;
+                }
+                else if (materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
+                {
+                    state.program = &defaultVertFrag;
+                    state.instancedProgram = &instancedVertFrag;
+                    state.subroutines[0] = 1;
+                    state.subroutines[1] = 3;
+                    state.subroutineCount = 2;
+                }
+                else if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                {
+                    state.program = &defaultVertUnlitFrag;
+                    state.instancedProgram = &instancedVertUnlitFrag;
+                }
+                else
+                {
+                    state.program = &defaultVertFrag;
+                    state.instancedProgram = &instancedVertFrag;
+                    state.subroutines[0] = 0;
+                    state.subroutines[1] = 2;
+                    state.subroutineCount = 2;
+                }
+                return true;
+            });
+
+            // Command recording: the binds and per object data of every queued draw, recorded by jobs and replayed by the main pass
+            // the per object blocks go to the uniform ring, each draw binding its own slices
+            GLuint materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties")->GetGLId();
+            GLuint localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices")->GetGLId();
+            GLuint materialPropertiesBinding = shaderMemoryPool.GetUniformBufferBinding("MaterialProperties");
+            GLuint localMatricesBinding = shaderMemoryPool.GetUniformBufferBinding("LocalMatrices");
+            uniformRing.BeginFrame(renderQueue.GetDrawCount() * (uniformRing.Align(sizeof(LocalMatrices)) + uniformRing.Align(sizeof(MaterialProperties))));
+            RenderQueue::TextureUnits textureUnits = {DIFFUSE_TEXTURE0_BINDING, NORMAL_TEXTURE0_BINDING, SPECULAR_TEXTURE0_BINDING};
+
+            renderQueue.Record(*scene, textureUnits, normalMatrices.data(), [&](CommandList &commands, const glm::mat4 &objectToWorld, const glm::mat4 &normalMatrix, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                RecordUniformData(commands, materialPropertiesBinding, materialPropertiesBuffer, &(materialInstance.properties), sizeof(MaterialProperties));
+
+                // model and normal matrices:
+                LocalMatrices localMatrices = {objectToWorld, normalMatrix};
+                RecordUniformData(commands, localMatricesBinding, localMatricesBuffer, &localMatrices, sizeof(LocalMatrices));
+            });
+
             // 1) Shadow Map Rendering Pass:
             // -----------------------------
             auto shadowTask = profiler->AddTask("shadow pass", Colors::amethyst);
@@ -220,98 +278,8 @@ class ForwardRenderer : public BaseRenderer
             glActiveTexture(GL_TEXTURE0 + SHADOW_MAP_BUFFER0_BINDING);
             glBindTexture(shadowOut.texType0, shadowOut.shadowMap0);
 
-            int shaderCache = -1;
-
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
-            {    
-                StandardShader activeShader;
-                GLuint activeRoutines[2];
-                
-                bool unlit = false;
-                if (materialInstance->HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
-                {
-                    activeShader = defaultVertNormalTexFrag;
-                    activeRoutines[0] = 1;
-                    activeRoutines[1] = 3;
-                }
-                else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
-                {
-                    activeShader = defaultVertFrag;
-                    activeRoutines[0] = 1;
-                    activeRoutines[1] = 3;
-                }
-                else if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
-                {
-                    unlit = true;
-                    activeShader = defaultVertUnlitFrag;
-                }
-                else
-                {
-                    activeShader = defaultVertFrag;
-                    activeRoutines[0] = 0;
-                    activeRoutines[1] = 2;
-                }
-
-                if (activeShader.ID != shaderCache)
-                {
-                    activeShader.UseProgram();
-                    shaderCache = activeShader.ID;
-                }
-
-                // setting if the color is sampled from texture or from UBO
-                if (!unlit)
-                {
-                    glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, 2, activeRoutines);
-                }
-                
-
-                auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
-
-                auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices"); 
-                localMatricesBuffer->SetData(0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                localMatricesBuffer->SetData(sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
-
-
-                // -Texture binding:
-                unsigned int diffuseBinding = DIFFUSE_TEXTURE0_BINDING;
-                unsigned int normalBinding = NORMAL_TEXTURE0_BINDING;
-                unsigned int specularBinding = SPECULAR_TEXTURE0_BINDING;
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_DIFFUSE); i++)
-                {
-                    diffuseBinding = std::min(diffuseBinding, (unsigned int)NORMAL_TEXTURE0_BINDING);
-                    
-                    auto texName = materialInstance->GetDiffuseMapName(i);
-                    scene->GetTexture(texName).BindForRead(diffuseBinding);
-                    
-                    diffuseBinding++;
-                }
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_NORMAL); i++)
-                {
-                    normalBinding = std::min(normalBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetNormalMapName(i);
-                    scene->GetTexture(texName).BindForRead(normalBinding);
-                    
-                    normalBinding++;
-                }
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_SPECULAR); i++)
-                {
-                    //specularBinding = std::min(specularBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetSpecularMapName(i);
-                    scene->GetTexture(texName).BindForRead(specularBinding);
-                    
-                    specularBinding++;
-                }
-                
-                //bind VAO
-                mesh->BindBuffers();
-
-                //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            });  
+            ReplayRenderQueue(0);
+            ReportRenderQueue(profiler);
             
             mainPassTask->End();
 
@@ -356,37 +324,41 @@ class ForwardRenderer : public BaseRenderer
             simpleDepthPass = StandardShader(BASE_DIR"/data/shaders/simpleVert.vert", BASE_DIR"/data/shaders/nullFrag.frag");
             simpleDepthPass.BuildProgram();
 
-            // For textured materials that may have albedo texture
-            defaultVertFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/forward/texturedFrag.frag");
-            defaultVertFrag.AddPreProcessorDefines(preprocessorDefines);
-            defaultVertFrag.BuildProgram();
-            defaultVertFrag.UseProgram();
-            defaultVertFrag.SetSamplerBinding("shadowMap0", SHADOW_MAP_BUFFER0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertFrag.BindUniformBlocks(bufferBindings);
-
-            // For textured materials with an normal map and albedo textures
-            defaultVertNormalTexFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/forward/texturedFrag.frag");
-            defaultVertNormalTexFrag.AddPreProcessorDefines(preprocessorDefines);
-            if (enableNormalMaps)
+            // For textured materials that may have albedo texture, and with an normal map and albedo textures. The
+            // instanced variants draw the runs of the same instance group of the render queue
+            auto buildTexturedShader = [&](StandardShader &shader, bool normalMapped, bool instanced)
             {
-                std::string s = "NORMAL_MAPPED";
-                defaultVertNormalTexFrag.AddPreProcessorDefines(&s,1);
-            }
-            defaultVertNormalTexFrag.BuildProgram();
-            defaultVertNormalTexFrag.UseProgram();
-            defaultVertNormalTexFrag.SetSamplerBinding("shadowMap0", SHADOW_MAP_BUFFER0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.BindUniformBlocks(bufferBindings);
+                shader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/forward/texturedFrag.frag");
+                shader.AddPreProcessorDefines(preprocessorDefines);
+                if (normalMapped)
+                {
+                    std::string s = "NORMAL_MAPPED";
+                    shader.AddPreProcessorDefines(&s,1);
+                }
+                if (instanced)
+                    shader.AddPreProcessorDefines(GetInstancingDefines());
+                shader.BuildProgram();
+                shader.UseProgram();
+                shader.SetSamplerBinding("shadowMap0", SHADOW_MAP_BUFFER0_BINDING);
+                shader.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
+                shader.BindUniformBlocks(bufferBindings);
+            };
+            buildTexturedShader(defaultVertFrag, false, false);
+            buildTexturedShader(defaultVertNormalTexFrag, enableNormalMaps, false);
+            buildTexturedShader(instancedVertFrag, false, true);
+            buildTexturedShader(instancedVertNormalTexFrag, enableNormalMaps, true);
 
             defaultVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
             defaultVertUnlitFrag.BuildProgram();
             defaultVertUnlitFrag.BindUniformBlocks(bufferBindings);
 
+            instancedVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
+            instancedVertUnlitFrag.AddPreProcessorDefines(GetInstancingDefines());
+            instancedVertUnlitFrag.BuildProgram();
+            instancedVertUnlitFrag.BindUniformBlocks(bufferBindings);
+
             postProcessShader = StandardShader(BASE_DIR"/data/shaders/screenQuad/quad.vert", BASE_DIR"/data/shaders/screenQuad/quadTonemap.frag");
             postProcessShader.BuildProgram();
 
@@ -423,6 +395,9 @@ class ForwardRenderer : public BaseRenderer
         StandardShader defaultVertFrag;
         StandardShader defaultVertNormalTexFrag;
         StandardShader defaultVertUnlitFrag;
+        StandardShader instancedVertFrag;
+        StandardShader instancedVertNormalTexFrag;
+        StandardShader instancedVertUnlitFrag;
 
         //Shader used to render to a quad:
         StandardShader postProcessShader;
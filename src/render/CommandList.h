@@ -0,0 +1,194 @@
+#ifndef COMMAND_LIST_H
+#define COMMAND_LIST_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../common/Shader.h"
+
+/*
+ * Compact list of GL commands, recorded on any thread and replayed on the thread owning the GL context.
+ *
+ * Commands are packed in a stream of 32 bit words: a header word (command type in the low byte, number of payload
+ * words above it) followed by the payload. Uniform data is copied into the stream, so the recorded source can change
+ * before the replay. Recording only appends words, so lists can be reused frame to frame without allocating.
+ */
+
+enum RenderCommandType
+{
+    OP_COMMAND_BIND_PROGRAM = 0,        // program
+    OP_COMMAND_SET_SUBROUTINES = 1,     // count, fragment subroutine indices...
+    OP_COMMAND_BIND_TEXTURE = 2,        // unit, target, texture
+    OP_COMMAND_SET_UNIFORM_DATA = 3,    // buffer, offset, size, data...
+    OP_COMMAND_BIND_VERTEX_ARRAY = 4,   // vertex array
+    OP_COMMAND_DRAW_ELEMENTS = 5,       // index count (indexed triangles, 32 bit indices)
+    OP_COMMAND_SET_UNIFORM_UINT = 6,    // program (Shader pointer, 2 words), uniform handle, value
+    OP_COMMAND_DRAW_ELEMENTS_INSTANCED = 7, // index count, instance count, base instance
+    OP_COMMAND_BIND_UNIFORM_RANGE = 8       // binding, buffer, offset, size
+};
+
+class CommandList
+{
+    public:
+        void Clear()
+        {
+            words.clear();
+            commandCount = 0;
+        }
+
+        void BindProgram(GLuint program)
+        {
+            uint32_t *payload = Append(OP_COMMAND_BIND_PROGRAM, 1);
+            payload[0] = program;
+        }
+
+        void SetSubroutines(const GLuint *indices, unsigned int count)
+        {
+            uint32_t *payload = Append(OP_COMMAND_SET_SUBROUTINES, 1 + count);
+            payload[0] = count;
+            std::memcpy(payload + 1, indices, count * sizeof(GLuint));
+        }
+
+        void BindTexture(unsigned int unit, GLenum target, GLuint texture)
+        {
+            uint32_t *payload = Append(OP_COMMAND_BIND_TEXTURE, 3);
+            payload[0] = unit;
+            payload[1] = target;
+            payload[2] = texture;
+        }
+
+        void SetUniformData(GLuint buffer, GLuint offset, GLuint size, const void *data)
+        {
+            uint32_t *payload = Append(OP_COMMAND_SET_UNIFORM_DATA, 3 + (size + 3) / 4);
+            payload[0] = buffer;
+            payload[1] = offset;
+            payload[2] = size;
+            std::memcpy(payload + 3, data, size);
+        }
+
+        void BindUniformRange(GLuint binding, GLuint buffer, GLintptr offset, GLsizeiptr size)
+        {
+            uint32_t *payload = Append(OP_COMMAND_BIND_UNIFORM_RANGE, 4);
+            payload[0] = binding;
+            payload[1] = buffer;
+            payload[2] = (uint32_t)offset;
+            payload[3] = (uint32_t)size;
+        }
+
+        // set through the program, so its uniform value cache skips the values it already has
+        void SetUniformUint(Shader *program, Shader::UniformHandle handle, GLuint value)
+        {
+            uint32_t *payload = Append(OP_COMMAND_SET_UNIFORM_UINT, 4);
+            std::memcpy(payload, &program, sizeof(Shader*));
+            payload[2] = (uint32_t)handle.index;
+            payload[3] = value;
+        }
+
+        void BindVertexArray(GLuint vertexArray)
+        {
+            uint32_t *payload = Append(OP_COMMAND_BIND_VERTEX_ARRAY, 1);
+            payload[0] = vertexArray;
+        }
+
+        void DrawElements(GLsizei indexCount)
+        {
+            uint32_t *payload = Append(OP_COMMAND_DRAW_ELEMENTS, 1);
+            payload[0] = (uint32_t)indexCount;
+        }
+
+        void DrawElementsInstanced(GLsizei indexCount, GLsizei instanceCount, GLuint baseInstance)
+        {
+            uint32_t *payload = Append(OP_COMMAND_DRAW_ELEMENTS_INSTANCED, 3);
+            payload[0] = (uint32_t)indexCount;
+            payload[1] = (uint32_t)instanceCount;
+            payload[2] = baseInstance;
+        }
+
+        // Issues the recorded commands. Only valid on the GL thread
+        void Replay() const
+        {
+            const uint32_t *word = words.data();
+            const uint32_t *end = word + words.size();
+
+            while (word < end)
+            {
+                uint32_t header = *word++;
+                const uint32_t *payload = word;
+                word += header >> 8;
+
+                switch (header & 0xFF)
+                {
+                    case OP_COMMAND_BIND_PROGRAM:
+                        glUseProgram(payload[0]);
+                        break;
+
+                    case OP_COMMAND_SET_SUBROUTINES:
+                        glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, payload[0], payload + 1);
+                        break;
+
+                    case OP_COMMAND_BIND_TEXTURE:
+                        glActiveTexture(GL_TEXTURE0 + payload[0]);
+                        glBindTexture(payload[1], payload[2]);
+                        break;
+
+                    case OP_COMMAND_SET_UNIFORM_DATA:
+                        glNamedBufferSubData(payload[0], payload[1], payload[2], payload + 3);
+                        break;
+
+                    case OP_COMMAND_BIND_UNIFORM_RANGE:
+                        glBindBufferRange(GL_UNIFORM_BUFFER, payload[0], payload[1], (GLintptr)payload[2], (GLsizeiptr)payload[3]);
+                        break;
+
+                    case OP_COMMAND_SET_UNIFORM_UINT:
+                    {
+                        Shader *program;
+                        std::memcpy(&program, payload, sizeof(Shader*));
+                        program->SetUInt(Shader::UniformHandle{(int32_t)payload[2]}, payload[3]);
+                        break;
+                    }
+
+                    case OP_COMMAND_BIND_VERTEX_ARRAY:
+                        glBindVertexArray(payload[0]);
+                        break;
+
+                    case OP_COMMAND_DRAW_ELEMENTS:
+                        glDrawElements(GL_TRIANGLES, (GLsizei)payload[0], GL_UNSIGNED_INT, 0);
+                        break;
+
+                    case OP_COMMAND_DRAW_ELEMENTS_INSTANCED:
+                        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, (GLsizei)payload[0], GL_UNSIGNED_INT, 0, (GLsizei)payload[1], payload[2]);
+                        break;
+
+                    default:
+                        break;
+                }
+            }
+        }
+
+        size_t GetCommandCount() const
+        {
+            return commandCount;
+        }
+
+        size_t GetSize() const
+        {
+            return words.size() * sizeof(uint32_t);
+        }
+
+    private:
+        std::vector<uint32_t> words;
+        size_t commandCount = 0;
+
+        uint32_t *Append(RenderCommandType type, uint32_t payloadWords)
+        {
+            size_t offset = words.size();
+            words.resize(offset + 1 + payloadWords);
+            words[offset] = (uint32_t)type | (payloadWords << 8);
+            commandCount++;
+            return &words[offset + 1];
+        }
+};
+
+#endif
@@ -0,0 +1,296 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "../common/Shader.h"
+#include "../common/MathUtils.h"
+#include "../common/CullingKernel.h"
+#include "../common/JobSystem.h"
+#include "MultiDrawList.h"
+
+/*
+ * Frustum culling of the draws of a MultiDrawList on the GPU (data/shaders/culling/cullDraws.comp), so the list can be
+ * built from every object of the scene and only the visible ones reach the rasterizer.
+ *
+ * The world bounds (sphere and box) of each draw are uploaded in the order of its commands. One invocation per draw
+ * tests them against the frustum planes, with the same tests as CullingKernel::IsVisibleReference, and copies the
+ * command of the visible draws to an output buffer:
+ *  - compacted: each batch keeps its range of the output, the draws are appended to it through an atomic counter per
+ *    batch, and the counters are read by glMultiDrawElementsIndirectCount (GL 4.6 or ARB_indirect_parameters)
+ *  - otherwise (e.g. Mesa llvmpipe, GL 4.5): every command keeps its place with instanceCount set to 0 when culled,
+ *    and the batches are drawn by plain glMultiDrawElementsIndirect
+ * The base instance of the commands is kept, so the draws still read their own draw data. ReadVisibleDraws and
+ * CountMismatches read the result back to compare it with the CPU reference. Only valid on the GL thread
+ */
+
+class GPUCuller
+{
+    public:
+        // storage bindings of the culling shader, only used during Cull
+        static constexpr GLuint INPUT_COMMANDS_BINDING = 0;
+        static constexpr GLuint BOUNDS_BINDING = 1;
+        static constexpr GLuint OUTPUT_COMMANDS_BINDING = 2;
+        static constexpr GLuint BATCH_COUNTS_BINDING = 3;
+        static constexpr GLuint WORKGROUP_SIZE = 64;
+
+        // std430 layout, declared on cullDraws.comp
+        struct DrawBounds
+        {
+            glm::vec4 sphere;       // center, radius
+            glm::vec3 center;       // box
+            uint32_t batch;
+            glm::vec3 extents;
+            uint32_t batchFirst;    // first command of the batch
+        };
+
+        GPUCuller(){}
+
+        ~GPUCuller()
+        {
+            if (boundsBuffer != 0)
+            {
+                glDeleteBuffers(1, &boundsBuffer);
+                glDeleteBuffers(1, &outputBuffer);
+                glDeleteBuffers(1, &countBuffer);
+            }
+        }
+
+        GPUCuller(GPUCuller &&other)
+        {
+            *this = std::move(other);
+        }
+
+        GPUCuller &operator = (GPUCuller &&other)
+        {
+            std::swap(cullShader, other.cullShader);
+            std::swap(frustumPlanes, other.frustumPlanes);
+            std::swap(built, other.built);
+            std::swap(compact, other.compact);
+            bounds.swap(other.bounds);
+            batches.swap(other.batches);
+            std::swap(drawCount, other.drawCount);
+            std::swap(boundsBuffer, other.boundsBuffer);
+            std::swap(outputBuffer, other.outputBuffer);
+            std::swap(countBuffer, other.countBuffer);
+            return *this;
+        }
+
+        // Builds the culling program, compacting when the driver can draw with a count buffer
+        void ReloadShader()
+        {
+            compact = GLAD_GL_VERSION_4_6 != 0 && glMultiDrawElementsIndirectCount != NULL;
+
+            cullShader = ComputeShader(BASE_DIR"/data/shaders/culling/cullDraws.comp");
+            cullShader.AddPreProcessorDefines({
+                "WORKGROUP_SIZE " + std::to_string(WORKGROUP_SIZE),
+                "INPUT_COMMANDS_BINDING " + std::to_string(INPUT_COMMANDS_BINDING),
+                "BOUNDS_BINDING " + std::to_string(BOUNDS_BINDING),
+                "OUTPUT_COMMANDS_BINDING " + std::to_string(OUTPUT_COMMANDS_BINDING),
+                "BATCH_COUNTS_BINDING " + std::to_string(BATCH_COUNTS_BINDING)
+            });
+            if (compact)
+            {
+                std::string s = "COMPACT_DRAWS";
+                cullShader.AddPreProcessorDefines(&s, 1);
+            }
+            cullShader.BuildProgram();
+            frustumPlanes = cullShader.GetUniformHandle("frustumPlanes");
+            built = true;
+        }
+
+        // Culls the draws of the list (after its Build, without merged instances) against the frustum, from the world
+        // bounds of their objects
+        void Cull(const Scene &scene, const MultiDrawList &draws, const MathUtils::Frustum &frustum)
+        {
+            assert(draws.GetDrawCount() == draws.GetInstanceCount());
+            const MathUtils::AABB *boxes = scene.GetObjects().GetWorldBounds();
+            const MathUtils::Sphere *spheres = scene.GetObjects().GetWorldSpheres();
+            const std::vector<uint32_t> &drawObjects = draws.GetDrawObjects();
+
+            bounds.resize(drawObjects.size());
+            JobSystem::Get().ParallelFor(drawObjects.size(), MultiDrawList::BUILD_RANGE_SIZE, [&](size_t begin, size_t end){
+                for (size_t i = begin; i < end; i++)
+                {
+                    uint32_t object = drawObjects[i];
+                    bounds[i].sphere = glm::vec4(spheres[object].center, spheres[object].radius);
+                    bounds[i].center = boxes[object].GetCenter();
+                    bounds[i].extents = boxes[object].GetExtents();
+                }
+            });
+
+            const std::vector<MultiDrawList::Batch> &drawBatches = draws.GetBatches();
+            for (uint32_t b = 0; b < drawBatches.size(); b++)
+            {
+                for (uint32_t i = drawBatches[b].first; i < drawBatches[b].first + drawBatches[b].count; i++)
+                {
+                    bounds[i].batch = b;
+                    bounds[i].batchFirst = drawBatches[b].first;
+                }
+            }
+
+            Cull(draws.GetCommandBuffer(), bounds, drawBatches, frustum);
+        }
+
+        // Same, with the bounds already filled in the order of the commands of commandBuffer
+        void Cull(GLuint commandBuffer, const std::vector<DrawBounds> &drawBounds, const std::vector<MultiDrawList::Batch> &drawBatches,
+                  const MathUtils::Frustum &frustum)
+        {
+            if (!built)
+                ReloadShader();
+            if (boundsBuffer == 0)
+            {
+                glCreateBuffers(1, &boundsBuffer);
+                glCreateBuffers(1, &outputBuffer);
+                glCreateBuffers(1, &countBuffer);
+            }
+
+            batches = drawBatches;
+            drawCount = (uint32_t)drawBounds.size();
+            if (drawCount == 0)
+                return;
+
+            // orphaned every frame, as the draw lists
+            glNamedBufferData(boundsBuffer, drawBounds.size() * sizeof(DrawBounds), drawBounds.data(), GL_STREAM_DRAW);
+            glNamedBufferData(outputBuffer, drawBounds.size() * sizeof(MultiDrawList::DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+            glNamedBufferData(countBuffer, std::max<size_t>(batches.size(), 1) * sizeof(GLuint), NULL, GL_STREAM_DRAW);
+            if (compact)
+                glClearNamedBufferData(countBuffer, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, NULL);
+
+            glm::vec4 planes[6];
+            for (int i = 0; i < 6; i++)
+                planes[i] = frustum.planes[i];
+
+            cullShader.UseProgram();
+            cullShader.SetUInt("drawCount", drawCount);
+            cullShader.SetVec4Array(frustumPlanes, planes, 6);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INPUT_COMMANDS_BINDING, commandBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, boundsBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OUTPUT_COMMANDS_BINDING, outputBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BATCH_COUNTS_BINDING, countBuffer);
+
+            glDispatchCompute((drawCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE, 1, 1);
+            glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+        }
+
+        // Binds the list and draws its batches from the culled commands, as MultiDrawList::DrawBatches
+        template<typename BatchSetup>
+        void DrawBatches(const Scene &scene, const MultiDrawList &draws, BatchSetup &&batchSetup) const
+        {
+            if (batches.empty() || drawCount == 0)
+                return;
+
+            draws.Bind(scene);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, outputBuffer);
+            if (compact)
+                glBindBuffer(GL_PARAMETER_BUFFER, countBuffer);
+
+            for (uint32_t b = 0; b < batches.size(); b++)
+            {
+                batchSetup(batches[b]);
+                const void *offset = (const void*)(batches[b].first * sizeof(MultiDrawList::DrawElementsIndirectCommand));
+                if (compact)
+                    glMultiDrawElementsIndirectCount(GL_TRIANGLES, GL_UNSIGNED_INT, offset, (GLintptr)(b * sizeof(GLuint)), (GLsizei)batches[b].count, 0);
+                else
+                    glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, offset, (GLsizei)batches[b].count, 0);
+            }
+            glBindVertexArray(0);
+        }
+
+        // Reads back the positions (base instances) of the draws that passed the last Cull, sorted. Stalls the pipeline
+        std::vector<uint32_t> ReadVisibleDraws() const
+        {
+            std::vector<uint32_t> visibleDraws;
+            if (drawCount == 0)
+                return visibleDraws;
+
+            std::vector<MultiDrawList::DrawElementsIndirectCommand> commands(drawCount);
+            glGetNamedBufferSubData(outputBuffer, 0, drawCount * sizeof(MultiDrawList::DrawElementsIndirectCommand), commands.data());
+            if (compact)
+            {
+                std::vector<GLuint> counts(batches.size());
+                glGetNamedBufferSubData(countBuffer, 0, counts.size() * sizeof(GLuint), counts.data());
+                for (size_t b = 0; b < batches.size(); b++)
+                {
+                    for (uint32_t i = 0; i < std::min(counts[b], batches[b].count); i++)
+                        visibleDraws.push_back(commands[batches[b].first + i].baseInstance);
+                }
+            }
+            else
+            {
+                for (const MultiDrawList::DrawElementsIndirectCommand &command : commands)
+                {
+                    if (command.instanceCount > 0)
+                        visibleDraws.push_back(command.baseInstance);
+                }
+            }
+            std::sort(visibleDraws.begin(), visibleDraws.end());
+            return visibleDraws;
+        }
+
+        // Number of draws whose visibility differs between the last Cull and CullingKernel::IsVisibleReference on the same
+        // bounds (the draws left out by the GPU plus the extra ones). Stalls the pipeline
+        size_t CountMismatches(const MathUtils::Frustum &frustum, const std::vector<DrawBounds> &drawBounds, size_t &visibleCount) const
+        {
+            std::vector<uint32_t> visibleDraws = ReadVisibleDraws();
+            visibleCount = visibleDraws.size();
+
+            std::vector<uint32_t> referenceDraws;
+            for (uint32_t i = 0; i < drawBounds.size(); i++)
+            {
+                MathUtils::AABB box = {drawBounds[i].center - drawBounds[i].extents, drawBounds[i].center + drawBounds[i].extents};
+                MathUtils::Sphere sphere = {glm::vec3(drawBounds[i].sphere), drawBounds[i].sphere.w};
+                if (CullingKernel::IsVisibleReference(frustum, box, sphere))
+                    referenceDraws.push_back(i);
+            }
+
+            std::vector<uint32_t> difference;
+            std::set_symmetric_difference(visibleDraws.begin(), visibleDraws.end(), referenceDraws.begin(), referenceDraws.end(),
+                                          std::back_inserter(difference));
+            return difference.size();
+        }
+
+        // Same, for the bounds uploaded by the last Cull from a scene
+        size_t CountMismatches(const MathUtils::Frustum &frustum, size_t &visibleCount) const
+        {
+            return CountMismatches(frustum, bounds, visibleCount);
+        }
+
+        // whether the culled draws are compacted and drawn with a count buffer
+        bool IsCompacting() const
+        {
+            return compact;
+        }
+
+        uint32_t GetDrawCount() const
+        {
+            return drawCount;
+        }
+
+    private:
+        ComputeShader cullShader;
+        Shader::UniformHandle frustumPlanes;
+        bool built = false;
+        bool compact = false;
+
+        std::vector<DrawBounds> bounds;
+        std::vector<MultiDrawList::Batch> batches;
+        uint32_t drawCount = 0;
+
+        GLuint boundsBuffer = 0;
+        GLuint outputBuffer = 0;
+        GLuint countBuffer = 0;
+
+        GPUCuller(const GPUCuller&) = delete;
+        GPUCuller &operator = (const GPUCuller &other) = delete;
+};
+
+#endif
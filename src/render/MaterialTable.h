@@ -0,0 +1,332 @@
+#ifndef MATERIAL_TABLE_H
+#define MATERIAL_TABLE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "../common/Shader.h"
+#include "../scene/Scene.h"
+
+/*
+ * The scene materials compiled into a shader storage buffer, with their textures copied into 2D texture arrays.
+ *
+ * Textures with the same size, format and mip count share an array (one layer each), so the materials of the whole
+ * scene are sampled from a few texture units: a pass binds the table once and each draw only selects its entry (the
+ * MaterialHandle of the object), instead of uploading its properties and binding its textures.
+ * Each entry holds the material properties and the array and layer of its diffuse and normal maps. Specular maps
+ * arent sampled by the gBuffer shaders, so they arent copied.
+ *
+ * The layers are copied on the GPU (glCopyImageSubData) once their source texture is resident, and again when it is
+ * reloaded, so Update has to be called every frame. Until then their contents are undefined, the same as the streamed
+ * textures themselves. The properties are read when the table is built.
+ * The table stays invalid when the textures need more than MAX_TEXTURE_ARRAYS arrays, in that case the renderers keep
+ * binding the textures of each draw.
+ */
+
+class MaterialTable
+{
+    public:
+        static constexpr unsigned int MAX_TEXTURE_ARRAYS = 16;
+        static constexpr unsigned int MAX_ARRAY_LAYERS = 2048; // minimum GL_MAX_ARRAY_TEXTURE_LAYERS
+        static constexpr int32_t NO_TEXTURE = -1;
+
+        // std430 layout, declared on data/shaders/include/materials.glsl
+        struct GPUMaterial
+        {
+            glm::vec4 albedoColor;
+            glm::vec4 emissiveColor;
+            glm::vec4 specular;
+            // (array << 16) | layer, or NO_TEXTURE
+            int32_t diffuseTexture;
+            int32_t normalTexture;
+            int32_t pad0;
+            int32_t pad1;
+        };
+
+        MaterialTable(){}
+
+        ~MaterialTable()
+        {
+            Release();
+        }
+
+        // Compiles every material of the scene and allocates the texture arrays. Has to be called again when materials
+        // are added. Returns false if the table cant be used (see IsValid)
+        bool Build(Scene &scene)
+        {
+            Release();
+            materialCount = scene.GetMaterialCount();
+
+            std::vector<GPUMaterial> entries(materialCount);
+            materialArrays.assign(materialCount, 0);
+            std::unordered_map<uint32_t, int32_t> textureEntries;
+            for (MaterialHandle handle = 0; handle < materialCount; handle++)
+            {
+                MaterialInstance &material = scene.GetMaterial(handle);
+                GPUMaterial &entry = entries[handle];
+                entry.albedoColor = material.properties.albedoColor;
+                entry.emissiveColor = material.properties.emissiveColor;
+                entry.specular = material.properties.specular;
+                entry.pad0 = 0;
+                entry.pad1 = 0;
+
+                // same texture selection as the gBuffer programs
+                entry.diffuseTexture = NO_TEXTURE;
+                entry.normalTexture = NO_TEXTURE;
+                if (material.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE) && material.GetNumTextures(OP_TEXTURE_DIFFUSE) > 0)
+                    entry.diffuseTexture = AddTexture(scene, material.GetTexture(OP_TEXTURE_DIFFUSE, 0), textureEntries);
+                if (material.HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL) && material.GetNumTextures(OP_TEXTURE_NORMAL) > 0)
+                    entry.normalTexture = AddTexture(scene, material.GetTexture(OP_TEXTURE_NORMAL, 0), textureEntries);
+
+                materialArrays[handle] = (ArrayOf(entry.diffuseTexture) << 8) | ArrayOf(entry.normalTexture);
+            }
+
+            if (arrays.size() > MAX_TEXTURE_ARRAYS)
+            {
+                std::cout << "Material table: the scene textures need " << arrays.size() << " texture arrays (max "
+                          << MAX_TEXTURE_ARRAYS << "), textures are bound per draw\n";
+                arrays.clear();
+                layers.clear();
+                return false;
+            }
+
+            for (TextureArray &array : arrays)
+            {
+                glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &array.GLId);
+                glTextureStorage3D(array.GLId, array.levels, array.format, array.width, array.height, array.layers);
+                glTextureParameteri(array.GLId, GL_TEXTURE_WRAP_S, GL_REPEAT);
+                glTextureParameteri(array.GLId, GL_TEXTURE_WRAP_T, GL_REPEAT);
+                glTextureParameteri(array.GLId, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+                glTextureParameteri(array.GLId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+                arrayIds.push_back(array.GLId);
+            }
+
+            glCreateBuffers(1, &materialBuffer);
+            glNamedBufferStorage(materialBuffer, std::max<size_t>(1, entries.size()) * sizeof(GPUMaterial), entries.empty() ? NULL : entries.data(), 0);
+            valid = true;
+            return true;
+        }
+
+        // Copies the layers of the textures that finished streaming or were reloaded since the last call. Only valid on
+        // the GL thread
+        void Update(Scene &scene)
+        {
+            if (!valid)
+                return;
+
+            TextureRegistry &textures = scene.GetTextures();
+            pendingLayerCount = 0;
+            for (Layer &layer : layers)
+            {
+                if (!textures.IsAlive(layer.texture) || !textures.IsLoaded(layer.texture))
+                    continue;
+
+                uint32_t revision = textures.GetRevision(layer.texture);
+                if (layer.copied && layer.revision == revision)
+                    continue;
+
+                if (!scene.IsTextureResident(layer.texture))
+                {
+                    pendingLayerCount++;
+                    continue;
+                }
+
+                // a reloaded texture may have changed its size or format
+                const TextureArray &array = arrays[layer.reference >> 16];
+                const Texture2D &source = textures.Get(layer.texture);
+                if (source.GetDescriptor().width == (unsigned int)array.width && source.GetDescriptor().height == (unsigned int)array.height
+                    && SizedFormat(source.GetDescriptor().sizedInternalFormat) == array.format)
+                {
+                    for (GLint level = 0; level < array.levels; level++)
+                    {
+                        GLsizei width = std::max(1, array.width >> level);
+                        GLsizei height = std::max(1, array.height >> level);
+                        glCopyImageSubData(source.GetGLId(), GL_TEXTURE_2D, level, 0, 0, 0,
+                                           array.GLId, GL_TEXTURE_2D_ARRAY, level, 0, 0, layer.reference & 0xFFFF, width, height, 1);
+                    }
+                }
+                layer.copied = true;
+                layer.revision = revision;
+            }
+        }
+
+        // Binds the material buffer and the texture arrays (on consecutive units from firstUnit)
+        void Bind(GLuint storageBinding, GLuint firstUnit) const
+        {
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, storageBinding, materialBuffer);
+            if (!arrayIds.empty())
+                glBindTextures(firstUnit, (GLsizei)arrayIds.size(), arrayIds.data());
+        }
+
+        // Points the materialTextures samplers of a program (declared on materials.glsl) to the units used by Bind
+        static void SetSamplerBindings(Shader &shader, GLuint firstUnit)
+        {
+            for (unsigned int i = 0; i < MAX_TEXTURE_ARRAYS; i++)
+                shader.SetSamplerBinding("materialTextures[" + std::to_string(i) + "]", firstUnit + i);
+        }
+
+        bool IsValid() const
+        {
+            return valid;
+        }
+
+        // Texture arrays sampled by a material, as (diffuse array << 8) | normal array. A missing texture counts as
+        // array 0, so that draws can be batched by the arrays they sample
+        uint32_t GetTextureArrays(MaterialHandle handle) const
+        {
+            return materialArrays[handle];
+        }
+
+        // number of scene materials compiled on the last Build, even if the table isnt valid
+        size_t GetMaterialCount() const
+        {
+            return materialCount;
+        }
+
+        size_t GetArrayCount() const
+        {
+            return arrays.size();
+        }
+
+        // layers waiting for their texture to be resident, as of the last Update
+        size_t GetPendingLayerCount() const
+        {
+            return pendingLayerCount;
+        }
+
+        // GPU memory of the texture arrays (estimated from the copied textures) and of the material buffer
+        size_t GetMemorySize() const
+        {
+            return textureMemorySize + materialCount * sizeof(GPUMaterial);
+        }
+
+    private:
+        struct TextureArray
+        {
+            GLuint GLId = 0;
+            GLsizei width;
+            GLsizei height;
+            GLenum format;
+            GLsizei levels;
+            GLsizei layers = 0;
+        };
+
+        struct Layer
+        {
+            TextureHandle texture;
+            int32_t reference;
+            uint32_t revision = 0;
+            bool copied = false;
+        };
+
+        bool valid = false;
+        size_t materialCount = 0;
+        size_t textureMemorySize = 0;
+        GLuint materialBuffer = 0;
+        std::vector<TextureArray> arrays;
+        std::vector<GLuint> arrayIds;
+        std::vector<Layer> layers;
+        size_t pendingLayerCount = 0;
+        std::vector<uint32_t> materialArrays;
+
+        MaterialTable(const MaterialTable&) = delete;
+        MaterialTable &operator = (const MaterialTable &other) = delete;
+
+        void Release()
+        {
+            if (!arrayIds.empty())
+                glDeleteTextures((GLsizei)arrayIds.size(), arrayIds.data());
+            if (materialBuffer != 0)
+                glDeleteBuffers(1, &materialBuffer);
+
+            valid = false;
+            materialCount = 0;
+            textureMemorySize = 0;
+            materialBuffer = 0;
+            arrays.clear();
+            arrayIds.clear();
+            layers.clear();
+            pendingLayerCount = 0;
+            materialArrays.clear();
+        }
+
+        // Assigns a layer to the texture (once per texture) and returns its reference
+        int32_t AddTexture(Scene &scene, TextureHandle handle, std::unordered_map<uint32_t, int32_t> &textureEntries)
+        {
+            auto found = textureEntries.find(handle.slot);
+            if (found != textureEntries.end())
+                return found->second;
+
+            TextureRegistry &textures = scene.GetTextures();
+            if (!textures.IsAlive(handle) || !textures.IsLoaded(handle))
+                return textureEntries[handle.slot] = NO_TEXTURE;
+
+            const Texture2D &texture = textures.Get(handle);
+            const TextureDescriptor &descriptor = texture.GetDescriptor();
+            if (texture.GetGLId() == 0 || descriptor.width == 0 || descriptor.height == 0)
+                return textureEntries[handle.slot] = NO_TEXTURE;
+
+            GLsizei width = (GLsizei)descriptor.width;
+            GLsizei height = (GLsizei)descriptor.height;
+            GLenum format = SizedFormat(descriptor.sizedInternalFormat);
+            GLsizei levels = LevelCount(texture.GetGLId(), width, height);
+
+            size_t arrayIndex = 0;
+            while (arrayIndex < arrays.size() && !(arrays[arrayIndex].width == width && arrays[arrayIndex].height == height
+                   && arrays[arrayIndex].format == format && arrays[arrayIndex].levels == levels && arrays[arrayIndex].layers < (GLsizei)MAX_ARRAY_LAYERS))
+                arrayIndex++;
+
+            if (arrayIndex == arrays.size())
+            {
+                TextureArray array;
+                array.width = width;
+                array.height = height;
+                array.format = format;
+                array.levels = levels;
+                arrays.push_back(array);
+            }
+
+            int32_t reference = ((int32_t)arrayIndex << 16) | arrays[arrayIndex].layers++;
+            layers.push_back({handle, reference});
+            textureMemorySize += texture.GetMemorySize();
+            return textureEntries[handle.slot] = reference;
+        }
+
+        static uint32_t ArrayOf(int32_t reference)
+        {
+            return reference == NO_TEXTURE ? 0 : (uint32_t)reference >> 16;
+        }
+
+        // the uncompressed scene textures are created with unsized formats, texture storage needs sized ones
+        static GLenum SizedFormat(GLint format)
+        {
+            switch (format)
+            {
+                case GL_RED: return GL_R8;
+                case GL_RG: return GL_RG8;
+                case GL_RGB: return GL_RGB8;
+                case GL_RGBA: return GL_RGBA8;
+                default: return (GLenum)format;
+            }
+        }
+
+        // the levels the texture was given (up to a full chain), GL_TEXTURE_MAX_LEVEL is left at 1000 for driver mips
+        static GLsizei LevelCount(GLuint texture, GLsizei width, GLsizei height)
+        {
+            GLsizei fullChain = 1;
+            while ((std::max(width, height) >> fullChain) > 0)
+                fullChain++;
+
+            GLint maxLevel = 0;
+            glGetTextureParameteriv(texture, GL_TEXTURE_MAX_LEVEL, &maxLevel);
+            return std::min(fullChain, (GLsizei)maxLevel + 1);
+        }
+};
+
+#endif
@@ -0,0 +1,295 @@
+#ifndef MULTI_DRAW_LIST_H
+#define MULTI_DRAW_LIST_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cassert>
+#include <glm/glm.hpp>
+
+#include "../common/JobSystem.h"
+#include "../scene/Scene.h"
+
+/*
+ * Draws of one pass from the scene geometry heap (GeometryHeap.h), submitted as a few glMultiDrawElementsIndirect
+ * calls instead of binding a mesh and issuing a draw per object.
+ *
+ * Each draw is given a batch by the pass (e.g. the texture arrays its material samples from) and the draws of every
+ * batch are submitted by one call. The per draw data (matrices, material, cascade mask) is written to a storage buffer
+ * read by the vertex shaders through the base instance of the draw plus its instance (drawData.glsl), so nothing is
+ * set between draws. The draws of a batch sharing a mesh are merged into one instanced command, unless the commands
+ * have to stay one per object (e.g. to be culled by GPUCuller.h).
+ * Objects whose mesh isnt in the heap are listed apart, for the pass to draw them one by one.
+ */
+
+class MultiDrawList
+{
+    public:
+        static constexpr uint32_t SKIP_DRAW = UINT32_MAX;
+        // storage binding of the draw data, the default of drawData.glsl
+        static constexpr GLuint DRAW_DATA_BINDING = 4;
+        static constexpr size_t BUILD_RANGE_SIZE = 512;
+
+        // std430 layout, declared on data/shaders/include/drawData.glsl
+        struct DrawData
+        {
+            glm::mat4 modelMatrix;
+            glm::mat4 normalMatrix;
+            // copy of the material properties, for the passes that dont read them from the material table
+            MaterialInstance::MaterialProperties properties;
+            uint32_t material;
+            uint32_t cascadeMask;
+            uint32_t pad0;
+            uint32_t pad1;
+        };
+
+        // GL layout of the indirect commands
+        struct DrawElementsIndirectCommand
+        {
+            GLuint count;
+            GLuint instanceCount;
+            GLuint firstIndex;
+            GLint baseVertex;
+            GLuint baseInstance;
+        };
+
+        struct Batch
+        {
+            uint32_t key;
+            uint32_t first;
+            uint32_t count;
+        };
+
+        MultiDrawList(){}
+
+        ~MultiDrawList()
+        {
+            if (commandBuffer != 0)
+            {
+                glDeleteBuffers(1, &commandBuffer);
+                glDeleteBuffers(1, &drawDataBuffer);
+            }
+        }
+
+        MultiDrawList(MultiDrawList &&other)
+        {
+            *this = std::move(other);
+        }
+
+        MultiDrawList &operator = (MultiDrawList &&other)
+        {
+            std::swap(commandBuffer, other.commandBuffer);
+            std::swap(drawDataBuffer, other.drawDataBuffer);
+            std::swap(commandCapacity, other.commandCapacity);
+            std::swap(drawDataCapacity, other.drawDataCapacity);
+            drawData.swap(other.drawData);
+            drawKeys.swap(other.drawKeys);
+            commands.swap(other.commands);
+            sortedData.swap(other.sortedData);
+            drawObjects.swap(other.drawObjects);
+            batches.swap(other.batches);
+            fallbackDraws.swap(other.fallbackDraws);
+            return *this;
+        }
+
+        // Fills the draws of the listed objects, on the job system. setup(size_t position, uint32_t object, MaterialInstance &,
+        // DrawData &) fills the data of the draw of objectIndices[position] and returns its batch, or SKIP_DRAW for
+        // objects that arent drawn, and may run on any thread. The draws are uploaded sorted by batch, the batches by key.
+        // With mergeInstances the draws of a batch with the same mesh become one instanced command. Only valid on the GL thread
+        template<typename DrawSetup>
+        void Build(Scene &scene, const std::vector<uint32_t> &objectIndices, DrawSetup &&setup, bool mergeInstances = true)
+        {
+            const ObjectStore &objects = scene.GetObjects();
+            const MeshHandle *meshes = objects.GetMeshes();
+            const MaterialHandle *materials = objects.GetMaterials();
+
+            size_t objectCount = objectIndices.size();
+            drawData.resize(objectCount);
+            drawKeys.resize(objectCount);
+
+            JobSystem::Get().ParallelFor(objectCount, BUILD_RANGE_SIZE, [&](size_t begin, size_t end){
+                for (size_t i = begin; i < end; i++)
+                {
+                    uint32_t object = objectIndices[i];
+                    if (!scene.GetMeshRange(meshes[object]).IsValid())
+                    {
+                        drawKeys[i] = {FALLBACK_DRAW, (uint32_t)i};
+                        continue;
+                    }
+                    drawKeys[i] = {setup(i, object, scene.GetMaterial(materials[object]), drawData[i]), (uint32_t)i};
+                }
+            });
+
+            // batch order, then the draws of each mesh together
+            std::sort(drawKeys.begin(), drawKeys.end(), [&](const DrawKey &a, const DrawKey &b){
+                if (a.batch != b.batch)
+                    return a.batch < b.batch;
+                return meshes[objectIndices[a.draw]] < meshes[objectIndices[b.draw]];
+            });
+
+            commands.clear();
+            sortedData.clear();
+            drawObjects.clear();
+            batches.clear();
+            fallbackDraws.clear();
+            for (const DrawKey &drawKey : drawKeys)
+            {
+                uint32_t object = objectIndices[drawKey.draw];
+                if (drawKey.batch == SKIP_DRAW)
+                    continue;
+                if (drawKey.batch == FALLBACK_DRAW)
+                {
+                    fallbackDraws.push_back(drawKey.draw);
+                    continue;
+                }
+
+                bool newBatch = batches.empty() || batches.back().key != drawKey.batch;
+                if (newBatch)
+                    batches.push_back({drawKey.batch, (uint32_t)commands.size(), 0});
+
+                // the instances of a command are consecutive on the draw data
+                if (mergeInstances && !newBatch && meshes[drawObjects.back()] == meshes[object])
+                {
+                    commands.back().instanceCount++;
+                }
+                else
+                {
+                    const GeometryRange &range = scene.GetMeshRange(meshes[object]);
+                    commands.push_back({range.indexCount, 1, range.firstIndex, range.baseVertex, (GLuint)sortedData.size()});
+                    batches.back().count++;
+                }
+                sortedData.push_back(drawData[drawKey.draw]);
+                drawObjects.push_back(object);
+            }
+
+            Upload();
+        }
+
+        // Binds the geometry heap, the indirect commands and the draw data. Replaces the bound GL_DRAW_INDIRECT_BUFFER
+        void Bind(const Scene &scene) const
+        {
+            scene.GetGeometry().Bind();
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBindBufferBase(GL_SHADER_STORAGE_BUFFER, DRAW_DATA_BINDING, drawDataBuffer);
+        }
+
+        // Submits the draws of a batch. The list has to be bound
+        void Draw(const Batch &batch) const
+        {
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (const void*)(batch.first * sizeof(DrawElementsIndirectCommand)),
+                                        (GLsizei)batch.count, 0);
+        }
+
+        // Binds the list and submits every batch with the current program. batchSetup(const Batch &) runs before each
+        // batch is drawn (e.g. to set the uniforms shared by its draws)
+        template<typename BatchSetup>
+        void DrawBatches(const Scene &scene, BatchSetup &&batchSetup) const
+        {
+            if (batches.empty())
+                return;
+
+            Bind(scene);
+            for (const Batch &batch : batches)
+            {
+                batchSetup(batch);
+                Draw(batch);
+            }
+            glBindVertexArray(0);
+        }
+
+        const std::vector<Batch> &GetBatches() const
+        {
+            return batches;
+        }
+
+        // positions on the object list of the last Build of the objects whose mesh isnt in the geometry heap (the setup
+        // doesnt run for them), for the pass to draw them one by one
+        const std::vector<uint32_t> &GetFallbackDraws() const
+        {
+            return fallbackDraws;
+        }
+
+        // indirect commands, one per object unless the instances were merged
+        size_t GetDrawCount() const
+        {
+            return commands.size();
+        }
+
+        size_t GetInstanceCount() const
+        {
+            return sortedData.size();
+        }
+
+        // object of each draw in the order of the draw data (the base instance of a command is the position of its first)
+        const std::vector<uint32_t> &GetDrawObjects() const
+        {
+            return drawObjects;
+        }
+
+        GLuint GetCommandBuffer() const
+        {
+            return commandBuffer;
+        }
+
+    private:
+        static constexpr uint32_t FALLBACK_DRAW = UINT32_MAX - 1;
+
+        struct DrawKey
+        {
+            uint32_t batch;
+            uint32_t draw;
+        };
+
+        std::vector<DrawData> drawData;
+        std::vector<DrawKey> drawKeys;
+        std::vector<DrawElementsIndirectCommand> commands;
+        std::vector<DrawData> sortedData;
+        std::vector<uint32_t> drawObjects;
+        std::vector<Batch> batches;
+        std::vector<uint32_t> fallbackDraws;
+
+        GLuint commandBuffer = 0;
+        GLuint drawDataBuffer = 0;
+        size_t commandCapacity = 0;
+        // the merged draws have more draw data entries than commands
+        size_t drawDataCapacity = 0;
+
+        MultiDrawList(const MultiDrawList&) = delete;
+        MultiDrawList &operator = (const MultiDrawList &other) = delete;
+
+        void Upload()
+        {
+            if (commandBuffer == 0)
+            {
+                glCreateBuffers(1, &commandBuffer);
+                glCreateBuffers(1, &drawDataBuffer);
+            }
+
+            // every instance of the commands reads its own draw data entry
+            assert(commands.empty() || commands.back().baseInstance + commands.back().instanceCount == sortedData.size());
+
+            // reallocated when they grow, orphaned every frame otherwise
+            commandCapacity = GrowCapacity(commandCapacity, commands.size());
+            drawDataCapacity = GrowCapacity(drawDataCapacity, sortedData.size());
+
+            glNamedBufferData(commandBuffer, commandCapacity * sizeof(DrawElementsIndirectCommand), NULL, GL_STREAM_DRAW);
+            glNamedBufferData(drawDataBuffer, drawDataCapacity * sizeof(DrawData), NULL, GL_STREAM_DRAW);
+            if (!commands.empty())
+            {
+                glNamedBufferSubData(commandBuffer, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+                glNamedBufferSubData(drawDataBuffer, 0, sortedData.size() * sizeof(DrawData), sortedData.data());
+            }
+        }
+
+        static size_t GrowCapacity(size_t capacity, size_t size)
+        {
+            capacity = std::max<size_t>(capacity, 1);
+            while (capacity < size)
+                capacity *= 2;
+            return capacity;
+        }
+};
+
+#endif
@@ -0,0 +1,584 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <utility>
+#include <glm/glm.hpp>
+
+#include "../common/Shader.h"
+#include "../common/JobSystem.h"
+#include "../scene/Scene.h"
+#include "CommandList.h"
+#include "MultiDrawList.h"
+
+/*
+ * Draws of the visible objects, sorted by state so that each program, subroutine selection, texture set and mesh is
+ * bound once per run of draws sharing it instead of once per object in scene file order.
+ *
+ * Every draw gets a 64 bit key (most significant field first):
+ *   pass (4) | program (8) | subroutine (4) | material template (10) | texture set (14) | mesh (16) | depth (8)
+ * The program field is a dense index given to each program in the order Build first meets it, not its GL name.
+ * The keys are radix sorted (stable, so equal keys keep the scene order). The fields only decide the order: each draw
+ * keeps its full state, so a value that doesnt fit its field just groups a bit worse. Within the same state, draws are
+ * ordered front to back by their quantized view depth. Draws reading their material from the material table dont
+ * bind textures, so their material template and texture set fields are left empty and they only group by mesh.
+ *
+ * The sorted draws are recorded into command lists (CommandList.h) by jobs, each tracking the bound state of its
+ * range of draws to skip redundant binds, and replayed in order on the GL thread. The state changes of the recorded
+ * draws are counted, along with the ones the per object binding in scene order issues for the same draws (the program
+ * when it differs from the previous object, and the subroutines, textures and mesh of every object), to compare both.
+ *
+ * Consecutive draws of the same instance group of the scene (same mesh, material template and flags, so the same state)
+ * are recorded as one instanced draw when their state gives an instanced program: a variant of the program reading the
+ * matrices and material properties of each instance from an instance buffer (drawData.glsl, MULTI_DRAW) instead of the
+ * per draw uniforms. Each range writes its instances, uploaded at the end of Record and bound to the draw data binding
+ * when the range is replayed.
+ */
+
+class RenderQueue
+{
+    public:
+        static constexpr unsigned int MAX_SUBROUTINES = 4;
+
+        // state chosen by the renderer for each draw
+        struct DrawState
+        {
+            unsigned int pass = 0;
+            Shader *program = nullptr;
+            GLuint subroutines[MAX_SUBROUTINES];
+            unsigned int subroutineCount = 0;
+            // when valid, the program reads the material from the material table (MaterialTable.h): its index (the
+            // MaterialHandle of the object) is set on this uniform of the program instead of binding the material textures.
+            // Looked up on the GL thread, before Build
+            Shader::UniformHandle materialIndex;
+            // when set, runs of draws of the same instance group are drawn by this program in one instanced draw
+            Shader *instancedProgram = nullptr;
+        };
+
+        // first texture unit of each texture type, as laid out by the pass shaders
+        struct TextureUnits
+        {
+            unsigned int diffuse;
+            unsigned int normal;
+            unsigned int specular;
+        };
+
+        struct StateChanges
+        {
+            unsigned int draws = 0;
+            unsigned int programs = 0;
+            unsigned int subroutines = 0;
+            unsigned int textures = 0;
+            unsigned int meshes = 0;
+            // instanced draws and the draws merged into them
+            unsigned int instancedDraws = 0;
+            unsigned int instances = 0;
+
+            unsigned int GetTotal() const
+            {
+                return programs + subroutines + textures + meshes;
+            }
+        };
+
+        // runs of draws merged into one instanced draw are at least this long, and split at the max
+        static constexpr size_t MIN_INSTANCES = 2;
+        static constexpr size_t MAX_INSTANCES = 1024;
+
+        RenderQueue(){}
+
+        ~RenderQueue()
+        {
+            if (instanceBuffer != 0)
+                glDeleteBuffers(1, &instanceBuffer);
+        }
+
+        RenderQueue(RenderQueue &&other)
+        {
+            *this = std::move(other);
+        }
+
+        RenderQueue &operator = (RenderQueue &&other)
+        {
+            draws.swap(other.draws);
+            order.swap(other.order);
+            sortBuffer.swap(other.sortBuffer);
+            ranges.swap(other.ranges);
+            std::swap(rangeCount, other.rangeCount);
+            std::swap(commandCount, other.commandCount);
+            std::swap(sceneOrderChanges, other.sceneOrderChanges);
+            std::swap(sortedChanges, other.sortedChanges);
+            std::swap(recordTime, other.recordTime);
+            std::swap(replayTime, other.replayTime);
+            std::swap(instanceBuffer, other.instanceBuffer);
+            std::swap(instanceCapacity, other.instanceCapacity);
+            std::swap(instanceAlignment, other.instanceAlignment);
+            programs.swap(other.programs);
+            return *this;
+        }
+
+        static uint64_t MakeKey(unsigned int pass, unsigned int program, unsigned int subroutine, unsigned int materialTemplate,
+                                unsigned int textureSet, unsigned int mesh, unsigned int depth)
+        {
+            return ((uint64_t)(pass & 0xF) << 60) | ((uint64_t)(program & 0xFF) << 52) | ((uint64_t)(subroutine & 0xF) << 48)
+                   | ((uint64_t)(materialTemplate & 0x3FF) << 38) | ((uint64_t)(textureSet & 0x3FFF) << 24)
+                   | ((uint64_t)(mesh & 0xFFFF) << 8) | (uint64_t)(depth & 0xFF);
+        }
+
+        // Queues the listed objects (e.g. the visible ones) and sorts them. classify(MaterialInstance &, DrawState &)
+        // fills the state of each draw and returns false for objects that arent drawn. maxDepth is the view depth
+        // mapped to the last depth bucket (e.g. the camera far plane)
+        template<typename Classifier>
+        void Build(Scene &scene, const std::vector<uint32_t> &objectIndices, const glm::mat4 &viewMatrix, float maxDepth, Classifier &&classify)
+        {
+            draws.clear();
+            programs.clear();
+            sceneOrderChanges = StateChanges();
+            sortedChanges = StateChanges();
+
+            const ObjectStore &objects = scene.GetObjects();
+            const MeshHandle *meshes = objects.GetMeshes();
+            const MaterialHandle *materials = objects.GetMaterials();
+            const MathUtils::Sphere *spheres = objects.GetWorldSpheres();
+            const uint32_t *instanceGroups = objects.GetInstanceGroups();
+            glm::vec4 depthRow = glm::vec4(viewMatrix[0][2], viewMatrix[1][2], viewMatrix[2][2], viewMatrix[3][2]);
+            float depthScale = maxDepth > 0.0f ? 255.0f / maxDepth : 0.0f;
+
+            uint32_t usedPasses = 0;
+            for (uint32_t object : objectIndices)
+            {
+                Draw draw;
+                MaterialInstance &material = scene.GetMaterial(materials[object]);
+                if (!classify(material, draw.state))
+                    continue;
+
+                bool tableMaterial = draw.state.materialIndex.IsValid();
+                draw.object = object;
+                draw.material = materials[object];
+                draw.instanceGroup = instanceGroups[object];
+                draw.textureSet = tableMaterial ? 0 : scene.GetTextureSet(materials[object]);
+                draw.mesh = &scene.GetMesh(meshes[object]);
+
+                float depth = -glm::dot(depthRow, glm::vec4(spheres[object].center, 1.0f));
+                unsigned int depthBucket = (unsigned int)std::min(std::max(depth * depthScale, 0.0f), 255.0f);
+                draw.key = MakeKey(draw.state.pass, GetProgramIndex(draw.state.program), draw.state.subroutineCount > 0 ? draw.state.subroutines[0] : 0,
+                                   tableMaterial ? 0 : material.TemplateId(), draw.textureSet, meshes[object], depthBucket);
+
+                usedPasses |= 1u << (draw.state.pass & 0xF);
+                draws.push_back(draw);
+            }
+
+            // what the per object binding costs in scene order
+            for (unsigned int pass = 0; pass < 16; pass++)
+            {
+                if (!(usedPasses & (1u << pass)))
+                    continue;
+
+                Shader *program = nullptr;
+                for (const Draw &draw : draws)
+                {
+                    if ((draw.state.pass & 0xF) != pass)
+                        continue;
+
+                    MaterialInstance &material = scene.GetMaterial(materials[draw.object]);
+                    sceneOrderChanges.draws++;
+                    sceneOrderChanges.programs += draw.state.program != program ? 1 : 0;
+                    sceneOrderChanges.subroutines += draw.state.subroutineCount > 0 ? 1 : 0;
+                    sceneOrderChanges.textures += material.GetNumTextures(OP_TEXTURE_DIFFUSE) + material.GetNumTextures(OP_TEXTURE_NORMAL)
+                                                  + material.GetNumTextures(OP_TEXTURE_SPECULAR);
+                    sceneOrderChanges.meshes++;
+                    program = draw.state.program;
+                }
+            }
+
+            Sort();
+        }
+
+        // Records the draws of every pass into command lists, on the job system: the sorted draws of each pass are split
+        // in ranges of RECORD_RANGE_SIZE recorded in parallel. setup(CommandList &, const glm::mat4 &objectToWorld,
+        // const glm::mat4 &normalMatrix, MaterialInstance &, Mesh &) records the per draw data (matrices, material
+        // properties) once the program is bound, and may run on any thread (it isnt called for instanced draws). The
+        // normal matrices are indexed by object (e.g. from TransformKernel.h). The bound state is assumed unknown at the
+        // start of each range. Uploads the instances, only valid on the GL thread
+        template<typename DrawSetup>
+        void Record(Scene &scene, const TextureUnits &units, const glm::mat4 *normalMatrices, DrawSetup &&setup)
+        {
+            auto recordStart = std::chrono::high_resolution_clock::now();
+
+            // ranges never cross passes, the keys are sorted by pass first
+            rangeCount = 0;
+            for (size_t begin = 0; begin < order.size();)
+            {
+                uint64_t pass = order[begin].key >> 60;
+                size_t passEnd = begin;
+                while (passEnd < order.size() && (order[passEnd].key >> 60) == pass)
+                    passEnd++;
+
+                for (size_t rangeBegin = begin; rangeBegin < passEnd; rangeBegin += RECORD_RANGE_SIZE)
+                {
+                    if (ranges.size() <= rangeCount)
+                        ranges.emplace_back();
+                    RecordedRange &range = ranges[rangeCount++];
+                    range.pass = (unsigned int)pass;
+                    range.begin = rangeBegin;
+                    range.end = std::min(passEnd, rangeBegin + RECORD_RANGE_SIZE);
+                }
+                begin = passEnd;
+            }
+
+            JobSystem::Get().ParallelFor(rangeCount, 1, [&](size_t first, size_t last){
+                for (size_t r = first; r < last; r++)
+                    RecordRange(scene, units, normalMatrices, setup, ranges[r]);
+            });
+
+            sortedChanges = StateChanges();
+            commandCount = 0;
+            for (size_t r = 0; r < rangeCount; r++)
+            {
+                const StateChanges &changes = ranges[r].changes;
+                sortedChanges.draws += changes.draws;
+                sortedChanges.programs += changes.programs;
+                sortedChanges.subroutines += changes.subroutines;
+                sortedChanges.textures += changes.textures;
+                sortedChanges.meshes += changes.meshes;
+                sortedChanges.instancedDraws += changes.instancedDraws;
+                sortedChanges.instances += changes.instances;
+                commandCount += ranges[r].commands.GetCommandCount();
+            }
+            UploadInstances();
+
+            recordTime = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - recordStart).count();
+            replayTime = 0;
+        }
+
+        // Issues the recorded commands of a pass, in key order. Only valid on the GL thread
+        void Replay(unsigned int pass)
+        {
+            auto replayStart = std::chrono::high_resolution_clock::now();
+            for (size_t r = 0; r < rangeCount; r++)
+            {
+                if (ranges[r].pass != (pass & 0xF))
+                    continue;
+
+                if (!ranges[r].instances.empty())
+                    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, MultiDrawList::DRAW_DATA_BINDING, instanceBuffer, ranges[r].instanceOffset,
+                                      ranges[r].instances.size() * sizeof(MultiDrawList::DrawData));
+                ranges[r].commands.Replay();
+            }
+            replayTime += std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - replayStart).count();
+        }
+
+        // state changes of the recorded draws, and of the same draws bound per object in scene order
+        const StateChanges &GetSortedChanges() const { return sortedChanges; }
+        const StateChanges &GetSceneOrderChanges() const { return sceneOrderChanges; }
+
+        // CPU time of the last Record (wall time, all threads) and of the Replay calls since then, in ms
+        double GetRecordTime() const { return recordTime; }
+        double GetReplayTime() const { return replayTime; }
+
+        size_t GetCommandCount() const
+        {
+            return commandCount;
+        }
+
+        size_t GetDrawCount() const
+        {
+            return draws.size();
+        }
+
+    private:
+        static constexpr unsigned int MAX_TRACKED_UNITS = 32;
+        static constexpr size_t RECORD_RANGE_SIZE = 256;
+
+        struct Draw
+        {
+            uint64_t key;
+            uint32_t object;
+            MaterialHandle material;
+            uint32_t instanceGroup;
+            uint32_t textureSet;
+            Mesh *mesh;
+            DrawState state;
+        };
+
+        struct SortEntry
+        {
+            uint64_t key;
+            uint32_t draw;
+        };
+
+        // state bound by the commands recorded so far on a range
+        struct BoundState
+        {
+            Shader *program = nullptr;
+            GLuint subroutines[MAX_SUBROUTINES];
+            unsigned int subroutineCount = 0;
+            uint32_t textureSet = UINT32_MAX;
+            const TextureObject *textures[MAX_TRACKED_UNITS] = {};
+            const Mesh *mesh = nullptr;
+        };
+
+        struct RecordedRange
+        {
+            unsigned int pass;
+            size_t begin;
+            size_t end;
+            CommandList commands;
+            StateChanges changes;
+            // per instance data of the instanced draws of the range, and its offset on the instance buffer
+            std::vector<MultiDrawList::DrawData> instances;
+            GLintptr instanceOffset = 0;
+        };
+
+        std::vector<Draw> draws;
+        std::vector<SortEntry> order;
+        std::vector<SortEntry> sortBuffer;
+
+        // kept between frames so that the command lists reuse their memory
+        std::vector<RecordedRange> ranges;
+        size_t rangeCount = 0;
+        size_t commandCount = 0;
+
+        StateChanges sceneOrderChanges;
+        StateChanges sortedChanges;
+        double recordTime = 0;
+        double replayTime = 0;
+
+        GLuint instanceBuffer = 0;
+        size_t instanceCapacity = 0;
+        // offset alignment of the storage buffer bindings, queried when the instance buffer is created
+        GLint instanceAlignment = 1;
+
+        // programs of the queued draws, their position is the program field of the keys
+        std::vector<Shader*> programs;
+
+        RenderQueue(const RenderQueue&) = delete;
+        RenderQueue &operator = (const RenderQueue &other) = delete;
+
+        unsigned int GetProgramIndex(Shader *program)
+        {
+            auto it = std::find(programs.begin(), programs.end(), program);
+            if (it != programs.end())
+                return (unsigned int)(it - programs.begin());
+            programs.push_back(program);
+            return (unsigned int)(programs.size() - 1);
+        }
+
+        // LSD radix sort on bytes. Bytes that are equal on every key (usually the pass and program ones) are skipped
+        void Sort()
+        {
+            size_t count = draws.size();
+            order.resize(count);
+            sortBuffer.resize(count);
+            for (uint32_t i = 0; i < count; i++)
+                order[i] = {draws[i].key, i};
+
+            uint32_t histograms[8][256];
+            std::memset(histograms, 0, sizeof(histograms));
+            for (const SortEntry &entry : order)
+            {
+                for (unsigned int b = 0; b < 8; b++)
+                    histograms[b][(entry.key >> (8 * b)) & 0xFF]++;
+            }
+
+            for (unsigned int b = 0; b < 8; b++)
+            {
+                uint32_t *histogram = histograms[b];
+                if (count == 0 || histogram[(order[0].key >> (8 * b)) & 0xFF] == count)
+                    continue;
+
+                uint32_t offset = 0;
+                for (unsigned int d = 0; d < 256; d++)
+                {
+                    uint32_t bucketSize = histogram[d];
+                    histogram[d] = offset;
+                    offset += bucketSize;
+                }
+                for (const SortEntry &entry : order)
+                    sortBuffer[histogram[(entry.key >> (8 * b)) & 0xFF]++] = entry;
+                order.swap(sortBuffer);
+            }
+        }
+
+        template<typename DrawSetup>
+        void RecordRange(Scene &scene, const TextureUnits &units, const glm::mat4 *normalMatrices, DrawSetup &setup, RecordedRange &range)
+        {
+            const glm::mat4 *transforms = scene.GetObjects().GetTransforms();
+            const MaterialHandle *materials = scene.GetObjects().GetMaterials();
+
+            CommandList &commands = range.commands;
+            commands.Clear();
+            range.changes = StateChanges();
+            range.instances.clear();
+            BoundState bound;
+
+            for (size_t i = range.begin; i < range.end;)
+            {
+                const Draw &draw = draws[order[i].draw];
+                MaterialInstance &material = scene.GetMaterial(materials[draw.object]);
+
+                size_t runEnd = i + 1;
+                if (draw.state.instancedProgram != nullptr)
+                {
+                    while (runEnd < range.end && runEnd - i < MAX_INSTANCES && IsSameInstance(draw, draws[order[runEnd].draw]))
+                        runEnd++;
+                }
+
+                if (runEnd - i < MIN_INSTANCES)
+                {
+                    RecordState(scene, draw, draw.state.program, material, units, bound, commands, range.changes);
+                    setup(commands, transforms[draw.object], normalMatrices[draw.object], material, *draw.mesh);
+                    commands.DrawElements(draw.mesh->indicesCount);
+                    i++;
+                    continue;
+                }
+
+                RecordState(scene, draw, draw.state.instancedProgram, material, units, bound, commands, range.changes);
+                GLuint baseInstance = (GLuint)range.instances.size();
+                for (size_t j = i; j < runEnd; j++)
+                {
+                    uint32_t object = draws[order[j].draw].object;
+                    MultiDrawList::DrawData instance;
+                    instance.modelMatrix = transforms[object];
+                    instance.normalMatrix = normalMatrices[object];
+                    instance.properties = scene.GetMaterial(materials[object]).properties;
+                    instance.material = materials[object];
+                    instance.cascadeMask = 0;
+                    range.instances.push_back(instance);
+                }
+                commands.DrawElementsInstanced(draw.mesh->indicesCount, (GLsizei)(runEnd - i), baseInstance);
+                range.changes.draws += (unsigned int)(runEnd - i - 1);
+                range.changes.instancedDraws++;
+                range.changes.instances += (unsigned int)(runEnd - i);
+                i = runEnd;
+            }
+        }
+
+        // same instance group drawn with the same state (the group already implies it, unless the classifier differs)
+        static bool IsSameInstance(const Draw &first, const Draw &draw)
+        {
+            return draw.instanceGroup == first.instanceGroup && draw.state.instancedProgram == first.state.instancedProgram
+                   && draw.state.program == first.state.program && draw.state.pass == first.state.pass;
+        }
+
+        // Uploads the instances of every range, each at an offset aligned for the storage buffer binding
+        void UploadInstances()
+        {
+            bool hasInstances = false;
+            for (size_t r = 0; r < rangeCount && !hasInstances; r++)
+                hasInstances = !ranges[r].instances.empty();
+            if (!hasInstances)
+                return;
+
+            if (instanceBuffer == 0)
+            {
+                glCreateBuffers(1, &instanceBuffer);
+                glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &instanceAlignment);
+                instanceAlignment = std::max(instanceAlignment, 1);
+            }
+
+            size_t size = 0;
+            for (size_t r = 0; r < rangeCount; r++)
+            {
+                if (ranges[r].instances.empty())
+                    continue;
+                size = (size + instanceAlignment - 1) / instanceAlignment * instanceAlignment;
+                ranges[r].instanceOffset = (GLintptr)size;
+                size += ranges[r].instances.size() * sizeof(MultiDrawList::DrawData);
+            }
+
+            // reallocated when it grows, orphaned every frame otherwise
+            instanceCapacity = std::max(instanceCapacity, size);
+            glNamedBufferData(instanceBuffer, instanceCapacity, NULL, GL_STREAM_DRAW);
+            for (size_t r = 0; r < rangeCount; r++)
+            {
+                if (!ranges[r].instances.empty())
+                    glNamedBufferSubData(instanceBuffer, ranges[r].instanceOffset, ranges[r].instances.size() * sizeof(MultiDrawList::DrawData), ranges[r].instances.data());
+            }
+        }
+
+        // Records the binds of what changed since the previous draw
+        void RecordState(Scene &scene, const Draw &draw, Shader *program, MaterialInstance &material, const TextureUnits &units, BoundState &bound, CommandList &commands, StateChanges &changes)
+        {
+            changes.draws++;
+            const DrawState &state = draw.state;
+
+            // the subroutine selection is reset when a program is made current
+            bool programChanged = program != bound.program;
+            if (programChanged)
+            {
+                commands.BindProgram(program->ID);
+                bound.program = program;
+                bound.subroutineCount = 0;
+                changes.programs++;
+            }
+
+            if (state.subroutineCount > 0 && (programChanged || state.subroutineCount != bound.subroutineCount
+                || !std::equal(state.subroutines, state.subroutines + state.subroutineCount, bound.subroutines)))
+            {
+                commands.SetSubroutines(state.subroutines, state.subroutineCount);
+                std::copy(state.subroutines, state.subroutines + state.subroutineCount, bound.subroutines);
+                bound.subroutineCount = state.subroutineCount;
+                changes.subroutines++;
+            }
+
+            if (state.materialIndex.IsValid())
+            {
+                commands.SetUniformUint(state.program, state.materialIndex, draw.material);
+            }
+            else if (draw.textureSet != bound.textureSet)
+            {
+                RecordTextures(scene, material, units, bound, commands, changes);
+                bound.textureSet = draw.textureSet;
+            }
+
+            if (draw.mesh != bound.mesh)
+            {
+                commands.BindVertexArray(draw.mesh->GetVertexArray());
+                bound.mesh = draw.mesh;
+                changes.meshes++;
+            }
+        }
+
+        // same unit layout as the per object binding of the renderers: diffuse maps from units.diffuse (up to the normal
+        // unit), normal maps from units.normal (up to the specular unit) and specular maps from units.specular
+        void RecordTextures(Scene &scene, MaterialInstance &material, const TextureUnits &units, BoundState &bound, CommandList &commands, StateChanges &changes)
+        {
+            unsigned int binding = units.diffuse;
+            for (unsigned int i = 0; i < material.GetNumTextures(OP_TEXTURE_DIFFUSE); i++)
+            {
+                binding = std::min(binding, units.normal);
+                RecordTexture(scene.GetTexture(material.GetTexture(OP_TEXTURE_DIFFUSE, i)), binding++, bound, commands, changes);
+            }
+
+            binding = units.normal;
+            for (unsigned int i = 0; i < material.GetNumTextures(OP_TEXTURE_NORMAL); i++)
+            {
+                binding = std::min(binding, units.specular);
+                RecordTexture(scene.GetTexture(material.GetTexture(OP_TEXTURE_NORMAL, i)), binding++, bound, commands, changes);
+            }
+
+            binding = units.specular;
+            for (unsigned int i = 0; i < material.GetNumTextures(OP_TEXTURE_SPECULAR); i++)
+                RecordTexture(scene.GetTexture(material.GetTexture(OP_TEXTURE_SPECULAR, i)), binding++, bound, commands, changes);
+        }
+
+        void RecordTexture(const TextureObject &texture, unsigned int binding, BoundState &bound, CommandList &commands, StateChanges &changes)
+        {
+            if (binding < MAX_TRACKED_UNITS)
+            {
+                if (bound.textures[binding] == &texture)
+                    return;
+                bound.textures[binding] = &texture;
+            }
+
+            commands.BindTexture(binding, texture.GetTarget(), texture.GetGLId());
+            changes.textures++;
+        }
+};
+
+#endif
@@ -60,6 +60,17 @@ class CMVCTGIRenderer : public BaseRenderer
             NORMAL_TEXTURE0_BINDING = 2,
             SPECULAR_TEXTURE0_BINDING = 4,
         };
+        enum RenderQueuePasses
+        {
+            GBUFFER_QUEUE_PASS = 0,
+            UNLIT_QUEUE_PASS = 1,
+        };
+        enum MaterialTableBindings
+        {
+            MATERIAL_TEXTURE_ARRAY0_BINDING = 0, // up to MaterialTable::MAX_TEXTURE_ARRAYS units
+            MATERIAL_TABLE_BUFFER_BINDING = 3,
+            MATERIAL_ARRAYS_LOCATION = 1, // multi draws
+        };
         enum GBufferPassOutputBindings
         {
             G_COLOR_SPEC_BUFFER_BINDING = 0,
@@ -73,6 +84,7 @@ class CMVCTGIRenderer : public BaseRenderer
             VX_VOXEL2DTEX_BINDING = 1,
             VX_VOXEL3DTEX_BINDING = 2,
             VX_SHADOW_MAP0_BINDING = 3,
+            VX_MATERIAL_TEXTURE_ARRAY0_BINDING = 4, // multi draws, up to MaterialTable::MAX_TEXTURE_ARRAYS units
         };
         
         enum GIPassBindings
@@ -413,6 +425,75 @@ class CMVCTGIRenderer : public BaseRenderer
             }
             lightDataBuffer->EndSetData();
             
+            // Frustum culling (camera and PCF shadow cascades in one pass, the voxelization still uses every object):
+            unsigned int cascadeCount = activeShadowRenderer == PCF_SHADOW_MAP ? PCFshadowRenderer.UpdateCascades(frameResources) : 0;
+            CullVisibleObjects(frameResources, profiler, PCFshadowRenderer.GetCascadeMatrices(), cascadeCount);
+
+            // Material table: when usable, the gBuffer pass reads every material from it with a single program
+            bool useMaterialTable = UpdateMaterialTable(*scene, profiler);
+
+            // Multi draws: with the material table, the lit objects in the geometry heap are drawn by a few indirect
+            // multi draws (one per texture array pair), the render queue gets the rest
+            bool useMultiDraw = useMaterialTable && !scene->GetGeometry().IsEmpty();
+            if (useMultiDraw)
+                BuildGBufferDraws(frameResources, profiler);
+
+            // Render queue: lit objects go to the gBuffer pass and unlit ones to the unlit pass, sorted by state
+            Shader::UniformHandle materialIndex = gBufferMaterialShader.GetUniformHandle("materialIndex");
+            renderQueue.Build(*scene, useMultiDraw ? queuedObjects : visibleObjects, viewMatrix, camera.Far, [&](MaterialInstance &materialInstance, RenderQueue::DrawState &state)
+            {
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                {
+                    state.pass = UNLIT_QUEUE_PASS;
+                    state.program = &defaultVertUnlitFrag;
+                    state.instancedProgram = &instancedVertUnlitFrag;
+                    return true;
+                }
+
+                state.pass = GBUFFER_QUEUE_PASS;
+                if (useMaterialTable)
+                {
+                    state.program = &gBufferMaterialShader;
+                    state.materialIndex = materialIndex;
+                    return true;
+                }
+
+                if (materialInstance.HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
+                {
+                    state.program = &defaultVertNormalTexFrag;
+                    state.instancedProgram = &instancedVertNormalTexFrag;
+                }
+                else
+                {
+                    state.program = &defaultVertFrag;
+                    state.instancedProgram = &instancedVertFrag;
+                }
+
+                // setting if the color is sampled from texture or from UBO
+                state.subroutines[0] = materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE) ? 1 : 0;
+                state.subroutineCount = 1;
+                return true;
+            });
+
+            // Command recording: the binds and per object data of every queued draw, recorded by jobs and replayed by the passes
+            // the per object blocks go to the uniform ring, each draw binding its own slices
+            GLuint materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties")->GetGLId();
+            GLuint localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices")->GetGLId();
+            GLuint materialPropertiesBinding = shaderMemoryPool.GetUniformBufferBinding("MaterialProperties");
+            GLuint localMatricesBinding = shaderMemoryPool.GetUniformBufferBinding("LocalMatrices");
+            uniformRing.BeginFrame(renderQueue.GetDrawCount() * (uniformRing.Align(sizeof(LocalMatrices)) + uniformRing.Align(sizeof(MaterialProperties))));
+            RenderQueue::TextureUnits textureUnits = {DIFFUSE_TEXTURE0_BINDING, NORMAL_TEXTURE0_BINDING, SPECULAR_TEXTURE0_BINDING};
+
+            renderQueue.Record(*scene, textureUnits, normalMatrices.data(), [&](CommandList &commands, const glm::mat4 &objectToWorld, const glm::mat4 &normalMatrix, MaterialInstance &materialInstance, Mesh &mesh)
+            {
+                if (!useMaterialTable || materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                    RecordUniformData(commands, materialPropertiesBinding, materialPropertiesBuffer, &(materialInstance.properties), sizeof(MaterialProperties));
+
+                // model and normal matrices:
+                LocalMatrices localMatrices = {objectToWorld, normalMatrix};
+                RecordUniformData(commands, localMatricesBinding, localMatricesBuffer, &localMatrices, sizeof(LocalMatrices));
+            });
+
             // 1) Shadow Map Rendering Pass:
             // -----------------------------
             auto shadowTask = profiler->AddTask("Shadow Pass", Colors::sunFlower);
@@ -443,92 +524,11 @@ class CMVCTGIRenderer : public BaseRenderer
             glBindFramebuffer(GL_FRAMEBUFFER, gBufferFBO);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-            GLuint shaderCache = 0;
-
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
-            {    
-                StandardShader activeShader;
-                GLuint activeRoutine;
-
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
-                {
-                    return;
-                }
-                else if (materialInstance->HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
-                {
-                    activeShader = defaultVertNormalTexFrag;
-                    activeRoutine = 1;
-                }
-                else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
-                {
-                    activeShader = defaultVertFrag;
-                    activeRoutine = 1;
-                }
-                else
-                {
-                    activeShader = defaultVertFrag;
-                    activeRoutine = 0;
-                }
-
-                // shader has to be used before updating the uniforms
-                if (activeShader.ID != shaderCache)
-                {
-                    activeShader.UseProgram();
-                    shaderCache = activeShader.ID;
-                }
-
-                // setting if the color is sampled from texture or from UBO
-                glUniformSubroutinesuiv(GL_FRAGMENT_SHADER, 1, &activeRoutine);
-
-
-                // Setting object-related properties
-                // ---------------------------------
-                auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
-
-                // Update model and normal matrices:
-                auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices"); 
-                localMatricesBuffer->SetData( 0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                localMatricesBuffer->SetData( sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
-
-                //Bind all textures
-                unsigned int diffuseBinding = DIFFUSE_TEXTURE0_BINDING;
-                unsigned int normalBinding = NORMAL_TEXTURE0_BINDING;
-                unsigned int specularBinding = SPECULAR_TEXTURE0_BINDING;
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_DIFFUSE); i++)
-                {
-                    diffuseBinding = std::min(diffuseBinding, (unsigned int)NORMAL_TEXTURE0_BINDING);
-                    
-                    auto texName = materialInstance->GetDiffuseMapName(i);
-                    scene->GetTexture(texName).BindForRead(diffuseBinding);
-                    
-                    diffuseBinding++;
-                }
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_NORMAL); i++)
-                {
-                    normalBinding = std::min(normalBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetNormalMapName(i);
-                    scene->GetTexture(texName).BindForRead(normalBinding);
-                    
-                    normalBinding++;
-                }
-
-                for (unsigned int i = 0; i < materialInstance->GetNumTextures(OP_TEXTURE_SPECULAR); i++)
-                {
-                    //specularBinding = std::min(specularBinding++, (unsigned int)SPECULAR_TEXTURE0_BINDING);
-                    auto texName = materialInstance->GetSpecularMapName(i);
-                    scene->GetTexture(texName).BindForRead(specularBinding);
-                    
-                    specularBinding++;
-                }
-                
-                //bind VAO
-                mesh->BindBuffers();
-                //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            });  
+            if (useMaterialTable)
+                materialTable.Bind(MATERIAL_TABLE_BUFFER_BINDING, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            ReplayRenderQueue(GBUFFER_QUEUE_PASS);
+            if (useMultiDraw)
+                DrawGBufferBatches(*scene, gBufferMultiDrawShader);
 
             gbufferTask->End();
 
@@ -586,18 +586,53 @@ class CMVCTGIRenderer : public BaseRenderer
                 // 1st part of voxelization:
                 // -------------------------
                 glDisable(GL_CULL_FACE);// all faces must be rendered
+
+                // with the material table, the objects in the geometry heap are drawn by a multi draw per diffuse texture array
+                const std::vector<uint32_t> &allObjects = GetSceneObjects(*scene);
+                const std::vector<uint32_t> &perObjectDraws = useMultiDraw ? voxelFallbackObjects : allObjects;
+                UpdateNormalMatrices(frameResources, allObjects);
+                if (useMultiDraw)
+                {
+                    const glm::mat4 *transforms = scene->GetObjects().GetTransforms();
+                    const MaterialHandle *materials = scene->GetObjects().GetMaterials();
+                    voxelDraws.Build(*scene, allObjects, [&](size_t position, uint32_t object, MaterialInstance &materialInstance, MultiDrawList::DrawData &draw)
+                    {
+                        if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
+                            return MultiDrawList::SKIP_DRAW;
+
+                        draw.modelMatrix = transforms[object];
+                        draw.normalMatrix = normalMatrices[object];
+                        draw.material = materials[object];
+                        draw.cascadeMask = 0;
+                        return materialTable.GetTextureArrays(materials[object]) & 0xFF00;
+                    });
+                    voxelFallbackObjects.clear();
+                    for (uint32_t position : voxelDraws.GetFallbackDraws())
+                        voxelFallbackObjects.push_back(allObjects[position]);
+
+                    materialTable.Bind(MATERIAL_TABLE_BUFFER_BINDING, VX_MATERIAL_TEXTURE_ARRAY0_BINDING);
+                    voxelizationMultiDrawShader.UseProgram();
+                    voxelizationMultiDrawShader.SetUInt("voxelRes", voxelRes);
+                    Shader::UniformHandle materialArrays = voxelizationMultiDrawShader.GetUniformHandle("materialArrays");
+                    voxelDraws.DrawBatches(*scene, [&](const MultiDrawList::Batch &batch)
+                    {
+                        voxelizationMultiDrawShader.SetIVec2(materialArrays, glm::ivec2(batch.key >> 8, 0));
+                    });
+                    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+                }
+
                 voxelizationShader.UseProgram();
                 voxelizationShader.SetUInt("voxelRes", voxelRes);
                 
-                scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+                scene->ForEachObject(perObjectDraws, [&](uint32_t object, const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
                 {    
                     GLuint activeRoutine;
 
-                    if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                    if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
                     {
                         return;
                     }
-                    else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
+                    else if (materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
                     {
                         activeRoutine = 1;
                     }
@@ -612,24 +647,23 @@ class CMVCTGIRenderer : public BaseRenderer
                     // Setting object-related properties
                     // ---------------------------------
                     auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                    materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
+                    materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance.properties));
 
                     // Update model and normal matrices:
                     auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices");
                     localMatricesBuffer->SetData(0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                    localMatricesBuffer->SetData(sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
+                    localMatricesBuffer->SetData(sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(normalMatrices[object]));
 
-                    if (materialInstance->GetNumTextures(OP_TEXTURE_DIFFUSE) > 0)
+                    if (materialInstance.GetNumTextures(OP_TEXTURE_DIFFUSE) > 0)
                     {
-                        auto texName = materialInstance->GetDiffuseMapName(0);
-                        scene->GetTexture(texName).BindForRead(VX_COLOR_SPEC_BINDING);
+                        scene->GetTexture(materialInstance.GetTexture(OP_TEXTURE_DIFFUSE, 0)).BindForRead(VX_COLOR_SPEC_BINDING);
                     }
                     
                     //bind VAO
-                    mesh->BindBuffers();
+                    mesh.BindBuffers();
 
                     //Indexed drawing
-                    glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
+                    glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
                     glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
                 });  
                 glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -696,6 +730,8 @@ class CMVCTGIRenderer : public BaseRenderer
                 drawVoxelsShader.SetUInt("voxelRes", voxelRes);
 
                 voxelMesh->BindBuffers();
+                // the multi draws (gBuffer, shadow casters, voxelization) leave their own commands bound
+                glBindBuffer(GL_DRAW_INDIRECT_BUFFER, drawIndBuffer);
                 
                 glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(sizeof(DrawElementsIndirectCommand) * mipLevel)); // control this parameter with imgui
                 
@@ -753,36 +789,8 @@ class CMVCTGIRenderer : public BaseRenderer
             glEnable(GL_DEPTH_TEST);
             glDisable(GL_BLEND);
 
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
-            {    
-                StandardShader activeShader;
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
-                {
-                    activeShader = defaultVertUnlitFrag;   
-                }
-                else
-                {
-                    return;
-                }
-
-                if (activeShader.ID != shaderCache)
-                {
-                    activeShader.UseProgram();
-                    shaderCache = activeShader.ID; 
-                }
-
-                auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
-
-                // Update model and normal matrices:
-                auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices");
-                localMatricesBuffer->SetData( 0, sizeof(glm::mat4), (void*)glm::value_ptr(objectToWorld));
-                localMatricesBuffer->SetData( sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
-
-
-                mesh->BindBuffers();
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            }); 
+            ReplayRenderQueue(UNLIT_QUEUE_PASS);
+            ReportRenderQueue(profiler);
 
             this->skyRenderer.Render(frameResources);
 
@@ -831,27 +839,64 @@ class CMVCTGIRenderer : public BaseRenderer
             auto bufferBindings = shaderMemoryPool.GetNamedBindings();
 
 
-            defaultVertFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
-            defaultVertFrag.BuildProgram();
-            defaultVertFrag.UseProgram();
-            defaultVertFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertFrag.BindUniformBlocks(bufferBindings);
-
-
-            defaultVertNormalTexFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
+            // the instanced variants draw the runs of the same instance group of the render queue
+            auto buildTexturedShader = [&](StandardShader &shader, bool normalMapped, bool instanced)
+            {
+                shader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferTextured.frag");
+                if (normalMapped)
+                {
+                    std::string s = "NORMAL_MAPPED";
+                    shader.AddPreProcessorDefines(&s,1);
+                }
+                if (instanced)
+                    shader.AddPreProcessorDefines(GetInstancingDefines());
+                shader.BuildProgram();
+                shader.UseProgram();
+                shader.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
+                shader.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
+                shader.BindUniformBlocks(bufferBindings);
+            };
+            buildTexturedShader(defaultVertFrag, false, false);
+            buildTexturedShader(defaultVertNormalTexFrag, enableNormalMaps, false);
+            buildTexturedShader(instancedVertFrag, false, true);
+            buildTexturedShader(instancedVertNormalTexFrag, enableNormalMaps, true);
+
+            gBufferMaterialShader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferMaterial.frag");
+            gBufferMaterialShader.AddPreProcessorDefines({
+                "MATERIAL_TABLE_BINDING " + std::to_string(MATERIAL_TABLE_BUFFER_BINDING),
+                "MATERIAL_TEXTURE_ARRAYS " + std::to_string(MaterialTable::MAX_TEXTURE_ARRAYS)
+            });
             if (enableNormalMaps)
             {
                 std::string s = "NORMAL_MAPPED";
-                defaultVertNormalTexFrag.AddPreProcessorDefines(&s,1);
+                gBufferMaterialShader.AddPreProcessorDefines(&s,1);
             }
-            defaultVertNormalTexFrag.BuildProgram();
-            defaultVertNormalTexFrag.UseProgram();
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_diffuse1", DIFFUSE_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_normal1", NORMAL_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
-            defaultVertNormalTexFrag.BindUniformBlocks(bufferBindings);
+            gBufferMaterialShader.BuildProgram();
+            gBufferMaterialShader.UseProgram();
+            MaterialTable::SetSamplerBindings(gBufferMaterialShader, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            gBufferMaterialShader.BindUniformBlocks(bufferBindings);
+
+            // same, reading the per draw data of the multi draws
+            gBufferMultiDrawShader = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/deferred/gBufferMaterial.frag");
+            gBufferMultiDrawShader.AddPreProcessorDefines({
+                "MATERIAL_TABLE_BINDING " + std::to_string(MATERIAL_TABLE_BUFFER_BINDING),
+                "MATERIAL_TEXTURE_ARRAYS " + std::to_string(MaterialTable::MAX_TEXTURE_ARRAYS),
+                "MATERIAL_ARRAYS_LOCATION " + std::to_string(MATERIAL_ARRAYS_LOCATION),
+                "DRAW_DATA_BINDING " + std::to_string(MultiDrawList::DRAW_DATA_BINDING),
+                "MULTI_DRAW"
+            });
+            if (enableNormalMaps)
+            {
+                std::string s = "NORMAL_MAPPED";
+                gBufferMultiDrawShader.AddPreProcessorDefines(&s,1);
+            }
+            gBufferMultiDrawShader.BuildProgram();
+            gBufferMultiDrawShader.UseProgram();
+            MaterialTable::SetSamplerBindings(gBufferMultiDrawShader, MATERIAL_TEXTURE_ARRAY0_BINDING);
+            gBufferMultiDrawShader.BindUniformBlocks(bufferBindings);
+            gBufferCuller.ReloadShader();
+
 
 
             defaultVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
@@ -862,6 +907,11 @@ class CMVCTGIRenderer : public BaseRenderer
             defaultVertUnlitFrag.SetSamplerBinding("texture_specular1", SPECULAR_TEXTURE0_BINDING);
             defaultVertUnlitFrag.BindUniformBlocks(bufferBindings);
 
+            instancedVertUnlitFrag = StandardShader(BASE_DIR"/data/shaders/defaultVert.vert", BASE_DIR"/data/shaders/UnlitAlbedoFrag.frag");
+            instancedVertUnlitFrag.AddPreProcessorDefines(GetInstancingDefines());
+            instancedVertUnlitFrag.BuildProgram();
+            instancedVertUnlitFrag.BindUniformBlocks(bufferBindings);
+
 
             postProcessShader = StandardShader(BASE_DIR"/data/shaders/screenQuad/quad.vert", BASE_DIR"/data/shaders/screenQuad/quadTonemapLum.frag");
             postProcessShader.BuildProgram();
@@ -884,6 +934,25 @@ class CMVCTGIRenderer : public BaseRenderer
             voxelizationShader.SetSamplerBinding("shadowMap0", VX_SHADOW_MAP0_BINDING); // do the binding properly
             voxelizationShader.BindUniformBlocks(bufferBindings);
 
+            // same, reading the per draw data of the multi draws and the materials from the material table
+            voxelizationMultiDrawShader = StandardShader(BASE_DIR"/data/shaders/voxelization/voxel.vert", BASE_DIR"/data/shaders/voxelization/voxel.frag");
+            voxelizationMultiDrawShader.AddPreProcessorDefines(preprocessorDefines);
+            voxelizationMultiDrawShader.AddPreProcessorDefines({
+                "MATERIAL_TABLE_BINDING " + std::to_string(MATERIAL_TABLE_BUFFER_BINDING),
+                "MATERIAL_TEXTURE_ARRAYS " + std::to_string(MaterialTable::MAX_TEXTURE_ARRAYS),
+                "MATERIAL_ARRAYS_LOCATION " + std::to_string(MATERIAL_ARRAYS_LOCATION),
+                "DRAW_DATA_BINDING " + std::to_string(MultiDrawList::DRAW_DATA_BINDING),
+                "MULTI_DRAW"
+            });
+            voxelizationMultiDrawShader.AddShaderStage(BASE_DIR"/data/shaders/voxelization/voxel.geom", GL_GEOMETRY_SHADER);
+            voxelizationMultiDrawShader.BuildProgram();
+            voxelizationMultiDrawShader.UseProgram();
+            MaterialTable::SetSamplerBindings(voxelizationMultiDrawShader, VX_MATERIAL_TEXTURE_ARRAY0_BINDING);
+            voxelizationMultiDrawShader.SetSamplerBinding("voxelTextures", VX_VOXEL2DTEX_BINDING);
+            voxelizationMultiDrawShader.SetSamplerBinding("voxel3DData", VX_VOXEL3DTEX_BINDING);
+            voxelizationMultiDrawShader.SetSamplerBinding("shadowMap0", VX_SHADOW_MAP0_BINDING);
+            voxelizationMultiDrawShader.BindUniformBlocks(bufferBindings);
+
 
             resolveVoxelsShader = ComputeShader(BASE_DIR"/data/shaders/voxelization/resolveVoxels.comp");
             resolveVoxelsShader.AddPreProcessorDefines(preprocessorDefines);
@@ -923,6 +992,10 @@ class CMVCTGIRenderer : public BaseRenderer
             ImGui::SeparatorText("Postprocessing");
             ImGui::SliderFloat("Tonemap Exposure", &tonemapExposure, 0.0f, 10.0f, "exposure = %.3f");
 
+            ImGui::SeparatorText("Culling");
+            ImGui::Checkbox("GPU culling (multi draws)", &gpuCulling);
+            ImGui::Checkbox("Check against the CPU", &checkGPUCulling);
+
             ImGui::SeparatorText("Voxelization");
             ImGui::Checkbox("revoxelize", &voxelize);
             ImGui::Checkbox("Draw Voxels", &drawVoxels);
@@ -995,7 +1068,12 @@ class CMVCTGIRenderer : public BaseRenderer
 
         StandardShader defaultVertFrag;
         StandardShader defaultVertNormalTexFrag;
+        StandardShader gBufferMaterialShader;
+        StandardShader gBufferMultiDrawShader;
         StandardShader defaultVertUnlitFrag;
+        StandardShader instancedVertFrag;
+        StandardShader instancedVertNormalTexFrag;
+        StandardShader instancedVertUnlitFrag;
 
 
 
@@ -1011,6 +1089,10 @@ class CMVCTGIRenderer : public BaseRenderer
         GLuint numMipLevels;
 
         StandardShader voxelizationShader;
+        StandardShader voxelizationMultiDrawShader;
+        MultiDrawList voxelDraws;
+        //objects the voxelization multi draws leave out
+        std::vector<uint32_t> voxelFallbackObjects;
         ComputeShader resolveVoxelsShader;
         ComputeShader mipmappingShader;
         StandardShader conetraceShader;
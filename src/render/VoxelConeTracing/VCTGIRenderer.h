@@ -429,21 +429,21 @@ class VCTGIRenderer : public BaseRenderer
 
             GLuint shaderCache = 0;
 
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            scene->ForEachObject([&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
             {    
                 StandardShader activeShader;
                 GLuint activeRoutine;
 
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
                 {
                     return;
                 }
-                else if (materialInstance->HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
+                else if (materialInstance.HasFlags(OP_MATERIAL_TEXTURED_DIFFUSE | OP_MATERIAL_TEXTURED_NORMAL))
                 {
                     activeShader = defaultVertNormalTexFrag;
                     activeRoutine = 1;
                 }
-                else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
+                else if (materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
                 {
                     activeShader = defaultVertFrag;
                     activeRoutine = 1;
@@ -469,7 +469,7 @@ class VCTGIRenderer : public BaseRenderer
                 // ---------------------------------
 
                 auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
+                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance.properties));
 
                 // Update model and normal matrices:
                 auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices"); 
@@ -482,9 +482,9 @@ class VCTGIRenderer : public BaseRenderer
                 unsigned int specularNr = 1;
                 unsigned int normalNr = 1;
                 /*
-                for (unsigned int i = 0; i < materialInstance->numTextures; i++)
+                for (unsigned int i = 0; i < materialInstance.numTextures; i++)
                 {
-                    Texture texture = scene->GetTexture(materialInstance->GetTexturePath(i));
+                    Texture texture = scene->GetTexture(materialInstance.GetTexturePath(i));
 
                     // activate proper texture unit before binding
                     glActiveTexture(GL_TEXTURE0 + i); 
@@ -519,10 +519,10 @@ class VCTGIRenderer : public BaseRenderer
                 }*/
                 
                 //bind VAO
-                mesh->BindBuffers();
+                mesh.BindBuffers();
 
                 //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
+                glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
             });  
 
             gbufferTask->End();
@@ -582,15 +582,15 @@ class VCTGIRenderer : public BaseRenderer
             voxelizationShader.UseProgram();
             voxelizationShader.SetUInt("voxelRes", voxelRes);
             
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            scene->ForEachObject([&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
             {    
                 GLuint activeRoutine;
 
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
                 {
                     return;
                 }
-                else if (materialInstance->HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
+                else if (materialInstance.HasFlag(OP_MATERIAL_TEXTURED_DIFFUSE))
                 {
                     activeRoutine = 1;
                 }
@@ -605,7 +605,7 @@ class VCTGIRenderer : public BaseRenderer
                 // Setting object-related properties
                 // ---------------------------------
                 auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
+                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance.properties));
 
                 // Update model and normal matrices:
                 auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices");
@@ -619,9 +619,9 @@ class VCTGIRenderer : public BaseRenderer
                 unsigned int specularNr = 1;
                 unsigned int normalNr = 1;
                 /*
-                for (unsigned int i = 0; i < materialInstance->numTextures; i++)
+                for (unsigned int i = 0; i < materialInstance.numTextures; i++)
                 {
-                    Texture texture = scene->GetTexture(materialInstance->GetTexturePath(i));
+                    Texture texture = scene->GetTexture(materialInstance.GetTexturePath(i));
 
                     // activate proper texture unit before binding
                     glActiveTexture(GL_TEXTURE0 + VX_COLOR_SPEC_BINDING); 
@@ -642,10 +642,10 @@ class VCTGIRenderer : public BaseRenderer
                 }*/
                 
                 //bind VAO
-                mesh->BindBuffers();
+                mesh.BindBuffers();
 
                 //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
+                glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
                 glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
             });  
             glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
@@ -758,10 +758,10 @@ class VCTGIRenderer : public BaseRenderer
             glEnable(GL_DEPTH_TEST);
             glDisable(GL_BLEND);
 
-            scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            scene->ForEachObject([&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
             {    
                 StandardShader activeShader;
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                if (materialInstance.HasFlag(OP_MATERIAL_UNLIT))
                 {
                     activeShader = defaultVertUnlitFrag;   
                 }
@@ -777,7 +777,7 @@ class VCTGIRenderer : public BaseRenderer
                 }
 
                 auto materialPropertiesBuffer = shaderMemoryPool.GetUniformBuffer("MaterialProperties");
-                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance->properties));
+                materialPropertiesBuffer->SetData(0, sizeof(MaterialProperties), &(materialInstance.properties));
 
                 // Update model and normal matrices:
                 auto localMatricesBuffer = shaderMemoryPool.GetUniformBuffer("LocalMatrices");
@@ -785,8 +785,8 @@ class VCTGIRenderer : public BaseRenderer
                 localMatricesBuffer->SetData( sizeof(glm::mat4), sizeof(glm::mat4), (void*)glm::value_ptr(MathUtils::ComputeNormalMatrix(viewMatrix,objectToWorld)) );
 
 
-                mesh->BindBuffers();
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
+                mesh.BindBuffers();
+                glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
             }); 
 
             this->skyRenderer.Render(frameResources);
@@ -23,6 +23,60 @@ struct ShadowsOutput
     GLenum texType0;
 };
 
+// Culls the shadow casters against the volume of each cascade. The volumes are the light space ortho boxes extruded
+// towards the light (casters between the light and the box still project into it). Each caster is listed once, with
+// the mask of the cascades it overlaps, so the layered geometry shader only emits it into those layers
+class ShadowCasterCuller
+{
+    public:
+        static constexpr unsigned int MAX_CASCADES = 4;
+
+        void Cull(Scene *scene, const glm::mat4 *lightMatrices, unsigned int cascadeCount)
+        {
+            cascadeCount = std::min(cascadeCount, MAX_CASCADES);
+            MathUtils::Frustum cascadeVolumes[MAX_CASCADES];
+            for (unsigned int i = 0; i < cascadeCount; i++)
+                cascadeVolumes[i] = MathUtils::Frustum::FromShadowMatrix(lightMatrices[i]);
+
+            scene->CullObjects(cascadeVolumes, cascadeCount, cascadeObjects);
+            Merge(scene, cascadeObjects, cascadeCount);
+        }
+
+        // Builds the caster list from objects already culled against each cascade volume
+        void Merge(Scene *scene, const std::vector<uint32_t> *cascadeLists, unsigned int cascadeCount)
+        {
+            casters.clear();
+            casterMasks.clear();
+            objectMasks.assign(scene->GetObjects().GetCount(), 0);
+
+            for (unsigned int i = 0; i < cascadeCount; i++)
+            {
+                for (uint32_t object : cascadeLists[i])
+                    objectMasks[object] |= 1 << i;
+            }
+
+            const uint32_t *flags = scene->GetObjects().GetFlags();
+            for (uint32_t object = 0; object < objectMasks.size(); object++)
+            {
+                if (objectMasks[object] != 0 && !(flags[object] & OP_OBJECT_UNLIT))
+                {
+                    casters.push_back(object);
+                    casterMasks.push_back(objectMasks[object]);
+                }
+            }
+        }
+
+        // indices of the objects overlapping at least one cascade, with the cascades each one overlaps
+        const std::vector<uint32_t> &GetCasters() const { return casters; }
+        const std::vector<uint32_t> &GetCasterMasks() const { return casterMasks; }
+
+    private:
+        std::vector<uint32_t> casters;
+        std::vector<uint32_t> casterMasks;
+        std::vector<uint32_t> cascadeObjects[MAX_CASCADES];
+        std::vector<uint32_t> objectMasks;
+};
+
 // Cascade partitioning scheme was Based on: https://developer.download.nvidia.com/SDK/10.5/opengl/src/cascaded_shadow_maps/doc/cascaded_shadow_maps.pdf
 //Add enum containing all shadow mapping techniques to select from
 
@@ -101,6 +155,17 @@ class PCFShadowRenderer
             shadowDepthPass.AddShaderStage(BASE_DIR"/data/shaders/shadows/shadow_mapping/layeredGeom.geom",GL_GEOMETRY_SHADER);
             shadowDepthPass.BuildProgram();
             shadowDepthPass.BindUniformBlock("ShadowData", shaderMemoryPool->GetUniformBufferBinding("ShadowData"));
+
+            //same, reading the model matrix and cascade mask of each caster from the multi draw data
+            shadowDepthMultiDrawPass = StandardShader(BASE_DIR"/data/shaders/shadows/shadow_mapping/layeredVert.vert", BASE_DIR"/data/shaders/nullFrag.frag");
+            shadowDepthMultiDrawPass.AddPreProcessorDefines({
+                "SHADOW_CASCADE_COUNT " + std::to_string(SHADOW_CASCADE_COUNT),
+                "DRAW_DATA_BINDING " + std::to_string(MultiDrawList::DRAW_DATA_BINDING),
+                "MULTI_DRAW"
+            });
+            shadowDepthMultiDrawPass.AddShaderStage(BASE_DIR"/data/shaders/shadows/shadow_mapping/layeredGeom.geom",GL_GEOMETRY_SHADER);
+            shadowDepthMultiDrawPass.BuildProgram();
+            shadowDepthMultiDrawPass.BindUniformBlock("ShadowData", shaderMemoryPool->GetUniformBufferBinding("ShadowData"));
         }
 
         void SetupFrustumCuts(float camNear, float camFar)
@@ -122,28 +187,20 @@ class PCFShadowRenderer
             }
         }
         
-        // Add a frameResources as as struct for input!!. ADD the scene reference. viewport reference. Matrices reference
-        //Returns a set of output textures
-        ShadowsOutput Render(const BaseRenderer::FrameResources& frameResources)
+        // Computes the light matrices of the cascades for the current camera. Returns the cascade count (0 when there is no
+        // directional light)
+        unsigned int UpdateCascades(const BaseRenderer::FrameResources& frameResources)
         {
-            ShadowsOutput out = {0, GL_TEXTURE_2D};
-
             if (frameResources.lightData->numDirLights == 0)
             {
-                return out;
+                return 0;
             }
 
             SetupFrustumCuts(frameResources.camera->Near,frameResources.camera->Far);
 
-            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
-            glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
-            glClear(GL_DEPTH_BUFFER_BIT);
-
             auto mainLight = frameResources.lightData->directionalLights[0];
             glm::vec3 lightDir = glm::normalize(glm::vec3(frameResources.inverseViewMatrix * mainLight.lightDirection));
 
-            glm::mat4 lightMatrices[SHADOW_CASCADE_COUNT];
-
             for (size_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
                 {
                     auto frustrumCorners = frameResources.camera->GetFrustumCornersWorldSpace(frustumCuts[i], frustumCuts[i+1]);
@@ -191,6 +248,35 @@ class PCFShadowRenderer
                     lightMatrices[i] = lightMatrix;
                 }
 
+            return SHADOW_CASCADE_COUNT;
+        }
+
+        const glm::mat4 *GetCascadeMatrices() const
+        {
+            return lightMatrices;
+        }
+
+        // Add a frameResources as as struct for input!!. ADD the scene reference. viewport reference. Matrices reference
+        //Returns a set of output textures
+        ShadowsOutput Render(const BaseRenderer::FrameResources& frameResources)
+        {
+            ShadowsOutput out = {0, GL_TEXTURE_2D};
+
+            if (frameResources.lightData->numDirLights == 0)
+            {
+                return out;
+            }
+
+            // the renderer updates the cascades before the frame when it culls them together with the camera
+            if (frameResources.cascadeObjects == nullptr)
+            {
+                UpdateCascades(frameResources);
+            }
+
+            glViewport(0, 0, SHADOW_WIDTH, SHADOW_HEIGHT);
+            glBindFramebuffer(GL_FRAMEBUFFER, shadowMapFBO);
+            glClear(GL_DEPTH_BUFFER_BIT);
+
             // Filling shadowData buffer:
             auto shadowDataBuffer = frameResources.shaderMemoryPool->GetUniformBuffer("ShadowData");
             ShadowData *shadowData = shadowDataBuffer->BeginSetData<ShadowData>();
@@ -218,23 +304,51 @@ class PCFShadowRenderer
             
             //glCullFace(GL_FRONT); //(Front face culling avoids self shadowing/Acne)
 
-            shadowDepthPass.UseProgram();
-            
-            frameResources.scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            if (frameResources.cascadeObjects != nullptr)
+            {
+                casterCuller.Merge(frameResources.scene, frameResources.cascadeObjects, frameResources.cascadeCount);
+            }
+            else
             {
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
+                casterCuller.Cull(frameResources.scene, lightMatrices, SHADOW_CASCADE_COUNT);
+            }
+            Scene &scene = *frameResources.scene;
+            const std::vector<uint32_t> &casters = casterCuller.GetCasters();
+            const std::vector<uint32_t> &casterMasks = casterCuller.GetCasterMasks();
+            const glm::mat4 *transforms = scene.GetObjects().GetTransforms();
+            const MeshHandle *meshes = scene.GetObjects().GetMeshes();
+
+            //the casters in the geometry heap are drawn by a single multi draw
+            casterDraws.Build(scene, casters, [&](size_t position, uint32_t object, MaterialInstance &materialInstance, MultiDrawList::DrawData &draw)
+            {
+                draw.modelMatrix = transforms[object];
+                draw.normalMatrix = glm::mat4(1.0f);
+                draw.material = 0;
+                draw.cascadeMask = casterMasks[position];
+                return 0u;
+            });
+            shadowDepthMultiDrawPass.UseProgram();
+            casterDraws.DrawBatches(scene, [](const MultiDrawList::Batch &batch){});
+
+            //the rest one by one
+            if (!casterDraws.GetFallbackDraws().empty())
+            {
+                shadowDepthPass.UseProgram();
+                Shader::UniformHandle modelMatrix = shadowDepthPass.GetUniformHandle("modelMatrix");
+                Shader::UniformHandle cascadeMask = shadowDepthPass.GetUniformHandle("cascadeMask");
+                for (uint32_t position : casterDraws.GetFallbackDraws())
                 {
-                    return;
-                }
+                    Mesh &mesh = scene.GetMesh(meshes[casters[position]]);
+                    shadowDepthPass.SetMat4(modelMatrix, transforms[casters[position]]);
+                    shadowDepthPass.SetUInt(cascadeMask, casterMasks[position]);
 
-                shadowDepthPass.SetMat4("modelMatrix", objectToWorld);
+                    //bind VAO
+                    mesh.BindBuffers();
 
-                //bind VAO
-                mesh->BindBuffers();
-
-                //Indexed drawing
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
-            });    
+                    //Indexed drawing
+                    glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
+                }
+            }
 
             glViewport(0, 0, frameResources.viewportWidth, frameResources.viewportHeight);
             //glCullFace(GL_BACK);
@@ -268,7 +382,11 @@ class PCFShadowRenderer
         GLuint shadowMapBuffer0;
 
         float frustumCuts[5];
+        glm::mat4 lightMatrices[4];
         StandardShader shadowDepthPass;
+        StandardShader shadowDepthMultiDrawPass;
+        ShadowCasterCuller casterCuller;
+        MultiDrawList casterDraws;
 };
 
 
@@ -522,6 +640,8 @@ class VarianceShadowRenderer
             glBufferSubData(GL_UNIFORM_BUFFER, 0, 4 * sizeof(float), &shadowParams);
             int offset = 0;
             offset += 4 * sizeof(float);
+
+            glm::mat4 lightMatrices[4];
             
             for (size_t i = 0; i < SHADOW_CASCADE_COUNT; i++)
             {
@@ -558,6 +678,7 @@ class VarianceShadowRenderer
                 );
                 glm::mat4 lightProjection = glm::ortho(-boundingRadius, boundingRadius, -boundingRadius, boundingRadius, -boundingRadius * zMult, boundingRadius * zMult);
                 glm::mat4 lightMatrix = lightProjection * lightView;
+                lightMatrices[i] = lightMatrix;
 
                 glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(glm::mat4), glm::value_ptr(lightMatrix));
                 offset += sizeof(glm::mat4);
@@ -572,18 +693,20 @@ class VarianceShadowRenderer
             
             // Rendering the shadowMap
             VSMShadowPass.UseProgram();
+
+            casterCuller.Cull(frameResources.scene, lightMatrices, SHADOW_CASCADE_COUNT);
+            const std::vector<uint32_t> &casterMasks = casterCuller.GetCasterMasks();
+            size_t caster = 0;
+            Shader::UniformHandle modelMatrix = VSMShadowPass.GetUniformHandle("modelMatrix");
+            Shader::UniformHandle cascadeMask = VSMShadowPass.GetUniformHandle("cascadeMask");
             
-            frameResources.scene->IterateObjects([&](glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)
+            frameResources.scene->ForEachObject(casterCuller.GetCasters(), [&](const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh)
             {
-                if (materialInstance->HasFlag(OP_MATERIAL_UNLIT))
-                {
-                    return;
-                }
-
-                VSMShadowPass.SetMat4("modelMatrix", objectToWorld);
+                VSMShadowPass.SetMat4(modelMatrix, objectToWorld);
+                VSMShadowPass.SetUInt(cascadeMask, casterMasks[caster++]);
 
-                mesh->BindBuffers();
-                glDrawElements(GL_TRIANGLES, mesh->indicesCount, GL_UNSIGNED_INT, 0);
+                mesh.BindBuffers();
+                glDrawElements(GL_TRIANGLES, mesh.indicesCount, GL_UNSIGNED_INT, 0);
             });    
 
 
@@ -645,6 +768,7 @@ class VarianceShadowRenderer
 
         StandardShader VSMShadowPass;
         StandardShader GaussianBlurPass;
+        ShadowCasterCuller casterCuller;
 
         GLuint shadowMapFBO;
         GLuint shadowMapBuffer0;
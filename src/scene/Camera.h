@@ -7,6 +7,8 @@
 #include <json/json.h>
 #include <vector>
 
+#include "../common/MathUtils.h"
+
 
 
 // Defines several possible options for camera movement to avoid window-system specific input methods
@@ -132,6 +134,12 @@ class Camera
             return glm::perspective(glm::radians(Zoom), Aspect, Near, Far);
         }
 
+        // world space frustum planes of the camera
+        MathUtils::Frustum GetFrustum() const
+        {
+            return MathUtils::Frustum::FromMatrix(GetProjectionMatrix() * GetViewMatrix());
+        }
+
         void SetProjectionAspect(float aspect)
         {
             this->Aspect = aspect;
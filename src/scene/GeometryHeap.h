@@ -0,0 +1,162 @@
+#ifndef GEOMETRY_HEAP_H
+#define GEOMETRY_HEAP_H
+
+#include <glad/glad.h>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+
+#include "Mesh.h"
+
+/*
+ * One vertex and one index buffer shared by every scene mesh with the default vertex layout (MeshData::Vertex), so
+ * the objects of a pass can be drawn from a single vertex array by glMultiDrawElementsIndirect.
+ *
+ * Meshes are appended (the scene meshes are never removed) and located by their GeometryRange: the indices keep the
+ * values of the mesh and are offset by baseVertex when drawn. The data is copied on the GPU from the buffers of the
+ * mesh, which keeps its own vertex array for the passes drawing it on its own. The buffers double their capacity when
+ * full, copying the previous contents. Only valid on the GL thread
+ */
+
+struct GeometryRange
+{
+    uint32_t firstIndex = 0;
+    uint32_t indexCount = 0;
+    int32_t baseVertex = 0;
+
+    bool IsValid() const
+    {
+        return indexCount > 0;
+    }
+};
+
+class GeometryHeap
+{
+    public:
+        static constexpr unsigned int DEFAULT_LAYOUT = OP_MESH_COORDS | OP_MESH_NORMALS | OP_MESH_TANGENTS | OP_MESH_TEXCOORDS;
+        static constexpr uint32_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+        static constexpr uint32_t INITIAL_INDEX_CAPACITY = 1 << 18;
+
+        GeometryHeap(){}
+
+        ~GeometryHeap()
+        {
+            if (VAO != 0)
+            {
+                glDeleteVertexArrays(1, &VAO);
+                glDeleteBuffers(1, &VBO);
+                glDeleteBuffers(1, &EBO);
+            }
+        }
+
+        // Copies the mesh into the heap. Returns an invalid range if its vertex layout isnt the default one
+        GeometryRange Add(const Mesh &mesh)
+        {
+            GeometryRange range;
+            if ((mesh.GetFlags() & DEFAULT_LAYOUT) != DEFAULT_LAYOUT || mesh.indicesCount == 0)
+                return range;
+
+            if (VAO == 0)
+                CreateBuffers();
+
+            if (vertexCount + mesh.verticesCount > vertexCapacity)
+                Grow(VBO, vertexCapacity, vertexCount, vertexCount + mesh.verticesCount, sizeof(MeshData::Vertex));
+            if (indexCount + mesh.indicesCount > indexCapacity)
+                Grow(EBO, indexCapacity, indexCount, indexCount + mesh.indicesCount, sizeof(unsigned int));
+
+            glCopyNamedBufferSubData(mesh.GetVertexBuffer(), VBO, 0, (GLintptr)vertexCount * sizeof(MeshData::Vertex), (GLsizeiptr)mesh.verticesCount * sizeof(MeshData::Vertex));
+            glCopyNamedBufferSubData(mesh.GetIndexBuffer(), EBO, 0, (GLintptr)indexCount * sizeof(unsigned int), (GLsizeiptr)mesh.indicesCount * sizeof(unsigned int));
+
+            range.firstIndex = indexCount;
+            range.indexCount = mesh.indicesCount;
+            range.baseVertex = (int32_t)vertexCount;
+            vertexCount += mesh.verticesCount;
+            indexCount += mesh.indicesCount;
+            return range;
+        }
+
+        void Bind() const
+        {
+            glBindVertexArray(VAO);
+        }
+
+        bool IsEmpty() const
+        {
+            return indexCount == 0;
+        }
+
+        uint32_t GetVertexCount() const
+        {
+            return vertexCount;
+        }
+
+        uint32_t GetIndexCount() const
+        {
+            return indexCount;
+        }
+
+        // allocated GPU memory, used or not
+        size_t GetMemorySize() const
+        {
+            return (size_t)vertexCapacity * sizeof(MeshData::Vertex) + (size_t)indexCapacity * sizeof(unsigned int);
+        }
+
+    private:
+        GLuint VAO = 0, VBO = 0, EBO = 0;
+        uint32_t vertexCount = 0, vertexCapacity = 0;
+        uint32_t indexCount = 0, indexCapacity = 0;
+
+        GeometryHeap(const GeometryHeap&) = delete;
+        GeometryHeap &operator = (const GeometryHeap &other) = delete;
+
+        void CreateBuffers()
+        {
+            vertexCapacity = INITIAL_VERTEX_CAPACITY;
+            indexCapacity = INITIAL_INDEX_CAPACITY;
+            glCreateBuffers(1, &VBO);
+            glNamedBufferData(VBO, (GLsizeiptr)vertexCapacity * sizeof(MeshData::Vertex), NULL, GL_STATIC_DRAW);
+            glCreateBuffers(1, &EBO);
+            glNamedBufferData(EBO, (GLsizeiptr)indexCapacity * sizeof(unsigned int), NULL, GL_STATIC_DRAW);
+
+            // same attributes as the meshes (Mesh::InitBuffers)
+            glCreateVertexArrays(1, &VAO);
+            SetupAttribute(MESH_COORDS_ATTRIBUTE, 3, offsetof(MeshData::Vertex, Position));
+            SetupAttribute(MESH_NORMALS_ATTRIBUTE, 3, offsetof(MeshData::Vertex, Normal));
+            SetupAttribute(MESH_TANGENTS_ATTRIBUTE, 3, offsetof(MeshData::Vertex, Tangent));
+            SetupAttribute(MESH_TEXCOORDS_ATTRIBUTE, 2, offsetof(MeshData::Vertex, TexCoords));
+            AttachBuffers();
+        }
+
+        void SetupAttribute(GLuint attribute, GLint size, size_t offset)
+        {
+            glEnableVertexArrayAttrib(VAO, attribute);
+            glVertexArrayAttribFormat(VAO, attribute, size, GL_FLOAT, GL_FALSE, (GLuint)offset);
+            glVertexArrayAttribBinding(VAO, attribute, 0);
+        }
+
+        void AttachBuffers()
+        {
+            glVertexArrayVertexBuffer(VAO, 0, VBO, 0, sizeof(MeshData::Vertex));
+            glVertexArrayElementBuffer(VAO, EBO);
+        }
+
+        void Grow(GLuint &buffer, uint32_t &capacity, uint32_t used, uint32_t required, size_t elementSize)
+        {
+            uint32_t newCapacity = std::max(capacity, 1u);
+            while (newCapacity < required)
+                newCapacity *= 2;
+
+            GLuint newBuffer;
+            glCreateBuffers(1, &newBuffer);
+            glNamedBufferData(newBuffer, (GLsizeiptr)newCapacity * elementSize, NULL, GL_STATIC_DRAW);
+            if (used > 0)
+                glCopyNamedBufferSubData(buffer, newBuffer, 0, 0, (GLsizeiptr)used * elementSize);
+            glDeleteBuffers(1, &buffer);
+
+            buffer = newBuffer;
+            capacity = newCapacity;
+            AttachBuffers();
+        }
+};
+
+#endif
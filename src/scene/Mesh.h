@@ -12,6 +12,7 @@
 #include "../common/AssimpHelpers.h"
 
 #include "../common/Shader.h"
+#include "../common/MathUtils.h"
 
 
 class Mesh;
@@ -136,6 +137,9 @@ class Mesh
     public:
         unsigned int verticesCount;
         unsigned int indicesCount;
+        // object space bounds of the vertex positions
+        MathUtils::AABB bounds;
+        MathUtils::Sphere boundingSphere;
 
         Mesh(){}
 
@@ -152,6 +156,14 @@ class Mesh
             InitBuffers(mVertices, mIndices);
         }
 
+        // Generates a default mesh straight from contiguous vertex/index arrays (e.g. a memory mapped cooked mesh file), 
+        // without building intermediate vectors
+        Mesh(const MeshData::Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+        {
+            this->flags = OP_MESH_COORDS | OP_MESH_NORMALS | OP_MESH_TANGENTS | OP_MESH_TEXCOORDS ;
+            InitBuffers(vertices, vertexCount, indices, indexCount);
+        }
+
         ~Mesh()
         {   
             glDeleteVertexArrays(1, &VAO);
@@ -225,6 +237,26 @@ class Mesh
             glBindVertexArray(0);
         }
 
+        GLuint GetVertexArray() const
+        {
+            return VAO;
+        }
+
+        GLuint GetVertexBuffer() const
+        {
+            return VBO;
+        }
+
+        GLuint GetIndexBuffer() const
+        {
+            return EBO;
+        }
+
+        unsigned int GetFlags() const
+        {
+            return flags;
+        }
+
     private:
         //Vertex + Index buffers
         GLuint VAO, VBO, EBO;
@@ -232,7 +264,13 @@ class Mesh
 
         void InitBuffers(std::vector<MeshData::Vertex> &vertices, std::vector<unsigned int> &indices)
         {
-            glGenVertexArrays(1, &VAO);
+            InitBuffers(vertices.data(), vertices.size(), indices.data(), indices.size());
+            vertices.clear();
+            indices.clear();
+        }
+
+        void InitBuffers(const MeshData::Vertex *vertices, size_t vertexCount, const unsigned int *indices, size_t indexCount)
+        {
             glGenVertexArrays(1, &VAO);
             glGenBuffers(1, &VBO);
             glGenBuffers(1, &EBO);
@@ -241,12 +279,12 @@ class Mesh
             glBindVertexArray(VAO);
             glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(MeshData::Vertex), 
-                        &vertices[0], GL_STATIC_DRAW);  
+            glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(MeshData::Vertex), 
+                        vertices, GL_STATIC_DRAW);  
 
             glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), 
-                        &indices[0], GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * sizeof(unsigned int), 
+                        indices, GL_STATIC_DRAW);
 
 
             // vertex positions
@@ -282,10 +320,28 @@ class Mesh
             
 
             glBindVertexArray(0);
-            verticesCount = vertices.size();
-            indicesCount = indices.size();
-            vertices.clear();
-            indices.clear();
+            verticesCount = vertexCount;
+            indicesCount = indexCount;
+
+            if (vertexCount > 0)
+            {
+                bounds.min = bounds.max = vertices[0].Position;
+                for (size_t i = 1; i < vertexCount; i++)
+                {
+                    bounds.min = glm::min(bounds.min, vertices[i].Position);
+                    bounds.max = glm::max(bounds.max, vertices[i].Position);
+                }
+
+                // centered on the box, which is tighter than the box corners but not minimal
+                float radius2 = 0.0f;
+                boundingSphere.center = bounds.GetCenter();
+                for (size_t i = 0; i < vertexCount; i++)
+                {
+                    glm::vec3 offset = vertices[i].Position - boundingSphere.center;
+                    radius2 = glm::max(radius2, glm::dot(offset, offset));
+                }
+                boundingSphere.radius = glm::sqrt(radius2);
+            }
         }
 
 };
@@ -6,6 +6,7 @@
 #include <memory>
 #include <glm/glm.hpp>
 #include "Mesh.h"
+#include "../gl/TextureRegistry.h"
 
 enum TextureType
 {
@@ -62,14 +63,16 @@ class MaterialInstance
         }properties;
         #pragma pack(pop)
         
+        //The textures are resolved by the Scene (see SetTextures), the template only names them
         MaterialInstance(MaterialTemplate &matTemp) 
         {
-            this->diffuseTextureNames = matTemp.diffuseTextureNames;
-            this->normalTextureNames = matTemp.normalTextureNames;
-            this->specularTextureNames = matTemp.specularTextureNames;
             this->flags = matTemp.flags;
             this->templateId = matTemp.id;
         }
+        unsigned int GetFlags() const
+        {
+            return flags;
+        }
         bool HasFlags(unsigned int tFlags)
         {
             return (flags & (int)tFlags) == (int)tFlags;
@@ -95,58 +98,54 @@ class MaterialInstance
             return templateId;
         }
 
-        unsigned int GetNumTextures(TextureType texType)
+        unsigned int GetNumTextures(TextureType texType) const
         {
-            switch (texType)
-            {
-                case OP_TEXTURE_DIFFUSE:
-                    return diffuseTextureNames.size();
-                case OP_TEXTURE_NORMAL:
-                    return normalTextureNames.size();
-                case OP_TEXTURE_SPECULAR:
-                    return specularTextureNames.size();
-                default:
-                    return 0;
-            }
+            return GetTextures(texType).size();
         }
 
-        std::string GetDiffuseMapName(unsigned int i)
+        //Returns an invalid handle when the material has less textures of that type
+        TextureHandle GetTexture(TextureType texType, unsigned int i) const
         {
-            if (i >= diffuseTextureNames.size())
-            {
-                return "";
-            }
-
-            return diffuseTextureNames[i];
+            const std::vector<TextureHandle> &textures = GetTextures(texType);
+            return i < textures.size() ? textures[i] : TextureHandle();
         }
 
-        std::string GetNormalMapName(unsigned int i)
+        const std::vector<TextureHandle> &GetTextures(TextureType texType) const
         {
-            if (i >= normalTextureNames.size())
+            switch (texType)
             {
-                return "";
+                case OP_TEXTURE_NORMAL:
+                    return normalTextures;
+                case OP_TEXTURE_SPECULAR:
+                    return specularTextures;
+                default:
+                    return diffuseTextures;
             }
-
-            return normalTextureNames[i];
         }
 
-        std::string GetSpecularMapName(unsigned int i)
+        void SetTextures(TextureType texType, std::vector<TextureHandle> &&textures)
         {
-            if (i >= specularTextureNames.size())
+            switch (texType)
             {
-                return "";
+                case OP_TEXTURE_NORMAL:
+                    normalTextures = std::move(textures);
+                    break;
+                case OP_TEXTURE_SPECULAR:
+                    specularTextures = std::move(textures);
+                    break;
+                default:
+                    diffuseTextures = std::move(textures);
+                    break;
             }
-
-            return specularTextureNames[i];
         }
 
     private:
         unsigned int flags;
         unsigned int templateId;
         unsigned int instanceId;
-        std::vector<std::string> diffuseTextureNames;
-        std::vector<std::string> normalTextureNames;
-        std::vector<std::string> specularTextureNames;
+        std::vector<TextureHandle> diffuseTextures;
+        std::vector<TextureHandle> normalTextures;
+        std::vector<TextureHandle> specularTextures;
 
 };
 
@@ -159,19 +158,4 @@ struct Texture {
     TextureType type;
 };  
 
-struct Object
-{
-    //currently each object can only have one mesh
-    std::shared_ptr<Mesh> mesh;
-    std::unique_ptr<MaterialInstance> materialInstance;
-
-    glm::mat4 objToWorld;
-
-    Object()
-    {
-    }
-};
-
-
-
 #endif
\ No newline at end of file
@@ -0,0 +1,222 @@
+#ifndef OBJECT_BVH_H
+#define OBJECT_BVH_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include "../common/MathUtils.h"
+#include "ObjectStore.h"
+
+/*
+ * Bounding volume hierarchy over the world space bounds of the objects of an ObjectStore, used to cull whole groups of
+ * objects against a frustum.
+ *
+ * The tree is built top down by splitting the objects at the median of the largest axis of their centers. Nodes are
+ * stored in depth first order (the left child follows its parent, so parents always come before their children) and the
+ * objects below any node are a contiguous range of the item array, so a node fully inside the frustum is accepted
+ * without visiting its children.
+ *
+ * Moving objects doesnt change the topology: Refit only recomputes the boxes of the leaves holding the moved objects and
+ * of their ancestors. Build has to be called again after objects are added or removed.
+ */
+
+class ObjectBVH
+{
+    public:
+        static constexpr uint32_t MAX_LEAF_SIZE = 4;
+
+        void Build(const ObjectStore &objects)
+        {
+            nodes.clear();
+            items.clear();
+            slotLeaves.clear();
+
+            size_t objectCount = objects.GetCount();
+            if (objectCount == 0)
+                return;
+
+            std::vector<uint32_t> order(objectCount);
+            for (uint32_t i = 0; i < objectCount; i++)
+                order[i] = i;
+            nodes.reserve(2 * (objectCount / MAX_LEAF_SIZE + 1));
+            BuildNode(objects, order, 0, (uint32_t)objectCount, UINT32_MAX);
+
+            items.resize(objectCount);
+            for (size_t i = 0; i < objectCount; i++)
+            {
+                items[i] = objects.GetId(order[i]);
+                if (slotLeaves.size() <= items[i].slot)
+                    slotLeaves.resize(items[i].slot + 1, UINT32_MAX);
+            }
+            for (uint32_t n = 0; n < nodes.size(); n++)
+            {
+                if (!nodes[n].IsLeaf())
+                    continue;
+                for (uint32_t i = nodes[n].first; i < nodes[n].first + nodes[n].count; i++)
+                    slotLeaves[items[i].slot] = n;
+            }
+            refitFlags.assign(nodes.size(), 0);
+        }
+
+        // Updates the boxes after the objects moved
+        void Refit(const ObjectStore &objects, const std::vector<ObjectId> &movedObjects)
+        {
+            refitNodes.clear();
+            for (ObjectId id : movedObjects)
+            {
+                if (id.slot >= slotLeaves.size())
+                    continue;
+
+                uint32_t node = slotLeaves[id.slot];
+                while (node != UINT32_MAX && !refitFlags[node])
+                {
+                    refitFlags[node] = 1;
+                    refitNodes.push_back(node);
+                    node = nodes[node].parent;
+                }
+            }
+
+            // children are stored after their parents
+            std::sort(refitNodes.begin(), refitNodes.end(), std::greater<uint32_t>());
+            const MathUtils::AABB *worldBounds = objects.GetWorldBounds();
+            for (uint32_t n : refitNodes)
+            {
+                Node &node = nodes[n];
+                if (node.IsLeaf())
+                {
+                    node.bounds = worldBounds[objects.GetIndex(items[node.first])];
+                    for (uint32_t i = node.first + 1; i < node.first + node.count; i++)
+                        node.bounds.Expand(worldBounds[objects.GetIndex(items[i])]);
+                }
+                else
+                {
+                    node.bounds = nodes[n + 1].bounds;
+                    node.bounds.Expand(nodes[node.rightChild].bounds);
+                }
+                refitFlags[n] = 0;
+            }
+        }
+
+        // Writes the (dense) indices of the objects intersecting the frustum to visibleObjects
+        void Cull(const MathUtils::Frustum &frustum, const ObjectStore &objects, std::vector<uint32_t> &visibleObjects) const
+        {
+            visibleObjects.clear();
+            if (nodes.empty())
+                return;
+
+            const MathUtils::AABB *worldBounds = objects.GetWorldBounds();
+            const MathUtils::Sphere *worldSpheres = objects.GetWorldSpheres();
+
+            struct StackEntry
+            {
+                uint32_t node;
+                uint32_t planeMask;
+            };
+            StackEntry stack[64];
+            int stackSize = 0;
+            stack[stackSize++] = {0, MathUtils::Frustum::ALL_PLANES};
+
+            while (stackSize > 0)
+            {
+                StackEntry entry = stack[--stackSize];
+                const Node &node = nodes[entry.node];
+                uint32_t planeMask = entry.planeMask;
+
+                MathUtils::FrustumTest result = frustum.Test(node.bounds, planeMask);
+                if (result == MathUtils::OP_FRUSTUM_OUTSIDE)
+                    continue;
+
+                if (result == MathUtils::OP_FRUSTUM_INSIDE)
+                {
+                    for (uint32_t i = node.first; i < node.first + node.count; i++)
+                        visibleObjects.push_back(objects.GetIndex(items[i]));
+                }
+                else if (node.IsLeaf())
+                {
+                    // the sphere rejects most objects with a cheaper test before the box
+                    for (uint32_t i = node.first; i < node.first + node.count; i++)
+                    {
+                        uint32_t index = objects.GetIndex(items[i]);
+                        uint32_t objectMask = planeMask;
+                        if (frustum.Intersects(worldSpheres[index], planeMask) && frustum.Test(worldBounds[index], objectMask) != MathUtils::OP_FRUSTUM_OUTSIDE)
+                            visibleObjects.push_back(index);
+                    }
+                }
+                else
+                {
+                    stack[stackSize++] = {node.rightChild, planeMask};
+                    stack[stackSize++] = {entry.node + 1, planeMask};
+                }
+            }
+        }
+
+        size_t GetNodeCount() const
+        {
+            return nodes.size();
+        }
+
+    private:
+        struct Node
+        {
+            MathUtils::AABB bounds;
+            // range of the items below this node
+            uint32_t first = 0;
+            uint32_t count = 0;
+            // the left child is always the next node. The root is never a right child, so 0 marks the leaves
+            uint32_t rightChild = 0;
+            uint32_t parent = UINT32_MAX;
+
+            bool IsLeaf() const { return rightChild == 0; }
+        };
+
+        std::vector<Node> nodes;
+        std::vector<ObjectId> items;
+        // leaf holding each object, indexed by ObjectId slot
+        std::vector<uint32_t> slotLeaves;
+
+        std::vector<uint8_t> refitFlags;
+        std::vector<uint32_t> refitNodes;
+
+        // order holds dense object indices and is partitioned in place. Returns the index of the new node
+        uint32_t BuildNode(const ObjectStore &objects, std::vector<uint32_t> &order, uint32_t first, uint32_t count, uint32_t parent)
+        {
+            const MathUtils::AABB *worldBounds = objects.GetWorldBounds();
+
+            uint32_t nodeIndex = (uint32_t)nodes.size();
+            nodes.emplace_back();
+            nodes[nodeIndex].first = first;
+            nodes[nodeIndex].count = count;
+            nodes[nodeIndex].parent = parent;
+
+            MathUtils::AABB bounds = worldBounds[order[first]];
+            MathUtils::AABB centers = {bounds.GetCenter(), bounds.GetCenter()};
+            for (uint32_t i = first + 1; i < first + count; i++)
+            {
+                bounds.Expand(worldBounds[order[i]]);
+                glm::vec3 center = worldBounds[order[i]].GetCenter();
+                centers.min = glm::min(centers.min, center);
+                centers.max = glm::max(centers.max, center);
+            }
+            nodes[nodeIndex].bounds = bounds;
+
+            if (count <= MAX_LEAF_SIZE)
+                return nodeIndex;
+
+            glm::vec3 size = centers.max - centers.min;
+            int axis = (size.x > size.y && size.x > size.z) ? 0 : (size.y > size.z ? 1 : 2);
+
+            uint32_t leftCount = count / 2;
+            std::nth_element(order.begin() + first, order.begin() + first + leftCount, order.begin() + first + count, [&](uint32_t a, uint32_t b){
+                return worldBounds[a].min[axis] + worldBounds[a].max[axis] < worldBounds[b].min[axis] + worldBounds[b].max[axis];
+            });
+
+            BuildNode(objects, order, first, leftCount, nodeIndex);
+            uint32_t rightChild = BuildNode(objects, order, first + leftCount, count - leftCount, nodeIndex);
+            nodes[nodeIndex].rightChild = rightChild;
+            return nodeIndex;
+        }
+};
+
+#endif
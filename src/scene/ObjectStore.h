@@ -0,0 +1,206 @@
+#ifndef OBJECT_STORE_H
+#define OBJECT_STORE_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "../common/MathUtils.h"
+#include "../common/CullingKernel.h"
+#include "TransformGraph.h"
+
+/*
+ * Storage for the objects of a scene. Every component lives in its own contiguous array (SoA) and the arrays are kept
+ * dense: removing an object moves the last one into its place, so iterating all objects is a linear scan over
+ * [0, GetCount()).
+ *
+ * Objects are referenced from the outside (lights, parsers, ...) by an ObjectId, which stays valid while the object
+ * exists no matter how the dense arrays are reordered. Ids are generational: once an object is removed its id is never
+ * resolved again, even if the slot is reused.
+ *
+ * The transform of an object is a copy of the world transform of its node on the scene TransformGraph, updated by the
+ * Scene when the node changes. Its inverse is kept along with it, so static objects never invert it again.
+ */
+
+enum ObjectFlags
+{
+    OP_OBJECT_DEFAULT = 0,
+    OP_OBJECT_UNLIT = 1 << 0,         // the object is not lit and doesnt cast shadows (e.g. light sources)
+    OP_OBJECT_TRANSPARENT = 1 << 1
+};
+
+// mesh and material handles index the mesh and material tables of the Scene
+typedef uint32_t MeshHandle;
+typedef uint32_t MaterialHandle;
+
+struct ObjectId
+{
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool IsValid() const { return slot != UINT32_MAX; }
+    bool operator == (const ObjectId &other) const { return slot == other.slot && generation == other.generation; }
+    bool operator != (const ObjectId &other) const { return !(*this == other); }
+};
+
+class ObjectStore
+{
+    public:
+        ObjectId Add(MeshHandle mesh, MaterialHandle material, TransformId node, const glm::mat4 &objToWorld, const MathUtils::AABB &localBounds, const MathUtils::Sphere &localSphere, uint32_t flags,
+                     uint32_t instanceGroup = 0)
+        {
+            ObjectId id;
+            if (!freeSlots.empty())
+            {
+                id.slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+            else
+            {
+                id.slot = (uint32_t)slotToDense.size();
+                slotToDense.push_back(0);
+                slotGenerations.push_back(0);
+            }
+            id.generation = slotGenerations[id.slot];
+            slotToDense[id.slot] = (uint32_t)denseToSlot.size();
+
+            denseToSlot.push_back(id.slot);
+            transforms.push_back(objToWorld);
+            inverseTransforms.push_back(glm::inverse(objToWorld));
+            nodes.push_back(node);
+            meshes.push_back(mesh);
+            materials.push_back(material);
+            this->localBounds.push_back(localBounds);
+            worldBounds.push_back(localBounds.Transform(objToWorld));
+            this->localSpheres.push_back(localSphere);
+            worldSpheres.push_back(localSphere.Transform(objToWorld));
+            cullBounds.Push(worldBounds.back(), worldSpheres.back());
+            this->flags.push_back(flags);
+            instanceGroups.push_back(instanceGroup);
+            return id;
+        }
+
+        void Remove(ObjectId id)
+        {
+            assert(IsAlive(id));
+            uint32_t index = slotToDense[id.slot];
+            uint32_t last = (uint32_t)denseToSlot.size() - 1;
+
+            if (index != last)
+            {
+                denseToSlot[index] = denseToSlot[last];
+                transforms[index] = transforms[last];
+                inverseTransforms[index] = inverseTransforms[last];
+                nodes[index] = nodes[last];
+                meshes[index] = meshes[last];
+                materials[index] = materials[last];
+                localBounds[index] = localBounds[last];
+                worldBounds[index] = worldBounds[last];
+                localSpheres[index] = localSpheres[last];
+                worldSpheres[index] = worldSpheres[last];
+                cullBounds.Copy(last, index);
+                flags[index] = flags[last];
+                instanceGroups[index] = instanceGroups[last];
+                slotToDense[denseToSlot[index]] = index;
+            }
+
+            denseToSlot.pop_back();
+            transforms.pop_back();
+            inverseTransforms.pop_back();
+            nodes.pop_back();
+            meshes.pop_back();
+            materials.pop_back();
+            localBounds.pop_back();
+            worldBounds.pop_back();
+            localSpheres.pop_back();
+            worldSpheres.pop_back();
+            cullBounds.PopBack();
+            flags.pop_back();
+            instanceGroups.pop_back();
+
+            slotGenerations[id.slot]++;
+            freeSlots.push_back(id.slot);
+        }
+
+        bool IsAlive(ObjectId id) const
+        {
+            return id.slot < slotGenerations.size() && slotGenerations[id.slot] == id.generation && slotToDense[id.slot] < denseToSlot.size()
+                   && denseToSlot[slotToDense[id.slot]] == id.slot;
+        }
+
+        // position of the object on the dense arrays. Only valid until the next removal
+        uint32_t GetIndex(ObjectId id) const
+        {
+            assert(IsAlive(id));
+            return slotToDense[id.slot];
+        }
+
+        ObjectId GetId(uint32_t index) const
+        {
+            ObjectId id;
+            id.slot = denseToSlot[index];
+            id.generation = slotGenerations[id.slot];
+            return id;
+        }
+
+        size_t GetCount() const
+        {
+            return denseToSlot.size();
+        }
+
+        void SetTransform(ObjectId id, const glm::mat4 &objToWorld)
+        {
+            uint32_t index = GetIndex(id);
+            transforms[index] = objToWorld;
+            inverseTransforms[index] = glm::inverse(objToWorld);
+            worldBounds[index] = localBounds[index].Transform(objToWorld);
+            worldSpheres[index] = localSpheres[index].Transform(objToWorld);
+            cullBounds.Set(index, worldBounds[index], worldSpheres[index]);
+        }
+
+        const glm::mat4 &GetTransform(ObjectId id) const { return transforms[GetIndex(id)]; }
+        TransformId GetNode(ObjectId id) const { return nodes[GetIndex(id)]; }
+        MaterialHandle GetMaterial(ObjectId id) const { return materials[GetIndex(id)]; }
+        uint32_t GetFlags(ObjectId id) const { return flags[GetIndex(id)]; }
+
+        void AddFlags(ObjectId id, uint32_t addedFlags)
+        {
+            flags[GetIndex(id)] |= addedFlags;
+        }
+
+        // Dense component arrays, indexed from 0 to GetCount() - 1
+        const glm::mat4 *GetTransforms() const { return transforms.data(); }
+        const glm::mat4 *GetInverseTransforms() const { return inverseTransforms.data(); }
+        const MeshHandle *GetMeshes() const { return meshes.data(); }
+        const MaterialHandle *GetMaterials() const { return materials.data(); }
+        const MathUtils::AABB *GetWorldBounds() const { return worldBounds.data(); }
+        const MathUtils::Sphere *GetWorldSpheres() const { return worldSpheres.data(); }
+        // world bounds again, as SoA float arrays for the SIMD culling kernel
+        const CullingKernel::BoundsSoA &GetCullBounds() const { return cullBounds; }
+        const uint32_t *GetFlags() const { return flags.data(); }
+        // objects of the same group share mesh, material template and material flags, and can be drawn instanced
+        const uint32_t *GetInstanceGroups() const { return instanceGroups.data(); }
+
+    private:
+        // sparse slot -> dense index (and back), with the generation of the object currently using each slot
+        std::vector<uint32_t> slotToDense;
+        std::vector<uint32_t> slotGenerations;
+        std::vector<uint32_t> freeSlots;
+        std::vector<uint32_t> denseToSlot;
+
+        std::vector<glm::mat4> transforms;
+        std::vector<glm::mat4> inverseTransforms;
+        std::vector<TransformId> nodes;
+        std::vector<MeshHandle> meshes;
+        std::vector<MaterialHandle> materials;
+        std::vector<MathUtils::AABB> localBounds;
+        std::vector<MathUtils::AABB> worldBounds;
+        std::vector<MathUtils::Sphere> localSpheres;
+        std::vector<MathUtils::Sphere> worldSpheres;
+        CullingKernel::BoundsSoA cullBounds;
+        std::vector<uint32_t> flags;
+        std::vector<uint32_t> instanceGroups;
+};
+
+#endif
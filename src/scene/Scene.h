@@ -5,8 +5,10 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <map>
+#include <tuple>
 #include <memory>
-#include <functional>
+#include <type_traits>
 
 
 #include <glm/gtx/string_cast.hpp>
@@ -14,10 +16,14 @@
 #include "../common/Shader.h"
 #include "Mesh.h"
 #include "Object.h"
+#include "ObjectStore.h"
+#include "ObjectBVH.h"
+#include "GeometryHeap.h"
 #include "lights.h"
 
 #include "env.h"
 #include "../gl/Texture.h"
+#include "../gl/TextureRegistry.h"
 
 
 
@@ -34,50 +40,254 @@ class Scene
         int MAX_DIR_LIGHTS;
         int MAX_POINT_LIGHTS;
 
+        // from this many objects, culling several frustums sweeps the flat object list with the SIMD kernel instead of
+        // walking the BVH once per frustum
+        static constexpr size_t FLAT_CULL_OBJECT_COUNT = 16384;
+
         Scene()
         {
 
         }
 
-        using ObjectCallback = std::function<void(glm::mat4 objectToWorld, std::unique_ptr<MaterialInstance> &materialInstance, std::shared_ptr<Mesh> mesh, unsigned int verticesCount, unsigned int indicesCount)>;
-        void IterateObjects(ObjectCallback objectCallback)
+        // Calls visitor(const glm::mat4 &objectToWorld, MaterialInstance &materialInstance, Mesh &mesh) for every object,
+        // in storage order. The visitor is inlined into the scan, so there is no indirect call or refcounting per object
+        template<typename Visitor>
+        void ForEachObject(Visitor &&visitor)
+        {
+            const glm::mat4 *transforms = objects.GetTransforms();
+            const MeshHandle *meshHandles = objects.GetMeshes();
+            const MaterialHandle *materialHandles = objects.GetMaterials();
+            size_t objectCount = objects.GetCount();
+
+            for (size_t i = 0; i < objectCount; i++)
+            {
+                visitor(transforms[i], materials[materialHandles[i]], *meshes[meshHandles[i]]);
+            }
+        }
+
+        // Same as above, only for the objects listed on objectIndices (e.g. the output of CullObjects). A visitor taking
+        // the object index first, visitor(uint32_t object, const glm::mat4 &, MaterialInstance &, Mesh &), also gets the
+        // index (e.g. to read per object arrays such as the normal matrices)
+        template<typename Visitor>
+        void ForEachObject(const std::vector<uint32_t> &objectIndices, Visitor &&visitor)
+        {
+            const glm::mat4 *transforms = objects.GetTransforms();
+            const MeshHandle *meshHandles = objects.GetMeshes();
+            const MaterialHandle *materialHandles = objects.GetMaterials();
+
+            for (uint32_t i : objectIndices)
+            {
+                if constexpr (std::is_invocable_v<Visitor&, uint32_t, const glm::mat4&, MaterialInstance&, Mesh&>)
+                    visitor(i, transforms[i], materials[materialHandles[i]], *meshes[meshHandles[i]]);
+                else
+                    visitor(transforms[i], materials[materialHandles[i]], *meshes[meshHandles[i]]);
+            }
+        }
+
+        // Writes the indices of the objects intersecting the frustum to visibleObjects
+        void CullObjects(const MathUtils::Frustum &frustum, std::vector<uint32_t> &visibleObjects)
+        {
+            if (bvhOutdated)
+            {
+                objectBVH.Build(objects);
+                bvhOutdated = false;
+            }
+            objectBVH.Cull(frustum, objects, visibleObjects);
+        }
+
+        // Culls several frustums at once (e.g. the camera and the shadow cascades): visibleLists[i] receives the indices
+        // of the objects intersecting frustums[i]
+        void CullObjects(const MathUtils::Frustum *frustums, unsigned int frustumCount, std::vector<uint32_t> *visibleLists)
         {
-           
-            for (auto &object : objects)
+            if (objects.GetCount() < FLAT_CULL_OBJECT_COUNT || frustumCount > CullingKernel::MAX_VIEWS)
             {
-                objectCallback(object->objToWorld, object->materialInstance, object->mesh, object->mesh->verticesCount, object->mesh->indicesCount);
+                for (unsigned int i = 0; i < frustumCount; i++)
+                    CullObjects(frustums[i], visibleLists[i]);
+                return;
             }
+            flatCuller.Cull(objects.GetCullBounds(), frustums, frustumCount, visibleLists);
         }
 
-        bool HasTexture(const std::string &path)
+        bool HasTexture(const std::string &name) const
         {
-            return loadedTextures.find(path) != loadedTextures.end();
+            return textures.Find(name).IsValid();
         }
 
-        Texture2D &GetTexture(const std::string &path)
+        Texture2D &GetTexture(TextureHandle handle)
         {   
-            return loadedTextures.at(path);
+            return textures.Get(handle);
         }
 
-        void AddTexture(std::string path, Texture2D &&texture)
+        TextureRegistry &GetTextures()
         {
-            loadedTextures.emplace(path, std::move(texture));
+            return textures;
         }
 
-        std::shared_ptr<Object> AddObject(std::shared_ptr<Mesh> mesh, glm::mat4 objToWorld, MaterialInstance::MaterialProperties materialProperties, MaterialTemplate materialTemplate, unsigned int materialOverrideFlags)
+        size_t GetTextureMemorySize() const
         {
-            Object* newObject = new Object();
-            newObject->mesh = mesh;
-            newObject->materialInstance = std::make_unique<MaterialInstance>(materialTemplate);
-            newObject->materialInstance->AddFlags(materialOverrideFlags);
+            return textures.GetResidentMemory();
+        }
+
+        //Registers a texture loaded from path under the name used by the material templates
+        TextureHandle AddTexture(const std::string &name, const std::string &path, TextureUsage usage, Texture2D &&texture)
+        {
+            return textures.Add(name, path, usage, std::move(texture));
+        }
+
+        //Uploader streaming the scene textures (set by the SceneParser), or null when they are uploaded synchronously
+        void SetTextureUploader(const TextureUploadService *uploader)
+        {
+            textureUploader = uploader;
+        }
+
+        //Returns false while the texture contents are still being streamed to the GPU
+        bool IsTextureResident(TextureHandle handle) const
+        {
+            return textureUploader == nullptr || textures.Get(handle).IsResident(*textureUploader);
+        }
+
+        //Adds an object placed by a node of the transform graph
+        ObjectId AddObject(std::shared_ptr<Mesh> mesh, TransformId transform, MaterialInstance::MaterialProperties materialProperties, MaterialTemplate materialTemplate, unsigned int materialOverrideFlags)
+        {
+            MaterialHandle material = (MaterialHandle)materials.size();
+            materials.emplace_back(materialTemplate);
+            materials.back().AddFlags(materialOverrideFlags);
+            ResolveTextures(materials.back(), materialTemplate);
 
             //Material properties:
-            newObject->materialInstance->properties = materialProperties;
-            
-            
-            newObject->objToWorld = objToWorld;
-            objects.emplace_back(newObject);
-            return objects[objects.size()-1];
+            materials.back().properties = materialProperties;
+            materialTextureSets.push_back(AddTextureSet(materials.back()));
+
+            uint32_t flags = materials.back().HasFlag(OP_MATERIAL_UNLIT) ? OP_OBJECT_UNLIT : OP_OBJECT_DEFAULT;
+            MeshHandle meshHandle = AddMesh(mesh);
+            uint32_t instanceGroup = AddInstanceGroup(meshHandle, materials.back());
+            ObjectId id = objects.Add(meshHandle, material, transform, transformGraph.GetWorldTransform(transform), mesh->bounds, mesh->boundingSphere, flags, instanceGroup);
+            bvhOutdated = true;
+
+            if (nodeObjects.size() <= transform.index)
+                nodeObjects.resize(transform.index + 1);
+            nodeObjects[transform.index] = id;
+            return id;
+        }
+
+        //Adds an object on a new root node of the transform graph
+        ObjectId AddObject(std::shared_ptr<Mesh> mesh, glm::mat4 objToWorld, MaterialInstance::MaterialProperties materialProperties, MaterialTemplate materialTemplate, unsigned int materialOverrideFlags)
+        {
+            return AddObject(mesh, transformGraph.Add(objToWorld), materialProperties, materialTemplate, materialOverrideFlags);
+        }
+
+        //Adds a node to the transform graph. Nodes without an object can be used to group objects
+        TransformId AddTransform(const glm::mat4 &localTransform, TransformId parent = TransformId())
+        {
+            return transformGraph.Add(localTransform, parent);
+        }
+
+        //Moves a node (and everything below it) on the next Update
+        void SetLocalTransform(TransformId transform, const glm::mat4 &localTransform)
+        {
+            transformGraph.SetLocalTransform(transform, localTransform);
+        }
+
+        TransformGraph &GetTransformGraph()
+        {
+            return transformGraph;
+        }
+
+        //Propagates the transform changes to the objects. Called once per frame before rendering
+        void Update()
+        {
+            changedObjects.clear();
+            transformGraph.Update();
+
+            for (TransformId node : transformGraph.GetChangedNodes())
+            {
+                if (node.index >= nodeObjects.size() || !objects.IsAlive(nodeObjects[node.index]))
+                    continue;
+
+                objects.SetTransform(nodeObjects[node.index], transformGraph.GetWorldTransform(node));
+                changedObjects.push_back(nodeObjects[node.index]);
+            }
+
+            if (bvhOutdated)
+            {
+                objectBVH.Build(objects);
+                bvhOutdated = false;
+            }
+            else
+            {
+                objectBVH.Refit(objects, changedObjects);
+            }
+        }
+
+        //Objects whose transform changed on the last Update (including the objects added since the previous one), so that
+        //dependent caches (shadows, voxels, GPU buffers) can be updated incrementally
+        const std::vector<ObjectId> &GetChangedObjects() const
+        {
+            return changedObjects;
+        }
+
+        //Registers the mesh on the mesh table (once per mesh) and copies it into the geometry heap
+        MeshHandle AddMesh(const std::shared_ptr<Mesh> &mesh)
+        {
+            auto handle = meshHandles.find(mesh.get());
+            if (handle != meshHandles.end())
+                return handle->second;
+
+            MeshHandle newHandle = (MeshHandle)meshes.size();
+            meshes.push_back(mesh);
+            meshRanges.push_back(geometry.Add(*mesh));
+            meshHandles.emplace(mesh.get(), newHandle);
+            return newHandle;
+        }
+
+        //Number of distinct (mesh, material template, material flags) combinations among the objects added so far. Objects
+        //of the same instance group only differ on their transform and material properties, so they can be drawn instanced
+        size_t GetInstanceGroupCount() const
+        {
+            return instanceGroupIds.size();
+        }
+
+        //Shared buffers holding the meshes with the default vertex layout, for multi draws
+        const GeometryHeap &GetGeometry() const
+        {
+            return geometry;
+        }
+
+        //Range of the mesh in the geometry heap, invalid if the mesh isnt in it
+        const GeometryRange &GetMeshRange(MeshHandle handle) const
+        {
+            return meshRanges[handle];
+        }
+
+        ObjectStore &GetObjects()
+        {
+            return objects;
+        }
+
+        const ObjectStore &GetObjects() const
+        {
+            return objects;
+        }
+
+        Mesh &GetMesh(MeshHandle handle)
+        {
+            return *meshes[handle];
+        }
+
+        MaterialInstance &GetMaterial(MaterialHandle handle)
+        {
+            return materials[handle];
+        }
+
+        size_t GetMaterialCount() const
+        {
+            return materials.size();
+        }
+
+        //Materials binding the same textures share a texture set id (used to sort draws and skip redundant binds)
+        uint32_t GetTextureSet(MaterialHandle handle) const
+        {
+            return materialTextureSets[handle];
         }
 
         //Adds an ambient light to the scene
@@ -86,12 +296,12 @@ class Scene
             ambientLight = color;
         }
         //Adds a directional light to the scene
-        void AddLight(glm::vec3 direction, glm::vec3 color, std::shared_ptr<Object> boundObject)
+        void AddLight(glm::vec3 direction, glm::vec3 color, ObjectId boundObject)
         {
             directionalLights.emplace_back(direction,color,boundObject);
         }
         //Adds a point light to the scene
-        void AddLight(glm::vec3 color, float constant,float linear, float quadratic, std::shared_ptr<Object> boundObject)
+        void AddLight(glm::vec3 color, float constant,float linear, float quadratic, ObjectId boundObject)
         {
             pointLights.emplace_back(color,constant,linear,quadratic,boundObject);
         }
@@ -109,7 +319,7 @@ class Scene
                 {
                     break;
                 }
-                auto lightData = directionalLights[i].GetLightData();
+                auto lightData = directionalLights[i].GetLightData(objects.GetTransform(directionalLights[i].GetObject()));
                 lightData.lightDirection = viewMatrix * lightData.lightDirection;
                 gLightData.directionalLights.push_back(lightData);
             }
@@ -121,7 +331,7 @@ class Scene
                 {
                     break;
                 }
-                auto lightData = pointLights[i].GetLightData();
+                auto lightData = pointLights[i].GetLightData(objects.GetTransform(pointLights[i].GetObject()));
                 lightData.position = viewMatrix * lightData.position;
                 gLightData.pointLights.push_back(lightData);
             }
@@ -142,16 +352,71 @@ class Scene
 
      
     private:
-        //maps texture (file) paths to each texture object
-        //std::unordered_map<std::string, Texture> loadedTextures;
+        //textures loaded from files, referenced by the materials through handles
+        TextureRegistry textures;
+        const TextureUploadService *textureUploader = nullptr;
+
+
+        ObjectStore objects;
+        TransformGraph transformGraph;
+        //object placed by each node of the transform graph (if any)
+        std::vector<ObjectId> nodeObjects;
+        std::vector<ObjectId> changedObjects;
+        //rebuilt when objects are added, refit when they move
+        ObjectBVH objectBVH;
+        bool bvhOutdated = true;
+        CullingKernel::MultiViewCuller flatCuller;
+
+        //meshes and materials referenced by the objects
+        std::vector<std::shared_ptr<Mesh>> meshes;
+        std::unordered_map<const Mesh*, MeshHandle> meshHandles;
+        GeometryHeap geometry;
+        std::vector<GeometryRange> meshRanges;
+        std::vector<MaterialInstance> materials;
+        std::vector<uint32_t> materialTextureSets;
+        std::unordered_map<std::string, uint32_t> textureSetIds;
+        //(mesh, material template, material flags, texture set) -> instance group
+        std::map<std::tuple<MeshHandle, unsigned int, unsigned int, uint32_t>, uint32_t> instanceGroupIds;
+
+        uint32_t AddInstanceGroup(MeshHandle mesh, MaterialInstance &material)
+        {
+            auto key = std::make_tuple(mesh, material.TemplateId(), material.GetFlags(), materialTextureSets.back());
+            return instanceGroupIds.emplace(key, (uint32_t)instanceGroupIds.size()).first->second;
+        }
 
-        //Currently this would not support dynamic scene loading and unloading as the texture IDs would still exist inside the MaterialInstance after deletion
-        //Instead, PASS TEXTURE HANDLES ARROUND
-        //REPLACE WITH  Pool<Texture>
-        std::unordered_map<std::string, Texture2D> loadedTextures;
+        uint32_t AddTextureSet(MaterialInstance &material)
+        {
+            std::string key;
+            for (TextureType type : {OP_TEXTURE_DIFFUSE, OP_TEXTURE_NORMAL, OP_TEXTURE_SPECULAR})
+            {
+                for (TextureHandle texture : material.GetTextures(type))
+                    key += std::to_string(texture.slot) + ':' + std::to_string(texture.generation) + ',';
+                key += '|';
+            }
+            return textureSetIds.emplace(key, (uint32_t)textureSetIds.size()).first->second;
+        }
 
+        //Resolves the texture names of the template to handles, once per material. Each material holds a reference to
+        //its textures. Names that werent loaded are skipped
+        void ResolveTextures(MaterialInstance &material, const MaterialTemplate &materialTemplate)
+        {
+            const std::vector<std::string> *names[] = {&materialTemplate.diffuseTextureNames, &materialTemplate.normalTextureNames, &materialTemplate.specularTextureNames};
+            const TextureType types[] = {OP_TEXTURE_DIFFUSE, OP_TEXTURE_NORMAL, OP_TEXTURE_SPECULAR};
 
-        std::vector<std::shared_ptr<Object>> objects;
+            for (unsigned int t = 0; t < 3; t++)
+            {
+                std::vector<TextureHandle> handles;
+                for (const std::string &name : *names[t])
+                {
+                    TextureHandle handle = textures.Find(name);
+                    if (!handle.IsValid())
+                        continue;
+                    textures.AddReference(handle);
+                    handles.push_back(handle);
+                }
+                material.SetTextures(types[t], std::move(handles));
+            }
+        }
 
 
         glm::vec4 ambientLight = glm::vec4(0);
@@ -0,0 +1,484 @@
+#ifndef SCENE_CACHE_H
+#define SCENE_CACHE_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <glm/glm.hpp>
+
+#ifdef _WIN32
+    #ifndef NOMINMAX
+        #define NOMINMAX
+    #endif
+    #ifndef WIN32_LEAN_AND_MEAN
+        #define WIN32_LEAN_AND_MEAN
+    #endif
+    #include <windows.h>
+#else
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
+#include "../common/Hashing.h"
+#include "Mesh.h"
+#include "Object.h"
+
+// Cooked mesh files store the final output of the assimp import (vertex/index arrays, the node transforms of each
+// submesh and the material templates) so that the scene parser can skip assimp entirely on warm starts.
+// The file is meant to be memory mapped and used in place: the header and record tables are plain structs and
+// every vertex/index array is stored contiguously, aligned to COOKED_DATA_ALIGNMENT, so that it can be
+// passed straight to glBufferData.
+//
+// Layout:
+//  [FileHeader][MaterialRecord * materialCount][MeshRecord * meshCount][NameRecord * nameCount][string table]
+//  [vertex/index data]
+//
+// The file is invalidated when the format version, the vertex layout or the hash of the source files changes.
+
+#define COOKED_MESH_EXTENSION ".opmesh"
+
+namespace SceneCache
+{
+    static constexpr uint32_t COOKED_MESH_MAGIC = 0x4D504F43; // "COPM"
+    static constexpr uint32_t COOKED_MESH_VERSION = 2;
+    static constexpr uint64_t COOKED_DATA_ALIGNMENT = 16;
+
+    // Hashes the contents of the mesh file and, for .obj files, of every material library it references
+    inline uint64_t HashSourceFiles(const std::string &meshFile)
+    {
+        std::string contents;
+        if (!Hashing::ReadWholeFile(meshFile, contents))
+            return 0;
+
+        uint64_t hash = Hashing::HashBytes(contents.data(), contents.size());
+
+        std::string directory = meshFile.substr(0, meshFile.find_last_of('/'));
+        size_t lineStart = 0;
+        while (lineStart < contents.size())
+        {
+            size_t lineEnd = contents.find('\n', lineStart);
+            if (lineEnd == std::string::npos)
+                lineEnd = contents.size();
+
+            if (contents.compare(lineStart, 7, "mtllib ") == 0)
+            {
+                std::string libName = contents.substr(lineStart + 7, lineEnd - lineStart - 7);
+                while (!libName.empty() && (libName.back() == '\r' || libName.back() == ' '))
+                    libName.pop_back();
+
+                std::string libContents;
+                if (Hashing::ReadWholeFile(directory + '/' + libName, libContents))
+                    hash = Hashing::HashBytes(libContents.data(), libContents.size(), hash);
+            }
+            lineStart = lineEnd + 1;
+        }
+
+        return hash;
+    }
+
+
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t sourceHash;
+        uint32_t vertexSize;
+        uint32_t materialCount;
+        uint32_t meshCount;
+        uint32_t nameCount;
+        uint64_t materialsOffset;
+        uint64_t meshesOffset;
+        uint64_t namesOffset;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint64_t fileSize;
+    };
+
+    // texture names are stored sequentially starting at firstName: diffuse, normal, then specular
+    struct MaterialRecord
+    {
+        uint32_t flags;
+        uint32_t firstName;
+        uint32_t diffuseCount;
+        uint32_t normalCount;
+        uint32_t specularCount;
+    };
+
+    struct MeshRecord
+    {
+        glm::mat4 localTransform;
+        uint32_t materialIndex;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t padding;
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+    };
+
+    struct NameRecord
+    {
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    // Points into the cooked file. Only valid while the owning CookedMeshFile is alive
+    struct SubMeshView
+    {
+        glm::mat4 localTransform;
+        unsigned int materialIndex;
+        const MeshData::Vertex *vertices;
+        size_t vertexCount;
+        const unsigned int *indices;
+        size_t indexCount;
+    };
+
+
+
+    // Read only view of a cooked mesh file. The contents can either be memory mapped from disk or owned
+    // (when the file was just cooked)
+    class CookedMeshFile
+    {
+        public:
+            CookedMeshFile(const CookedMeshFile&) = delete;
+            CookedMeshFile& operator=(const CookedMeshFile&) = delete;
+
+            ~CookedMeshFile()
+            {
+                Unmap();
+            }
+
+            // Returns nullptr if the file doesnt exist or is stale
+            static std::unique_ptr<CookedMeshFile> Open(const std::string &path, uint64_t expectedHash)
+            {
+                std::unique_ptr<CookedMeshFile> file(new CookedMeshFile());
+                if (!file->Map(path))
+                    return nullptr;
+
+                if (!file->Validate(expectedHash))
+                    return nullptr;
+
+                return file;
+            }
+
+            static std::unique_ptr<CookedMeshFile> FromMemory(std::vector<char> &&blob)
+            {
+                std::unique_ptr<CookedMeshFile> file(new CookedMeshFile());
+                file->ownedData = std::move(blob);
+                file->data = file->ownedData.data();
+                file->size = file->ownedData.size();
+
+                if (!file->Validate(file->Header().sourceHash))
+                    return nullptr;
+
+                return file;
+            }
+
+            bool WriteToFile(const std::string &path) const
+            {
+                std::ofstream output(path, std::ios::binary | std::ios::trunc);
+                if (!output.is_open())
+                {
+                    std::cout << "Failed to write cooked mesh file: " << path << "\n";
+                    return false;
+                }
+                output.write(data, size);
+                return output.good();
+            }
+
+            const FileHeader &Header() const
+            {
+                return *reinterpret_cast<const FileHeader*>(data);
+            }
+
+            unsigned int GetMeshCount() const { return Header().meshCount; }
+            unsigned int GetMaterialCount() const { return Header().materialCount; }
+            size_t GetSize() const { return size; }
+            bool IsMapped() const { return mappedData != nullptr; }
+
+            SubMeshView GetMesh(unsigned int index) const
+            {
+                const MeshRecord &record = reinterpret_cast<const MeshRecord*>(data + Header().meshesOffset)[index];
+
+                SubMeshView view;
+                view.localTransform = record.localTransform;
+                view.materialIndex = record.materialIndex;
+                view.vertices = reinterpret_cast<const MeshData::Vertex*>(data + record.vertexOffset);
+                view.vertexCount = record.vertexCount;
+                view.indices = reinterpret_cast<const unsigned int*>(data + record.indexOffset);
+                view.indexCount = record.indexCount;
+                return view;
+            }
+
+            // the returned template has no id assigned
+            MaterialTemplate GetMaterial(unsigned int index) const
+            {
+                const MaterialRecord &record = reinterpret_cast<const MaterialRecord*>(data + Header().materialsOffset)[index];
+
+                MaterialTemplate material = MaterialTemplate(record.flags);
+                uint32_t name = record.firstName;
+                for (uint32_t i = 0; i < record.diffuseCount; i++)
+                    material.diffuseTextureNames.push_back(GetName(name++));
+                for (uint32_t i = 0; i < record.normalCount; i++)
+                    material.normalTextureNames.push_back(GetName(name++));
+                for (uint32_t i = 0; i < record.specularCount; i++)
+                    material.specularTextureNames.push_back(GetName(name++));
+
+                return material;
+            }
+
+        private:
+            const char *data = nullptr;
+            size_t size = 0;
+
+            std::vector<char> ownedData;
+            void *mappedData = nullptr;
+            #ifdef _WIN32
+                HANDLE fileHandle = INVALID_HANDLE_VALUE;
+                HANDLE mappingHandle = NULL;
+            #endif
+
+            CookedMeshFile(){}
+
+            std::string GetName(uint32_t index) const
+            {
+                const NameRecord &record = reinterpret_cast<const NameRecord*>(data + Header().namesOffset)[index];
+                return std::string(data + Header().stringsOffset + record.offset, record.length);
+            }
+
+            bool Validate(uint64_t expectedHash) const
+            {
+                if (size < sizeof(FileHeader))
+                    return false;
+
+                const FileHeader &header = Header();
+                if (header.magic != COOKED_MESH_MAGIC || header.version != COOKED_MESH_VERSION)
+                    return false;
+                if (header.vertexSize != sizeof(MeshData::Vertex) || header.fileSize != size)
+                    return false;
+                if (header.sourceHash != expectedHash)
+                    return false;
+
+                if (header.materialsOffset + (uint64_t)header.materialCount * sizeof(MaterialRecord) > size ||
+                    header.meshesOffset + (uint64_t)header.meshCount * sizeof(MeshRecord) > size ||
+                    header.namesOffset + (uint64_t)header.nameCount * sizeof(NameRecord) > size ||
+                    header.stringsOffset + header.stringsSize > size)
+                    return false;
+
+                // every name has to be inside the string table and every material name inside the name records
+                const NameRecord *names = reinterpret_cast<const NameRecord*>(data + header.namesOffset);
+                for (uint32_t i = 0; i < header.nameCount; i++)
+                {
+                    if ((uint64_t)names[i].offset + names[i].length > header.stringsSize)
+                        return false;
+                }
+
+                const MaterialRecord *materials = reinterpret_cast<const MaterialRecord*>(data + header.materialsOffset);
+                for (uint32_t i = 0; i < header.materialCount; i++)
+                {
+                    if ((uint64_t)materials[i].firstName + materials[i].diffuseCount + materials[i].normalCount +
+                        materials[i].specularCount > header.nameCount)
+                        return false;
+                }
+
+                const MeshRecord *meshes = reinterpret_cast<const MeshRecord*>(data + header.meshesOffset);
+                for (uint32_t i = 0; i < header.meshCount; i++)
+                {
+                    if (meshes[i].materialIndex >= header.materialCount ||
+                        meshes[i].vertexOffset + (uint64_t)meshes[i].vertexCount * sizeof(MeshData::Vertex) > size ||
+                        meshes[i].indexOffset + (uint64_t)meshes[i].indexCount * sizeof(unsigned int) > size)
+                        return false;
+                }
+
+                return true;
+            }
+
+            bool Map(const std::string &path)
+            {
+                #ifdef _WIN32
+                    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+                    if (fileHandle == INVALID_HANDLE_VALUE)
+                        return false;
+
+                    LARGE_INTEGER fileSize;
+                    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+                        return false;
+
+                    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+                    if (mappingHandle == NULL)
+                        return false;
+
+                    mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+                    if (mappedData == nullptr)
+                        return false;
+
+                    size = (size_t)fileSize.QuadPart;
+                #else
+                    int fd = open(path.c_str(), O_RDONLY);
+                    if (fd < 0)
+                        return false;
+
+                    struct stat fileStat;
+                    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+                    {
+                        close(fd);
+                        return false;
+                    }
+
+                    void *mapping = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                    close(fd);
+                    if (mapping == MAP_FAILED)
+                        return false;
+
+                    mappedData = mapping;
+                    size = (size_t)fileStat.st_size;
+                #endif
+
+                data = static_cast<const char*>(mappedData);
+                return true;
+            }
+
+            void Unmap()
+            {
+                #ifdef _WIN32
+                    if (mappedData != nullptr)
+                        UnmapViewOfFile(mappedData);
+                    if (mappingHandle != NULL)
+                        CloseHandle(mappingHandle);
+                    if (fileHandle != INVALID_HANDLE_VALUE)
+                        CloseHandle(fileHandle);
+                #else
+                    if (mappedData != nullptr)
+                        munmap(mappedData, size);
+                #endif
+                mappedData = nullptr;
+                data = nullptr;
+            }
+    };
+
+
+
+    // Collects the imported data and serializes it into the cooked format
+    class MeshFileCooker
+    {
+        public:
+            MeshFileCooker(uint64_t sourceHash) : sourceHash(sourceHash) {}
+
+            void AddMaterial(unsigned int flags, const std::vector<std::string> &diffuseNames,
+                             const std::vector<std::string> &normalNames, const std::vector<std::string> &specularNames)
+            {
+                MaterialRecord record;
+                record.flags = flags;
+                record.firstName = (uint32_t)names.size();
+                record.diffuseCount = (uint32_t)diffuseNames.size();
+                record.normalCount = (uint32_t)normalNames.size();
+                record.specularCount = (uint32_t)specularNames.size();
+
+                names.insert(names.end(), diffuseNames.begin(), diffuseNames.end());
+                names.insert(names.end(), normalNames.begin(), normalNames.end());
+                names.insert(names.end(), specularNames.begin(), specularNames.end());
+                materials.push_back(record);
+            }
+
+            void AddMesh(unsigned int materialIndex, std::vector<MeshData::Vertex> &&vertices, std::vector<unsigned int> &&indices)
+            {
+                MeshRecord record = MeshRecord();
+                record.localTransform = glm::mat4(1);
+                record.materialIndex = materialIndex;
+                record.vertexCount = (uint32_t)vertices.size();
+                record.indexCount = (uint32_t)indices.size();
+                meshes.push_back(record);
+
+                meshVertices.push_back(std::move(vertices));
+                meshIndices.push_back(std::move(indices));
+            }
+
+            void SetLocalTransform(unsigned int meshIndex, const glm::mat4 &transform)
+            {
+                meshes[meshIndex].localTransform = transform;
+            }
+
+            std::vector<char> Serialize()
+            {
+                FileHeader header = FileHeader();
+                header.magic = COOKED_MESH_MAGIC;
+                header.version = COOKED_MESH_VERSION;
+                header.sourceHash = sourceHash;
+                header.vertexSize = sizeof(MeshData::Vertex);
+                header.materialCount = (uint32_t)materials.size();
+                header.meshCount = (uint32_t)meshes.size();
+                header.nameCount = (uint32_t)names.size();
+
+                std::string stringTable;
+                std::vector<NameRecord> nameRecords;
+                for (auto &name : names)
+                {
+                    nameRecords.push_back({(uint32_t)stringTable.size(), (uint32_t)name.size()});
+                    stringTable += name;
+                }
+
+                uint64_t offset = sizeof(FileHeader);
+                header.materialsOffset = offset;
+                offset = Align(offset + materials.size() * sizeof(MaterialRecord));
+                header.meshesOffset = offset;
+                offset = Align(offset + meshes.size() * sizeof(MeshRecord));
+                header.namesOffset = offset;
+                offset += nameRecords.size() * sizeof(NameRecord);
+                header.stringsOffset = offset;
+                header.stringsSize = stringTable.size();
+                offset = Align(offset + stringTable.size());
+
+                for (size_t i = 0; i < meshes.size(); i++)
+                {
+                    meshes[i].vertexOffset = offset;
+                    offset = Align(offset + meshVertices[i].size() * sizeof(MeshData::Vertex));
+                    meshes[i].indexOffset = offset;
+                    offset = Align(offset + meshIndices[i].size() * sizeof(unsigned int));
+                }
+                header.fileSize = offset;
+
+                std::vector<char> blob(offset, 0);
+                std::memcpy(blob.data(), &header, sizeof(FileHeader));
+                CopyArray(blob, header.materialsOffset, materials.data(), materials.size() * sizeof(MaterialRecord));
+                CopyArray(blob, header.meshesOffset, meshes.data(), meshes.size() * sizeof(MeshRecord));
+                CopyArray(blob, header.namesOffset, nameRecords.data(), nameRecords.size() * sizeof(NameRecord));
+                CopyArray(blob, header.stringsOffset, stringTable.data(), stringTable.size());
+
+                for (size_t i = 0; i < meshes.size(); i++)
+                {
+                    CopyArray(blob, meshes[i].vertexOffset, meshVertices[i].data(), meshVertices[i].size() * sizeof(MeshData::Vertex));
+                    CopyArray(blob, meshes[i].indexOffset, meshIndices[i].data(), meshIndices[i].size() * sizeof(unsigned int));
+                }
+
+                return blob;
+            }
+
+        private:
+            uint64_t sourceHash;
+            std::vector<MaterialRecord> materials;
+            std::vector<MeshRecord> meshes;
+            std::vector<std::string> names;
+            std::vector<std::vector<MeshData::Vertex>> meshVertices;
+            std::vector<std::vector<unsigned int>> meshIndices;
+
+            static uint64_t Align(uint64_t offset)
+            {
+                return (offset + COOKED_DATA_ALIGNMENT - 1) & ~(COOKED_DATA_ALIGNMENT - 1);
+            }
+
+            static void CopyArray(std::vector<char> &blob, uint64_t offset, const void *src, size_t bytes)
+            {
+                if (bytes > 0)
+                    std::memcpy(blob.data() + offset, src, bytes);
+            }
+    };
+
+}
+
+#endif
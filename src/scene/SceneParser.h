@@ -6,6 +6,9 @@
 #include <unordered_map>
 #include <memory>
 #include <functional>
+#include <chrono>
+#include <atomic>
+#include <unordered_set>
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
@@ -16,10 +19,13 @@
 
 #include "../common/AssimpHelpers.h"
 #include "../common/JsonHelpers.h"
+#include "../common/JobSystem.h"
+#include "../gl/TextureUploadService.h"
 
 
 #include "Scene.h"
 #include "Camera.h"
+#include "SceneCache.h"
 
 //ObjectBlueprint contains data used to build objects
 struct ObjectBlueprint
@@ -45,9 +51,12 @@ namespace JsonHelpers
             SceneParser(){}
             void Parse(Scene &scene, Camera *camera, const std::string &relativePath, SceneLoadingFormat loadingFormat)
             {
+                auto parseStart = std::chrono::high_resolution_clock::now();
                 sceneFilePath = relativePath;
                 std::cout << "Loading Scene: \n";
                 this->sceneLoadingFormat = loadingFormat;
+                if (textureUploader != nullptr)
+                    scene.SetTextureUploader(textureUploader);
 
                 Json::Reader reader;
 
@@ -104,23 +113,8 @@ namespace JsonHelpers
                 scene.AddLight(glm::vec4(JsonHelpers::GetJsonVec3f(sceneFileRoot["renderer"]["ambientLight"]), 1.0));
 
                 //construct blueprints from object file or use existing ones
-                Json::Value meshArray = sceneFileRoot["scene"]["meshes"];
-
-                for (Json::ArrayIndex meshIndex = 0; meshIndex < meshArray.size(); meshIndex++)
-                {
-                    Json::Value currMesh = meshArray[meshIndex];
-                    std::string meshFilename = currMesh.get("filename", "<unspecified>").asString();
-
-
-                    std::string objFile = BASE_DIR+meshFilename;
-                    std::string meshName = currMesh.get("name", "<unspecified_mesh>").asString();
-
-                    if(objectBlueprints.find(meshName) == objectBlueprints.end())
-                    {
-                        AssimpLoadObjects(scene, objFile, meshName);
-                        materialIdOffset = materialTemplates.size();
-                    }
-                }
+                LoadMeshFiles(scene, sceneFileRoot["scene"]["meshes"]);
+                auto objectsStart = std::chrono::high_resolution_clock::now();
                 
 
                 //use the blueprints to build the objects
@@ -162,6 +156,10 @@ namespace JsonHelpers
                     glm::mat4 rootTransform = glm::mat4(1);
                     rootTransform = glm::translate(rootTransform, worldPosition);
                     rootTransform = glm::scale(rootTransform, scale);
+
+                    // the scene object is a node of the transform graph and each of its submeshes a child node, so the 
+                    // whole object can be moved at runtime through the root node
+                    TransformId rootNode = scene.AddTransform(rootTransform);
                     
                     
                     for (auto &blueprint : objectBlueprints[meshName])
@@ -170,19 +168,17 @@ namespace JsonHelpers
                         materialProperties.albedoColor = glm::vec4(albedo,1.0);
                         materialProperties.specular = specular;
                         
-                        // currently the objects are being copied into a vector, but object bascially only stores
-                        // references, so it doesnt impact as much
-                        auto newObject = scene.AddObject(
+                        // objects bound to a light are drawn unlit
+                        ObjectId newObject = scene.AddObject(
                             blueprint.mesh,
-                            rootTransform * blueprint.localTransform,
+                            scene.AddTransform(blueprint.localTransform, rootNode),
                             materialProperties,
                             materialTemplates[blueprint.materialId],
-                            overrideFlags
+                            hasLight ? overrideFlags | OP_MATERIAL_UNLIT : overrideFlags
                         );
 
                         if(hasLight)
                         {
-                            newObject->materialInstance->AddFlag(OP_MATERIAL_UNLIT);
                             std::string lightType = currObject["Light"]["type"].asString();
 
                             if (lightType == "directional")
@@ -210,6 +206,9 @@ namespace JsonHelpers
 
                 }
 
+                std::cout << "   object construction: " << MillisecondsSince(objectsStart) << " ms\n";
+                std::cout << "   " << scene.GetObjects().GetCount() << " objects in " << scene.GetInstanceGroupCount() << " instance groups\n";
+                std::cout << "Scene loaded in: " << MillisecondsSince(parseStart) << " ms\n";
 
                 /*
                 std::cout << "Loading Success: \n";
@@ -247,6 +246,100 @@ namespace JsonHelpers
 
             }
 
+            // Offline cooking step: imports every mesh file referenced by the scene and writes its cooked version 
+            // next to it. Doesnt require a GL context
+            static void CookScene(const std::string &relativePath)
+            {
+                Json::Reader reader;
+                Json::Value root;
+                std::ifstream fileStream(BASE_DIR + relativePath);
+
+                if (!fileStream.is_open() || !reader.parse(fileStream, root))
+                {
+                    std::cout << "Error: Can't cook scene file " << BASE_DIR + relativePath << "\n";
+                    return;
+                }
+
+                std::unordered_set<std::string> cookedTextures;
+                Json::Value meshArray = root["scene"]["meshes"];
+                for (Json::ArrayIndex meshIndex = 0; meshIndex < meshArray.size(); meshIndex++)
+                {
+                    std::string objFile = BASE_DIR + meshArray[meshIndex].get("filename", "<unspecified>").asString();
+
+                    auto startTime = std::chrono::high_resolution_clock::now();
+                    auto cookedMesh = AssimpCookMeshFile(objFile, SceneCache::HashSourceFiles(objFile));
+                    if (!cookedMesh || !cookedMesh->WriteToFile(objFile + COOKED_MESH_EXTENSION))
+                        continue;
+
+                    std::cout << "Cooked Mesh File: " << objFile << " (" << cookedMesh->GetSize() / 1024 << " KB) in "
+                              << MillisecondsSince(startTime) << " ms\n";
+
+                    std::vector<SceneTexture> textures;
+                    AppendMaterialTextures(*cookedMesh, objFile, textures, cookedTextures);
+                    for (auto &texture : textures)
+                    {
+                        startTime = std::chrono::high_resolution_clock::now();
+                        CookedTextureData cookedTexture = TextureCooker::CookTexture(texture.path, texture.usage);
+                        TextureCooker::SourceStamp sourceStamp;
+                        TextureCooker::GetSourceStamp(texture.path, sourceStamp);
+                        if (cookedTexture.IsValid() && TextureCooker::WriteContainer(texture.path + COOKED_TEXTURE_EXTENSION, cookedTexture,
+                                                                                     Hashing::HashFile(texture.path), sourceStamp, texture.usage))
+                        {
+                            std::cout << "Cooked Texture: " << texture.path << " (" << cookedTexture.GetByteSize() / 1024 << " KB) in "
+                                      << MillisecondsSince(startTime) << " ms\n";
+                        }
+                    }
+                }
+            }
+
+            struct SceneTexture
+            {
+                std::string path;
+                TextureUsage usage;
+            };
+
+            // Lists every texture referenced by the materials of the scene (without loading them). The mesh files are read 
+            // from their cooked version when it is up to date. Doesnt require a GL context
+            static std::vector<SceneTexture> CollectSceneTextures(const std::string &relativePath)
+            {
+                std::vector<SceneTexture> textures;
+                Json::Reader reader;
+                Json::Value root;
+                std::ifstream fileStream(BASE_DIR + relativePath);
+
+                if (!fileStream.is_open() || !reader.parse(fileStream, root))
+                {
+                    std::cout << "Error: Can't read scene file " << BASE_DIR + relativePath << "\n";
+                    return textures;
+                }
+
+                std::unordered_set<std::string> listedTextures;
+                Json::Value meshArray = root["scene"]["meshes"];
+                for (Json::ArrayIndex meshIndex = 0; meshIndex < meshArray.size(); meshIndex++)
+                {
+                    std::string objFile = BASE_DIR + meshArray[meshIndex].get("filename", "<unspecified>").asString();
+                    uint64_t sourceHash = SceneCache::HashSourceFiles(objFile);
+
+                    auto cookedMesh = SceneCache::CookedMeshFile::Open(objFile + COOKED_MESH_EXTENSION, sourceHash);
+                    if (!cookedMesh)
+                        cookedMesh = AssimpCookMeshFile(objFile, sourceHash);
+                    if (cookedMesh)
+                        AppendMaterialTextures(*cookedMesh, objFile, textures, listedTextures);
+                }
+                return textures;
+            }
+
+            // when disabled, the mesh files are always imported with assimp and no cooked file is written
+            bool useCookedMeshes = true;
+
+            // when set, texture pixels are streamed through the uploader instead of being uploaded synchronously. 
+            // The uploads that dont fit during loading continue on the following frames
+            TextureUploadService *textureUploader = nullptr;
+
+            // textures are block compressed and cached next to their source (see TextureCooker.h). When disabled they are
+            // decoded and uploaded uncompressed
+            bool compressTextures = true;
+
         private:
             std::string sceneFilePath;
             Json::Value sceneFileRoot;
@@ -260,7 +353,276 @@ namespace JsonHelpers
             std::vector<MaterialTemplate> materialTemplates;
             unsigned int materialIdOffset = 0;
 
-            void AssimpLoadObjects(Scene &scene, const std::string &objFile, const std::string & meshName)
+            struct ImportedMeshFile
+            {
+                std::string objFile;
+                std::unique_ptr<SceneCache::CookedMeshFile> cookedMesh;
+                bool cacheHit = false;
+                float importTime = 0;
+            };
+
+            // either a cooked (compressed) texture or a decoded image, when compression is disabled
+            struct DecodedTexture
+            {
+                CookedTextureData cooked;
+                TextureImageData image;
+            };
+
+            // appends the textures of every material of the mesh file that arent on listedTextures yet
+            static void AppendMaterialTextures(const SceneCache::CookedMeshFile &cookedMesh, const std::string &objFile, 
+                                               std::vector<SceneTexture> &textures, std::unordered_set<std::string> &listedTextures)
+            {
+                std::string directory = objFile.substr(0, objFile.find_last_of('/'));
+                for (unsigned int i = 0; i < cookedMesh.GetMaterialCount(); i++)
+                {
+                    MaterialTemplate material = cookedMesh.GetMaterial(i);
+                    for (auto *names : {&material.diffuseTextureNames, &material.normalTextureNames, &material.specularTextureNames})
+                    {
+                        TextureUsage usage = names == &material.normalTextureNames ? OP_TEXTURE_USAGE_NORMAL : OP_TEXTURE_USAGE_COLOR;
+                        for (auto &texName : *names)
+                        {
+                            std::string texturePath = directory + '/' + texName;
+                            if (listedTextures.insert(texturePath).second)
+                                textures.push_back({texturePath, TextureCooker::DetectUsage(texturePath, usage)});
+                        }
+                    }
+                }
+            }
+
+            static float MillisecondsSince(std::chrono::high_resolution_clock::time_point start)
+            {
+                return std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            }
+
+            // Loads every new mesh file of the scene along with its textures. The CPU heavy work (mesh import and image decoding)
+            // runs on the job system, while this thread, which owns the GL context, uploads the results. 
+            // Materials, blueprints and textures are always created in scene file order, regardless of the order in which 
+            // the jobs finish
+            void LoadMeshFiles(Scene &scene, const Json::Value &meshArray)
+            {
+                auto phaseStart = std::chrono::high_resolution_clock::now();
+
+                // unique mesh names in scene file order, each pointing to a (unique) mesh file
+                std::vector<std::pair<std::string, unsigned int>> newMeshes;
+                std::vector<ImportedMeshFile> meshFiles;
+                std::unordered_map<std::string, unsigned int> meshFileIndices;
+
+                for (Json::ArrayIndex meshIndex = 0; meshIndex < meshArray.size(); meshIndex++)
+                {
+                    Json::Value currMesh = meshArray[meshIndex];
+                    std::string meshFilename = currMesh.get("filename", "<unspecified>").asString();
+
+                    std::string objFile = BASE_DIR+meshFilename;
+                    std::string meshName = currMesh.get("name", "<unspecified_mesh>").asString();
+
+                    if(objectBlueprints.find(meshName) != objectBlueprints.end())
+                        continue;
+
+                    // reserve the name so that repeated entries are skipped
+                    objectBlueprints[meshName] = std::vector<ObjectBlueprint>();
+
+                    if (meshFileIndices.find(objFile) == meshFileIndices.end())
+                    {
+                        meshFileIndices[objFile] = meshFiles.size();
+                        meshFiles.emplace_back();
+                        meshFiles.back().objFile = objFile;
+                    }
+                    newMeshes.push_back({meshName, meshFileIndices[objFile]});
+                }
+
+                // Mesh import
+                JobSystem::Get().ParallelFor(meshFiles.size(), 1, [&](size_t begin, size_t end){
+                    for (size_t i = begin; i < end; i++)
+                        ImportMeshFile(meshFiles[i]);
+                });
+                float importPhaseTime = MillisecondsSince(phaseStart);
+
+                unsigned int cookedCount = 0;
+                for (auto &meshFile : meshFiles)
+                {
+                    std::cout << "Imported Mesh File: " << meshFile.objFile << (meshFile.cacheHit ? " (cooked) " : " (assimp) ") 
+                              << meshFile.importTime << " ms\n";
+                    cookedCount += meshFile.cacheHit ? 1 : 0;
+                }
+                
+                // Material templates, and the list of textures they need
+                std::vector<unsigned int> materialOffsets;
+                std::vector<std::string> textureNames;
+                std::vector<std::string> texturePaths;
+                std::vector<TextureUsage> textureUsages;
+                std::unordered_set<std::string> queuedTextures;
+
+                for (auto &newMesh : newMeshes)
+                {
+                    materialOffsets.push_back(materialIdOffset);
+                    ImportedMeshFile &meshFile = meshFiles[newMesh.second];
+                    if (!meshFile.cookedMesh)
+                        continue;
+
+                    std::string directory = meshFile.objFile.substr(0, meshFile.objFile.find_last_of('/'));
+                    for (unsigned int i = 0; i < meshFile.cookedMesh->GetMaterialCount(); i++)
+                    {
+                        MaterialTemplate material = meshFile.cookedMesh->GetMaterial(i);
+                        material.id = i + materialIdOffset;
+
+                        for (auto *names : {&material.diffuseTextureNames, &material.normalTextureNames, &material.specularTextureNames})
+                        {
+                            TextureUsage usage = names == &material.normalTextureNames ? OP_TEXTURE_USAGE_NORMAL : OP_TEXTURE_USAGE_COLOR;
+                            for (auto &texName : *names)
+                            {
+                                if (!scene.HasTexture(texName) && queuedTextures.insert(texName).second)
+                                {
+                                    textureNames.push_back(texName);
+                                    texturePaths.push_back(directory + '/' + texName);
+                                    textureUsages.push_back(usage);
+                                }
+                            }
+                        }
+                        materialTemplates.push_back(material);
+                    }
+                    materialIdOffset = materialTemplates.size();
+                }
+
+                // Texture upload, in list order: textures that finish decoding early wait for the previous ones. Only runs 
+                // on this thread, as main thread jobs queued by the decode jobs
+                float textureUploadTime = 0;
+                std::vector<DecodedTexture> pendingTextures(texturePaths.size());
+                std::vector<char> isDecoded(texturePaths.size(), 0);
+                unsigned int nextUpload = 0;
+
+                auto uploadDecoded = [&](unsigned int index){
+                    isDecoded[index] = 1;
+                    while (nextUpload < texturePaths.size() && isDecoded[nextUpload])
+                    {
+                        auto uploadStart = std::chrono::high_resolution_clock::now();
+                        scene.AddTexture(textureNames[nextUpload], texturePaths[nextUpload], textureUsages[nextUpload], UploadTexture(pendingTextures[nextUpload]));
+                        pendingTextures[nextUpload] = DecodedTexture();
+                        textureUploadTime += MillisecondsSince(uploadStart);
+
+                        std::cout << "Loaded Texture: " << texturePaths[nextUpload] << "\n";
+                        nextUpload++;
+                    }
+                };
+
+                // Texture loading (reading cooked textures, or decoding and cooking) runs on the workers while the meshes are uploaded
+                auto decodeStart = std::chrono::high_resolution_clock::now();
+                std::atomic<long long> decodeMicroseconds{0};
+                std::atomic<unsigned int> cookedTextureCount{0};
+                JobCounter decodeJobs;
+                JobCounter uploadJobs;
+
+                for (unsigned int i = 0; i < texturePaths.size(); i++)
+                {
+                    JobSystem::Get().Run([&, i]{
+                        auto taskStart = std::chrono::high_resolution_clock::now();
+
+                        DecodedTexture &decoded = pendingTextures[i];
+                        if (compressTextures)
+                        {
+                            bool cacheHit;
+                            decoded.cooked = TextureCooker::LoadOrCook(texturePaths[i], textureUsages[i], &cacheHit);
+                            cookedTextureCount += cacheHit ? 1 : 0;
+                        }
+                        else
+                        {
+                            decoded.image = Texture2D::LoadImageData(texturePaths[i], textureUsages[i]);
+                        }
+
+                        decodeMicroseconds += std::chrono::duration_cast<std::chrono::microseconds>(
+                            std::chrono::high_resolution_clock::now() - taskStart).count();
+                        JobSystem::Get().RunOnMainThread([&, i]{ uploadDecoded(i); }, &uploadJobs);
+                    }, &decodeJobs);
+                }
+
+                // Mesh upload
+                phaseStart = std::chrono::high_resolution_clock::now();
+                for (unsigned int i = 0; i < newMeshes.size(); i++)
+                {
+                    ImportedMeshFile &meshFile = meshFiles[newMeshes[i].second];
+                    if (meshFile.cookedMesh)
+                        BuildBlueprints(*meshFile.cookedMesh, newMeshes[i].first, materialOffsets[i]);
+                }
+                float meshUploadTime = MillisecondsSince(phaseStart);
+
+                // this thread helps with the decoding and runs the uploads while waiting. Every upload job is queued before
+                // its decode job finishes
+                JobSystem::Get().Wait(decodeJobs);
+                JobSystem::Get().Wait(uploadJobs);
+                float texturePhaseTime = MillisecondsSince(decodeStart);
+
+                std::cout << "Scene loading with " << JobSystem::Get().GetWorkerCount() << " job system workers:\n";
+                std::cout << "   mesh import: " << importPhaseTime << " ms (" << cookedCount << " cooked, " 
+                          << meshFiles.size() - cookedCount << " imported with assimp)\n";
+                std::cout << "   texture decode + upload: " << texturePhaseTime << " ms (" << texturePaths.size() << " textures, " 
+                          << (compressTextures ? std::to_string(cookedTextureCount) + " cooked, " : std::string("uncompressed, "))
+                          << decodeMicroseconds / 1000.0f << " ms decode thread time)\n";
+                std::cout << "   mesh upload: " << meshUploadTime << " ms\n";
+                std::cout << "   texture upload: " << textureUploadTime << " ms" 
+                          << (textureUploader != nullptr ? " (queued on the upload ring)\n" : "\n");
+            }
+
+            Texture2D UploadTexture(DecodedTexture &texture)
+            {
+                if (texture.cooked.IsValid())
+                {
+                    if (textureUploader == nullptr)
+                        return Texture2D::TextureFromCooked(texture.cooked);
+
+                    Texture2D uploaded = Texture2D::TextureFromCookedAsync(std::move(texture.cooked), *textureUploader);
+                    textureUploader->Update();
+                    return uploaded;
+                }
+
+                // a failed cook also ends here, with an empty image
+                if (textureUploader == nullptr)
+                    return Texture2D::TextureFromImage(texture.image);
+
+                Texture2D uploaded = Texture2D::TextureFromImageAsync(std::move(texture.image), *textureUploader);
+                textureUploader->Update();
+                return uploaded;
+            }
+
+            // Maps the cooked version of a mesh file or, if it is missing or stale, imports the file through assimp and 
+            // cooks it for the next runs. Doesnt touch GL, so it can run on any thread
+            void ImportMeshFile(ImportedMeshFile &meshFile) const
+            {
+                auto startTime = std::chrono::high_resolution_clock::now();
+
+                uint64_t sourceHash = SceneCache::HashSourceFiles(meshFile.objFile);
+                std::string cookedFile = meshFile.objFile + COOKED_MESH_EXTENSION;
+
+                if (useCookedMeshes)
+                    meshFile.cookedMesh = SceneCache::CookedMeshFile::Open(cookedFile, sourceHash);
+                
+                meshFile.cacheHit = meshFile.cookedMesh != nullptr;
+                if (!meshFile.cacheHit)
+                {
+                    meshFile.cookedMesh = AssimpCookMeshFile(meshFile.objFile, sourceHash);
+
+                    if (meshFile.cookedMesh && useCookedMeshes)
+                        meshFile.cookedMesh->WriteToFile(cookedFile);
+                }
+
+                meshFile.importTime = MillisecondsSince(startTime);
+            }
+
+            // Builds the blueprints of a mesh file. The vertex data is uploaded directly from the cooked file 
+            // (memory mapped on a cache hit)
+            void BuildBlueprints(const SceneCache::CookedMeshFile &cookedMesh, const std::string &meshName, unsigned int materialOffset)
+            {
+                for (unsigned int m = 0; m < cookedMesh.GetMeshCount(); m++)
+                {
+                    SceneCache::SubMeshView subMesh = cookedMesh.GetMesh(m);
+
+                    auto blueprint = ObjectBlueprint(); 
+                    blueprint.mesh = std::make_shared<Mesh>(subMesh.vertices, subMesh.vertexCount, subMesh.indices, subMesh.indexCount);
+                    blueprint.localTransform = subMesh.localTransform;
+                    blueprint.materialId = subMesh.materialIndex + materialOffset;
+                    objectBlueprints[meshName].push_back(blueprint);
+                }
+            }
+
+            static std::unique_ptr<SceneCache::CookedMeshFile> AssimpCookMeshFile(const std::string &objFile, uint64_t sourceHash)
             {
                 Assimp::Importer import;
                 const aiScene *assimpScene = import.ReadFile(objFile, 
@@ -279,14 +641,11 @@ namespace JsonHelpers
                 if(!assimpScene || assimpScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !assimpScene->mRootNode) 
                 {
                     std::cout << "ERROR::ASSIMP::" << import.GetErrorString() << "\n";
-                    return;
+                    return nullptr;
                 }
                 
-
-                objectBlueprints[meshName] = std::vector<ObjectBlueprint>();
-
-                std::string baseDirectory = objFile.substr(0, objFile.find_last_of('/'));
-                AssimpLoadMaterials(scene, assimpScene, baseDirectory);
+                SceneCache::MeshFileCooker cooker = SceneCache::MeshFileCooker(sourceHash);
+                AssimpCookMaterials(cooker, assimpScene);
 
                 // Loading meshes
                 for(unsigned int m = 0; m < assimpScene->mNumMeshes; m++)
@@ -295,11 +654,13 @@ namespace JsonHelpers
                     
                     std::vector<MeshData::Vertex> mVertices;
                     std::vector<unsigned int> mIndices;
+                    mVertices.reserve(mMesh->mNumVertices);
+                    mIndices.reserve(mMesh->mNumFaces * 3);
 
                     // process vertex positions, normals and texture coordinates for each vertex in the mesh
                     for(unsigned int i = 0; i < mMesh->mNumVertices; i++)
                     {
-                        MeshData::Vertex vertex;
+                        MeshData::Vertex vertex = MeshData::Vertex();
                         vertex.Position = AssimpHelpers::GetGLMVec3(mMesh->mVertices[i]);
 
                         if (mMesh->HasNormals())
@@ -333,70 +694,47 @@ namespace JsonHelpers
                             mIndices.push_back(face.mIndices[j]);
                     }  
 
-
-                    auto meshptr = std::make_shared<Mesh>(mVertices, mIndices);
-                    
-                    auto blueprint = ObjectBlueprint(); 
-                    blueprint.mesh = meshptr;
-                    blueprint.materialId = mMesh->mMaterialIndex + materialIdOffset;
-                    objectBlueprints[meshName].push_back(blueprint);
-
-                    
+                    cooker.AddMesh(mMesh->mMaterialIndex, std::move(mVertices), std::move(mIndices));
                 }
 
-
                 auto identity = glm::mat4(1);
-                ProcessAssimpNode(assimpScene->mRootNode, identity, meshName);
+                ProcessAssimpNode(cooker, assimpScene->mRootNode, identity);
+
+                return SceneCache::CookedMeshFile::FromMemory(cooker.Serialize());
             }  
 
 
-            void ProcessAssimpNode(aiNode *node, glm::mat4 &parentTransform, const std::string &meshName)
+            static void ProcessAssimpNode(SceneCache::MeshFileCooker &cooker, aiNode *node, glm::mat4 &parentTransform)
             {
                 glm::mat4 objectTransform = parentTransform * AssimpHelpers::ConvertMatrixToGLMFormat(node->mTransformation);
 
                 for(unsigned int i = 0; i < node->mNumMeshes; i++)
                 {
                     unsigned int mMeshId = node->mMeshes[i]; 
-                    objectBlueprints[meshName][mMeshId].localTransform = objectTransform;
+                    cooker.SetLocalTransform(mMeshId, objectTransform);
                 }
 
                 for(unsigned int i = 0; i < node->mNumChildren; i++)
                 {
-                    ProcessAssimpNode((node->mChildren[i]), objectTransform, meshName);
+                    ProcessAssimpNode(cooker, (node->mChildren[i]), objectTransform);
                 }
             }  
 
 
-            void AssimpLoadMaterials(Scene &scene, const aiScene *assimpScene, const std::string &directory)
+            static void AssimpCookMaterials(SceneCache::MeshFileCooker &cooker, const aiScene *assimpScene)
             {
                 for (unsigned int i = 0; i < assimpScene->mNumMaterials; i++)
                 {
                     aiMaterial *mMaterial = assimpScene->mMaterials[i];
 
-                    //std::vector<std::string> mTextures;
-
-                    std::vector<std::string> diffuseMaps = LoadMaterialTextures(scene, mMaterial, 
-                                                        aiTextureType_DIFFUSE, OP_TEXTURE_DIFFUSE, directory);
-                    //mTextures.insert(mTextures.end(), diffuseMaps.begin(), diffuseMaps.end());
-                    std::vector<std::string> specularMaps = LoadMaterialTextures(scene, mMaterial, 
-                                                        aiTextureType_SPECULAR, OP_TEXTURE_SPECULAR, directory);
-                    //mTextures.insert(mTextures.end(), specularMaps.begin(), specularMaps.end());
-
-                    std::vector<std::string> normalMaps;
-                    
-                    normalMaps = LoadMaterialTextures(scene, mMaterial, aiTextureType_NORMALS, OP_TEXTURE_NORMAL, directory);
+                    std::vector<std::string> diffuseMaps = GetMaterialTextureNames(mMaterial, aiTextureType_DIFFUSE);
+                    std::vector<std::string> specularMaps = GetMaterialTextureNames(mMaterial, aiTextureType_SPECULAR);
+                    std::vector<std::string> normalMaps = GetMaterialTextureNames(mMaterial, aiTextureType_NORMALS);
                     /*
                     if (sceneLoadingFormat == OP_OBJ) 
                     {
-                        normalMaps = LoadMaterialTextures(mMaterial, aiTextureType_HEIGHT, OP_TEXTURE_NORMAL, directory);
-                    }
-                    else
-                    {
-                        normalMaps = LoadMaterialTextures(mMaterial, aiTextureType_NORMALS, OP_TEXTURE_NORMAL, directory);
+                        normalMaps = GetMaterialTextureNames(mMaterial, aiTextureType_HEIGHT);
                     }*/
-                    //mTextures.insert(mTextures.end(), normalMaps.begin(), normalMaps.end());
-
-
                     
                     unsigned int flags = OP_MATERIAL_DEFAULT;
 
@@ -413,45 +751,25 @@ namespace JsonHelpers
                         flags = flags | OP_MATERIAL_TEXTURED_NORMAL;
                     }
 
-                    MaterialTemplate material = MaterialTemplate(flags);
-                    material.diffuseTextureNames = diffuseMaps;
-                    material.normalTextureNames = normalMaps;
-                    material.specularTextureNames = specularMaps;
-                    material.id = i + materialIdOffset;
-                    materialTemplates.push_back(material);
+                    cooker.AddMaterial(flags, diffuseMaps, normalMaps, specularMaps);
                 }
             }
 
 
-            std::vector<std::string> LoadMaterialTextures(Scene &scene, aiMaterial *mMaterial, aiTextureType type, TextureType OPtype, const std::string &directory)
+            static std::vector<std::string> GetMaterialTextureNames(aiMaterial *mMaterial, aiTextureType type)
             {
-                std::vector<std::string> texturePaths;
+                std::vector<std::string> textureNames;
                 for(unsigned int i = 0; i < mMaterial->GetTextureCount(type); i++)
                 {
                     aiString aiPath;
                     mMaterial->GetTexture(type, i, &aiPath);
-
-                    auto texName = std::string(aiPath.C_Str());
-
-                    if (scene.HasTexture(texName))
-                    {
-                        texturePaths.push_back(texName);
-                    }
-                    else
-                    {   
-                        
-                        auto filePath = directory + '/' + texName;
-                        //Texture2D texture = ;
-
-                        scene.AddTexture(texName, std::move(Texture2D::TextureFromFile(filePath)));
-
-                        std::cout << "Loaded Texture: " << filePath << "\n";
-                        texturePaths.push_back(texName);
-                    }
+                    textureNames.push_back(std::string(aiPath.C_Str()));
                 }
 
-                return texturePaths;
+                return textureNames;
             }
+
+
             /*
             unsigned int TextureFromFile(const char *path, const std::string &directory)
             {
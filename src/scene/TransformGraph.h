@@ -0,0 +1,152 @@
+#ifndef TRANSFORM_GRAPH_H
+#define TRANSFORM_GRAPH_H
+
+#include <cstdint>
+#include <cassert>
+#include <vector>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+#include "../common/JobSystem.h"
+
+/*
+ * Transform hierarchy of the scene. Every node has a local transform and an optional parent, and its world transform
+ * is parentWorld * local.
+ *
+ * Changing a local transform only marks the node as dirty. Update recomputes the world transforms of the dirty nodes
+ * and of everything below them, level by level (every parent is finished before its children), so each level is a
+ * batch of independent nodes that can be split across the job system workers. Nodes outside of dirty subtrees are never recomputed.
+ * After Update, GetChangedNodes lists the nodes whose world transform changed, so dependent data can be updated
+ * incrementally.
+ */
+
+struct TransformId
+{
+    uint32_t index = UINT32_MAX;
+
+    bool IsValid() const { return index != UINT32_MAX; }
+    bool operator == (const TransformId &other) const { return index == other.index; }
+    bool operator != (const TransformId &other) const { return index != other.index; }
+};
+
+class TransformGraph
+{
+    public:
+        // levels with less nodes than this are updated on the calling thread, larger ones in jobs of this many nodes
+        static constexpr size_t PARALLEL_LEVEL_SIZE = 4096;
+
+        // The parent must already exist. The world transform is available right away
+        TransformId Add(const glm::mat4 &localTransform, TransformId parent = TransformId())
+        {
+            assert(!parent.IsValid() || parent.index < parents.size());
+
+            TransformId id;
+            id.index = (uint32_t)parents.size();
+
+            uint32_t depth = parent.IsValid() ? depths[parent.index] + 1 : 0;
+            parents.push_back(parent.index);
+            depths.push_back(depth);
+            localTransforms.push_back(localTransform);
+            worldTransforms.push_back(parent.IsValid() ? worldTransforms[parent.index] * localTransform : localTransform);
+            flags.push_back(NODE_DIRTY);
+            dirtyCount++;
+
+            if (levels.size() <= depth)
+                levels.resize(depth + 1);
+            levels[depth].push_back(id.index);
+            return id;
+        }
+
+        void SetLocalTransform(TransformId id, const glm::mat4 &localTransform)
+        {
+            localTransforms[id.index] = localTransform;
+            if (!(flags[id.index] & NODE_DIRTY))
+            {
+                flags[id.index] |= NODE_DIRTY;
+                dirtyCount++;
+            }
+        }
+
+        const glm::mat4 &GetLocalTransform(TransformId id) const { return localTransforms[id.index]; }
+        const glm::mat4 &GetWorldTransform(TransformId id) const { return worldTransforms[id.index]; }
+        TransformId GetParent(TransformId id) const { return {parents[id.index]}; }
+
+        size_t GetCount() const
+        {
+            return parents.size();
+        }
+
+        // Recomputes the dirty subtrees. Large levels are split across the job system
+        void Update()
+        {
+            changedNodes.clear();
+            if (dirtyCount == 0)
+                return;
+
+            for (auto &level : levels)
+            {
+                JobSystem::Get().ParallelFor(level.size(), PARALLEL_LEVEL_SIZE, [&](size_t begin, size_t end){
+                    UpdateNodes(level.data() + begin, end - begin);
+                });
+            }
+
+            // collected in level order, so parents are listed before their children
+            for (auto &level : levels)
+            {
+                for (uint32_t node : level)
+                {
+                    if (flags[node] & NODE_CHANGED)
+                        changedNodes.push_back({node});
+                }
+            }
+            dirtyCount = 0;
+        }
+
+        // nodes whose world transform changed on the last Update
+        const std::vector<TransformId> &GetChangedNodes() const
+        {
+            return changedNodes;
+        }
+
+    private:
+        enum NodeFlags : uint8_t
+        {
+            NODE_DIRTY = 1 << 0,    // the local transform changed since the last update
+            NODE_CHANGED = 1 << 1   // the world transform changed on the last update
+        };
+
+        // SoA node data, indexed by TransformId
+        std::vector<uint32_t> parents;
+        std::vector<uint32_t> depths;
+        std::vector<glm::mat4> localTransforms;
+        std::vector<glm::mat4> worldTransforms;
+        std::vector<uint8_t> flags;
+
+        // node indices grouped by depth
+        std::vector<std::vector<uint32_t>> levels;
+        std::vector<TransformId> changedNodes;
+        size_t dirtyCount = 0;
+
+        // the parents of the nodes must already be up to date (i.e. belong to a previous level)
+        void UpdateNodes(const uint32_t *nodes, size_t count)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                uint32_t node = nodes[i];
+                uint32_t parent = parents[node];
+                bool parentChanged = parent != UINT32_MAX && (flags[parent] & NODE_CHANGED);
+
+                if ((flags[node] & NODE_DIRTY) || parentChanged)
+                {
+                    worldTransforms[node] = parent != UINT32_MAX ? worldTransforms[parent] * localTransforms[node] : localTransforms[node];
+                    flags[node] = NODE_CHANGED;
+                }
+                else
+                {
+                    flags[node] = 0;
+                }
+            }
+        }
+};
+
+#endif
@@ -3,6 +3,7 @@
 
 
 #include "Object.h"
+#include "ObjectStore.h"
 #include <glm/glm.hpp>
 #include <memory>
 
@@ -22,30 +23,13 @@ class DirectionalLight
         };
         #pragma pack(pop)
 
-        DirectionalLight(glm::vec3 direction, glm::vec3 color, std::shared_ptr<Object> srcObject)
+        DirectionalLight(glm::vec3 direction, glm::vec3 color, ObjectId srcObject)
         {
             this->lightData = DirectionalLightData();
             this->lightData.lightColor = glm::vec4(color.x,color.y,color.z,1.0f);
             this->lightData.lightDirection = glm::vec4(direction, 0.0f);
-
-            glm::mat4 lightProjection = glm::ortho(-40.0f, 40.0f, -40.0f, 40.0f, lightNearPlane, lightFarPlane); 
-
-            if (srcObject != nullptr)
-            {
-                glm::mat4 lightView = glm::lookAt(
-                    glm::vec3(srcObject->objToWorld[3]), 
-                    -direction + glm::vec3(srcObject->objToWorld[3]), 
-                    glm::vec3(0.0f, 1.0f, 0.0f)
-                );  
-
-                this->lightData.lightMatrix = lightProjection * lightView;
-                this->object = srcObject;
-            }
-            else
-            {
-                this->lightData.lightMatrix = glm::mat4(1.0);
-            }
-
+            this->lightData.lightMatrix = glm::mat4(1.0);
+            this->object = srcObject;
         }
         
         //every change that happens to the light will be throgh these functions
@@ -63,14 +47,31 @@ class DirectionalLight
 
         }
 
-        DirectionalLightData GetLightData()
+        //objToWorld is the current transform of the bound object. The light matrix follows the object position
+        DirectionalLightData GetLightData(const glm::mat4 &objToWorld)
         {
+            if (object.IsValid())
+            {
+                glm::mat4 lightProjection = glm::ortho(-40.0f, 40.0f, -40.0f, 40.0f, lightNearPlane, lightFarPlane); 
+                glm::mat4 lightView = glm::lookAt(
+                    glm::vec3(objToWorld[3]), 
+                    -glm::vec3(lightData.lightDirection) + glm::vec3(objToWorld[3]), 
+                    glm::vec3(0.0f, 1.0f, 0.0f)
+                );  
+
+                this->lightData.lightMatrix = lightProjection * lightView;
+            }
             return lightData;
         }
 
+        ObjectId GetObject()
+        {
+            return object;
+        }
+
     private:
         DirectionalLightData lightData;
-        std::shared_ptr<Object> object;
+        ObjectId object;
 };  
 
 
@@ -104,13 +105,12 @@ class PointLight
         };
         #pragma pack(pop)
 
-        PointLight(glm::vec3 color, float c, float l, float q, std::shared_ptr<Object> srcObject)
+        PointLight(glm::vec3 color, float c, float l, float q, ObjectId srcObject)
         {
             this->object = srcObject;
             this->lightData = PointLightData();
             this->lightData.lightColor = glm::vec4(color.x,color.y,color.z,1.0f);
-            this->lightData.position = glm::vec4(srcObject->objToWorld[3]);
-            this->lightData.position.w = 1.0;
+            this->lightData.position = glm::vec4(0.0, 0.0, 0.0, 1.0);
             this->lightData.constant = c;
             this->lightData.linear = l;
             this->lightData.quadratic = q;
@@ -119,16 +119,22 @@ class PointLight
         
 
 
-        PointLightData GetLightData()
+        //objToWorld is the current transform of the bound object
+        PointLightData GetLightData(const glm::mat4 &objToWorld)
         {
-            this->lightData.position = glm::vec4(object->objToWorld[3]);
+            this->lightData.position = glm::vec4(objToWorld[3]);
             this->lightData.position.w = 1.0;
             return lightData;
         }
 
+        ObjectId GetObject()
+        {
+            return object;
+        }
+
     private:
         PointLightData lightData;
-        std::shared_ptr<Object> object;
+        ObjectId object;
 };  
 
 